@@ -46,6 +46,7 @@
 #define TCFS_ANDERSEN_H
 
 #include "llvm/Analysis/Andersen/Constraint.h"
+#include "llvm/Analysis/Andersen/DemandPointsTo.h"
 #include "llvm/Analysis/Andersen/DetectParametersPass.h"
 #include "llvm/Analysis/Andersen/NodeFactory.h"
 #include "llvm/Analysis/Andersen/PtsSet.h"
@@ -60,6 +61,7 @@
 #include <map>
 #include <mutex>
 #include <set>
+#include <tuple>
 #include <vector>
 
 #include <sparsehash/sparse_hash_set>
@@ -79,6 +81,26 @@ public:
   typedef std::map<const llvm::Value *, FunctionIntPairSet_t> StackOffsetMap_t;
   typedef std::set<std::string> StringSet_t;
 
+  /*
+   * What one outer iteration of runOnModule did, written as JSON to
+   * -andersen-stats together with the sizes of the points-to sets.
+   */
+  struct SolverIteration {
+    // Constraints by type, as collected and after HVN and HU.
+    uint64_t Constraints[4] = {};
+    uint64_t Optimized[4] = {};
+    // Nodes merged into another one by each technique.
+    uint64_t MergedHVN = 0;
+    uint64_t MergedHU = 0;
+    uint64_t MergedHCD = 0;
+    uint64_t MergedLCD = 0;
+    uint64_t WorklistPops = 0;
+    uint64_t Calls = 0;
+    double OptimizeSeconds = 0;
+    double SolveSeconds = 0;
+    double CallSeconds = 0;
+  };
+
 private:
   const llvm::DataLayout *dataLayout;
 
@@ -143,6 +165,25 @@ private:
 
   void addProtocolConstraints(std::string className, std::string protocolName);
 
+  std::vector<SolverIteration> solverIterations;
+
+  static bool isStatisticsEnabled();
+  SolverIteration &getSolverIteration();
+  void countConstraints(uint64_t (&Counts)[4]) const;
+  void writeStatistics();
+
+  static bool isConstraintDumpEnabled();
+  void writeConstraintDump();
+
+  // With -pts-demand, the constraints of the last solved iteration, and the
+  // queries answered from them once runOnModule is done.
+  std::vector<AndersConstraint> solvedConstraints;
+  std::unique_ptr<DemandPointsTo> demandPointsTo;
+
+  NodeIndex getQueryNode(const llvm::Value *v) const;
+  void getValuesForPtsSet(const AndersPtsSet &Set,
+                          std::vector<const llvm::Value *> &ptsSet) const;
+
   llvm::Module *Mod;
 
   llvm::raw_ostream *unhandledFunctions;
@@ -155,6 +196,8 @@ private:
   std::mutex unhandledLock;
   std::mutex typeLock;
   std::mutex paramLock;
+  // Guards handledAliases in findAliases.
+  std::mutex aliasLock;
 
   std::map<uint64_t, const llvm::Value *> ivarMap;
   std::map<const llvm::Value *, llvm::Value *> DummyMap;
@@ -182,6 +225,12 @@ public:
   bool getPointsToSet(const llvm::Value *v,
                       std::vector<const llvm::Value *> &ptsSet) const;
 
+  // The same, but answered by a demand-driven query with -pts-demand. A
+  // query over its budget falls back to getPointsToSet.
+  bool getPointsToSetOnDemand(const llvm::Value *v,
+                              std::vector<const llvm::Value *> &ptsSet);
+  void printDemandStatistics(llvm::raw_ostream &OS) const;
+
   // Put all allocation sites (i.e. all memory objects identified by the
   // analysis) into the first arugment
   void
@@ -207,6 +256,25 @@ public:
 
   std::vector<AndersConstraint> &getConstraints() { return constraints; };
 
+  /*
+   * A compact binary form of what the solver starts from: the nodes with
+   * their merge targets, the constraints and the points-to sets so far.
+   * llvm-andersen-replay reads it back into an Andersen without a module,
+   * so the values of the nodes are lost; Names receives the names they had.
+   */
+  void writeConstraintDump(llvm::raw_ostream &OS) const;
+  bool readConstraintDump(llvm::StringRef Data, std::string &Error,
+                          std::vector<std::string> *Names = nullptr);
+  // Optimizes and solves the constraints as one iteration of runOnModule.
+  void replaySolver();
+
+  const std::vector<SolverIteration> &getSolverIterations() const {
+    return solverIterations;
+  }
+  const std::map<NodeIndex, AndersPtsSet> &getPointsToGraph() const {
+    return ptsGraph;
+  }
+
   AndersNodeFactory &getNodeFactory() { return nodeFactory; };
 
   void addToWorklist(llvm::Instruction *v) {
@@ -248,8 +316,30 @@ public:
 
   std::set<const llvm::Value *> handledAliases;
 
+  /*
+   * A stack slot of a function, addressed through one base register. With
+   * -stack-slot-aliases the accessors of a slot alias through its node
+   * instead of a COPY constraint between every pair of them.
+   */
+  struct StackSlot {
+    NodeIndex Node = AndersNodeFactory::InvalidIndex;
+    // Accessors findAliases was asked about; they flow into the slot.
+    std::set<NodeIndex> Sources;
+    // All accessors; the slot flows into them.
+    std::vector<NodeIndex> Members;
+  };
+  typedef std::tuple<const llvm::Function *, uint64_t, int64_t> StackSlotKey_t;
+  std::map<StackSlotKey_t, StackSlot> stackSlots;
+  // COPY constraints for aliases, and how many the pairwise scheme needs.
+  uint64_t aliasConstraints = 0;
+  uint64_t pairwiseAliasConstraints = 0;
+
   bool findAliases(const llvm::Value *Address, bool Sharp = true,
                    uint64_t SPIdx = 3);
+  // In verify mode, checks the slots against the solved points-to sets.
+  void verifyStackSlots();
+  // Reports the alias constraints.
+  void finishStackSlots();
 
   llvm::raw_ostream &getUnhandledStream() { return *unhandledFunctions; }
 
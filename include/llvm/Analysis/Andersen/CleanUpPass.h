@@ -2,8 +2,22 @@
 #define LLVM_CLEANUPPASS_H
 
 #include "llvm/Pass.h"
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace llvm {
+    class raw_ostream;
+
+    /*
+     * Removes the calls to the ARC runtime, which only manage reference
+     * counts and would otherwise show up as external calls on every path.
+     * Only the call sites of the entry points are visited, through their use
+     * lists, and the entry points are erased once no call is left.
+     *
+     * The entry points are the ARC functions unless -cleanup-functions
+     * names others; -cleanup-extra-functions adds to them.
+     */
     class CleanUpPass : public ModulePass {
     public:
         static char ID;
@@ -12,7 +26,13 @@ namespace llvm {
 
         virtual bool runOnModule(Module &M);
 
+        // The calls removed from each entry point by the last run.
+        void printStatistics(raw_ostream &OS) const;
+
+        static std::vector<std::string> getEntryPoints();
+
     private:
+        std::vector<std::pair<std::string, unsigned>> Removed;
     };
 }
 
@@ -0,0 +1,130 @@
+#ifndef ANDERSEN_DEMANDPOINTSTO_H
+#define ANDERSEN_DEMANDPOINTSTO_H
+
+#include "llvm/Analysis/Andersen/Constraint.h"
+#include "llvm/Analysis/Andersen/NodeFactory.h"
+#include "llvm/Analysis/Andersen/PtsSet.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace llvm {
+class raw_ostream;
+}
+
+/*
+ * Answers the points-to set of single nodes from the constraints the solver
+ * got in the last iteration, as CFL-reachability over the constraint graph.
+ * The Andersen rules are evaluated only as far as two kinds of demand need
+ * them: the points-to set of a node, and the nodes an object flows to, which
+ * the stores into a demanded object need. Facts derived for one query are
+ * kept for the next ones.
+ *
+ * A query that takes more than -pts-demand-budget steps gives up, and the
+ * caller falls back to the exhaustive result. Its pending work is not lost,
+ * the next query continues it.
+ *
+ * The whole program is still solved, the calls the Objective-C handlers
+ * resolve depend on it. llvm-slicer-bench -mode=demand compares a pipeline
+ * run with and without -pts-demand.
+ */
+class DemandPointsTo {
+public:
+  DemandPointsTo(const AndersNodeFactory &Nodes,
+                 const std::vector<AndersConstraint> &Constraints);
+
+  static bool isEnabled();
+  static bool isVerifyEnabled();
+
+  // False if the query ran out of budget; PtsSet is left alone then.
+  bool query(NodeIndex Node, AndersPtsSet &PtsSet);
+
+  // Counts a query whose answer differs from the exhaustive one.
+  void recordMismatch() { ++Mismatches; }
+
+  void printStatistics(llvm::raw_ostream &OS) const;
+
+private:
+  enum EdgeKind {
+    AddrOf,     // n = &o, at n
+    AddrOfUser, // n = &o, at o
+    CopyIn,     // n = s, at n
+    CopyOut,    // n = s, at s
+    LoadIn,     // n = *p, at n
+    LoadOut,    // n = *p, at p
+    StoreAt,    // *q = w, at q
+    StoreFrom   // *q = w, at w
+  };
+
+  struct Edge {
+    NodeIndex Node;
+    unsigned Kind;
+    NodeIndex Other;
+
+    bool operator<(const Edge &RHS) const {
+      if (Node != RHS.Node)
+        return Node < RHS.Node;
+      if (Kind != RHS.Kind)
+        return Kind < RHS.Kind;
+      return Other < RHS.Other;
+    }
+    bool operator==(const Edge &RHS) const {
+      return Node == RHS.Node && Kind == RHS.Kind && Other == RHS.Other;
+    }
+  };
+
+  enum WorkKind { NewFact, NewPtsDemand, NewFlowDemand };
+
+  struct WorkItem {
+    WorkKind Kind;
+    NodeIndex Node;
+    NodeIndex Object;
+  };
+
+  const AndersNodeFactory &Nodes;
+
+  // Sorted by node and kind, with the range of each node.
+  std::vector<Edge> Edges;
+  llvm::DenseMap<NodeIndex, std::pair<unsigned, unsigned>> EdgeRanges;
+  // The objects merged into each representative other than itself.
+  llvm::DenseMap<NodeIndex, std::vector<NodeIndex>> MergedObjects;
+
+  // Pts holds the facts by representative, PointedBy the same by object.
+  llvm::DenseMap<NodeIndex, AndersPtsSet> Pts;
+  llvm::DenseMap<NodeIndex, AndersPtsSet> PointedBy;
+  llvm::DenseSet<NodeIndex> PtsDemand;
+  llvm::DenseSet<NodeIndex> FlowDemand;
+  std::deque<WorkItem> Worklist;
+
+  std::mutex Lock;
+
+  uint64_t Queries = 0;
+  uint64_t Fallbacks = 0;
+  uint64_t Steps = 0;
+  uint64_t Mismatches = 0;
+
+  NodeIndex getRep(NodeIndex N) const { return Nodes.getMergeTarget(N); }
+
+  llvm::ArrayRef<Edge> getEdges(NodeIndex N, EdgeKind Kind) const;
+  std::vector<NodeIndex> getObjects(NodeIndex Rep) const;
+
+  // Copies, since adding facts may grow the maps the sets live in.
+  AndersPtsSet getPts(NodeIndex Rep) const;
+  AndersPtsSet getPointedBy(NodeIndex Object) const;
+
+  void addFact(NodeIndex Rep, NodeIndex Object);
+  void demandPts(NodeIndex Rep);
+  void demandFlow(NodeIndex Object);
+
+  void processFact(NodeIndex X, NodeIndex O);
+  void processPtsDemand(NodeIndex N);
+  void processFlowDemand(NodeIndex O);
+};
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef LLVM_EXTERNALMODEL_H
+#define LLVM_EXTERNALMODEL_H
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Analysis/Andersen/DetectParametersPass.h"
+
+class Andersen;
+
+namespace llvm {
+    /*
+     * Register effects of external functions, interpreted at runtime instead
+     * of being compiled into the generated ExternalHandler headers. The model
+     * is the JSON file written by llvm-tblgen -gen-ext-model and is loaded
+     * from -external-models; without that option the generated handlers are
+     * used. The same model drives the slicer, mod/ref and Andersen.
+     */
+    class ExternalModel {
+    public:
+        typedef DetectParametersPass::UserSet_t UserSet_t;
+        // Adds the objects the value points to.
+        typedef std::function<void(const Value *, UserSet_t &)> PointsTo_t;
+
+        enum OpKind { DEF, DEF_MOD, REF, REF1, LOAD, STORE, ALLOC, COPY, LOC };
+
+        struct Operation {
+            OpKind Kind;
+            // Register expressions: the defined or referenced register, or
+            // val/loc, from/to, and reg for the points-to operations.
+            unsigned A;
+            unsigned B;
+            // Type name of ALLOC.
+            std::string Type;
+        };
+
+        struct Function {
+            std::vector<Operation> SliceOps;
+            std::vector<Operation> PtsToOps;
+        };
+
+        /**
+         * The model loaded from -external-models, or nullptr if none was
+         * given. Loaded on first use; a model that can not be read is fatal.
+         */
+        static const ExternalModel *get();
+
+        bool load(StringRef Path, std::string &Error);
+
+        const Function *lookup(StringRef Name) const {
+            auto F = Functions.find(Name);
+            return F == Functions.end() ? nullptr : &F->second;
+        }
+
+        /**
+         * Evaluates register expression Reg at CallInst into Out.
+         * @param andersen needed for DummyObject, may be null otherwise
+         * @param PointsTo resolves Pts and Call, may be empty if the model
+         *                 does not use them in this context
+         */
+        void evaluate(unsigned Reg, const Instruction *CallInst,
+                      Andersen *andersen, const PointsTo_t &PointsTo,
+                      UserSet_t &Out) const;
+
+        // Whether register expression Reg is a Pts, i.e. names memory.
+        bool isPointsTo(unsigned Reg) const {
+            return Registers[Reg].Kind == PTS;
+        }
+
+        // Adds the constraints of F's points-to operations for CallInst.
+        void addConstraints(const Function &F, const Instruction *CallInst,
+                            Andersen *andersen) const;
+
+        size_t size() const { return Functions.size(); }
+
+    private:
+        enum RegKind { PRE, PRE_STORE, POST, DUMMY_OBJECT, PTS, CALL };
+
+        struct Register {
+            RegKind Kind;
+            uint64_t RegNo;
+            // The register PTS dereferences.
+            unsigned Inner;
+            // Name of the DUMMY_OBJECT global.
+            std::string Name;
+        };
+
+        std::vector<Register> Registers;
+        StringMap<Function> Functions;
+    };
+}
+
+#endif //LLVM_EXTERNALMODEL_H
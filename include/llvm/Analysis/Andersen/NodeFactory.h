@@ -73,6 +73,9 @@ private:
     llvm::DenseMap<const llvm::Value*, const llvm::Value*> dummyOriginMap;
 
     std::recursive_mutex nodeLock;
+
+	// Number of nodes merged into another one so far
+	uint64_t numMerges;
 public:
 	AndersNodeFactory();
 
@@ -83,6 +86,8 @@ public:
 	NodeIndex createObjectNode(const llvm::Value* val = nullptr);
 	NodeIndex createReturnNode(const llvm::Function* f);
 	NodeIndex createVarargNode(const llvm::Function* f);
+	// A node without a value, for replaying a constraint dump
+	NodeIndex createNode(AndersNode::AndersNodeType t);
 
 	// Map lookup interfaces (return InvalidIndex if value not found)
 	NodeIndex getValueNodeFor(const llvm::Value* val) const;
@@ -126,6 +131,7 @@ public:
 	void mergeNode(NodeIndex n0, NodeIndex n1);	// Merge n1 into n0
 	NodeIndex getMergeTarget(NodeIndex n);
 	NodeIndex getMergeTarget(NodeIndex n) const;
+	uint64_t getNumMerges() const { return numMerges; }
 
 	// Pointer arithmetic
 	bool isObjectNode(NodeIndex i) const
@@ -1,10 +1,29 @@
 #ifndef LLVM_NONVOLATILEREGISTERSPASS_H
 #define LLVM_NONVOLATILEREGISTERSPASS_H
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/Pass.h"
 #include "llvm/IR/Instruction.h"
 
+#include <utility>
+#include <vector>
+
 namespace llvm {
+    class LoadInst;
+    class StoreInst;
+    class raw_ostream;
+
+    /*
+     * Callee-saved registers and the stack pointer keep their value across
+     * calls. In blocks with calls, a load of such a register from the
+     * register file is replaced with the value last stored to it in the
+     * block, and the stores to callee-saved registers are removed.
+     *
+     * Each block is scanned once from front to back. With
+     * -nonvolatile-threads the functions are scanned in parallel; the
+     * changes are made afterwards on one thread, as they also touch the use
+     * lists of constants shared by all functions.
+     */
     class NonVolatileRegistersPass : public ModulePass {
     public:
         static char ID;
@@ -13,11 +32,25 @@ namespace llvm {
 
         virtual bool runOnModule(Module &M);
 
+        void printStatistics(raw_ostream &OS) const;
+
     private:
+        struct Rewrite {
+            // Loads and the values replacing them, in program order.
+            std::vector<std::pair<LoadInst *, Value *>> Forwarded;
+            std::vector<StoreInst *> DeadStores;
+        };
+
+        void findRewrite(Function &F, Rewrite &R);
+        void verifyRewrite(BasicBlock &BB,
+                           const DenseMap<const Value *, unsigned> &Slots,
+                           const DenseMap<Value *, Value *> &Replacement);
         bool hasCall(const BasicBlock &BB);
         bool isNonVolatile(uint64_t Idx);
         bool isStack(uint64_t Idx);
-        void replaceLoaded(llvm::Instruction *StoreInst);
+
+        unsigned LoadsForwarded = 0;
+        unsigned StoresErased = 0;
     };
 }
 
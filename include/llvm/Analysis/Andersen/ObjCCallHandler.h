@@ -1,9 +1,12 @@
 #ifndef LLVM_OBJCCALLHANDLER_H
 #define LLVM_OBJCCALLHANDLER_H
 
+#include <atomic>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <vector>
 #include "llvm/ADT/StringRef.h"
 #include "llvm/IR/CallSite.h"
 #include "llvm/Analysis/Andersen/SimpleCallGraph.h"
@@ -57,17 +60,40 @@ namespace llvm {
             static CallHandlerManager &getInstance();
 
             template<class T>
-            void registerCallHandler() {
+            void registerCallHandler(StringRef Name) {
 
 //                CallHandlers.insert(std::make_pair(FunctionName, NULL));
 //                CallHandlers.push_back(std::unique_ptr<CallHandlerBase>(new T()));
-                addCallHandler(std::shared_ptr<T>(new T()));
+                addCallHandler(std::shared_ptr<T>(new T()), Name);
             }
 
-            void addCallHandler(std::shared_ptr<CallHandlerBase> Handler);
+            void addCallHandler(std::shared_ptr<CallHandlerBase> Handler, StringRef Name);
             bool handleFunctionCall(const Instruction *CallInst, std::string &F, Andersen *andersen);
 
+            // The calls each handler ran on and the time it took, counted
+            // once enableStatistics() was called.
+            struct HandlerStatistics {
+                std::string Name;
+                uint64_t Calls;
+                uint64_t Handled;
+                double Seconds;
+            };
+            void enableStatistics() { StatisticsEnabled = true; }
+            std::vector<HandlerStatistics> getStatistics() const;
+            // Calls no handler took.
+            uint64_t getNumUnhandled() const { return Unhandled; }
+
         private:
+            struct HandlerCounters {
+                std::string Name;
+                std::atomic<uint64_t> Calls{0};
+                std::atomic<uint64_t> Handled{0};
+                std::atomic<uint64_t> Nanoseconds{0};
+            };
+            std::vector<std::unique_ptr<HandlerCounters>> Counters;
+            std::atomic<bool> StatisticsEnabled{false};
+            std::atomic<uint64_t> Unhandled{0};
+
             typedef std::shared_ptr<CallHandlerBase> CallHandlerPtr_t;
             typedef std::map<StringRef, std::shared_ptr<CallHandlerBase>> CallHandlerMap_t;
             typedef std::vector<CallHandlerPtr_t> CallHandlerList_t;
@@ -81,8 +107,8 @@ namespace llvm {
         template <class T>
         class RegisterCallHandler {
         public:
-            RegisterCallHandler() {
-                getGlobalCallHandlerManager().registerCallHandler<T>();
+            explicit RegisterCallHandler(StringRef Name) {
+                getGlobalCallHandlerManager().registerCallHandler<T>(Name);
             }
         };
 
@@ -44,6 +44,12 @@ namespace llvm {
 
         StringRef getString(uint64_t Address);
 
+        /**
+         * The methods a message to an instance (or with Meta, the class) of
+         * Type may reach, from Type along its superclasses, e.g.
+         * "-[NSMutableData length]", "-[NSData length]". Doesn't change the
+         * binary, so it may be called concurrently.
+         */
         std::deque<std::string> getMethodCandidates(StringRef Type, StringRef Selector, bool Meta);
         std::string getFunctionName(uint64_t Address);
 
@@ -73,6 +79,8 @@ namespace llvm {
         void loadSections();
         void loadClasses();
         void doBinding();
+        // Resolves the superclass of every class once all are known.
+        void linkClasses();
 
         void parseClass(uint64_t DataAddress, bool MetaClass = false);
         std::vector<ObjectiveC::Method> parseMethods(uint64_t MethodsPtr, uint64_t SignatureStartPtr = 0, uint64_t *signaturesIdx = NULL);
@@ -3,9 +3,12 @@
 
 #include "llvm/ADT/StringRef.h"
 
+#include <string>
 #include <vector>
 
 namespace llvm {
+    class raw_ostream;
+
     namespace ObjectiveC {
 
         enum ClassType {
@@ -17,53 +20,112 @@ namespace llvm {
         class IVAR;
         class Protocol;
 
+        /*
+         * Where the arguments of a method are passed on arm64, decoded from
+         * its Objective-C type encoding, e.g. v24@0:8@"NSString"16. Structs,
+         * unions and arrays follow the AAPCS64 rules: homogeneous floating
+         * point aggregates of up to four members go in FPRs, others of up to
+         * 16 bytes in one or two GPRs, larger ones by reference.
+         *
+         * get() decodes every encoding once per process and hands out the
+         * same layout for it from then on; it may be called from any thread.
+         */
+        class MethodLayout {
+        public:
+            typedef std::pair<uint64_t, std::string> RegType_t;
+
+            enum ArgKind { GPR, FPR, Stack };
+
+            struct Arg {
+                ArgKind Kind;
+                // Register file index of the first GPR (X0 is 5), number of
+                // the first FPR (V0 is 0) or the offset on the stack.
+                unsigned Reg;
+                // Registers taken, more than one for a struct.
+                unsigned NumRegs;
+                // The class of an object, if the encoding names it.
+                std::string Class;
+            };
+
+            static const MethodLayout &get(StringRef Encoding);
+            // Decodes without the cache.
+            static MethodLayout decode(StringRef Encoding);
+            static void printStatistics(raw_ostream &OS);
+
+            StringRef getEncoding() const {return Encoding;}
+            // All arguments, self and _cmd included.
+            const std::vector<Arg> &getArgs() const {return Args;}
+            // The GPRs holding objects of a known class.
+            const std::vector<RegType_t> &getRegTypes() const {return RegTypes;}
+            // False if decoding stopped at something it doesn't know; the
+            // arguments before it are still right.
+            bool isComplete() const {return Complete;}
+
+        private:
+            std::string Encoding;
+            std::vector<Arg> Args;
+            std::vector<RegType_t> RegTypes;
+            bool Complete;
+        };
+
+        /*
+         * The classes are filled while ObjectiveCBinary parses the Mach-O and
+         * are not changed afterwards, so lookups may run concurrently and the
+         * references they return stay valid as long as the binary.
+         */
         class Base {
         public:
-            Base(StringRef Classname) : Classname(Classname), Address(0) {}
+            Base(StringRef Classname) : Classname(Classname), Address(0), SuperclassPtr(nullptr) {}
             virtual ~Base() {}
 
-            StringRef getClassName() {
+            StringRef getClassName() const {
                 return Classname;
             }
 
-            StringRef getSuperclass() {return Superclass;};
-            void setSuperclass(StringRef s) {Superclass = s;};
+            StringRef getSuperclass() const {return Superclass;};
+            void setSuperclass(StringRef s) {Superclass = s; SuperclassPtr = nullptr;};
+
+            // The class named by getSuperclass(), once ObjectiveCBinary linked
+            // the classes, or null if the binary doesn't know it.
+            const Base *getSuperclassPtr() const {return SuperclassPtr;}
+            void setSuperclassPtr(const Base *B) {SuperclassPtr = B;}
 
             void setAddress(uint64_t a) { Address = a; }
-            uint64_t getAddress() { return Address; }
+            uint64_t getAddress() const { return Address; }
 
-            virtual ClassType getType() = 0;
+            virtual ClassType getType() const = 0;
         protected:
             StringRef Classname;
             StringRef Superclass;
             uint64_t Address;
+            const Base *SuperclassPtr;
         };
 
         class Class: public Base {
         public:
             typedef std::vector<std::string> ProtocolList_t;
+            typedef std::vector<Method> MethodList_t;
 
             Class(StringRef Classname) : Base(Classname) {}
 
-            virtual ClassType getType() { return ClassType::Initialized; };
-
-
+            virtual ClassType getType() const { return ClassType::Initialized; };
 
             void addMethod(Method M);
-            bool getMethod(StringRef Methodname, Method &M);
+            // The first method added for the selector, or null.
+            const Method *getMethod(StringRef Methodname) const;
 
             void addIVAR(IVAR ivar);
-            bool getIVAR(StringRef IVARName, IVAR &ivar);
-            bool getIVAR(uint64_t IVAROffset, IVAR &ivar);
+            const IVAR *getIVAR(StringRef IVARName) const;
+            const IVAR *getIVAR(uint64_t IVAROffset) const;
 
             void addProtocol(std::string protocol) {
                 protocols.push_back(protocol);
             }
 
-            ProtocolList_t &getProtocolList() {return protocols;}
+            const ProtocolList_t &getProtocolList() const {return protocols;}
+            const MethodList_t &getMethods() const {return Methods;}
         private:
 
-            typedef std::vector<Method> MethodList_t;
             MethodList_t Methods;
 
             typedef std::vector<IVAR> IVARList_t;
@@ -75,26 +137,25 @@ namespace llvm {
         class DummyClass: public Base {
         public:
             DummyClass(StringRef Classname): Base(Classname) {}
-            virtual ClassType getType() { return ClassType::Dummy; };
+            virtual ClassType getType() const { return ClassType::Dummy; };
         };
 
         class Method {
             friend class Class;
         public:
-            typedef std::pair<uint64_t, std::string> RegType_t;
-            Method(StringRef Methodname, uint64_t IMP, StringRef type) : Methodname(Methodname), IMP(IMP), type(type), Parent(0) { parseType();}
-            Method(const Method &M) : Methodname(M.Methodname), IMP(M.IMP), type(M.type), Parent(M.Parent), regTypes(M.regTypes){}
-
-            StringRef getMethodname() {return Methodname;}
-            std::vector<RegType_t> getRegTypes() {return regTypes; };
+            typedef MethodLayout::RegType_t RegType_t;
+            Method(StringRef Methodname, uint64_t IMP, StringRef type) : Methodname(Methodname), IMP(IMP), Layout(&MethodLayout::get(type)), Parent(0) {}
+            Method(const Method &M) : Methodname(M.Methodname), IMP(M.IMP), Layout(M.Layout), Parent(M.Parent) {}
+
+            StringRef getMethodname() const {return Methodname;}
+            StringRef getType() const {return Layout->getEncoding();}
+            const MethodLayout &getLayout() const {return *Layout;}
+            const std::vector<RegType_t> &getRegTypes() const {return Layout->getRegTypes(); };
         private:
             StringRef Methodname;
             uint64_t IMP;
-            std::string type;
+            const MethodLayout *Layout;
             Base *Parent;
-            std::vector<RegType_t> regTypes;
-
-            void parseType();
         };
 
         class IVAR {
@@ -105,9 +166,9 @@ namespace llvm {
             IVAR() {};
 
 //            StringRef getID() {return std::string(ParentClass.str() + "." + IVARName.str());};
-            std::string getID() {return ParentClass.str() + IVARName.str();};
+            std::string getID() const {return ParentClass.str() + IVARName.str();};
 
-            StringRef getType() {return IVARType;}
+            StringRef getType() const {return IVARType;}
         private:
             StringRef IVARName;
             uint64_t OffsetPtr;
@@ -130,8 +191,8 @@ namespace llvm {
             void addInstanceMethod(Method m) { instanceMethods.push_back(m); }
             void addClassMethod(Method m) { classMethods.push_back(m); }
 
-            std::vector<Method> getInstanceMethods() {return instanceMethods;}
-            std::vector<Method> getClassMethods() {return classMethods;}
+            const std::vector<Method> &getInstanceMethods() const {return instanceMethods;}
+            const std::vector<Method> &getClassMethods() const {return classMethods;}
         private:
             std::string protocolName;
             std::vector<Method> instanceMethods;
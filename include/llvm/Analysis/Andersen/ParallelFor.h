@@ -0,0 +1,47 @@
+#ifndef LLVM_PARALLELFOR_H
+#define LLVM_PARALLELFOR_H
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace llvm {
+
+  /**
+   * Calls Body(i) for every i in [0, N) on up to NumThreads threads, the
+   * calling thread included. Indices are handed out one at a time, so the
+   * order in which they are processed is unspecified.
+   * @param  NumThreads 0 selects the number of hardware threads, 1 runs
+   *                    everything on the calling thread
+   */
+  inline void parallelFor(size_t N, unsigned NumThreads,
+                          const std::function<void(size_t)> &Body) {
+    if (!NumThreads)
+      NumThreads = std::max(1u, std::thread::hardware_concurrency());
+    if (NumThreads > N)
+      NumThreads = (unsigned)N;
+
+    if (NumThreads <= 1) {
+      for (size_t i = 0; i < N; ++i)
+        Body(i);
+      return;
+    }
+
+    std::atomic<size_t> Next(0);
+    auto Worker = [&]() {
+      for (size_t i = Next++; i < N; i = Next++)
+        Body(i);
+    };
+
+    std::vector<std::thread> Threads;
+    for (unsigned t = 1; t < NumThreads; ++t)
+      Threads.emplace_back(Worker);
+    Worker();
+    for (auto &T : Threads)
+      T.join();
+  }
+}
+
+#endif //LLVM_PARALLELFOR_H
@@ -0,0 +1,46 @@
+#ifndef LLVM_PHASEPROFILE_H
+#define LLVM_PHASEPROFILE_H
+
+#include <cstdint>
+#include "llvm/ADT/StringRef.h"
+
+namespace llvm {
+    class raw_ostream;
+
+    /*
+     * Time and memory of the phases of the analysis. Phases nest, and a phase
+     * that runs repeatedly, like an Andersen iteration or a rule iteration,
+     * is recorded once per run. Each phase name is also a Timer of the
+     * "Slicer phases" group, so the usual timer report shows the totals.
+     *
+     * Nothing is recorded unless -phase-profile=<file> is given; write()
+     * then stores the profile there as JSON.
+     */
+    class PhaseProfile {
+    public:
+        // Records the enclosing block as a phase.
+        class Scope {
+        public:
+            explicit Scope(StringRef Name);
+            ~Scope();
+
+        private:
+            bool Active;
+        };
+
+        static bool isEnabled();
+
+        static void begin(StringRef Name);
+        static void end();
+
+        // Writes the profile to -phase-profile and prints the timer report.
+        static void write();
+        static void write(raw_ostream &OS);
+
+        // Resident set size of the process now and at its peak, in bytes.
+        static uint64_t getCurrentRSS();
+        static uint64_t getPeakRSS();
+    };
+}
+
+#endif //LLVM_PHASEPROFILE_H
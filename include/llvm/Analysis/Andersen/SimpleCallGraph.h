@@ -1,16 +1,21 @@
 #ifndef LLVM_SIMPLECALLGRAPH_H
 #define LLVM_SIMPLECALLGRAPH_H
 
+#include <atomic>
+#include <deque>
 #include <set>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <vector>
 #include "llvm/ADT/StringRef.h"
 #include "llvm/IR/Instruction.h"
 
 namespace llvm {
     class SimpleCallGraph {
     public:
-        SimpleCallGraph(Module &M): M(M) {};
+        SimpleCallGraph(Module &M)
+            : M(M), Names(nullptr), Version(0), Index(nullptr) {};
         typedef std::set<std::string> FunctionSet_t;
         typedef std::set<const Instruction*> InstructionSet_t;
 
@@ -18,12 +23,21 @@ namespace llvm {
 
         InstructionSet_t &getCallers(std::string F);
         FunctionSet_t &getCalled(const Instruction *Inst);
+        // Unlike getCalled this never inserts, so it may be used concurrently
+        // once the graph is complete. Returns nullptr for unknown calls.
+        const FunctionSet_t *findCalled(const Instruction *Inst) const;
         FunctionSet_t getCalled(const std::string &fun);
         bool containtsEdge(const Instruction *Inst, std::string F);
 
         void finalize();
 
-        bool hasPath(std::string &from, std::string &to);
+        /**
+         * True if a call chain of at least one call leads from one function
+         * to the other. Answered from a reachability index that is rebuilt
+         * once after the graph changed; while it is current, queries take no
+         * lock.
+         */
+        bool hasPath(const std::string &from, const std::string &to);
 
         void print(raw_ostream &ostream);
     private:
@@ -36,10 +50,61 @@ namespace llvm {
         Module &M;
         std::mutex graphLock;
 
-        typedef std::pair<std::string, std::string> FromTo_t;
-        typedef std::map<FromTo_t, bool> PathCache_t;
-        std::mutex pathCacheLock;
-        PathCache_t pathCache;
+        /*
+         * Function level view of the graph. Functions are interned to dense
+         * IDs; every new (caller, callee) pair is appended to FunctionEdges.
+         */
+        typedef unsigned FunctionID_t;
+        struct FunctionName {
+            std::string Name;
+            FunctionID_t ID;
+        };
+        // Open addressing table of the interned functions. Once published,
+        // a slot is only ever set, never changed.
+        struct NameTable {
+            explicit NameTable(unsigned Size);
+            unsigned Mask;
+            std::unique_ptr<std::atomic<const FunctionName *>[]> Slots;
+        };
+
+        // Append only, so the entries never move. Queries read the names
+        // and the published table without a lock; addCallEdge only appends
+        // under graphLock. A full table is replaced by a bigger one, the old
+        // ones are kept for queries still reading them.
+        std::deque<FunctionName> FunctionNames;
+        std::vector<std::unique_ptr<NameTable>> NameTables;
+        std::atomic<const NameTable *> Names;
+        std::vector<std::pair<FunctionID_t, FunctionID_t>> FunctionEdges;
+        std::atomic<unsigned> Version;
+
+        FunctionID_t getFunctionID(StringRef F);
+        // The function if it was interned before the first NumFunctions.
+        const FunctionName *findFunction(StringRef F,
+                                         unsigned NumFunctions) const;
+
+        /*
+         * Immutable snapshot of the function level graph: the callees in
+         * compressed sparse row form and, in the same layout, the sorted
+         * list of SCCs reachable from each SCC over at least one call. It
+         * covers the first NumFunctions functions.
+         */
+        struct ReachabilityIndex {
+            unsigned Version;
+            unsigned NumFunctions;
+            std::vector<unsigned> CalleeOffsets;
+            std::vector<const FunctionName *> Callees;
+            std::vector<unsigned> SCCOf;
+            std::vector<unsigned> ReachableOffsets;
+            std::vector<unsigned> Reachable;
+        };
+
+        std::mutex indexLock;
+        std::atomic<const ReachabilityIndex *> Index;
+        // Outdated snapshots may still be read by concurrent queries, so they
+        // live as long as the graph.
+        std::vector<std::unique_ptr<const ReachabilityIndex>> Indexes;
+
+        const ReachabilityIndex &getIndex();
     };
 }
 
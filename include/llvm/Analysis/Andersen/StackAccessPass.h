@@ -1,20 +1,94 @@
 #ifndef LLVM_STACKACCESSPASS_H
 #define LLVM_STACKACCESSPASS_H
 
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/Pass.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Function.h"
 
+#include <algorithm>
 #include <map>
 #include <vector>
 #include <set>
 #include <deque>
 #include <tuple>
 #include <mutex>
+#include <atomic>
+#include <memory>
 
 namespace llvm {
 
+  /**
+   * A map from keys to lists of values, kept in two flat arrays: the keys
+   * with their lists, sorted by key, and the values of all lists in one
+   * pool. Each list is sorted and holds no duplicates. The map is built at
+   * once by assign() and only read afterwards.
+   */
+  template <typename KeyT, typename ValueT>
+  class FlatListMap {
+  public:
+    typedef ArrayRef<ValueT> List_t;
+    typedef std::pair<KeyT, List_t> Entry_t;
+    typedef typename std::vector<Entry_t>::const_iterator const_iterator;
+    typedef const_iterator iterator;
+
+    FlatListMap() {}
+    FlatListMap(FlatListMap &&) = default;
+    FlatListMap &operator=(FlatListMap &&) = default;
+    // The lists point into Pool.
+    FlatListMap(const FlatListMap &) = delete;
+    FlatListMap &operator=(const FlatListMap &) = delete;
+
+    // Replaces the contents with the (key, value) pairs given.
+    void assign(std::vector<std::pair<KeyT, ValueT>> Pairs) {
+      std::sort(Pairs.begin(), Pairs.end());
+      Pairs.erase(std::unique(Pairs.begin(), Pairs.end()), Pairs.end());
+      Entries.clear();
+      Pool.clear();
+      Pool.reserve(Pairs.size());
+      for (const auto &P : Pairs)
+        Pool.push_back(P.second);
+      for (size_t Begin = 0, End; Begin < Pairs.size(); Begin = End) {
+        for (End = Begin + 1; End < Pairs.size(); ++End)
+          if (Pairs[End].first != Pairs[Begin].first)
+            break;
+        Entries.push_back(std::make_pair(
+            Pairs[Begin].first, List_t(Pool.data() + Begin, End - Begin)));
+      }
+    }
+
+    const_iterator begin() const { return Entries.begin(); }
+    const_iterator end() const { return Entries.end(); }
+    size_t size() const { return Entries.size(); }
+    bool empty() const { return Entries.empty(); }
+
+    // The first entry whose key is not less than Key.
+    const_iterator lower_bound(const KeyT &Key) const {
+      return std::lower_bound(
+          Entries.begin(), Entries.end(), Key,
+          [](const Entry_t &E, const KeyT &K) { return E.first < K; });
+    }
+
+    const_iterator find(const KeyT &Key) const {
+      const_iterator It = lower_bound(Key);
+      return It != end() && It->first == Key ? It : end();
+    }
+
+    size_t count(const KeyT &Key) const { return find(Key) != end(); }
+
+    // The list of Key, empty if it has none.
+    List_t lookup(const KeyT &Key) const {
+      const_iterator It = find(Key);
+      return It == end() ? List_t() : It->second;
+    }
+
+  private:
+    std::vector<Entry_t> Entries;
+    std::vector<ValueT> Pool;
+  };
+
   class StackAccessPass : public ModulePass {
   public:
     static char ID;
@@ -22,13 +96,22 @@ namespace llvm {
     StackAccessPass() : ModulePass(ID) {
     }
 
-    typedef std::set<const Value *> ValueList_t;
-    typedef std::set<int64_t> Int64List_t;
-    typedef std::map<const Value *, std::shared_ptr<Int64List_t>> OffsetMap_t;
-    typedef std::map<int64_t, std::shared_ptr<ValueList_t>> OffsetValueListMap_t;
+    ~StackAccessPass();
+
+    // The stack offsets each access may address, and the accesses of each
+    // offset.
+    typedef FlatListMap<const Value *, int64_t> OffsetMap_t;
+    typedef FlatListMap<int64_t, const Value *> OffsetValueListMap_t;
+    typedef OffsetMap_t::List_t Int64List_t;
+    typedef OffsetValueListMap_t::List_t ValueList_t;
 
     virtual bool runOnModule(Module &M);
 
+    /**
+     * Finds the stack accesses of F through the registers in SPIdx. The
+     * offsets of all values are computed in one forward pass over the
+     * function, see OffsetTable.
+     */
     static void runOnFunction(Function &F, OffsetMap_t &OffsetMap, OffsetValueListMap_t &OffsetValueListMap,
                               std::set<uint64_t> SPIdx);
 
@@ -38,22 +121,38 @@ namespace llvm {
       return "StackAccessPass";
     }
 
-    OffsetMap_t &getOffsets(const Function *F) {
-      if (Offsets.find(F) == Offsets.end())
-        Offsets[F] = std::shared_ptr<OffsetMap_t>(new OffsetMap_t());
-      return *Offsets[F];
+    // The accesses through the stack pointer, i.e. the frame of register 3.
+    const OffsetMap_t &getOffsets(const Function *F) {
+      return getStackFrame(F, 3).Offsets;
     };
 
-    OffsetValueListMap_t &getOffsetValues(const Function *F) {
-      if (ValuesForOffset.find(F) == ValuesForOffset.end())
-        ValuesForOffset[F] = std::shared_ptr<OffsetValueListMap_t>(new OffsetValueListMap_t());
-      return *ValuesForOffset[F];
+    const OffsetValueListMap_t &getOffsetValues(const Function *F) {
+      return getStackFrame(F, 3).Values;
     };
 
     /**
-     * findStackPointer defines if the last store of the stackpointer should be used as starting point
-     * or if false the passed instrution is used
+     * The stack accesses of a function relative to one base register. The
+     * frame of the stack pointer (register 3) is the one runOnModule
+     * computes, which also follows register 0.
+     */
+    struct StackFrame {
+      explicit StackFrame(uint64_t SPIdx) : SPIdx(SPIdx), Next(nullptr) {}
+
+      uint64_t SPIdx;
+      OffsetMap_t Offsets;
+      OffsetValueListMap_t Values;
+      // Next frame of the same function.
+      StackFrame *Next;
+    };
+
+    /**
+     * Returns the frame of F addressed through register SPIdx and computes
+     * it on first use. Lookups of known frames take no lock, so this may be
+     * called concurrently; the returned frame is never modified.
      */
+    const StackFrame &getStackFrame(const Function *F, uint64_t SPIdx);
+
+    void printStatistics(raw_ostream &OS) const;
 
     /**
      * findStackPointer defines if the last store of the stackpointer should be used as starting point
@@ -66,20 +165,29 @@ namespace llvm {
 
   private:
 
-    typedef std::map<const Function *, std::shared_ptr<OffsetMap_t>> FunctionOffsetMap_t;
-    typedef std::map<const Function *, std::shared_ptr<OffsetValueListMap_t>> FunctionOffsetValueListMap_t;
+    class OffsetTable;
 
-    typedef std::pair<Instruction *, int64_t> InstructionOffsetPair_t;
-    typedef std::tuple<Instruction *, int64_t, Instruction *> InstructionOffsetTuple_t;
+    static bool isStackPointer(const Value *Ptr, const std::set<uint64_t> &SPIdx);
 
-    static bool isStackPointer(Value *Ptr, std::set<uint64_t> SPIdx);
+    /*
+     * Frames of each function as a list that only grows at its head. The
+     * map is filled by runOnModule and not changed afterwards; functions
+     * created later go to LateFrames, which needs FramesLock.
+     */
+    typedef std::map<const Function *, std::atomic<StackFrame *>> FrameListMap_t;
+    FrameListMap_t Frames;
+    FrameListMap_t LateFrames;
+    std::mutex FramesLock;
 
-    FunctionOffsetMap_t Offsets;
-    FunctionOffsetValueListMap_t ValuesForOffset;
+    std::atomic<StackFrame *> &getFrameList(const Function *F);
 
-    Function *CurrentFunction;
+    std::atomic<uint64_t> FrameLookups{0};
+    std::atomic<uint64_t> FramesComputed{0};
+    std::atomic<uint64_t> FramesRaced{0};
 
-    std::deque<InstructionOffsetTuple_t> Worklist;
+    // getStackPointerValue by the instruction its walk starts at.
+    DenseMap<const Instruction *, int64_t> StackPointerValues;
+    std::mutex StackPointerLock;
 
     /**
      * Returns the instruction that points to the stack pointer element in the register set
@@ -87,14 +195,6 @@ namespace llvm {
      * @return   The pointer to the stack pointer register
      */
     const Instruction *getStackPointer(const Function *F);
-
-    /**
-     * @param  Inst     The initial instruction to start backtracking
-     * @param  InstList A queue containing all instructions to backtrack
-     * @param  SPIdx    A set containing the indexes of the registers in the register file
-     * @return          All offset candidates at this point (Inst)
-     */
-    static std::set<int64_t> backtrackInstruction(const Instruction *Inst, std::deque<const Instruction *> &InstList, const std::set<uint64_t> SPIdx);
   };
 }
 
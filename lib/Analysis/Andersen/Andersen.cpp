@@ -10,12 +10,14 @@
 
 #include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/Andersen/DetectParametersPass.h"
+#include "llvm/Analysis/Andersen/PhaseProfile.h"
 #include "llvm/Analysis/Andersen/StackAccessPass.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include "algorithm"
 #include "llvm/IR/Instructions.h"
+#include <chrono>
 
 using namespace llvm;
 
@@ -37,6 +39,14 @@ cl::opt<std::string> UnhandledFile("unhandled", cl::desc(""), cl::init(""),
 
 Andersen::Andersen() : llvm::ModulePass(ID) {}
 
+namespace {
+typedef std::chrono::steady_clock Clock;
+
+double secondsSince(Clock::time_point Start) {
+  return std::chrono::duration<double>(Clock::now() - Start).count();
+}
+} // namespace
+
 void Andersen::getAnalysisUsage(AnalysisUsage &AU) const {
   AU.setPreservesAll();
   //	AU.addRequired<DataLayoutPass>();
@@ -51,15 +61,33 @@ void Andersen::getAllAllocationSites(
   nodeFactory.getAllocSites(allocSites);
 }
 
-bool Andersen::getPointsToSet(const llvm::Value *v,
-                              std::vector<const llvm::Value *> &ptsSet) const {
+NodeIndex Andersen::getQueryNode(const llvm::Value *v) const {
   NodeIndex ptrIndex = nodeFactory.getValueNodeFor(v);
   if (ptrIndex == AndersNodeFactory::InvalidIndex) {
     ptrIndex = nodeFactory.getObjectNodeFor(v);
   }
   // We have no idea what v is...
-  if (ptrIndex == AndersNodeFactory::InvalidIndex ||
-      ptrIndex == nodeFactory.getUniversalPtrNode())
+  if (ptrIndex == nodeFactory.getUniversalPtrNode())
+    return AndersNodeFactory::InvalidIndex;
+  return ptrIndex;
+}
+
+void Andersen::getValuesForPtsSet(
+    const AndersPtsSet &Set, std::vector<const llvm::Value *> &ptsSet) const {
+  for (auto v : Set) {
+    if (v == nodeFactory.getNullObjectNode())
+      continue;
+
+    const llvm::Value *val = nodeFactory.getValueForNode(v);
+    if (val != nullptr)
+      ptsSet.push_back(val);
+  }
+}
+
+bool Andersen::getPointsToSet(const llvm::Value *v,
+                              std::vector<const llvm::Value *> &ptsSet) const {
+  NodeIndex ptrIndex = getQueryNode(v);
+  if (ptrIndex == AndersNodeFactory::InvalidIndex)
     return false;
 
   NodeIndex ptrTgt = nodeFactory.getMergeTarget(ptrIndex);
@@ -72,21 +100,53 @@ bool Andersen::getPointsToSet(const llvm::Value *v,
     // want to treat it as a nullptr pointer
     return true;
   }
-  for (auto v : ptsItr->second) {
-    if (v == nodeFactory.getNullObjectNode())
-      continue;
+  getValuesForPtsSet(ptsItr->second, ptsSet);
+  return true;
+}
 
-    const llvm::Value *val = nodeFactory.getValueForNode(v);
-    if (val != nullptr)
-      ptsSet.push_back(val);
+bool Andersen::getPointsToSetOnDemand(
+    const llvm::Value *v, std::vector<const llvm::Value *> &ptsSet) {
+  if (!demandPointsTo)
+    return getPointsToSet(v, ptsSet);
+  NodeIndex ptrIndex = getQueryNode(v);
+  if (ptrIndex == AndersNodeFactory::InvalidIndex)
+    return false;
+
+  AndersPtsSet Set;
+  if (!demandPointsTo->query(ptrIndex, Set))
+    return getPointsToSet(v, ptsSet);
+
+  if (DemandPointsTo::isVerifyEnabled()) {
+    auto ptsItr = ptsGraph.find(nodeFactory.getMergeTarget(ptrIndex));
+    if (!(Set == (ptsItr == ptsGraph.end() ? AndersPtsSet()
+                                             : ptsItr->second))) {
+      demandPointsTo->recordMismatch();
+      std::lock_guard<std::mutex> guard(outputLock);
+      errs() << "[-]demand points-to set of node " << ptrIndex
+             << " differs: " << Set.getSize() << " instead of "
+             << (ptsItr == ptsGraph.end() ? 0 : ptsItr->second.getSize())
+             << " elements\n";
+    }
   }
+
+  ptsSet.clear();
+  getValuesForPtsSet(Set, ptsSet);
   return true;
 }
 
+void Andersen::printDemandStatistics(raw_ostream &OS) const {
+  if (demandPointsTo)
+    demandPointsTo->printStatistics(OS);
+}
+
 bool Andersen::runOnModule(Module &M) {
   errs() << "[+]Start AndersenPass\n";
+  PhaseProfile::Scope ProfileScope("andersen");
   Mod = &M;
   CallGraph = std::unique_ptr<SimpleCallGraph>(new SimpleCallGraph(M));
+  solverIterations.clear();
+  if (isStatisticsEnabled())
+    ObjectiveC::getGlobalCallHandlerManager().enableStatistics();
   // dataLayout = &(getAnalysis<DataLayoutPass>().getDataLayout());
 
   if (!BinaryFile.length())
@@ -161,7 +221,10 @@ bool Andersen::runOnModule(Module &M) {
     }
   }
 
-  collectConstraints(M);
+  {
+    PhaseProfile::Scope ProfileScope("andersen.collectConstraints");
+    collectConstraints(M);
+  }
 
   uint64_t NumConstraints = constraints.size();
 
@@ -335,9 +398,24 @@ bool Andersen::runOnModule(Module &M) {
   int n = 1;
   do {
     {
+      PhaseProfile::Scope IterationScope("andersen.iteration");
+      solverIterations.emplace_back();
       errs() << "Optimize and solve constraints\n";
+      // Overwritten each iteration, so the last one is kept.
+      writeConstraintDump();
+      Clock::time_point Start = Clock::now();
+      PhaseProfile::begin("andersen.optimize");
       optimizeConstraints();
+      PhaseProfile::end();
+      solverIterations.back().OptimizeSeconds = secondsSince(Start);
+      Start = Clock::now();
+      PhaseProfile::begin("andersen.solve");
       solveConstraints();
+      PhaseProfile::end();
+      solverIterations.back().SolveSeconds = secondsSince(Start);
+      verifyStackSlots();
+      if (DemandPointsTo::isEnabled())
+        solvedConstraints = constraints;
       errs() << "End Optimizing and solving constraints\n";
 
       StackAccessPass *SAP = getAnalysisIfAvailable<StackAccessPass>();
@@ -350,17 +428,15 @@ bool Andersen::runOnModule(Module &M) {
         if (f->isDeclaration() || f->isIntrinsic())
           continue;
 
-        StackAccessPass::OffsetMap_t &Offsets = SAP->getOffsets(f);
-
-        StackAccessPass::OffsetMap_t::iterator end = Offsets.end();
+        const StackAccessPass::OffsetMap_t &Offsets = SAP->getOffsets(f);
 
         for (inst_iterator I_it = inst_begin(f); I_it != inst_end(f); ++I_it) {
           const Instruction *I = &*I_it;
-          if (Offsets.find(I) == end)
+          StackAccessPass::OffsetMap_t::const_iterator OffsetList_it =
+              Offsets.find(I);
+          if (OffsetList_it == Offsets.end())
             continue;
-          if (!Offsets[I])
-            continue;
-          StackAccessPass::Int64List_t &OffsetList = *Offsets[I];
+          StackAccessPass::Int64List_t OffsetList = OffsetList_it->second;
 
           std::vector<const Value *> ptsTo;
           getPointsToSet(I, ptsTo);
@@ -382,6 +458,9 @@ bool Andersen::runOnModule(Module &M) {
 
       errs() << "Add function call constraints\n";
       errs() << CallInsts.size() << " Call insts\n";
+      solverIterations.back().Calls = CallInsts.size();
+      Start = Clock::now();
+      PhaseProfile::begin("andersen.callConstraints");
       while (CallInsts.size()) {
         Instruction *i = CallInsts.front();
         CallInsts.pop_front();
@@ -389,6 +468,8 @@ bool Andersen::runOnModule(Module &M) {
         ImmutableCallSite cs(i);
         addConstraintForCall(cs);
       }
+      PhaseProfile::end();
+      solverIterations.back().CallSeconds = secondsSince(Start);
       std::sort(constraints.begin(), constraints.end());
       constraints.erase(std::unique(constraints.begin(), constraints.end()),
                         constraints.end());
@@ -429,6 +510,11 @@ bool Andersen::runOnModule(Module &M) {
     dumpPtsGraphPlainVanilla();
   }
 
+  if (StackAccessPass *SAP = getAnalysisIfAvailable<StackAccessPass>())
+    SAP->printStatistics(errs());
+  finishStackSlots();
+  writeStatistics();
+
   //    CallGraph->finalize();
 
   DEBUG_WITH_TYPE("simple-callgraph", CallGraph->print(errs()););
@@ -440,6 +526,14 @@ bool Andersen::runOnModule(Module &M) {
   if (UnhandledFile.length())
     delete (unhandledFunctions);
 
+  // The constraints of the last round of calls were never solved, so the
+  // demand-driven queries answer from the ones ptsGraph holds the solution of.
+  if (DemandPointsTo::isEnabled()) {
+    PhaseProfile::Scope DemandScope("andersen.demandIndex");
+    demandPointsTo.reset(new DemandPointsTo(nodeFactory, solvedConstraints));
+    solvedConstraints.clear();
+  }
+
   constraints.clear();
 
   return false;
@@ -2,6 +2,7 @@
 #include <llvm/IR/PatternMatch.h>
 
 #include "llvm/Analysis/Andersen/Andersen.h"
+#include "llvm/Analysis/Andersen/ExternalModel.h"
 #include "llvm/IR/Constants.h"
 
 #include "llvm/IR/InstIterator.h"
@@ -76,7 +77,7 @@ bool CallHandlerBase::isSelf(Instruction *v, Andersen *andersen) {
   if (!SAP)
     SAP = &andersen->getAnalysis<StackAccessPass>();
 
-  StackAccessPass::OffsetMap_t &Offsets =
+  const StackAccessPass::OffsetMap_t &Offsets =
       SAP->getOffsets(v->getParent()->getParent());
 
   std::vector<int64_t> StoredAtOffsets;
@@ -93,9 +94,7 @@ bool CallHandlerBase::isSelf(Instruction *v, Andersen *andersen) {
                   dyn_cast<const StoreInst>(IU_it.getUser())) {
             if (Store->getOperand(0) == Self) {
               self_stored = true;
-              if (!O_it.second)
-                continue;
-              for (auto &Off_it : *O_it.second) {
+              for (auto &Off_it : O_it.second) {
                 StoredAtOffsets.push_back(Off_it);
               }
               break;
@@ -109,17 +108,15 @@ bool CallHandlerBase::isSelf(Instruction *v, Andersen *andersen) {
     }
   }
 
-  StackAccessPass::OffsetValueListMap_t &OffsetValues = SAP->getOffsetValues(f);
+  const StackAccessPass::OffsetValueListMap_t &OffsetValues =
+      SAP->getOffsetValues(f);
 
   std::set<const Value *> checked;
 
   for (size_t i = 0; i < StoredAtOffsets.size(); ++i) {
     int64_t O = StoredAtOffsets[i];
     //    for (auto &O : StoredAtOffsets) {
-    if (OffsetValues.find(O) == OffsetValues.end())
-      continue;
-
-    for (auto &V : *OffsetValues[O]) {
+    for (auto &V : OffsetValues.lookup(O)) {
       for (auto &U_it : V->uses()) {
         if (const Instruction *ItoP =
                 dyn_cast<const IntToPtrInst>(U_it.getUser())) {
@@ -137,13 +134,11 @@ bool CallHandlerBase::isSelf(Instruction *v, Andersen *andersen) {
                           dyn_cast<const StoreInst>(LU_it.getUser())) {
                     if (const IntToPtrInst *StoreItoP =
                             dyn_cast<IntToPtrInst>(Store->getOperand(1))) {
-                      if (SAP->getOffsets(f)[StoreItoP->getOperand(0)]) {
-                        StackAccessPass::Int64List_t StoreOffsets =
-                            *SAP->getOffsets(f)[StoreItoP->getOperand(0)];
-                        StoredAtOffsets.insert(StoredAtOffsets.end(),
-                                               StoreOffsets.begin(),
-                                               StoreOffsets.end());
-                      }
+                      StackAccessPass::Int64List_t StoreOffsets =
+                          SAP->getOffsets(f).lookup(StoreItoP->getOperand(0));
+                      StoredAtOffsets.insert(StoredAtOffsets.end(),
+                                             StoreOffsets.begin(),
+                                             StoreOffsets.end());
                     }
                   }
                 }
@@ -284,17 +279,14 @@ bool objcMsgSend::run(const Instruction *CallInst, std::string &F,
               if (const IntToPtrInst *ItoP =
                       dyn_cast<const IntToPtrInst>(store->getOperand(1))) {
                 if (andersen->pointsTo(ItoP, *X0PT_it)) {
-                  if (!andersen->getAnalysis<StackAccessPass>().getOffsets(
-                          (Function *)ItoP->getParent()
-                              ->getParent())[ItoP->getOperand(0)]) {
+                  StackAccessPass::Int64List_t Offsets =
+                      andersen->getAnalysis<StackAccessPass>()
+                          .getOffsets(ItoP->getParent()->getParent())
+                          .lookup(ItoP->getOperand(0));
+                  if (Offsets.empty()) {
                     llvm_unreachable("'self' not stored on stack???");
                   }
 
-                  StackAccessPass::Int64List_t &Offsets =
-                      *andersen->getAnalysis<StackAccessPass>().getOffsets(
-                          (Function *)ItoP->getParent()
-                              ->getParent())[ItoP->getOperand(0)];
-
                   bool cond2 = false;
                   for (BasicBlock::const_iterator I2_it =
                            CallInst->getParent()->begin();
@@ -312,17 +304,13 @@ bool objcMsgSend::run(const Instruction *CallInst, std::string &F,
                       if (const IntToPtrInst *ItoP2 =
                               dyn_cast<const IntToPtrInst>(
                                   store2->getOperand(1))) {
-                        if (!andersen->getAnalysis<StackAccessPass>()
-                                 .getOffsets(
-                                     (Function *)ItoP->getParent()
-                                         ->getParent())[ItoP2->getOperand(0)]) {
+                        StackAccessPass::Int64List_t Offsets2 =
+                            andersen->getAnalysis<StackAccessPass>()
+                                .getOffsets(ItoP2->getParent()->getParent())
+                                .lookup(ItoP2->getOperand(0));
+                        if (Offsets2.empty()) {
                           continue;
                         }
-                        StackAccessPass::Int64List_t &Offsets2 =
-                            *andersen->getAnalysis<StackAccessPass>()
-                                 .getOffsets(
-                                     (Function *)ItoP2->getParent()
-                                         ->getParent())[ItoP2->getOperand(0)];
 
                         bool intersect = false;
                         for (auto O1 : Offsets) {
@@ -688,16 +676,13 @@ bool dispatchBlock::run(const Instruction *CallInst, std::string &F,
       StackAccessPass &StackAccess = andersen->getAnalysis<StackAccessPass>();
 
       for (auto &fs_it : fs) {
-        StackAccessPass::OffsetValueListMap_t &OffsetValues =
-            StackAccess.getOffsetValues((Function *)fs_it.first);
+        const StackAccessPass::OffsetValueListMap_t &OffsetValues =
+            StackAccess.getOffsetValues(fs_it.first);
 
         int64_t BlockAddress = fs_it.second + 16;
 
-        if (!OffsetValues[BlockAddress])
-          continue;
-
-        StackAccessPass::ValueList_t &FunctionAddress =
-            *OffsetValues[BlockAddress];
+        StackAccessPass::ValueList_t FunctionAddress =
+            OffsetValues.lookup(BlockAddress);
 
         for (StackAccessPass::ValueList_t::iterator FAV_it =
                  FunctionAddress.begin();
@@ -710,11 +695,9 @@ bool dispatchBlock::run(const Instruction *CallInst, std::string &F,
             Andersen::FunctionIntPairSet_t blockStackOffsets =
                 andersen->getStackOffsets()[*FAC_it];
             for (auto &blockOffset_it : blockStackOffsets) {
-              if (!StackAccess.getOffsetValues(
-                      (Function *)blockOffset_it.first)[blockOffset_it.second])
-                continue;
-              StackAccessPass::ValueList_t &Vals = *StackAccess.getOffsetValues(
-                  (Function *)blockOffset_it.first)[blockOffset_it.second];
+              StackAccessPass::ValueList_t Vals =
+                  StackAccess.getOffsetValues(blockOffset_it.first)
+                      .lookup(blockOffset_it.second);
               for (auto &V_it : Vals) {
                 for (Value::const_use_iterator ITPUse_it = V_it->use_begin();
                      ITPUse_it != V_it->use_end(); ++ITPUse_it) {
@@ -781,18 +764,19 @@ bool dispatchBlock::run(const Instruction *CallInst, std::string &F,
       Function *Func =
           (Function *)((Instruction *)(*Block_it))->getParent()->getParent();
 
-      StackAccessPass::OffsetMap_t &Offsets = StackAccess.getOffsets(Func);
-      StackAccessPass::OffsetValueListMap_t &OffsetValues =
+      const StackAccessPass::OffsetMap_t &Offsets =
+          StackAccess.getOffsets(Func);
+      const StackAccessPass::OffsetValueListMap_t &OffsetValues =
           StackAccess.getOffsetValues(Func);
 
-      StackAccessPass::Int64List_t &BlockOffsets = *Offsets[*Block_it];
+      StackAccessPass::Int64List_t BlockOffsets = Offsets.lookup(*Block_it);
 
       for (StackAccessPass::Int64List_t::iterator BO_it = BlockOffsets.begin();
            BO_it != BlockOffsets.end(); ++BO_it) {
         int64_t BlockAddress = *BO_it + 16;
 
-        StackAccessPass::ValueList_t &FunctionAddress =
-            *OffsetValues[BlockAddress];
+        StackAccessPass::ValueList_t FunctionAddress =
+            OffsetValues.lookup(BlockAddress);
 
         for (StackAccessPass::ValueList_t::iterator FAV_it =
                  FunctionAddress.begin();
@@ -921,6 +905,9 @@ bool ClassHandler::run(const Instruction *CallInst, std::string &F,
 }
 
 bool ExternalHandler::shouldHandleCall(std::string &F) {
+  // Interpret the -external-models file instead of the generated handlers.
+  if (const ExternalModel *Model = ExternalModel::get())
+    return Model->lookup(F) != nullptr;
   if (llvm::pointsto::canHandleCall(F) && isObjectiveCMethod(F)) {
     return true;
   }
@@ -933,7 +920,14 @@ bool ExternalHandler::run(const Instruction *CallInst, std::string &F,
   if (!andersen->getCallGraph().containtsEdge(CallInst, F)) {
     //                        errs() << AllocMethod << "\n";
 
-    if (llvm::pointsto::handleCall((Instruction *)CallInst, andersen, F)) {
+    if (const ExternalModel *Model = ExternalModel::get()) {
+      const ExternalModel::Function *Fn = Model->lookup(F);
+      if (!Fn)
+        return false;
+      Model->addConstraints(*Fn, CallInst, andersen);
+      andersen->getCallGraph().addCallEdge(CallInst, F);
+    } else if (llvm::pointsto::handleCall(const_cast<Instruction *>(CallInst),
+                                          andersen, F)) {
       andersen->getCallGraph().addCallEdge(CallInst, F);
     } else {
       return false;
@@ -986,17 +980,14 @@ bool MsgSendSuper::run(const Instruction *CallInst, std::string &F,
           if (const IntToPtrInst *ItoP =
                   dyn_cast<const IntToPtrInst>(store->getOperand(1))) {
             if (andersen->pointsTo(ItoP, pts_it)) {
-              if (!andersen->getAnalysis<StackAccessPass>().getOffsets(
-                      (Function *)ItoP->getParent()
-                          ->getParent())[ItoP->getOperand(0)]) {
+              StackAccessPass::Int64List_t Offsets =
+                  andersen->getAnalysis<StackAccessPass>()
+                      .getOffsets(ItoP->getParent()->getParent())
+                      .lookup(ItoP->getOperand(0));
+              if (Offsets.empty()) {
                 llvm_unreachable("'self' not stored on stack???");
               }
 
-              StackAccessPass::Int64List_t &Offsets =
-                  *andersen->getAnalysis<StackAccessPass>().getOffsets(
-                      (Function *)ItoP->getParent()
-                          ->getParent())[ItoP->getOperand(0)];
-
               bool cond2 = false;
               for (BasicBlock::const_iterator I2_it =
                        CallInst->getParent()->begin();
@@ -1012,15 +1003,13 @@ bool MsgSendSuper::run(const Instruction *CallInst, std::string &F,
                         dyn_cast<const StoreInst>(&*I2_it)) {
                   if (const IntToPtrInst *ItoP2 =
                           dyn_cast<const IntToPtrInst>(store2->getOperand(1))) {
-                    if (!andersen->getAnalysis<StackAccessPass>().getOffsets(
-                            (Function *)ItoP->getParent()
-                                ->getParent())[ItoP2->getOperand(0)]) {
+                    StackAccessPass::Int64List_t Offsets2 =
+                        andersen->getAnalysis<StackAccessPass>()
+                            .getOffsets(ItoP2->getParent()->getParent())
+                            .lookup(ItoP2->getOperand(0));
+                    if (Offsets2.empty()) {
                       continue;
                     }
-                    StackAccessPass::Int64List_t &Offsets2 =
-                        *andersen->getAnalysis<StackAccessPass>().getOffsets(
-                            (Function *)ItoP2->getParent()
-                                ->getParent())[ItoP2->getOperand(0)];
 
                     bool intersect = false;
                     for (auto O1 : Offsets) {
@@ -1285,10 +1274,10 @@ bool NSArray::run(const Instruction *CallInst, std::string &F,
 
   StackAccessPass &SAP = andersen->getAnalysis<StackAccessPass>();
 
-  StackAccessPass::OffsetMap_t &stackOffsets =
-      SAP.getOffsets((Function *)CallInst->getParent()->getParent());
-  StackAccessPass::OffsetValueListMap_t &stackOffsetValues =
-      SAP.getOffsetValues((Function *)CallInst->getParent()->getParent());
+  const StackAccessPass::OffsetMap_t &stackOffsets =
+      SAP.getOffsets(CallInst->getParent()->getParent());
+  const StackAccessPass::OffsetValueListMap_t &stackOffsetValues =
+      SAP.getOffsetValues(CallInst->getParent()->getParent());
 
   for (auto &objectParam : objects) {
     // The passed objects should all be stored on the stack in this case
@@ -1301,14 +1290,11 @@ bool NSArray::run(const Instruction *CallInst, std::string &F,
         if (!constNumObjects)
           continue;
 
-        for (auto &startStackOffset : *stackOffsets[objectParam]) {
+        for (auto &startStackOffset : stackOffsets.lookup(objectParam)) {
           for (unsigned stackOffset = 0;
                stackOffset < constNumObjects->getZExtValue(); ++stackOffset) {
-            if (stackOffsetValues.find(startStackOffset + (8 * stackOffset)) ==
-                stackOffsetValues.end())
-              continue;
-            for (auto &offsetValue :
-                 *stackOffsetValues[startStackOffset + (8 * stackOffset)]) {
+            for (auto &offsetValue : stackOffsetValues.lookup(
+                     startStackOffset + (8 * stackOffset))) {
               NodeIndex valIdx =
                   andersen->getNodeFactory().getValueNodeFor(offsetValue);
               if (valIdx == AndersNodeFactory::InvalidIndex)
@@ -1337,10 +1323,10 @@ void NSArray::handleFastEnum(const Instruction *CallInst, Andersen *andersen) {
 
   StackAccessPass &SAP = andersen->getAnalysis<StackAccessPass>();
 
-  StackAccessPass::OffsetMap_t &stackOffsets =
-      SAP.getOffsets((Function *)CallInst->getParent()->getParent());
-  StackAccessPass::OffsetValueListMap_t &stackOffsetValues =
-      SAP.getOffsetValues((Function *)CallInst->getParent()->getParent());
+  const StackAccessPass::OffsetMap_t &stackOffsets =
+      SAP.getOffsets(CallInst->getParent()->getParent());
+  const StackAccessPass::OffsetValueListMap_t &stackOffsetValues =
+      SAP.getOffsetValues(CallInst->getParent()->getParent());
 
   for (auto &array : arrayValues) {
 
@@ -1350,15 +1336,12 @@ void NSArray::handleFastEnum(const Instruction *CallInst, Andersen *andersen) {
 
     for (auto &contextValue : contextValues) {
       if (stackOffsets.find(contextValue) != stackOffsets.end()) {
-        for (uint64_t stackOffset : *stackOffsets[contextValue]) {
+        for (uint64_t stackOffset : stackOffsets.lookup(contextValue)) {
           // The passed 'context' struct has this pointer at offset 8
           uint64_t objectsStart = stackOffset + 8;
 
-          if (stackOffsetValues.find(objectsStart) == stackOffsetValues.end())
-            continue;
-
           //'Forward pattern matching'
-          for (auto &offsetValue : *stackOffsetValues[objectsStart]) {
+          for (auto &offsetValue : stackOffsetValues.lookup(objectsStart)) {
             for (auto offsetUser : offsetValue->users()) {
               const IntToPtrInst *offsetUserInst =
                   dyn_cast<const IntToPtrInst>(offsetUser);
@@ -1,64 +1,118 @@
 #include "llvm/Analysis/Andersen/CleanUpPass.h"
 
+#include "llvm/IR/Constants.h"
 #include "llvm/IR/Function.h"
-#include "llvm/IR/InstIterator.h"
-#include "llvm/IR/Instruction.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
-#include <set>
+#include <iterator>
 #include <string>
 
 using namespace llvm;
 
-bool CleanUpPass::runOnModule(Module &M) {
+static cl::list<std::string> CleanUpFunctions(
+    "cleanup-functions",
+    cl::desc("Runtime functions whose calls -cleanup removes, instead of "
+             "the ARC entry points"),
+    cl::CommaSeparated, cl::Hidden);
+
+static cl::list<std::string> CleanUpExtraFunctions(
+    "cleanup-extra-functions",
+    cl::desc("Further retain/release functions whose calls -cleanup removes, "
+             "e.g. CFRetain,CFRelease"),
+    cl::CommaSeparated, cl::Hidden);
 
-  std::set<std::string> functions;
-  functions.insert("objc_release");
-  functions.insert("objc_retainAutoreleasedReturnValue");
-  functions.insert("objc_autorelease");
-  functions.insert("objc_retainAutorelease");
-  functions.insert("objc_retain");
-  functions.insert("objc_autoreleaseReturnValue");
+static const char *const ARCFunctions[] = {
+    "objc_release",
+    "objc_retainAutoreleasedReturnValue",
+    "objc_autorelease",
+    "objc_retainAutorelease",
+    "objc_retain",
+    "objc_autoreleaseReturnValue",
+};
 
-  std::set<Instruction *> toRemove;
+std::vector<std::string> CleanUpPass::getEntryPoints() {
+  std::vector<std::string> Names(CleanUpFunctions.begin(),
+                                 CleanUpFunctions.end());
+  if (Names.empty())
+    Names.assign(std::begin(ARCFunctions), std::end(ARCFunctions));
+  Names.insert(Names.end(), CleanUpExtraFunctions.begin(),
+               CleanUpExtraFunctions.end());
+  return Names;
+}
 
-  size_t totalCalls = 0;
+/*
+ * Removes a call to a function that returns its first argument or nothing.
+ * The lifted code passes the register file and the object stays in X0, so
+ * the call can simply go; in ordinary IR the result is replaced with the
+ * argument. A call whose result cannot be replaced is kept.
+ */
+static bool removeCall(CallInst *Call) {
+  if (!Call->use_empty()) {
+    if (!Call->getNumArgOperands())
+      return false;
+    Value *Arg = Call->getArgOperand(0);
+    if (Arg->getType() != Call->getType()) {
+      if (!Arg->getType()->isPointerTy() || !Call->getType()->isPointerTy())
+        return false;
+      Arg = CastInst::CreatePointerCast(Arg, Call->getType(), "", Call);
+    }
+    Call->replaceAllUsesWith(Arg);
+  }
+  Call->eraseFromParent();
+  return true;
+}
 
-  for (auto &f : M.functions()) {
+bool CleanUpPass::runOnModule(Module &M) {
+  Removed.clear();
+  bool Changed = false;
 
-    for (inst_iterator i_it = inst_begin(f); i_it != inst_end(f); ++i_it) {
+  for (const std::string &Name : getEntryPoints()) {
+    Function *F = M.getFunction(Name);
+    if (!F)
+      continue;
 
-      if (i_it->getOpcode() == Instruction::Call) {
-        totalCalls++;
-        CallInst *callInst = dyn_cast<CallInst>(&*i_it);
-        Function *calledFunction = callInst->getCalledFunction();
-        if (calledFunction) {
-          if (calledFunction->hasName() &&
-              functions.find(calledFunction->getName()) != functions.end()) {
-            toRemove.insert(callInst);
-          }
-        }
+    // The call sites, also those calling through a cast of the function.
+    std::vector<CallInst *> Calls;
+    std::vector<User *> Users(F->user_begin(), F->user_end());
+    while (!Users.empty()) {
+      User *U = Users.back();
+      Users.pop_back();
+      if (CallInst *Call = dyn_cast<CallInst>(U)) {
+        if (Call->getCalledValue()->stripPointerCasts() == F)
+          Calls.push_back(Call);
+      } else if (ConstantExpr *CE = dyn_cast<ConstantExpr>(U)) {
+        if (CE->isCast())
+          Users.insert(Users.end(), CE->user_begin(), CE->user_end());
       }
     }
-  }
 
-  errs() << "Remove " << toRemove.size() << " calls "
-         << (toRemove.size() * 100) / totalCalls << "%\n";
-
-  for (auto &r : toRemove) {
-    //                r->eraseFromParent();
-    r->removeFromParent();
-  }
+    unsigned Count = 0;
+    for (CallInst *Call : Calls)
+      Count += removeCall(Call);
+    Removed.push_back(std::make_pair(Name, Count));
+    Changed |= Count != 0;
 
-  for (auto &f : functions) {
-    Function *fun = M.getFunction(f);
-    if (fun) {
-      fun->removeFromParent();
+    F->removeDeadConstantUsers();
+    if (F->use_empty()) {
+      F->eraseFromParent();
+      Changed = true;
     }
   }
 
-  return true;
+  printStatistics(errs());
+  return Changed;
+}
+
+void CleanUpPass::printStatistics(raw_ostream &OS) const {
+  unsigned Total = 0;
+  for (auto &R : Removed)
+    Total += R.second;
+  OS << "[+]cleanup: removed " << Total << " calls\n";
+  for (auto &R : Removed)
+    if (R.second)
+      OS << "    " << R.first << ": " << R.second << "\n";
 }
 
 char CleanUpPass::ID = 0;
@@ -20,7 +20,9 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/PatternMatch.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
 
 #define DECOMPILED
@@ -70,6 +72,23 @@
 
 using namespace llvm;
 
+namespace {
+enum StackSlotAliasMode { PairwiseAliases, SlotAliases, VerifySlotAliases };
+}
+
+static cl::opt<StackSlotAliasMode> StackSlotAliases(
+    "stack-slot-aliases",
+    cl::desc("How findAliases relates the accessors of a stack slot"),
+    cl::values(clEnumValN(PairwiseAliases, "pairwise",
+                          "A COPY constraint between every two accessors"),
+               clEnumValN(SlotAliases, "slot",
+                          "One node per slot, connected to its accessors"),
+               clEnumValN(VerifySlotAliases, "verify",
+                          "Like slot, and check the solution against the "
+                          "pairwise constraints"),
+               clEnumValEnd),
+    cl::init(SlotAliases), cl::Hidden);
+
 void Andersen::addProtocolConstraints(std::string className,
                                       std::string protocolName) {
   //    PROTOCOL_METHOD(false, className.data(),
@@ -478,8 +497,8 @@ void Andersen::collectConstraintsForInstruction(const Instruction *inst) {
         StackAccessPass &SAP = getAnalysis<StackAccessPass>();
         Function *f = (Function *)inst->getParent()->getParent();
 
-        StackAccessPass::OffsetMap_t &Offsets = SAP.getOffsets(f);
-        if (Offsets.find(inst->getOperand(0)) != Offsets.end()) {
+        const StackAccessPass::OffsetMap_t &Offsets = SAP.getOffsets(f);
+        if (Offsets.count(inst->getOperand(0))) {
           if (handledAliases.find(inst->getOperand(0)) ==
               handledAliases.end()) {
             NodeIndex valIdx = nodeFactory.getValueNodeFor(inst->getOperand(0));
@@ -1377,85 +1396,101 @@ void Andersen::addArgumentConstraintForCall(ImmutableCallSite cs,
 
 bool Andersen::findAliases(const llvm::Value *Address, bool Sharp,
                            uint64_t SPIdx) {
-  static std::mutex aliasLock;
-  std::unique_lock<std::mutex> lock(aliasLock);
   if (const Instruction *Inst = dyn_cast<const Instruction>(Address)) {
-    Function &F = *((Function *)Inst->getParent()->getParent());
+    const Function *F = Inst->getParent()->getParent();
     StackAccessPass *StackAccess = getAnalysisIfAvailable<StackAccessPass>();
     if (!StackAccess)
       StackAccess = &getAnalysis<StackAccessPass>();
-    StackAccessPass::OffsetMap_t OffsetsTmp;
-    StackAccessPass::OffsetValueListMap_t OffsetValuesTmp;
-    if (SPIdx != 3) {
-      std::set<uint64_t> SPSet;
-      SPSet.insert(SPIdx);
-      StackAccess->runOnFunction(F, OffsetsTmp, OffsetValuesTmp, SPSet);
-    }
-    StackAccessPass::OffsetMap_t &Offsets =
-        SPIdx == 3 ? StackAccess->getOffsets(&F) : OffsetsTmp;
-    StackAccessPass::OffsetValueListMap_t &OffsetValues =
-        SPIdx == 3 ? StackAccess->getOffsetValues(&F) : OffsetValuesTmp;
+    const StackAccessPass::StackFrame &Frame =
+        StackAccess->getStackFrame(F, SPIdx);
+    const StackAccessPass::OffsetMap_t &Offsets = Frame.Offsets;
+    const StackAccessPass::OffsetValueListMap_t &OffsetValues = Frame.Values;
+    StackAccessPass::OffsetMap_t::const_iterator AddressOffsets =
+        Offsets.find(Address);
 
     if (Sharp) {
-      if (Offsets[Address] == nullptr) {
+      if (AddressOffsets == Offsets.end()) {
         return false;
       }
-      for (StackAccessPass::Int64List_t::iterator Offset_it =
-               Offsets[Address]->begin();
-           Offset_it != Offsets[Address]->end(); ++Offset_it) {
-        for (StackAccessPass::ValueList_t::iterator V_it =
-                 OffsetValues[*Offset_it]->begin();
-             V_it != OffsetValues[*Offset_it]->end(); ++V_it) {
-          if (Address == *V_it)
-            continue;
-          NodeIndex idxA = nodeFactory.getValueNodeFor(Address);
-          assert(idxA != AndersNodeFactory::InvalidIndex);
-          NodeIndex idxB = nodeFactory.getValueNodeFor(*V_it);
-          if (idxB == AndersNodeFactory::InvalidIndex) {
-            idxB = nodeFactory.createValueNode(*V_it);
+      NodeIndex idxA = nodeFactory.getValueNodeFor(Address);
+      assert(idxA != AndersNodeFactory::InvalidIndex);
+      auto getValueNode = [&](const Value *V) {
+        NodeIndex idx = nodeFactory.getValueNodeFor(V);
+        if (idx == AndersNodeFactory::InvalidIndex)
+          idx = nodeFactory.createValueNode(V);
+        return idx;
+      };
+
+      std::lock_guard<std::mutex> lock(aliasLock);
+      for (int64_t Offset : AddressOffsets->second) {
+        StackAccessPass::OffsetValueListMap_t::const_iterator Values =
+            OffsetValues.find(Offset);
+        if (Values == OffsetValues.end())
+          continue;
+        unsigned NumAliases =
+            Values->second.size() - std::binary_search(Values->second.begin(),
+                                                       Values->second.end(),
+                                                       Address);
+        pairwiseAliasConstraints += NumAliases;
+        for (const Value *V : Values->second) {
+          if (Address != V)
+            handledAliases.insert(V);
+        }
+
+        if (StackSlotAliases == PairwiseAliases) {
+          for (const Value *V : Values->second) {
+            if (Address != V)
+              addConstraint(AndersConstraint::COPY, getValueNode(V), idxA);
           }
-          addConstraint(AndersConstraint::COPY, idxB, idxA);
-          handledAliases.insert(*V_it);
+          aliasConstraints += NumAliases;
+          continue;
+        }
+
+        // The slot collects the accessors that were asked about and flows
+        // into all of them, so each accessor gets the same points-to set as
+        // with a COPY from every other one.
+        StackSlot &Slot = stackSlots[StackSlotKey_t(F, SPIdx, Offset)];
+        if (Slot.Node == AndersNodeFactory::InvalidIndex) {
+          Slot.Node = nodeFactory.createValueNode();
+          for (const Value *V : Values->second) {
+            NodeIndex idx = getValueNode(V);
+            addConstraint(AndersConstraint::COPY, idx, Slot.Node);
+            Slot.Members.push_back(idx);
+          }
+          aliasConstraints += Slot.Members.size();
+        }
+        if (Slot.Sources.insert(idxA).second) {
+          addConstraint(AndersConstraint::COPY, Slot.Node, idxA);
+          ++aliasConstraints;
         }
       }
     } else {
       return false;
       int64_t min = INT64_MAX;
-      if (!Offsets[Address]) {
+      if (AddressOffsets == Offsets.end()) {
         DEBUG_WITH_TYPE("err", errs() << "CANT FIND ANY BASE POINTER: ";
                         Address->print(errs()); errs() << "\n";);
         min = INT64_MIN;
       } else {
-        for (StackAccessPass::Int64List_t::iterator Offset_it =
-                 Offsets[Address]->begin();
-             Offset_it != Offsets[Address]->end(); ++Offset_it) {
-          if (*Offset_it < min)
-            min = *Offset_it;
+        for (int64_t Offset : AddressOffsets->second) {
+          if (Offset < min)
+            min = Offset;
         }
       }
-      for (StackAccessPass::OffsetValueListMap_t::iterator OV_it =
-               OffsetValues.begin();
+      for (StackAccessPass::OffsetValueListMap_t::const_iterator OV_it =
+               OffsetValues.lower_bound(min);
            OV_it != OffsetValues.end(); ++OV_it) {
-        if (OV_it->first >= min) {
-          if (!OffsetValues[OV_it->first]) {
-            //                        errs() << "Can't find offset values\n";
-            //                        errs() << F.getName() << "\n";
+        for (const Value *V : OV_it->second) {
+          if (Address == V)
             continue;
+          NodeIndex idxA = nodeFactory.getValueNodeFor(Address);
+          assert(idxA != AndersNodeFactory::InvalidIndex);
+          NodeIndex idxB = nodeFactory.getValueNodeFor(V);
+          if (idxB == AndersNodeFactory::InvalidIndex) {
+            idxB = nodeFactory.createValueNode(V);
           }
-          for (StackAccessPass::ValueList_t::iterator V_it =
-                   OffsetValues[OV_it->first]->begin();
-               V_it != OffsetValues[OV_it->first]->end(); ++V_it) {
-            if (Address == *V_it)
-              continue;
-            NodeIndex idxA = nodeFactory.getValueNodeFor(Address);
-            assert(idxA != AndersNodeFactory::InvalidIndex);
-            NodeIndex idxB = nodeFactory.getValueNodeFor(*V_it);
-            if (idxB == AndersNodeFactory::InvalidIndex) {
-              idxB = nodeFactory.createValueNode(*V_it);
-            }
-            addConstraint(AndersConstraint::COPY, idxB, idxA);
-            // TODO: should we insert this into handled aliases?
-          }
+          addConstraint(AndersConstraint::COPY, idxB, idxA);
+          // TODO: should we insert this into handled aliases?
         }
       }
     }
@@ -1463,6 +1498,47 @@ bool Andersen::findAliases(const llvm::Value *Address, bool Sharp,
   return false;
 }
 
+/*
+ * Runs right after a solve, when the constraints of every slot made so far
+ * are solved. Slots made or extended by the calls handled after the last
+ * solve are never solved and so are not compared.
+ */
+void Andersen::verifyStackSlots() {
+  if (StackSlotAliases != VerifySlotAliases)
+    return;
+  auto getPtsSet = [&](NodeIndex idx) {
+    auto It = ptsGraph.find(nodeFactory.getMergeTarget(idx));
+    return It == ptsGraph.end() ? AndersPtsSet() : It->second;
+  };
+  // The pairwise constraints hold and the slot holds nothing else.
+  unsigned Mismatches = 0;
+  for (auto &S : stackSlots) {
+    StackSlot &Slot = S.second;
+    AndersPtsSet Sources;
+    for (NodeIndex idx : Slot.Sources)
+      Sources.unionWith(getPtsSet(idx));
+    bool Equivalent = Sources.contains(getPtsSet(Slot.Node)) &&
+                      getPtsSet(Slot.Node).contains(Sources);
+    for (NodeIndex idx : Slot.Members)
+      Equivalent &= getPtsSet(idx).contains(Sources);
+    Mismatches += !Equivalent;
+  }
+  if (Mismatches)
+    report_fatal_error(Twine(Mismatches) + " stack slots differ from the "
+                                           "pairwise alias constraints");
+}
+
+void Andersen::finishStackSlots() {
+  errs() << "[+]stack aliases: " << aliasConstraints
+         << " COPY constraints, " << pairwiseAliasConstraints
+         << " pairwise, " << stackSlots.size() << " slots\n";
+  if (StackSlotAliases == VerifySlotAliases)
+    errs() << "[+]stack aliases: all solved slots match the pairwise "
+              "constraints\n";
+  stackSlots.clear();
+  aliasConstraints = pairwiseAliasConstraints = 0;
+}
+
 Instruction *Andersen::findSetStackParameterInstruction(
     Instruction *CallInst,
     DetectParametersPass::ParameterAccessPair_t Parameter, int64_t StackSize,
@@ -1489,14 +1565,11 @@ Instruction *Andersen::findSetStackParameterInstruction(
   StackAccessPass *StackAccess = getAnalysisIfAvailable<StackAccessPass>();
   if (!StackAccess)
     StackAccess = &getAnalysis<StackAccessPass>();
-  StackAccessPass::OffsetValueListMap_t &ValueMap =
+  const StackAccessPass::OffsetValueListMap_t &ValueMap =
       StackAccess->getOffsetValues(F);
-  if (ValueMap[Offset] == nullptr) {
+  StackAccessPass::ValueList_t Values = ValueMap.lookup(Offset);
+  if (Values.empty())
     return nullptr;
-  }
-  StackAccessPass::ValueList_t &Values = *ValueMap[Offset];
-  if (!Values.size())
-    llvm_unreachable("Can't find Instruction that sets the parameter");
 
   NodeIndex idxA = nodeFactory.getValueNodeFor(*Values.begin());
   if (idxA == AndersNodeFactory::InvalidIndex) {
@@ -1523,19 +1596,21 @@ Instruction *Andersen::findSetStackParameterInstruction(
           if (!S)
             continue;
 
-          StackAccessPass::OffsetMap_t &Offsets = StackAccess->getOffsets(F);
+          const StackAccessPass::OffsetMap_t &Offsets =
+              StackAccess->getOffsets(F);
+          StackAccessPass::OffsetMap_t::const_iterator StoreOffsets =
+              Offsets.find(S->getOperand(0));
+          if (StoreOffsets == Offsets.end())
+            continue;
           for (StackAccessPass::Int64List_t::iterator O_it =
-                   Offsets[S->getOperand(0)]->begin();
-               O_it != Offsets[S->getOperand(0)]->end(); ++O_it) {
+                   StoreOffsets->second.begin();
+               O_it != StoreOffsets->second.end(); ++O_it) {
             int64_t O1 = *O_it + 8;
             int64_t O2 = *O_it + CopyInParent;
-            if (ValueMap[O1] == nullptr)
-              continue;
-            if (ValueMap[O2] == nullptr)
+            StackAccessPass::ValueList_t VList1 = ValueMap.lookup(O1);
+            StackAccessPass::ValueList_t VList2 = ValueMap.lookup(O2);
+            if (VList1.empty() || VList2.empty())
               continue;
-            StackAccessPass::ValueList_t &VList1 = *ValueMap[O1];
-            StackAccessPass::ValueList_t &VList2 = *ValueMap[O2];
-            assert(VList1.size() && VList2.size());
 
             for (StackAccessPass::ValueList_t::iterator V1_it = VList1.begin();
                  V1_it != VList1.end(); ++V1_it) {
@@ -1580,20 +1655,19 @@ Instruction *Andersen::findSetRegisterParameterInstruction(
     Instruction *CallInst,
     DetectParametersPass::ParameterAccessPair_t Parameter) {
   std::unique_lock<std::mutex> lock(paramLock);
-  StackAccessPass::OffsetMap_t OffsetMap_param;
-  StackAccessPass::OffsetValueListMap_t OffsetValueListMap_param;
-  std::set<uint64_t> SPIdx;
-  SPIdx.insert(Parameter.first);
-  StackAccessPass::runOnFunction(*Parameter.second->getParent()->getParent(),
-                                 OffsetMap_param, OffsetValueListMap_param,
-                                 SPIdx);
-
   StackAccessPass *SAP = &getAnalysis<StackAccessPass>();
 
-  StackAccessPass::OffsetMap_t &OffsetMap_caller =
-      SAP->getOffsets(CallInst->getParent()->getParent());
-  StackAccessPass::OffsetValueListMap_t &OffsetValueListMap_caller =
-      SAP->getOffsetValues(CallInst->getParent()->getParent());
+  const StackAccessPass::StackFrame &ParamFrame = SAP->getStackFrame(
+      Parameter.second->getParent()->getParent(), Parameter.first);
+  const StackAccessPass::OffsetValueListMap_t &OffsetValueListMap_param =
+      ParamFrame.Values;
+
+  // Read concurrently by findAliases, so only looked up here.
+  const StackAccessPass::StackFrame &CallerFrame =
+      SAP->getStackFrame(CallInst->getParent()->getParent(), 3);
+  const StackAccessPass::OffsetMap_t &OffsetMap_caller = CallerFrame.Offsets;
+  const StackAccessPass::OffsetValueListMap_t &OffsetValueListMap_caller =
+      CallerFrame.Values;
 
   std::set<int64_t> OffsetsToFind;
 
@@ -1620,11 +1694,11 @@ Instruction *Andersen::findSetRegisterParameterInstruction(
       srcIndex = nodeFactory.createValueNode(*Pre_it);
     addConstraint(AndersConstraint::COPY, dstIndex, srcIndex);
 
-    if (OffsetMap_caller.find(*Pre_it) != OffsetMap_caller.end()) {
+    StackAccessPass::OffsetMap_t::const_iterator CallerOffsets =
+        OffsetMap_caller.find(*Pre_it);
+    if (CallerOffsets != OffsetMap_caller.end()) {
       // This means that this is a stack address
-      if (!OffsetMap_caller[*Pre_it])
-        continue;
-      if (OffsetMap_caller[*Pre_it]->size()) {
+      if (CallerOffsets->second.size()) {
         std::vector<const Value *> ptsTo;
         getPointsToSet(*Pre_it, ptsTo);
         if (ptsTo.size() == 0) {
@@ -1638,11 +1712,12 @@ Instruction *Andersen::findSetRegisterParameterInstruction(
         }
       }
       for (auto &O : OffsetsToFind) {
-        for (auto &O_C : *OffsetMap_caller[*Pre_it]) {
+        for (auto &O_C : CallerOffsets->second) {
           int Find = O_C + O;
-          if (OffsetValueListMap_caller[Find]) {
-            for (auto &OV_caller : *OffsetValueListMap_caller[Find]) {
-              for (auto &OV_param : *OffsetValueListMap_param[O]) {
+          auto CallerValues = OffsetValueListMap_caller.find(Find);
+          if (CallerValues != OffsetValueListMap_caller.end()) {
+            for (auto &OV_caller : CallerValues->second) {
+              for (auto &OV_param : OffsetValueListMap_param.lookup(O)) {
                 NodeIndex dstIndex2 = nodeFactory.getValueNodeFor(OV_param);
                 if (dstIndex2 == AndersNodeFactory::InvalidIndex)
                   dstIndex2 = nodeFactory.createValueNode(OV_param);
@@ -1934,18 +2009,16 @@ bool Andersen::isBlock(const llvm::Instruction *Inst, const llvm::Value *&B) {
       if (!I)
         continue;
       StackAccessPass &SAP = getAnalysis<StackAccessPass>();
-      StackAccessPass::OffsetMap_t &Offsets = SAP.getOffsets(
-          ((Instruction *)(*PtsTo_it))->getParent()->getParent());
-      StackAccessPass::OffsetValueListMap_t &OffsetValues = SAP.getOffsetValues(
-          ((Instruction *)(*PtsTo_it))->getParent()->getParent());
-      if (!Offsets[*PtsTo_it])
-        continue;
-      for (StackAccessPass::Int64List_t::iterator O_it =
-               Offsets[*PtsTo_it]->begin();
-           O_it != Offsets[*PtsTo_it]->end(); ++O_it) {
-        for (StackAccessPass::ValueList_t::iterator V_it =
-                 OffsetValues[*O_it]->begin();
-             V_it != OffsetValues[*O_it]->end(); ++V_it) {
+      const StackAccessPass::OffsetMap_t &Offsets =
+          SAP.getOffsets(I->getParent()->getParent());
+      const StackAccessPass::OffsetValueListMap_t &OffsetValues =
+          SAP.getOffsetValues(I->getParent()->getParent());
+      StackAccessPass::Int64List_t PtsToOffsets = Offsets.lookup(I);
+      for (StackAccessPass::Int64List_t::iterator O_it = PtsToOffsets.begin();
+           O_it != PtsToOffsets.end(); ++O_it) {
+        StackAccessPass::ValueList_t Values = OffsetValues.lookup(*O_it);
+        for (StackAccessPass::ValueList_t::iterator V_it = Values.begin();
+             V_it != Values.end(); ++V_it) {
           for (std::set<Value *>::iterator B_it = Blocks.begin();
                B_it != Blocks.end(); ++B_it) {
             if (*B_it == *V_it) {
@@ -1973,11 +2046,11 @@ bool Andersen::handleBlock(const Instruction *Call, const Value *Block) {
         cast<const Instruction>((*PtsTo_it))->getParent()->getParent();
     StackAccessPass &StackAccess = getAnalysis<StackAccessPass>();
 
-    StackAccessPass::OffsetMap_t &Offsets = StackAccess.getOffsets(Func);
-    StackAccessPass::OffsetValueListMap_t &OffsetValues =
+    const StackAccessPass::OffsetMap_t &Offsets = StackAccess.getOffsets(Func);
+    const StackAccessPass::OffsetValueListMap_t &OffsetValues =
         StackAccess.getOffsetValues(Func);
 
-    StackAccessPass::Int64List_t &BlockOffsets = *Offsets[*PtsTo_it];
+    StackAccessPass::Int64List_t BlockOffsets = Offsets.lookup(*PtsTo_it);
 
     for (StackAccessPass::Int64List_t::iterator BO_it = BlockOffsets.begin();
          BO_it != BlockOffsets.end(); ++BO_it) {
@@ -1985,8 +2058,8 @@ bool Andersen::handleBlock(const Instruction *Call, const Value *Block) {
       // object
       int64_t BlockAddress = *BO_it + 16;
 
-      StackAccessPass::ValueList_t &FunctionAddress =
-          *OffsetValues[BlockAddress];
+      StackAccessPass::ValueList_t FunctionAddress =
+          OffsetValues.lookup(BlockAddress);
 
       for (StackAccessPass::ValueList_t::iterator FAV_it =
                FunctionAddress.begin();
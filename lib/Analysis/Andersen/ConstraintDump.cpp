@@ -0,0 +1,297 @@
+#include "llvm/Analysis/Andersen/Andersen.h"
+
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace llvm;
+
+static cl::opt<std::string> DumpConstraintBinary(
+    "dump-cons-binary",
+    cl::desc("Write the constraints the solver gets in the last iteration to "
+             "this file, for llvm-andersen-replay"),
+    cl::init(""), cl::Hidden);
+
+/*
+ * The dump is "ANDC", a version and then unsigned LEB128 numbers only:
+ *
+ *  - the nodes: their number, then per node a byte of NodeFlags, its merge
+ *    target if merged and its name if named (length and bytes),
+ *  - the constraints of each type in the order of ConstraintType: their
+ *    number, then destination and source per constraint, sorted, the
+ *    destination as the difference to the one before and the source as the
+ *    difference to the one before if the destination is the same,
+ *  - the points-to sets: their number, then per set the node as the
+ *    difference to the one before, the size and the elements, each as the
+ *    difference to the one before.
+ */
+namespace {
+const char DumpMagic[] = {'A', 'N', 'D', 'C'};
+const uint64_t DumpVersion = 1;
+
+enum NodeFlags { ObjectNode = 1, MergedNode = 2, NamedNode = 4 };
+
+class DumpReader {
+public:
+  DumpReader(StringRef Data, std::string &Error) : Data(Data), Error(Error) {}
+
+  bool readMagic() {
+    if (!Data.startswith(StringRef(DumpMagic, sizeof(DumpMagic))))
+      return fail("not a constraint dump");
+    Pos = sizeof(DumpMagic);
+    return true;
+  }
+
+  bool read(uint64_t &Value) {
+    Value = 0;
+    for (unsigned Shift = 0; Pos < Data.size(); Shift += 7) {
+      uint8_t Byte = Data[Pos++];
+      if (Shift > 63 || (Shift == 63 && (Byte & 0x7e)))
+        return fail("number out of range");
+      Value |= uint64_t(Byte & 0x7f) << Shift;
+      if (!(Byte & 0x80))
+        return true;
+    }
+    return fail("truncated");
+  }
+
+  // A number that is below Limit.
+  bool read(uint64_t &Value, uint64_t Limit, const char *What) {
+    if (!read(Value))
+      return false;
+    if (Value >= Limit)
+      return fail(Twine(What) + " out of range");
+    return true;
+  }
+
+  bool readByte(uint8_t &Byte) {
+    if (Pos == Data.size())
+      return fail("truncated");
+    Byte = Data[Pos++];
+    return true;
+  }
+
+  bool readString(std::string &S) {
+    uint64_t Size;
+    if (!read(Size, remaining() + 1, "name length"))
+      return false;
+    S = Data.substr(Pos, Size);
+    Pos += Size;
+    return true;
+  }
+
+  // Every element takes a byte at least, which bounds a count.
+  uint64_t remaining() const { return Data.size() - Pos; }
+  bool atEnd() const { return Pos == Data.size(); }
+
+  bool fail(const Twine &Message) {
+    Error = (Message + " at offset " + Twine(Pos)).str();
+    return false;
+  }
+
+private:
+  StringRef Data;
+  std::string &Error;
+  size_t Pos = 0;
+};
+} // namespace
+
+bool Andersen::isConstraintDumpEnabled() {
+  return !DumpConstraintBinary.empty();
+}
+
+void Andersen::writeConstraintDump() {
+  if (!isConstraintDumpEnabled())
+    return;
+  std::error_code EC;
+  raw_fd_ostream OS(DumpConstraintBinary, EC, sys::fs::F_None);
+  if (EC) {
+    errs() << DumpConstraintBinary << ": " << EC.message() << "\n";
+    return;
+  }
+  writeConstraintDump(OS);
+}
+
+void Andersen::writeConstraintDump(raw_ostream &OS) const {
+  OS.write(DumpMagic, sizeof(DumpMagic));
+  encodeULEB128(DumpVersion, OS);
+
+  unsigned NumNodes = nodeFactory.getNumNodes();
+  encodeULEB128(NumNodes, OS);
+  for (NodeIndex Node = 0; Node < NumNodes; ++Node) {
+    NodeIndex Target = nodeFactory.getMergeTarget(Node);
+    const Value *V = nodeFactory.getValueForNode(Node);
+    uint8_t Flags = 0;
+    if (nodeFactory.isObjectNode(Node))
+      Flags |= ObjectNode;
+    if (Target != Node)
+      Flags |= MergedNode;
+    if (V && V->hasName())
+      Flags |= NamedNode;
+    OS << (char)Flags;
+    if (Flags & MergedNode)
+      encodeULEB128(Target, OS);
+    if (Flags & NamedNode) {
+      encodeULEB128(V->getName().size(), OS);
+      OS << V->getName();
+    }
+  }
+
+  std::vector<std::pair<NodeIndex, NodeIndex>> ByType[4];
+  for (const AndersConstraint &C : constraints)
+    ByType[C.getType()].push_back(std::make_pair(C.getDest(), C.getSrc()));
+  for (auto &Constraints : ByType) {
+    std::sort(Constraints.begin(), Constraints.end());
+    encodeULEB128(Constraints.size(), OS);
+    std::pair<NodeIndex, NodeIndex> Last(0, 0);
+    for (auto &C : Constraints) {
+      encodeULEB128(C.first - Last.first, OS);
+      encodeULEB128(C.first == Last.first ? C.second - Last.second : C.second,
+                    OS);
+      Last = C;
+    }
+  }
+
+  encodeULEB128(ptsGraph.size(), OS);
+  NodeIndex LastNode = 0;
+  for (auto &P : ptsGraph) {
+    encodeULEB128(P.first - LastNode, OS);
+    LastNode = P.first;
+    encodeULEB128(P.second.getSize(), OS);
+    NodeIndex LastElement = 0;
+    for (NodeIndex Element : P.second) {
+      encodeULEB128(Element - LastElement, OS);
+      LastElement = Element;
+    }
+  }
+}
+
+bool Andersen::readConstraintDump(StringRef Data, std::string &Error,
+                                  std::vector<std::string> *Names) {
+  if (nodeFactory.getNumNodes() != 4 || !constraints.empty() ||
+      !ptsGraph.empty()) {
+    Error = "the analysis is not empty";
+    return false;
+  }
+  DumpReader R(Data, Error);
+  uint64_t Version, NumNodes;
+  if (!R.readMagic() || !R.read(Version))
+    return false;
+  if (Version != DumpVersion)
+    return R.fail("unsupported version " + Twine(Version));
+  // The special nodes are there already.
+  if (!R.read(NumNodes, R.remaining() + 1, "node count"))
+    return false;
+  if (NumNodes < 4)
+    return R.fail("special nodes missing");
+
+  std::vector<std::pair<NodeIndex, NodeIndex>> Merges;
+  if (Names)
+    Names->assign(NumNodes, std::string());
+  for (NodeIndex Node = 0; Node < NumNodes; ++Node) {
+    uint8_t Flags;
+    if (!R.readByte(Flags))
+      return false;
+    if (Flags & ~(ObjectNode | MergedNode | NamedNode))
+      return R.fail("unknown node flags");
+    AndersNode::AndersNodeType Type =
+        Flags & ObjectNode ? AndersNode::OBJ_NODE : AndersNode::VALUE_NODE;
+    if (Node < 4) {
+      if (nodeFactory.isObjectNode(Node) != (Type == AndersNode::OBJ_NODE))
+        return R.fail("special node of the wrong type");
+    } else {
+      nodeFactory.createNode(Type);
+    }
+    if (Flags & MergedNode) {
+      uint64_t Target;
+      if (!R.read(Target, NumNodes, "merge target"))
+        return false;
+      if (Target == Node)
+        return R.fail("node merged into itself");
+      Merges.push_back(std::make_pair(Target, Node));
+    }
+    if (Flags & NamedNode) {
+      std::string Name;
+      if (!R.readString(Name))
+        return false;
+      if (Names)
+        (*Names)[Node] = Name;
+    }
+  }
+  // Targets are representatives, so the merges form no chains or cycles.
+  std::vector<bool> Merged(NumNodes);
+  for (auto &M : Merges)
+    Merged[M.second] = true;
+  for (auto &M : Merges) {
+    if (Merged[M.first])
+      return R.fail("merge target " + Twine(M.first) + " is merged itself");
+    nodeFactory.mergeNode(M.first, M.second);
+  }
+
+  for (unsigned Type = 0; Type < 4; ++Type) {
+    uint64_t Count;
+    if (!R.read(Count, R.remaining() / 2 + 1, "constraint count"))
+      return false;
+    uint64_t Dest = 0, Src = 0;
+    for (uint64_t Idx = 0; Idx < Count; ++Idx) {
+      uint64_t DestDelta, SrcValue;
+      if (!R.read(DestDelta, NumNodes - Dest, "constraint destination") ||
+          !R.read(SrcValue, DestDelta || !Idx ? NumNodes : NumNodes - Src,
+                  "constraint source"))
+        return false;
+      Src = DestDelta || !Idx ? SrcValue : Src + SrcValue;
+      Dest += DestDelta;
+      constraints.emplace_back((AndersConstraint::ConstraintType)Type,
+                               (NodeIndex)Dest, (NodeIndex)Src);
+    }
+  }
+
+  uint64_t NumSets;
+  if (!R.read(NumSets, R.remaining() / 2 + 1, "points-to set count"))
+    return false;
+  uint64_t Node = 0;
+  for (uint64_t Idx = 0; Idx < NumSets; ++Idx) {
+    uint64_t NodeDelta, Size;
+    if (!R.read(NodeDelta, NumNodes - Node, "points-to set node") ||
+        !R.read(Size, R.remaining() + 1, "points-to set size"))
+      return false;
+    if (Idx && !NodeDelta)
+      return R.fail("points-to set given twice");
+    Node += NodeDelta;
+    AndersPtsSet &Set = ptsGraph[Node];
+    uint64_t Element = 0;
+    for (uint64_t E = 0; E < Size; ++E) {
+      uint64_t Delta;
+      if (!R.read(Delta, NumNodes - Element, "points-to element"))
+        return false;
+      if (E && !Delta)
+        return R.fail("points-to element given twice");
+      Element += Delta;
+      Set.insert(Element);
+    }
+  }
+  if (!R.atEnd())
+    return R.fail("trailing data");
+  return true;
+}
+
+void Andersen::replaySolver() {
+  typedef std::chrono::steady_clock Clock;
+  solverIterations.emplace_back();
+  Clock::time_point Start = Clock::now();
+  optimizeConstraints();
+  solverIterations.back().OptimizeSeconds =
+      std::chrono::duration<double>(Clock::now() - Start).count();
+  Start = Clock::now();
+  solveConstraints();
+  solverIterations.back().SolveSeconds =
+      std::chrono::duration<double>(Clock::now() - Start).count();
+}
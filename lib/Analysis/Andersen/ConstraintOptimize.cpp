@@ -564,11 +564,17 @@ void Andersen::optimizeConstraints() {
   // First, let's do HVN
   // There is an additional assumption here that before HVN, we have not merged
   // any two nodes. Might fix that in the future
+  SolverIteration &Stats = getSolverIteration();
+  if (isStatisticsEnabled())
+    countConstraints(Stats.Constraints);
+
+  uint64_t Merges = nodeFactory.getNumMerges();
   if (EnableHVN) {
     HVNOptimizer hvn(constraints, nodeFactory);
     errs() << "[+]Start HVN Optimizer\n";
     hvn.run();
   }
+  Stats.MergedHVN = nodeFactory.getNumMerges() - Merges;
 
   // nodeFactory.dumpRepInfo();
   // dumpConstraints();
@@ -578,11 +584,15 @@ void Andersen::optimizeConstraints() {
   // Next, do HU
   // There is an additional assumption here that before HU, the predecessor
   // graph will have no cycle. Might fix that in the future
+  Merges = nodeFactory.getNumMerges();
   if (EnableHU) {
     HUOptimizer hu(constraints, nodeFactory);
     errs() << "[+]Start HU Optimizer\n";
     hu.run();
   }
+  Stats.MergedHU = nodeFactory.getNumMerges() - Merges;
+  if (isStatisticsEnabled())
+    countConstraints(Stats.Optimized);
 
   // nodeFactory.dumpRepInfo();
   // dumpConstraints();
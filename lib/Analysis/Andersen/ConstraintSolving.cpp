@@ -448,6 +448,9 @@ public:
 /// catches cycles slightly later than the original technique did, but does it
 /// make significantly cheaper.
 void Andersen::solveConstraints() {
+  SolverIteration &Stats = getSolverIteration();
+  uint64_t Merges = nodeFactory.getNumMerges();
+
   // We'll do offline HCD first
   OfflineCycleDetector offlineInfo(constraints, nodeFactory);
   if (EnableHCD)
@@ -486,13 +489,16 @@ void Andersen::solveConstraints() {
       // Detect and collapse cycles online
       OnlineCycleDetector cycleDetector(nodeFactory, constraintGraph, ptsGraph,
                                         cycleCandidates);
+      uint64_t LCDMerges = nodeFactory.getNumMerges();
       cycleDetector.run();
+      Stats.MergedLCD += nodeFactory.getNumMerges() - LCDMerges;
       cycleCandidates.clear();
     }
 
     while (!currWorkList->isEmpty()) {
       NodeIndex node = currWorkList->dequeue();
       node = nodeFactory.getMergeTarget(node);
+      ++Stats.WorklistPops;
       // errs() << "Examining node " << node << "\n";
 
       ConstraintGraphNode *cNode = constraintGraph.getNodeWithIndex(node);
@@ -620,4 +626,7 @@ void Andersen::solveConstraints() {
     // Swap the current and the next worklist
     std::swap(currWorkList, nextWorkList);
   }
+
+  // Everything else merged was collapsed by HCD, offline or online.
+  Stats.MergedHCD = nodeFactory.getNumMerges() - Merges - Stats.MergedLCD;
 }
@@ -0,0 +1,258 @@
+#include "llvm/Analysis/Andersen/DemandPointsTo.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+
+using namespace llvm;
+
+static cl::opt<bool> EnableDemandPointsTo(
+    "pts-demand",
+    cl::desc("Answer the slicer's points-to queries demand-driven from the "
+             "constraints instead of the solved points-to graph"),
+    cl::init(false), cl::Hidden);
+
+static cl::opt<unsigned> DemandBudget(
+    "pts-demand-budget",
+    cl::desc("Steps a demand-driven points-to query may take before it falls "
+             "back to the solved points-to graph (0 = unlimited)"),
+    cl::init(100000), cl::Hidden);
+
+static cl::opt<bool> VerifyDemandPointsTo(
+    "pts-demand-verify",
+    cl::desc("Compare every demand-driven points-to set with the solved one"),
+    cl::init(false), cl::Hidden);
+
+bool DemandPointsTo::isEnabled() { return EnableDemandPointsTo; }
+
+bool DemandPointsTo::isVerifyEnabled() { return VerifyDemandPointsTo; }
+
+DemandPointsTo::DemandPointsTo(const AndersNodeFactory &Nodes,
+                               const std::vector<AndersConstraint> &Constraints)
+    : Nodes(Nodes) {
+  Edges.reserve(2 * Constraints.size());
+  for (const AndersConstraint &C : Constraints) {
+    NodeIndex Dest = getRep(C.getDest());
+    NodeIndex Src = getRep(C.getSrc());
+    switch (C.getType()) {
+    case AndersConstraint::ADDR_OF:
+      // The solver puts the object itself into the set, not its rep.
+      Edges.push_back({Dest, AddrOf, C.getSrc()});
+      Edges.push_back({C.getSrc(), AddrOfUser, Dest});
+      break;
+    case AndersConstraint::COPY:
+      if (Dest == Src)
+        break;
+      Edges.push_back({Dest, CopyIn, Src});
+      Edges.push_back({Src, CopyOut, Dest});
+      break;
+    case AndersConstraint::LOAD:
+      Edges.push_back({Dest, LoadIn, Src});
+      Edges.push_back({Src, LoadOut, Dest});
+      break;
+    case AndersConstraint::STORE:
+      Edges.push_back({Dest, StoreAt, Src});
+      Edges.push_back({Src, StoreFrom, Dest});
+      break;
+    }
+  }
+  std::sort(Edges.begin(), Edges.end());
+  Edges.erase(std::unique(Edges.begin(), Edges.end()), Edges.end());
+  for (unsigned Begin = 0, End; Begin < Edges.size(); Begin = End) {
+    for (End = Begin + 1; End < Edges.size(); ++End)
+      if (Edges[End].Node != Edges[Begin].Node)
+        break;
+    EdgeRanges[Edges[Begin].Node] = std::make_pair(Begin, End);
+  }
+
+  for (NodeIndex N = 0; N < Nodes.getNumNodes(); ++N) {
+    NodeIndex Rep = getRep(N);
+    if (Rep != N && Nodes.isObjectNode(N))
+      MergedObjects[Rep].push_back(N);
+  }
+}
+
+ArrayRef<DemandPointsTo::Edge> DemandPointsTo::getEdges(NodeIndex N,
+                                                        EdgeKind Kind) const {
+  auto Range = EdgeRanges.find(N);
+  if (Range == EdgeRanges.end())
+    return ArrayRef<Edge>();
+  const Edge *Begin = Edges.data() + Range->second.first;
+  const Edge *End = Edges.data() + Range->second.second;
+  Begin = std::lower_bound(Begin, End, Edge{N, (unsigned)Kind, 0});
+  End = std::lower_bound(Begin, End, Edge{N, (unsigned)Kind + 1, 0});
+  return ArrayRef<Edge>(Begin, End);
+}
+
+// The objects whose contents Rep holds.
+std::vector<NodeIndex> DemandPointsTo::getObjects(NodeIndex Rep) const {
+  std::vector<NodeIndex> Objects;
+  if (Nodes.isObjectNode(Rep))
+    Objects.push_back(Rep);
+  auto Merged = MergedObjects.find(Rep);
+  if (Merged != MergedObjects.end())
+    Objects.insert(Objects.end(), Merged->second.begin(),
+                   Merged->second.end());
+  return Objects;
+}
+
+AndersPtsSet DemandPointsTo::getPts(NodeIndex Rep) const {
+  auto It = Pts.find(Rep);
+  return It == Pts.end() ? AndersPtsSet() : It->second;
+}
+
+AndersPtsSet DemandPointsTo::getPointedBy(NodeIndex Object) const {
+  auto It = PointedBy.find(Object);
+  return It == PointedBy.end() ? AndersPtsSet() : It->second;
+}
+
+/*
+ * A fact is only derived if a demand needs it: the points-to set of Rep, or
+ * where Object flows to.
+ */
+void DemandPointsTo::addFact(NodeIndex Rep, NodeIndex Object) {
+  ++Steps;
+  if (!PtsDemand.count(Rep) && !FlowDemand.count(Object))
+    return;
+  if (!Pts[Rep].insert(Object))
+    return;
+  PointedBy[Object].insert(Rep);
+  Worklist.push_back({NewFact, Rep, Object});
+}
+
+void DemandPointsTo::demandPts(NodeIndex Rep) {
+  if (PtsDemand.insert(Rep).second)
+    Worklist.push_back({NewPtsDemand, Rep, 0});
+}
+
+void DemandPointsTo::demandFlow(NodeIndex Object) {
+  if (FlowDemand.insert(Object).second)
+    Worklist.push_back({NewFlowDemand, 0, Object});
+}
+
+// X points to O: apply every rule with that in its body.
+void DemandPointsTo::processFact(NodeIndex X, NodeIndex O) {
+  NodeIndex Target = getRep(O);
+  bool Flows = FlowDemand.count(O);
+
+  for (const Edge &E : getEdges(X, CopyOut))
+    addFact(E.Other, O);
+
+  // n = *X gets what O holds.
+  for (const Edge &E : getEdges(X, LoadOut)) {
+    if (PtsDemand.count(E.Other))
+      demandPts(Target);
+    for (NodeIndex Held : getPts(Target))
+      addFact(E.Other, Held);
+  }
+
+  // X holds the contents of objects, so n = *p for any p pointing to one.
+  for (NodeIndex Object : getObjects(X)) {
+    if (Flows)
+      demandFlow(Object);
+    for (NodeIndex P : getPointedBy(Object))
+      for (const Edge &E : getEdges(P, LoadOut))
+        addFact(E.Other, O);
+  }
+
+  // *q = X stores O into what q points to.
+  for (const Edge &E : getEdges(X, StoreFrom)) {
+    if (Flows)
+      demandPts(E.Other);
+    for (NodeIndex Object : getPts(E.Other))
+      addFact(getRep(Object), O);
+  }
+
+  // *X = w stores into O.
+  for (const Edge &E : getEdges(X, StoreAt)) {
+    if (PtsDemand.count(Target))
+      demandPts(E.Other);
+    for (NodeIndex Stored : getPts(E.Other))
+      addFact(Target, Stored);
+  }
+}
+
+// Applies every rule deriving facts about N with what is known so far.
+void DemandPointsTo::processPtsDemand(NodeIndex N) {
+  for (const Edge &E : getEdges(N, AddrOf))
+    addFact(N, E.Other);
+
+  for (const Edge &E : getEdges(N, CopyIn)) {
+    demandPts(E.Other);
+    for (NodeIndex O : getPts(E.Other))
+      addFact(N, O);
+  }
+
+  for (const Edge &E : getEdges(N, LoadIn)) {
+    demandPts(E.Other);
+    for (NodeIndex Object : getPts(E.Other)) {
+      NodeIndex Target = getRep(Object);
+      demandPts(Target);
+      for (NodeIndex O : getPts(Target))
+        addFact(N, O);
+    }
+  }
+
+  // Stores into the objects N stands for, through any pointer to them.
+  for (NodeIndex Object : getObjects(N)) {
+    demandFlow(Object);
+    for (NodeIndex Q : getPointedBy(Object))
+      for (const Edge &E : getEdges(Q, StoreAt)) {
+        demandPts(E.Other);
+        for (NodeIndex O : getPts(E.Other))
+          addFact(N, O);
+      }
+  }
+}
+
+void DemandPointsTo::processFlowDemand(NodeIndex O) {
+  for (const Edge &E : getEdges(O, AddrOfUser))
+    addFact(E.Other, O);
+  // Facts about O derived before were not followed to where O flows.
+  for (NodeIndex X : getPointedBy(O))
+    Worklist.push_back({NewFact, X, O});
+}
+
+bool DemandPointsTo::query(NodeIndex Node, AndersPtsSet &PtsSet) {
+  std::lock_guard<std::mutex> Guard(Lock);
+  ++Queries;
+  NodeIndex Rep = getRep(Node);
+  demandPts(Rep);
+
+  // Pending work may come from an earlier query that gave up; all of it has
+  // to be done before any set is complete.
+  uint64_t Limit = DemandBudget ? Steps + DemandBudget : UINT64_MAX;
+  while (!Worklist.empty()) {
+    if (Steps >= Limit) {
+      ++Fallbacks;
+      return false;
+    }
+    WorkItem Item = Worklist.front();
+    Worklist.pop_front();
+    ++Steps;
+    switch (Item.Kind) {
+    case NewFact:
+      processFact(Item.Node, Item.Object);
+      break;
+    case NewPtsDemand:
+      processPtsDemand(Item.Node);
+      break;
+    case NewFlowDemand:
+      processFlowDemand(Item.Object);
+      break;
+    }
+  }
+  PtsSet = getPts(Rep);
+  return true;
+}
+
+void DemandPointsTo::printStatistics(raw_ostream &OS) const {
+  OS << "[+]demand points-to: " << Queries << " queries, " << Fallbacks
+     << " fell back, " << Steps << " steps, " << PtsDemand.size()
+     << " nodes and " << FlowDemand.size() << " objects demanded of "
+     << Nodes.getNumNodes() << "\n";
+  if (isVerifyEnabled())
+    OS << "[+]demand points-to: " << Mismatches
+       << " sets differ from the solved ones\n";
+}
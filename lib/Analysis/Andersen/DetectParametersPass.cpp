@@ -1,4 +1,5 @@
 #include "llvm/Analysis/Andersen/DetectParametersPass.h"
+#include "llvm/Analysis/Andersen/PhaseProfile.h"
 #include <llvm/IR/InstIterator.h>
 
 #include "llvm/IR/Constants.h"
@@ -28,6 +29,7 @@ void DetectParametersPass::getAnalysisUsage(AnalysisUsage &AU) const {
 }
 
 bool DetectParametersPass::runOnModule(Module &M) {
+  PhaseProfile::Scope ProfileScope("detectParameters");
   errs() << "[+]Start DetectParameters Pass"
          << "\n";
   for (auto &F : M.functions()) {
@@ -86,7 +88,7 @@ bool DetectParametersPass::runOnModule(Module &M) {
       }
     }
 
-    StackAccessPass::OffsetValueListMap_t &OffsetValues =
+    const StackAccessPass::OffsetValueListMap_t &OffsetValues =
         getAnalysis<StackAccessPass>().getOffsetValues(&F);
     const DominatorTree &DomTree =
         getAnalysis<DominatorTreeWrapperPass>(F).getDomTree();
@@ -97,13 +99,8 @@ bool DetectParametersPass::runOnModule(Module &M) {
 
       InstructionList_t LoadInstruction, StoreInstructions;
 
-      if (!OV_it->second) {
-        // FIXME: why can this happen???
-        continue;
-      }
-
-      for (StackAccessPass::ValueList_t::iterator V_it = OV_it->second->begin();
-           V_it != OV_it->second->end(); ++V_it) {
+      for (StackAccessPass::ValueList_t::iterator V_it = OV_it->second.begin();
+           V_it != OV_it->second.end(); ++V_it) {
         assert(isa<Instruction>(*V_it));
         getMemoryOperations((Instruction *)*V_it, LoadInstruction,
                             StoreInstructions);
@@ -434,8 +431,8 @@ DetectParametersPass::getStackParameters(Function &F,
 
     InstructionList_t LoadInstruction, StoreInstructions;
 
-    for (StackAccessPass::ValueList_t::iterator V_it = OV_it->second->begin();
-         V_it != OV_it->second->end(); ++V_it) {
+    for (StackAccessPass::ValueList_t::iterator V_it = OV_it->second.begin();
+         V_it != OV_it->second.end(); ++V_it) {
       assert(isa<Instruction>(*V_it));
       getMemoryOperations((Instruction *)*V_it, LoadInstruction,
                           StoreInstructions);
@@ -0,0 +1,308 @@
+#include "llvm/Analysis/Andersen/ExternalModel.h"
+
+#include "llvm/Analysis/Andersen/Andersen.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include "nlohmann/json.hpp"
+
+using namespace llvm;
+
+static cl::opt<std::string>
+    ExternalModelFile("external-models",
+                      cl::desc("Interpret the external function models in "
+                               "this file (llvm-tblgen -gen-ext-model)"),
+                      cl::init(""), cl::Hidden);
+
+namespace {
+typedef nlohmann::json json;
+
+struct ModelParser {
+  std::map<std::string, uint64_t> RegisterNumbers;
+  std::string Error;
+
+  bool fail(const std::string &Message) {
+    if (Error.empty())
+      Error = Message;
+    return false;
+  }
+
+  std::string getString(const json &J, const char *Key) {
+    auto It = J.find(Key);
+    if (It == J.end() || !It->is_string()) {
+      fail(std::string("missing string \"") + Key + "\"");
+      return "";
+    }
+    return It->get<std::string>();
+  }
+
+  uint64_t getRegNo(const json &J) {
+    std::string Name = getString(J, "name");
+    auto It = RegisterNumbers.find(Name);
+    if (It == RegisterNumbers.end()) {
+      fail("unknown register " + Name);
+      return 0;
+    }
+    return It->second;
+  }
+};
+} // namespace
+
+const ExternalModel *ExternalModel::get() {
+  static const ExternalModel *Model = []() -> const ExternalModel * {
+    if (ExternalModelFile.empty())
+      return nullptr;
+    ExternalModel *M = new ExternalModel();
+    std::string Error;
+    if (!M->load(ExternalModelFile, Error))
+      report_fatal_error("could not load external models from " +
+                         ExternalModelFile + ": " + Error,
+                         false);
+    return M;
+  }();
+  return Model;
+}
+
+bool ExternalModel::load(StringRef Path, std::string &Error) {
+  ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer = MemoryBuffer::getFile(Path);
+  if (!Buffer) {
+    Error = Buffer.getError().message();
+    return false;
+  }
+
+  json Root;
+  try {
+    Root = json::parse((*Buffer)->getBuffer().str());
+  } catch (std::exception &E) {
+    Error = E.what();
+    return false;
+  }
+
+  ModelParser P;
+  auto Regs = Root.find("registers");
+  if (Regs == Root.end() || !Regs->is_object()) {
+    Error = "missing \"registers\"";
+    return false;
+  }
+  for (auto It = Regs->begin(); It != Regs->end(); ++It)
+    P.RegisterNumbers[It.key()] = It.value().get<uint64_t>();
+
+  std::function<unsigned(const json &)> parseRegister =
+      [&](const json &J) -> unsigned {
+    Register R = {PRE, 0, 0, ""};
+    std::string Kind = P.getString(J, "kind");
+    if (Kind == "Pre") {
+      R.RegNo = P.getRegNo(J);
+    } else if (Kind == "PreStore") {
+      R.Kind = PRE_STORE;
+      R.RegNo = P.getRegNo(J);
+    } else if (Kind == "Post") {
+      R.Kind = POST;
+      R.RegNo = P.getRegNo(J);
+    } else if (Kind == "DummyObject") {
+      R.Kind = DUMMY_OBJECT;
+      R.Name = P.getString(J, "name");
+    } else if (Kind == "Pts") {
+      R.Kind = PTS;
+      auto Inner = J.find("reg");
+      if (Inner == J.end())
+        P.fail("Pts without \"reg\"");
+      else
+        R.Inner = parseRegister(*Inner);
+    } else if (Kind == "Call") {
+      R.Kind = CALL;
+    } else {
+      P.fail("unknown register kind " + Kind);
+    }
+    Registers.push_back(R);
+    return Registers.size() - 1;
+  };
+
+  auto getRegister = [&](const json &J, const char *Key) -> unsigned {
+    auto It = J.find(Key);
+    if (It == J.end()) {
+      P.fail(std::string("missing register \"") + Key + "\"");
+      return 0;
+    }
+    return parseRegister(*It);
+  };
+
+  auto Funcs = Root.find("functions");
+  if (Funcs == Root.end() || !Funcs->is_array()) {
+    Error = "missing \"functions\"";
+    return false;
+  }
+  for (const json &F : *Funcs) {
+    // Several records may model the same name; their operations run in
+    // record order, like the generated handlers.
+    Function &Model = Functions[P.getString(F, "name")];
+
+    auto Slice = F.find("slice");
+    if (Slice != F.end()) {
+      for (const json &S : *Slice) {
+        Operation Op = {DEF, 0, 0, ""};
+        std::string Kind = P.getString(S, "op");
+        if (Kind == "Def")
+          Op.Kind = DEF;
+        else if (Kind == "DefMod")
+          Op.Kind = DEF_MOD;
+        else if (Kind == "Ref")
+          Op.Kind = REF;
+        else if (Kind == "Ref1")
+          Op.Kind = REF1;
+        else
+          P.fail("unknown slice operation " + Kind);
+        Op.A = getRegister(S, "reg");
+        Model.SliceOps.push_back(Op);
+      }
+    }
+
+    auto PtsTo = F.find("ptsto");
+    if (PtsTo != F.end()) {
+      for (const json &S : *PtsTo) {
+        Operation Op = {LOAD, 0, 0, ""};
+        std::string Kind = P.getString(S, "op");
+        if (Kind == "Load" || Kind == "Store") {
+          Op.Kind = Kind == "Load" ? LOAD : STORE;
+          Op.A = getRegister(S, "val");
+          Op.B = getRegister(S, "loc");
+        } else if (Kind == "Alloc") {
+          Op.Kind = ALLOC;
+          Op.A = getRegister(S, "reg");
+          Op.Type = P.getString(S, "type");
+        } else if (Kind == "Copy") {
+          Op.Kind = COPY;
+          Op.A = getRegister(S, "from");
+          Op.B = getRegister(S, "to");
+        } else if (Kind == "Loc") {
+          Op.Kind = LOC;
+          Op.A = getRegister(S, "reg");
+        } else {
+          P.fail("unknown points-to operation " + Kind);
+        }
+        Model.PtsToOps.push_back(Op);
+      }
+    }
+  }
+
+  Error = P.Error;
+  return Error.empty();
+}
+
+void ExternalModel::evaluate(unsigned Reg, const Instruction *CallInst,
+                             Andersen *andersen, const PointsTo_t &PointsTo,
+                             UserSet_t &Out) const {
+  const Register &R = Registers[Reg];
+  switch (R.Kind) {
+  case PRE: {
+    UserSet_t S =
+        DetectParametersPass::getRegisterValuesBeforeCall(R.RegNo, CallInst);
+    Out.insert(S.begin(), S.end());
+    break;
+  }
+  case PRE_STORE: {
+    UserSet_t S = DetectParametersPass::getRegisterValuesBeforeCall(
+        R.RegNo, CallInst, true);
+    Out.insert(S.begin(), S.end());
+    break;
+  }
+  case POST: {
+    UserSet_t S =
+        DetectParametersPass::getRegisterValuesAfterCall(R.RegNo, CallInst);
+    Out.insert(S.begin(), S.end());
+    break;
+  }
+  case DUMMY_OBJECT: {
+    assert(andersen && "DummyObject needs the points-to analysis");
+    Module &M = andersen->getModule();
+    GlobalVariable *G = new GlobalVariable(
+        M, IntegerType::get(M.getContext(), 1), false,
+        GlobalVariable::ExternalLinkage, nullptr, R.Name);
+    Out.insert(G);
+    andersen->addConstraint(AndersConstraint::ADDR_OF,
+                            andersen->getNodeFactory().createValueNode(G),
+                            andersen->getNodeFactory().createObjectNode(G));
+    break;
+  }
+  case PTS: {
+    assert(PointsTo && "Pts needs points-to sets");
+    UserSet_t Src;
+    evaluate(R.Inner, CallInst, andersen, PointsTo, Src);
+    for (auto S : Src)
+      PointsTo(S, Out);
+    break;
+  }
+  case CALL:
+    assert(PointsTo && "Call needs points-to sets");
+    PointsTo(CallInst, Out);
+    break;
+  }
+}
+
+void ExternalModel::addConstraints(const Function &F,
+                                   const Instruction *CallInst,
+                                   Andersen *andersen) const {
+  AndersNodeFactory &NF = andersen->getNodeFactory();
+  auto getValueNode = [&](const Value *V) {
+    NodeIndex Idx = NF.getValueNodeFor(V);
+    if (Idx == AndersNodeFactory::InvalidIndex)
+      Idx = NF.createValueNode(V);
+    return Idx;
+  };
+  // The points-to operations run while the sets are being built.
+  PointsTo_t NoPointsTo;
+
+  for (const Operation &Op : F.PtsToOps) {
+    UserSet_t A, B;
+    evaluate(Op.A, CallInst, andersen, NoPointsTo, A);
+    switch (Op.Kind) {
+    case LOAD:
+    case STORE:
+      evaluate(Op.B, CallInst, andersen, NoPointsTo, B);
+      for (auto Val : A) {
+        NodeIndex ValIdx = getValueNode(Val);
+        for (auto Loc : B) {
+          NodeIndex LocIdx = getValueNode(Loc);
+          if (Op.Kind == LOAD)
+            andersen->addConstraint(AndersConstraint::LOAD, ValIdx, LocIdx);
+          else
+            andersen->addConstraint(AndersConstraint::STORE, LocIdx, ValIdx);
+        }
+      }
+      break;
+    case ALLOC:
+      for (auto V : A) {
+        NodeIndex ValIdx = getValueNode(V);
+        NodeIndex ObjIdx = NF.getObjectNodeFor(V);
+        if (ObjIdx == AndersNodeFactory::InvalidIndex)
+          ObjIdx = NF.createObjectNode(V);
+        andersen->setType(V, Op.Type);
+        andersen->addConstraint(AndersConstraint::ADDR_OF, ValIdx, ObjIdx);
+      }
+      break;
+    case COPY:
+      evaluate(Op.B, CallInst, andersen, NoPointsTo, B);
+      for (auto From : A) {
+        NodeIndex SrcIdx = getValueNode(From);
+        for (auto To : B)
+          andersen->addConstraint(AndersConstraint::COPY, getValueNode(To),
+                                  SrcIdx);
+      }
+      break;
+    case LOC:
+      // Give registers that point nowhere a dummy object.
+      for (auto V : A) {
+        if (NF.getObjectNodeFor(V) != AndersNodeFactory::InvalidIndex)
+          continue;
+        NodeIndex ObjIdx = NF.createObjectNodeDummy(V, andersen->getModule());
+        andersen->addConstraint(AndersConstraint::ADDR_OF, getValueNode(V),
+                                ObjIdx);
+      }
+      break;
+    default:
+      llvm_unreachable("Slice operation in points-to operations");
+    }
+  }
+}
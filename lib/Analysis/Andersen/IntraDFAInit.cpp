@@ -274,17 +274,15 @@ bool AndersenInit::runOnModule(Module &M) {
     solveConstraints();
     errs() << "End Optimizing and solving constraints\n";
 
-    StackAccessPass::OffsetMap_t &Offsets = SAP->getOffsets(&f);
-
-    StackAccessPass::OffsetMap_t::iterator end = Offsets.end();
+    const StackAccessPass::OffsetMap_t &Offsets = SAP->getOffsets(&f);
 
     for (inst_iterator I_it = inst_begin(fun); I_it != inst_end(fun); ++I_it) {
       const Instruction *I = &*I_it;
-      if (Offsets.find(I) == end)
-        continue;
-      if (!Offsets[I])
+      StackAccessPass::OffsetMap_t::const_iterator OffsetList_it =
+          Offsets.find(I);
+      if (OffsetList_it == Offsets.end())
         continue;
-      StackAccessPass::Int64List_t &OffsetList = *Offsets[I];
+      StackAccessPass::Int64List_t OffsetList = OffsetList_it->second;
 
       std::vector<const Value *> ptsTo;
       getPointsToSet(I, ptsTo);
@@ -686,8 +684,8 @@ void Andersen::collectConstraintsForInstruction(const Instruction *inst) {
         StackAccessPass &SAP = getAnalysis<StackAccessPass>();
         Function *f = (Function *)inst->getParent()->getParent();
 
-        StackAccessPass::OffsetMap_t &Offsets = SAP.getOffsets(f);
-        if (Offsets.find(inst->getOperand(0)) != Offsets.end()) {
+        const StackAccessPass::OffsetMap_t &Offsets = SAP.getOffsets(f);
+        if (Offsets.count(inst->getOperand(0))) {
           if (handledAliases.find(inst->getOperand(0)) ==
               handledAliases.end()) {
             NodeIndex valIdx = nodeFactory.getValueNodeFor(inst->getOperand(0));
@@ -1385,21 +1383,22 @@ bool AndersenInit::findAliases(const llvm::Value *Address, bool Sharp,
       SPSet.insert(SPIdx);
       StackAccess->runOnFunction(F, OffsetsTmp, OffsetValuesTmp, SPSet);
     }
-    StackAccessPass::OffsetMap_t &Offsets =
+    const StackAccessPass::OffsetMap_t &Offsets =
         SPIdx == 3 ? StackAccess->getOffsets(&F) : OffsetsTmp;
-    StackAccessPass::OffsetValueListMap_t &OffsetValues =
+    const StackAccessPass::OffsetValueListMap_t &OffsetValues =
         SPIdx == 3 ? StackAccess->getOffsetValues(&F) : OffsetValuesTmp;
+    StackAccessPass::Int64List_t AddressOffsets = Offsets.lookup(Address);
 
     if (Sharp) {
-      if (Offsets[Address] == nullptr) {
+      if (AddressOffsets.empty()) {
         return false;
       }
       for (StackAccessPass::Int64List_t::iterator Offset_it =
-               Offsets[Address]->begin();
-           Offset_it != Offsets[Address]->end(); ++Offset_it) {
-        for (StackAccessPass::ValueList_t::iterator V_it =
-                 OffsetValues[*Offset_it]->begin();
-             V_it != OffsetValues[*Offset_it]->end(); ++V_it) {
+               AddressOffsets.begin();
+           Offset_it != AddressOffsets.end(); ++Offset_it) {
+        StackAccessPass::ValueList_t Values = OffsetValues.lookup(*Offset_it);
+        for (StackAccessPass::ValueList_t::iterator V_it = Values.begin();
+             V_it != Values.end(); ++V_it) {
           if (Address == *V_it)
             continue;
           NodeIndex idxA = nodeFactory.getValueNodeFor(Address);
@@ -1415,14 +1414,14 @@ bool AndersenInit::findAliases(const llvm::Value *Address, bool Sharp,
     } else {
       return false;
       int64_t min = INT64_MAX;
-      if (!Offsets[Address]) {
+      if (AddressOffsets.empty()) {
         DEBUG_WITH_TYPE("err", errs() << "CANT FIND ANY BASE POINTER: ";
                         Address->print(errs()); errs() << "\n";);
         min = INT64_MIN;
       } else {
         for (StackAccessPass::Int64List_t::iterator Offset_it =
-                 Offsets[Address]->begin();
-             Offset_it != Offsets[Address]->end(); ++Offset_it) {
+                 AddressOffsets.begin();
+             Offset_it != AddressOffsets.end(); ++Offset_it) {
           if (*Offset_it < min)
             min = *Offset_it;
         }
@@ -1431,14 +1430,9 @@ bool AndersenInit::findAliases(const llvm::Value *Address, bool Sharp,
                OffsetValues.begin();
            OV_it != OffsetValues.end(); ++OV_it) {
         if (OV_it->first >= min) {
-          if (!OffsetValues[OV_it->first]) {
-            //                        errs() << "Can't find offset values\n";
-            //                        errs() << F.getName() << "\n";
-            continue;
-          }
           for (StackAccessPass::ValueList_t::iterator V_it =
-                   OffsetValues[OV_it->first]->begin();
-               V_it != OffsetValues[OV_it->first]->end(); ++V_it) {
+                   OV_it->second.begin();
+               V_it != OV_it->second.end(); ++V_it) {
             if (Address == *V_it)
               continue;
             NodeIndex idxA = nodeFactory.getValueNodeFor(Address);
@@ -1483,14 +1477,11 @@ Instruction *AndersenInit::findSetStackParameterInstruction(
   StackAccessPass *StackAccess = getAnalysisIfAvailable<StackAccessPass>();
   if (!StackAccess)
     StackAccess = &getAnalysis<StackAccessPass>();
-  StackAccessPass::OffsetValueListMap_t &ValueMap =
+  const StackAccessPass::OffsetValueListMap_t &ValueMap =
       StackAccess->getOffsetValues(F);
-  if (ValueMap[Offset] == nullptr) {
+  StackAccessPass::ValueList_t Values = ValueMap.lookup(Offset);
+  if (Values.empty())
     return nullptr;
-  }
-  StackAccessPass::ValueList_t &Values = *ValueMap[Offset];
-  if (!Values.size())
-    llvm_unreachable("Can't find Instruction that sets the parameter");
 
   NodeIndex idxA = nodeFactory.getValueNodeFor(*Values.begin());
   if (idxA == AndersNodeFactory::InvalidIndex) {
@@ -1517,19 +1508,21 @@ Instruction *AndersenInit::findSetStackParameterInstruction(
           if (!S)
             continue;
 
-          StackAccessPass::OffsetMap_t &Offsets = StackAccess->getOffsets(F);
+          const StackAccessPass::OffsetMap_t &Offsets =
+              StackAccess->getOffsets(F);
+          StackAccessPass::OffsetMap_t::const_iterator StoreOffsets =
+              Offsets.find(S->getOperand(0));
+          if (StoreOffsets == Offsets.end())
+            continue;
           for (StackAccessPass::Int64List_t::iterator O_it =
-                   Offsets[S->getOperand(0)]->begin();
-               O_it != Offsets[S->getOperand(0)]->end(); ++O_it) {
+                   StoreOffsets->second.begin();
+               O_it != StoreOffsets->second.end(); ++O_it) {
             int64_t O1 = *O_it + 8;
             int64_t O2 = *O_it + CopyInParent;
-            if (ValueMap[O1] == nullptr)
-              continue;
-            if (ValueMap[O2] == nullptr)
+            StackAccessPass::ValueList_t VList1 = ValueMap.lookup(O1);
+            StackAccessPass::ValueList_t VList2 = ValueMap.lookup(O2);
+            if (VList1.empty() || VList2.empty())
               continue;
-            StackAccessPass::ValueList_t &VList1 = *ValueMap[O1];
-            StackAccessPass::ValueList_t &VList2 = *ValueMap[O2];
-            assert(VList1.size() && VList2.size());
 
             for (StackAccessPass::ValueList_t::iterator V1_it = VList1.begin();
                  V1_it != VList1.end(); ++V1_it) {
@@ -1584,9 +1577,9 @@ Instruction *AndersenInit::findSetRegisterParameterInstruction(
 
   StackAccessPass *SAP = &getAnalysis<StackAccessPass>();
 
-  StackAccessPass::OffsetMap_t &OffsetMap_caller =
+  const StackAccessPass::OffsetMap_t &OffsetMap_caller =
       SAP->getOffsets(CallInst->getParent()->getParent());
-  StackAccessPass::OffsetValueListMap_t &OffsetValueListMap_caller =
+  const StackAccessPass::OffsetValueListMap_t &OffsetValueListMap_caller =
       SAP->getOffsetValues(CallInst->getParent()->getParent());
 
   std::set<int64_t> OffsetsToFind;
@@ -1614,11 +1607,11 @@ Instruction *AndersenInit::findSetRegisterParameterInstruction(
       srcIndex = nodeFactory.createValueNode(*Pre_it);
     addConstraint(AndersConstraint::COPY, dstIndex, srcIndex);
 
-    if (OffsetMap_caller.find(*Pre_it) != OffsetMap_caller.end()) {
+    StackAccessPass::OffsetMap_t::const_iterator CallerOffsets =
+        OffsetMap_caller.find(*Pre_it);
+    if (CallerOffsets != OffsetMap_caller.end()) {
       // This means that this is a stack address
-      if (!OffsetMap_caller[*Pre_it])
-        continue;
-      if (OffsetMap_caller[*Pre_it]->size()) {
+      if (CallerOffsets->second.size()) {
         std::vector<const Value *> ptsTo;
         getPointsToSet(*Pre_it, ptsTo);
         if (ptsTo.size() == 0) {
@@ -1632,11 +1625,12 @@ Instruction *AndersenInit::findSetRegisterParameterInstruction(
         }
       }
       for (auto &O : OffsetsToFind) {
-        for (auto &O_C : *OffsetMap_caller[*Pre_it]) {
+        for (auto &O_C : CallerOffsets->second) {
           int Find = O_C + O;
-          if (OffsetValueListMap_caller[Find]) {
-            for (auto &OV_caller : *OffsetValueListMap_caller[Find]) {
-              for (auto &OV_param : *OffsetValueListMap_param[O]) {
+          auto CallerValues = OffsetValueListMap_caller.find(Find);
+          if (CallerValues != OffsetValueListMap_caller.end()) {
+            for (auto &OV_caller : CallerValues->second) {
+              for (auto &OV_param : OffsetValueListMap_param.lookup(O)) {
                 NodeIndex dstIndex2 = nodeFactory.getValueNodeFor(OV_param);
                 if (dstIndex2 == AndersNodeFactory::InvalidIndex)
                   dstIndex2 = nodeFactory.createValueNode(OV_param);
@@ -1807,18 +1801,16 @@ bool AndersenInit::isBlock(const llvm::Instruction *Inst, const llvm::Value *&B)
       if (!I)
         continue;
       StackAccessPass &SAP = getAnalysis<StackAccessPass>();
-      StackAccessPass::OffsetMap_t &Offsets = SAP.getOffsets(
-          ((Instruction *)(*PtsTo_it))->getParent()->getParent());
-      StackAccessPass::OffsetValueListMap_t &OffsetValues = SAP.getOffsetValues(
-          ((Instruction *)(*PtsTo_it))->getParent()->getParent());
-      if (!Offsets[*PtsTo_it])
-        continue;
-      for (StackAccessPass::Int64List_t::iterator O_it =
-               Offsets[*PtsTo_it]->begin();
-           O_it != Offsets[*PtsTo_it]->end(); ++O_it) {
-        for (StackAccessPass::ValueList_t::iterator V_it =
-                 OffsetValues[*O_it]->begin();
-             V_it != OffsetValues[*O_it]->end(); ++V_it) {
+      const StackAccessPass::OffsetMap_t &Offsets =
+          SAP.getOffsets(I->getParent()->getParent());
+      const StackAccessPass::OffsetValueListMap_t &OffsetValues =
+          SAP.getOffsetValues(I->getParent()->getParent());
+      StackAccessPass::Int64List_t PtsToOffsets = Offsets.lookup(I);
+      for (StackAccessPass::Int64List_t::iterator O_it = PtsToOffsets.begin();
+           O_it != PtsToOffsets.end(); ++O_it) {
+        StackAccessPass::ValueList_t Values = OffsetValues.lookup(*O_it);
+        for (StackAccessPass::ValueList_t::iterator V_it = Values.begin();
+             V_it != Values.end(); ++V_it) {
           for (std::set<Value *>::iterator B_it = Blocks.begin();
                B_it != Blocks.end(); ++B_it) {
             if (*B_it == *V_it) {
@@ -1846,11 +1838,11 @@ bool AndersenInit::handleBlock(const Instruction *Call, const Value *Block) {
         cast<const Instruction>((*PtsTo_it))->getParent()->getParent();
     StackAccessPass &StackAccess = getAnalysis<StackAccessPass>();
 
-    StackAccessPass::OffsetMap_t &Offsets = StackAccess.getOffsets(Func);
-    StackAccessPass::OffsetValueListMap_t &OffsetValues =
+    const StackAccessPass::OffsetMap_t &Offsets = StackAccess.getOffsets(Func);
+    const StackAccessPass::OffsetValueListMap_t &OffsetValues =
         StackAccess.getOffsetValues(Func);
 
-    StackAccessPass::Int64List_t &BlockOffsets = *Offsets[*PtsTo_it];
+    StackAccessPass::Int64List_t BlockOffsets = Offsets.lookup(*PtsTo_it);
 
     for (StackAccessPass::Int64List_t::iterator BO_it = BlockOffsets.begin();
          BO_it != BlockOffsets.end(); ++BO_it) {
@@ -1858,8 +1850,8 @@ bool AndersenInit::handleBlock(const Instruction *Call, const Value *Block) {
       // object
       int64_t BlockAddress = *BO_it + 16;
 
-      StackAccessPass::ValueList_t &FunctionAddress =
-          *OffsetValues[BlockAddress];
+      StackAccessPass::ValueList_t FunctionAddress =
+          OffsetValues.lookup(BlockAddress);
 
       for (StackAccessPass::ValueList_t::iterator FAV_it =
                FunctionAddress.begin();
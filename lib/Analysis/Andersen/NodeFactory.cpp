@@ -12,7 +12,7 @@ using namespace llvm;
 const unsigned AndersNodeFactory::InvalidIndex =
     std::numeric_limits<unsigned int>::max();
 
-AndersNodeFactory::AndersNodeFactory() : dataLayout(nullptr) {
+AndersNodeFactory::AndersNodeFactory() : dataLayout(nullptr), numMerges(0) {
   // Note that we can't use std::vector::emplace_back() here because
   // AndersNode's constructors are private hence std::vector cannot see it
 
@@ -101,6 +101,13 @@ NodeIndex AndersNodeFactory::createVarargNode(const llvm::Function *f) {
   return nextIdx;
 }
 
+NodeIndex AndersNodeFactory::createNode(AndersNode::AndersNodeType t) {
+  std::unique_lock<std::recursive_mutex> lock(nodeLock);
+  unsigned nextIdx = nodes.size();
+  nodes.push_back(AndersNode(t, nextIdx));
+  return nextIdx;
+}
+
 NodeIndex AndersNodeFactory::getValueNodeFor(const Value *val) const {
   if (const Constant *c = dyn_cast<Constant>(val))
     if (!isa<GlobalValue>(c))
@@ -231,6 +238,8 @@ NodeIndex AndersNodeFactory::getVarargNodeFor(const llvm::Function *f) const {
 
 void AndersNodeFactory::mergeNode(NodeIndex n0, NodeIndex n1) {
   assert(n0 < nodes.size() && n1 < nodes.size());
+  if (n0 != n1)
+    ++numMerges;
   nodes[n1].mergeTarget = n0;
 }
 
@@ -1,70 +1,179 @@
 #include "llvm/Analysis/Andersen/NonVolatileRegistersPass.h"
+#include "llvm/Analysis/Andersen/ParallelFor.h"
+#include "llvm/Analysis/Andersen/PhaseProfile.h"
 #include <llvm/IR/Function.h>
 
-#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/ADT/DenseMap.h"
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/Module.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/ErrorHandling.h>
 #include <llvm/Support/raw_ostream.h>
-#include <set>
+#include <vector>
 
 using namespace llvm;
 
+static cl::opt<unsigned> NonVolatileThreads(
+    "nonvolatile-threads",
+    cl::desc("Number of threads used to scan for callee-saved registers "
+             "(0 = number of hardware threads)"),
+    cl::init(1), cl::Hidden);
+
+static cl::opt<bool> NonVolatileVerify(
+    "nonvolatile-verify",
+    cl::desc("Check every forwarded load against a backward search for its "
+             "store, and verify the functions afterwards"),
+    cl::init(false), cl::Hidden);
+
+static cl::opt<bool> NonVolatileStats(
+    "nonvolatile-stats",
+    cl::desc("Print how many loads and stores of callee-saved registers the "
+             "pass removed"),
+    cl::init(false), cl::Hidden);
+
 bool NonVolatileRegistersPass::runOnModule(Module &M) {
-  for (Module::iterator F_it = M.begin(); F_it != M.end(); ++F_it) {
-    Function &F = *F_it;
-    if (F.isDeclaration() || F.isIntrinsic()) {
+  PhaseProfile::Scope ProfileScope("nonVolatileRegisters");
+  std::vector<Function *> Functions;
+  for (auto &F : M.functions())
+    if (!F.isDeclaration() && !F.isIntrinsic())
+      Functions.push_back(&F);
+
+  std::vector<Rewrite> Rewrites(Functions.size());
+  parallelFor(Functions.size(), NonVolatileThreads, [&](size_t Idx) {
+    findRewrite(*Functions[Idx], Rewrites[Idx]);
+  });
+
+  LoadsForwarded = 0;
+  StoresErased = 0;
+  for (size_t Idx = 0; Idx < Functions.size(); ++Idx) {
+    Rewrite &R = Rewrites[Idx];
+    for (auto &F : R.Forwarded)
+      F.first->replaceAllUsesWith(F.second);
+    for (auto &F : R.Forwarded)
+      F.first->eraseFromParent();
+    for (StoreInst *Store : R.DeadStores)
+      Store->eraseFromParent();
+    LoadsForwarded += R.Forwarded.size();
+    StoresErased += R.DeadStores.size();
+
+    if (NonVolatileVerify && verifyFunction(*Functions[Idx], &errs()))
+      report_fatal_error("NonVolatileRegistersPass broke " +
+                         Functions[Idx]->getName());
+  }
+
+  if (NonVolatileStats)
+    printStatistics(errs());
+  return LoadsForwarded || StoresErased;
+}
+
+void NonVolatileRegistersPass::printStatistics(raw_ostream &OS) const {
+  OS << "[+]non-volatile registers: " << LoadsForwarded
+     << " loads forwarded, " << StoresErased << " stores erased\n";
+}
+
+/*
+ * Finds the changes to F without making them. Blocks are scanned once from
+ * the front, remembering the value last stored to each register; a load
+ * takes that value. A load forwarded earlier may itself have been stored,
+ * so stored values are looked through the replacements made so far.
+ */
+void NonVolatileRegistersPass::findRewrite(Function &F, Rewrite &R) {
+  // The register file pointers of the entry block and their registers.
+  DenseMap<const Value *, unsigned> Slots;
+  std::vector<Value *> NonVolatilePointers;
+  for (Instruction &I : F.getEntryBlock()) {
+    if (I.getOpcode() != Instruction::GetElementPtr || I.getNumOperands() < 3)
       continue;
-    }
-    std::set<Value *> NonVolatileAndStackPointers;
-    std::set<Value *> NonVolatilePointers;
-
-    BasicBlock &Entry = F.getEntryBlock();
-    for (BasicBlock::iterator I_it = Entry.begin(); I_it != Entry.end();
-         ++I_it) {
-      if (I_it->getOpcode() == Instruction::GetElementPtr) {
-        if (ConstantInt *ConstIdx =
-                dyn_cast<ConstantInt>(I_it->getOperand(2))) {
-          if (isNonVolatile(ConstIdx->getZExtValue())) {
-            NonVolatileAndStackPointers.insert(&*I_it);
-            NonVolatilePointers.insert(&*I_it);
-          } else if (isStack(ConstIdx->getZExtValue())) {
-            NonVolatileAndStackPointers.insert(&*I_it);
-          }
-        }
+    if (ConstantInt *ConstIdx = dyn_cast<ConstantInt>(I.getOperand(2))) {
+      uint64_t Idx = ConstIdx->getZExtValue();
+      if (isNonVolatile(Idx)) {
+        Slots[&I] = Idx;
+        NonVolatilePointers.push_back(&I);
+      } else if (isStack(Idx)) {
+        Slots[&I] = Idx;
       }
     }
+  }
+  if (Slots.empty())
+    return;
 
-    for (Function::iterator BB_it = F.begin(); BB_it != F.end(); ++BB_it) {
-      if (!hasCall(*BB_it))
-        continue;
-      for (BasicBlock::iterator I_it = BB_it->begin(); I_it != BB_it->end();
-           ++I_it) {
-        if (I_it->getOpcode() == Instruction::Store) {
-          std::set<Value *>::iterator S_it =
-              NonVolatileAndStackPointers.find(I_it->getOperand(1));
-          if (S_it != NonVolatileAndStackPointers.end()) {
-            replaceLoaded(&*I_it);
-          }
-        }
+  DenseMap<Value *, Value *> Replacement;
+  DenseMap<unsigned, Value *> LastStore;
+  for (BasicBlock &BB : F) {
+    if (!hasCall(BB))
+      continue;
+    LastStore.clear();
+    for (Instruction &I : BB) {
+      if (StoreInst *Store = dyn_cast<StoreInst>(&I)) {
+        auto Slot = Slots.find(Store->getPointerOperand());
+        if (Slot == Slots.end())
+          continue;
+        Value *V = Store->getValueOperand();
+        auto Replaced = Replacement.find(V);
+        LastStore[Slot->second] =
+            Replaced == Replacement.end() ? V : Replaced->second;
+      } else if (LoadInst *Load = dyn_cast<LoadInst>(&I)) {
+        auto Slot = Slots.find(Load->getPointerOperand());
+        if (Slot == Slots.end())
+          continue;
+        auto Stored = LastStore.find(Slot->second);
+        if (Stored == LastStore.end() ||
+            Stored->second->getType() != Load->getType())
+          continue;
+        R.Forwarded.push_back(std::make_pair(Load, Stored->second));
+        Replacement[Load] = Stored->second;
       }
     }
+    if (NonVolatileVerify)
+      verifyRewrite(BB, Slots, Replacement);
+  }
 
-    std::set<Instruction *> toRemove;
+  for (Value *Ptr : NonVolatilePointers)
+    for (User *U : Ptr->users())
+      if (StoreInst *Store = dyn_cast<StoreInst>(U))
+        if (Store->getPointerOperand() == Ptr)
+          R.DeadStores.push_back(Store);
+}
 
-    for (auto &ptr : NonVolatilePointers) {
+// Searches backward from every load of BB for the store it was forwarded
+// from, the way the pass used to, and compares.
+void NonVolatileRegistersPass::verifyRewrite(
+    BasicBlock &BB, const DenseMap<const Value *, unsigned> &Slots,
+    const DenseMap<Value *, Value *> &Replacement) {
+  for (BasicBlock::iterator I_it = BB.begin(); I_it != BB.end(); ++I_it) {
+    LoadInst *Load = dyn_cast<LoadInst>(&*I_it);
+    if (!Load)
+      continue;
+    auto Slot = Slots.find(Load->getPointerOperand());
+    if (Slot == Slots.end())
+      continue;
 
-      for (auto ptrUser : ptr->users()) {
-        if (StoreInst *storeInst = dyn_cast<StoreInst>(ptrUser)) {
-          toRemove.insert(storeInst);
-        }
-      }
+    Value *Expected = nullptr;
+    for (BasicBlock::iterator S_it = I_it; S_it != BB.begin();) {
+      StoreInst *Store = dyn_cast<StoreInst>(&*--S_it);
+      if (!Store)
+        continue;
+      auto StoreSlot = Slots.find(Store->getPointerOperand());
+      if (StoreSlot == Slots.end() || StoreSlot->second != Slot->second)
+        continue;
+      Expected = Store->getValueOperand();
+      auto Replaced = Replacement.find(Expected);
+      if (Replaced != Replacement.end())
+        Expected = Replaced->second;
+      if (Expected->getType() != Load->getType())
+        Expected = nullptr;
+      break;
     }
 
-    for (auto &r : toRemove) {
-      r->dropAllReferences();
-      r->removeFromParent();
-      //                r->dump();
+    auto Actual = Replacement.find(Load);
+    if (Expected != (Actual == Replacement.end() ? nullptr : Actual->second)) {
+      std::string Msg;
+      raw_string_ostream OS(Msg);
+      OS << "NonVolatileRegistersPass forwarded the wrong value to" << *Load
+         << " in " << BB.getParent()->getName();
+      report_fatal_error(OS.str());
     }
   }
 }
@@ -108,31 +217,5 @@ bool NonVolatileRegistersPass::isStack(uint64_t Idx) {
   return false;
 }
 
-void NonVolatileRegistersPass::replaceLoaded(Instruction *StoreInst) {
-  Value *Ptr = StoreInst->getOperand(1);
-  Value *V = StoreInst->getOperand(0);
-  if (!V)
-    StoreInst->dump();
-  assert(V);
-
-  BasicBlock *BB = StoreInst->getParent();
-  Instruction *Load = nullptr;
-  for (BasicBlock::iterator I_it = BB->begin(); I_it != BB->end(); ++I_it) {
-    if (I_it->getOpcode() == Instruction::Load && I_it->getOperand(0) == Ptr) {
-      Load = &*I_it;
-    }
-  }
-
-  if (!Load)
-    return;
-
-  //    for (Value::const_use_iterator U_it = Load->use_begin(); U_it !=
-  //    Load->use_end(); ++U_it) {
-  //
-  //    }
-  if (Load != V)
-    Load->replaceAllUsesWith(V);
-}
-
 char NonVolatileRegistersPass::ID = 0;
 static RegisterPass<NonVolatileRegistersPass> X("nonvolatile", "", true, false);
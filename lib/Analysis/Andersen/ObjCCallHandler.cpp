@@ -1,5 +1,6 @@
 #include "llvm/Analysis/Andersen/ObjCCallHandler.h"
 #include <llvm/IR/Value.h>
+#include <chrono>
 #include <memory>
 
 #include "llvm/IR/CallSite.h"
@@ -26,26 +27,26 @@ CallHandlerManager &CallHandlerManager::getInstance() {
   static CallHandlerManager *Instance = nullptr;
   if (!Instance) {
     Instance = new CallHandlerManager();
-    Instance->registerCallHandler<objcMsgSend>();
-    Instance->registerCallHandler<MsgSendSuper>();
-    Instance->registerCallHandler<dispatchBlock>();
-    Instance->registerCallHandler<CopyProperty>();
-    Instance->registerCallHandler<retainBlock>();
-    Instance->registerCallHandler<objcARC>();
+    Instance->registerCallHandler<objcMsgSend>("objcMsgSend");
+    Instance->registerCallHandler<MsgSendSuper>("MsgSendSuper");
+    Instance->registerCallHandler<dispatchBlock>("dispatchBlock");
+    Instance->registerCallHandler<CopyProperty>("CopyProperty");
+    Instance->registerCallHandler<retainBlock>("retainBlock");
+    Instance->registerCallHandler<objcARC>("objcARC");
     //        Instance->registerCallHandler<objcPreserveX0>();
     //        Instance->registerCallHandler<objcPreserveNone>();
     //        Instance->registerCallHandler<specialAllocs>();
-    Instance->registerCallHandler<ClassHandler>();
-    Instance->registerCallHandler<ExternalHandler>();
-    Instance->registerCallHandler<NSArray>();
-    Instance->registerCallHandler<UIControlTarget>();
-    Instance->registerCallHandler<UIAppDelegate>();
-    Instance->registerCallHandler<NSUserDefaults>();
-    Instance->registerCallHandler<SecItemCopyAdd>();
+    Instance->registerCallHandler<ClassHandler>("ClassHandler");
+    Instance->registerCallHandler<ExternalHandler>("ExternalHandler");
+    Instance->registerCallHandler<NSArray>("NSArray");
+    Instance->registerCallHandler<UIControlTarget>("UIControlTarget");
+    Instance->registerCallHandler<UIAppDelegate>("UIAppDelegate");
+    Instance->registerCallHandler<NSUserDefaults>("NSUserDefaults");
+    Instance->registerCallHandler<SecItemCopyAdd>("SecItemCopyAdd");
 
     //        Instance->registerCallHandler<Dummy>();
 
-    Instance->registerCallHandler<objcInit>();
+    Instance->registerCallHandler<objcInit>("objcInit");
     //        Instance->registerCallHandler<DummyHandler>();
   }
   initLock.unlock();
@@ -55,16 +56,42 @@ CallHandlerManager &CallHandlerManager::getInstance() {
 bool CallHandlerManager::handleFunctionCall(const Instruction *CallInst,
                                             std::string &F,
                                             Andersen *andersen) {
-  for (CallHandlerList_t::iterator CH_it = CallHandlers.begin();
-       CH_it != CallHandlers.end(); ++CH_it) {
-    if ((*CH_it)->shouldHandleCall(F)) {
-      if ((*CH_it)->run(CallInst, F, andersen))
+  typedef std::chrono::steady_clock Clock;
+  for (size_t Idx = 0; Idx < CallHandlers.size(); ++Idx) {
+    CallHandlerBase &Handler = *CallHandlers[Idx];
+    if (!Handler.shouldHandleCall(F))
+      continue;
+    if (!StatisticsEnabled) {
+      if (Handler.run(CallInst, F, andersen))
         return true;
+      continue;
+    }
+    HandlerCounters &C = *Counters[Idx];
+    Clock::time_point Start = Clock::now();
+    bool Handled = Handler.run(CallInst, F, andersen);
+    C.Nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         Clock::now() - Start)
+                         .count();
+    ++C.Calls;
+    if (Handled) {
+      ++C.Handled;
+      return true;
     }
   }
+  if (StatisticsEnabled)
+    ++Unhandled;
   return false;
 }
 
+std::vector<CallHandlerManager::HandlerStatistics>
+CallHandlerManager::getStatistics() const {
+  std::vector<HandlerStatistics> Statistics;
+  for (auto &C : Counters)
+    Statistics.push_back(
+        {C->Name, C->Calls, C->Handled, C->Nanoseconds / 1e9});
+  return Statistics;
+}
+
 CallHandlerManager::CallHandlerPtr_t
 CallHandlerManager::getCallHandler(StringRef &FunctionName) {
   for (CallHandlerList_t::iterator CH_it = CallHandlers.begin();
@@ -77,6 +104,8 @@ CallHandlerManager::getCallHandler(StringRef &FunctionName) {
 }
 
 void CallHandlerManager::addCallHandler(
-    std::shared_ptr<CallHandlerBase> Handler) {
+    std::shared_ptr<CallHandlerBase> Handler, StringRef Name) {
   CallHandlers.push_back(Handler);
+  Counters.emplace_back(new HandlerCounters());
+  Counters.back()->Name = Name;
 }
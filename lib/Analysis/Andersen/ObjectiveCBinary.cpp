@@ -66,6 +66,22 @@ ObjectiveCBinary::ObjectiveCBinary(llvm::StringRef Path) {
   ADDSUBSUP("UIButton", "UIControl")
   ADDSUBSUP("UIControl", "UIView")
   ADDSUBSUP("NSMutableDictionary", "NSDictionary")
+
+  linkClasses();
+}
+
+void ObjectiveCBinary::linkClasses() {
+  for (ClassMap_t *Map : {&Classes, &Metaclasses}) {
+    for (auto &C : *Map) {
+      if (!C.second)
+        continue;
+      StringRef Super = C.second->getSuperclass();
+      ClassMap_t::const_iterator Super_it = Map->find(Super);
+      // A class that names itself as its superclass ends the chain.
+      if (Super.size() && Super != C.first && Super_it != Map->end())
+        C.second->setSuperclassPtr(Super_it->second.get());
+    }
+  }
 }
 
 bool ObjectiveCBinary::isValidAddress(uint64_t Address) { return false; }
@@ -509,6 +525,10 @@ void ObjectiveCBinary::parseClass(uint64_t DataAddress, bool MetaClass) {
                .data();
     }
     StringRef ProtocolName = getString(ProtocolNamePtr);
+    ClassPtr->addProtocol(ProtocolName.str());
+    // Classes adopting the same protocol share its methods.
+    if (protocolMap.count(ProtocolName))
+      return;
 
     ObjectiveC::Protocol aProtocol(ProtocolName);
     uint64_t ProtocolsListPtr =
@@ -529,7 +549,6 @@ void ObjectiveCBinary::parseClass(uint64_t DataAddress, bool MetaClass) {
     uint64_t SignatureStartPtr =
         *(uint64_t *)SectionData.slice(ProtocolPtr - SectionAddress + 72)
              .data();
-    ClassPtr->addProtocol(ProtocolName.str());
 
     uint64_t signaturesIdx = 0;
 
@@ -748,6 +767,7 @@ StringRef ObjectiveCBinary::getString(uint64_t Address) {
   object::section_iterator CStringSection = getSectionIterator(SEC_CSTRING);
   object::section_iterator MethTypeSection = getSectionIterator(SEC_METHTYPE);
 
+  std::map<uint64_t, StringRef>::const_iterator Bind = BindInfo.find(Address);
   if (isAddressInSection(Address, CFStringSection)) {
     StringRef Contents;
     CFStringSection->getContents(Contents);
@@ -757,10 +777,10 @@ StringRef ObjectiveCBinary::getString(uint64_t Address) {
              .data();
     StringRef s = getString(stringAddress);
     return s;
-  } else if (BindInfo[Address].size()) {
-    return BindInfo[Address].startswith_lower(OBJC_CLASS_ID)
-               ? BindInfo[Address].substr(strlen(OBJC_CLASS_ID))
-               : BindInfo[Address];
+  } else if (Bind != BindInfo.end() && Bind->second.size()) {
+    return Bind->second.startswith_lower(OBJC_CLASS_ID)
+               ? Bind->second.substr(strlen(OBJC_CLASS_ID))
+               : Bind->second;
   } else if (isAddressInSection(Address, MethnameSection) &&
              !MethnameSection->getContents(Contents)) {
     return (Contents.data() + (Address - MethnameSection->getAddress()));
@@ -768,7 +788,9 @@ StringRef ObjectiveCBinary::getString(uint64_t Address) {
              !ClassnameSection->getContents(Contents)) {
     return (Contents.data() + (Address - ClassnameSection->getAddress()));
   } else if (isAddressInSection(Address, DataSection)) {
-    return ClassNames[Address];
+    std::map<uint64_t, StringRef>::const_iterator Name =
+        ClassNames.find(Address);
+    return Name == ClassNames.end() ? StringRef() : Name->second;
   } else if (isAddressInSection(Address, SelRefSection)) {
     StringRef Contents;
     SelRefSection->getContents(Contents);
@@ -832,7 +854,8 @@ StringRef ObjectiveCBinary::getString(uint64_t Address) {
 }
 
 bool ObjectiveCBinary::getClass(const uint64_t Address, StringRef &Classname) {
-  Classname = ClassRefs[Address];
+  std::map<uint64_t, StringRef>::const_iterator Ref = ClassRefs.find(Address);
+  Classname = Ref == ClassRefs.end() ? StringRef() : Ref->second;
   return Classname.size() > 0;
 }
 
@@ -848,42 +871,33 @@ bool ObjectiveCBinary::getSelector(const uint64_t Address,
 std::deque<std::string>
 ObjectiveCBinary::getMethodCandidates(StringRef Type, StringRef Selector,
                                       bool Meta) {
-  BaseClassPtr_t Base = Meta ? Metaclasses[Type] : Classes[Type];
-  if (!Base) {
-    //        for (ClassMap_t::iterator C_it = (Meta ? Metaclasses.begin() :
-    //        Classes.begin()); C_it != (Meta ? Metaclasses.end():
-    //        Classes.end()); ++C_it) {
-    //            errs() << C_it->first << " " << (uint64_t)C_it->second.get()
-    //            << "\n";
-    //        }
-    //        errs() << "NOT FOUND:\n";
-    //        errs() << Type << " " << Selector << "\n";
-    std::stringstream ss;
-    ss << (Meta ? "+[" : "-[") << Type.str() + " " + Selector.str() + "]";
-    std::deque<std::string> M;
-    M.push_front(ss.str());
+  auto getCandidate = [&](StringRef Classname) {
+    return (Twine(Meta ? "+[" : "-[") + Classname + " " + Selector + "]")
+        .str();
+  };
+
+  const ClassMap_t &Map = Meta ? Metaclasses : Classes;
+  ClassMap_t::const_iterator Base_it = Map.find(Type);
+  std::deque<std::string> M;
+  if (Base_it == Map.end() || !Base_it->second) {
+    M.push_back(getCandidate(Type));
     return M;
   }
-  assert(Base);
-  if (Base->getSuperclass().size() && (Base->getSuperclass() != Type.data())) {
-    //        ClassPtr_t Class =
-    //        std::static_pointer_cast<ObjectiveC::Class>(Base);
-    std::deque<std::string> M =
-        getMethodCandidates(Base->getSuperclass(), Selector, Meta);
-    std::stringstream ss;
-    ss << (Meta ? "+[" : "-[")
-       << Base->getClassName().str() + " " + Selector.str() + "]";
-    M.push_front(ss.str());
-    return M;
-  } else {
-    std::stringstream ss;
-    ss << (Meta ? "+[" : "-[")
-       << Base->getClassName().str() + " " + Selector.str() + "]";
-    std::deque<std::string> M;
-    M.push_front(ss.str());
-    return M;
+  // The class itself first, then its superclasses up to one the binary
+  // doesn't know, which is tried by name.
+  const ObjectiveC::Base *Base = Base_it->second.get();
+  while (Base) {
+    M.push_back(getCandidate(Base->getClassName()));
+    StringRef Super = Base->getSuperclass();
+    if (!Super.size() || Super == Base->getClassName())
+      break;
+    if (!Base->getSuperclassPtr()) {
+      M.push_back(getCandidate(Super));
+      break;
+    }
+    Base = Base->getSuperclassPtr();
   }
-  llvm_unreachable("");
+  return M;
 }
 
 std::string ObjectiveCBinary::getFunctionName(uint64_t Address) {
@@ -1,6 +1,13 @@
 #include "llvm/Analysis/Andersen/ObjectiveCClassInfo.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/MathExtras.h"
 #include "llvm/Support/raw_ostream.h"
 #include <llvm/Support/ErrorHandling.h>
+
+#include <algorithm>
+#include <cctype>
+#include <memory>
+#include <mutex>
 #include <sstream>
 
 using namespace llvm;
@@ -12,15 +19,11 @@ void Class::addMethod(Method M) {
   Methods.push_back(M);
 }
 
-bool Class::getMethod(StringRef Methodname, Method &M) {
-  for (MethodList_t::iterator M_it = Methods.begin(); M_it != Methods.end();
-       ++M_it) {
-    if (M_it->Methodname == Methodname) {
-      M = *M_it;
-      return true;
-    }
-  }
-  return false;
+const Method *Class::getMethod(StringRef Methodname) const {
+  for (const Method &M : Methods)
+    if (M.Methodname == Methodname)
+      return &M;
+  return nullptr;
 }
 
 void Class::addIVAR(IVAR ivar) {
@@ -29,124 +32,368 @@ void Class::addIVAR(IVAR ivar) {
   ivar.ParentClass = Classname;
 }
 
-bool Class::getIVAR(StringRef IVARName, IVAR &ivar) {
-  for (IVARList_t::iterator it = IVARs.begin(); it != IVARs.end(); ++it) {
-    if (it->IVARName == IVARName) {
-      ivar = *it;
-      return true;
-    }
-  }
-  return false;
+const IVAR *Class::getIVAR(StringRef IVARName) const {
+  for (const IVAR &I : IVARs)
+    if (I.IVARName == IVARName)
+      return &I;
+  return nullptr;
 }
 
-bool Class::getIVAR(uint64_t IVAROffset, IVAR &ivar) {
-  for (IVARList_t::iterator it = IVARs.begin(); it != IVARs.end(); ++it) {
-    if (it->OffsetPtr == IVAROffset) {
-      ivar = *it;
-      return true;
-    }
-  }
-  return false;
+const IVAR *Class::getIVAR(uint64_t IVAROffset) const {
+  for (const IVAR &I : IVARs)
+    if (I.OffsetPtr == IVAROffset)
+      return &I;
+  return nullptr;
 }
 
-// Method
+// MethodLayout
 
-void Method::parseType() {
-  if (!type.size())
-    return;
+namespace {
+// Size, alignment and floating point make-up of an encoded type.
+struct EncodedType {
+  uint64_t Size = 0;
+  uint64_t Align = 1;
+  // Width of a bitfield, which only occurs in structs.
+  uint64_t Bits = 0;
+  bool Composite = false;
+  // A struct or union known by name only, fine behind a pointer.
+  bool Opaque = false;
+  bool Object = false;
+  std::string Class;
+  // 'f' or 'd' if all members are floats or doubles, 'x' if there are
+  // others, 0 for no members. NumFP counts the floating point members.
+  char FPKind = 0;
+  uint64_t NumFP = 0;
+};
 
-  const char *type_it = type.data();
-  bool isReturnType = true;
+class EncodingParser {
+public:
+  explicit EncodingParser(StringRef S) : S(S) {}
 
-  unsigned currentGPR = 5;
-  unsigned currentFPR = -1U;
+  bool atEnd() const { return S.empty(); }
 
-  while (*type_it) {
-    switch (*type_it) {
-    default:
-      llvm_unreachable("");
-    case 'r':
-    case 'n':
-    case 'N':
-    case 'o':
-    case 'O':
-    case 'V': {
-      ++type_it;
-      break;
-    }
-    case 'v': {
+  // A type followed by its offset in the argument frame.
+  bool parseArgument(EncodedType &T) {
+    if (!parseType(T, 0))
+      return false;
+    if (peek() == '-')
+      next();
+    while (isdigit(peek()))
+      next();
+    return true;
+  }
 
-      ++type_it;
-      break;
+private:
+  static const unsigned MaxDepth = 64;
+  static const uint64_t MaxElements = 1 << 24;
+
+  StringRef S;
+
+  char peek() const { return S.empty() ? 0 : S.front(); }
+  char next() {
+    char C = peek();
+    S = S.drop_front(S.empty() ? 0 : 1);
+    return C;
+  }
+
+  bool parseNumber(uint64_t &N) {
+    if (!isdigit(peek()))
+      return false;
+    N = 0;
+    while (isdigit(peek())) {
+      if (N > MaxElements)
+        return false;
+      N = N * 10 + (next() - '0');
     }
-    case 'i':
+    return true;
+  }
+
+  static void setScalar(EncodedType &T, uint64_t Size, char FPKind = 'x') {
+    T.Size = T.Align = Size;
+    T.FPKind = FPKind;
+    T.NumFP = FPKind == 'x' ? 0 : 1;
+  }
+
+  static void mergeFP(EncodedType &T, const EncodedType &Member) {
+    if (!Member.FPKind)
+      return;
+    if (Member.FPKind == 'x' || (T.FPKind && T.FPKind != Member.FPKind))
+      T.FPKind = 'x';
+    else
+      T.FPKind = Member.FPKind;
+  }
+
+  bool parseType(EncodedType &T, unsigned Depth) {
+    if (Depth > MaxDepth)
+      return false;
+    // Qualifiers: const, in, inout, out, bycopy, byref, oneway, atomic.
+    while (peek() && StringRef("rnNoORVA").find(peek()) != StringRef::npos)
+      next();
+
+    switch (next()) {
+    default:
+      return false;
+    case 'c':
+    case 'C':
+    case 'B':
+      setScalar(T, 1);
+      return true;
     case 's':
-    case 'l':
-    case 'I':
     case 'S':
+      setScalar(T, 2);
+      return true;
+    case 'i':
+    case 'I':
+    case 'l':
     case 'L':
-    case 'C':
-    case 'c':
-    case 'B':
+      setScalar(T, 4);
+      return true;
+    case 'q':
+    case 'Q':
     case '*':
+    case '#':
     case ':':
-    case '#': {
-      ++currentGPR;
-      ++type_it;
-      break;
+    case '?':
+      setScalar(T, 8);
+      return true;
+    case 't':
+    case 'T':
+      // 128 bit integers take an even pair of GPRs.
+      setScalar(T, 16);
+      T.Composite = true;
+      return true;
+    case 'f':
+      setScalar(T, 4, 'f');
+      return true;
+    case 'd':
+    case 'D':
+      // long double is a double on arm64 Darwin.
+      setScalar(T, 8, 'd');
+      return true;
+    case 'v':
+      T.FPKind = 'x';
+      return true;
+    case '@':
+      setScalar(T, 8);
+      T.Object = true;
+      if (peek() == '?') {
+        // A block.
+        next();
+      } else if (peek() == '"') {
+        next();
+        size_t End = S.find('"');
+        if (End == StringRef::npos)
+          return false;
+        T.Class = S.substr(0, End);
+        S = S.drop_front(End + 1);
+      }
+      return true;
+    case '^': {
+      EncodedType Pointee;
+      if (!parseType(Pointee, Depth + 1))
+        return false;
+      setScalar(T, 8);
+      return true;
     }
-    case 'q':
-    case 'Q': {
-      return;
-      ++type_it;
-      break;
+    case 'b':
+      T.FPKind = 'x';
+      return parseNumber(T.Bits);
+    case 'j': {
+      // _Complex, laid out like a struct of two.
+      EncodedType Part;
+      if (!parseType(Part, Depth + 1) || Part.Composite || !Part.Size)
+        return false;
+      T = Part;
+      T.Size = 2 * Part.Size;
+      T.NumFP = 2 * Part.NumFP;
+      T.Composite = true;
+      return true;
     }
-    case 'f': {
-
-      ++type_it;
-      break;
+    case '[': {
+      uint64_t N;
+      EncodedType Element;
+      if (!parseNumber(N) || !parseType(Element, Depth + 1) ||
+          Element.Opaque || Element.Bits || next() != ']')
+        return false;
+      if (Element.Size && N > UINT64_MAX / Element.Size / 2)
+        return false;
+      T = Element;
+      T.Size = N * Element.Size;
+      T.NumFP = N * Element.NumFP;
+      T.Composite = true;
+      T.Object = false;
+      T.Class.clear();
+      return true;
+    }
+    case '{':
+      return parseAggregate(T, '}', false, Depth);
+    case '(':
+      return parseAggregate(T, ')', true, Depth);
     }
-    case 'd': {
+  }
 
-      ++type_it;
-      break;
+  // The name, then '=' and the members, or only the name.
+  bool parseAggregate(EncodedType &T, char Close, bool Union, unsigned Depth) {
+    size_t End = S.find_first_of(Close == '}' ? "=}" : "=)");
+    if (End == StringRef::npos)
+      return false;
+    char Separator = S[End];
+    S = S.drop_front(End + 1);
+    T.Composite = true;
+    if (Separator == Close) {
+      T.Opaque = true;
+      return true;
     }
-    case '@': {
-      unsigned reg = currentGPR++;
-      if (*(type_it + 1) == '\"') {
-        type_it += 2;
-        const char *end_it = strchr(type_it, '\"');
-        unsigned length = end_it - type_it;
-        std::string paramType(type_it);
-        paramType = paramType.substr(0, length);
-        type_it = end_it;
-        regTypes.push_back(RegType_t(reg, paramType));
+
+    uint64_t Bits = 0;
+    auto addBits = [&]() {
+      T.Size += (Bits + 7) / 8;
+      Bits = 0;
+    };
+    while (peek() != Close) {
+      if (atEnd())
+        return false;
+      if (peek() == '"') {
+        // A field name.
+        next();
+        size_t NameEnd = S.find('"');
+        if (NameEnd == StringRef::npos)
+          return false;
+        S = S.drop_front(NameEnd + 1);
+        continue;
+      }
+      EncodedType Member;
+      if (!parseType(Member, Depth + 1) || Member.Opaque)
+        return false;
+      mergeFP(T, Member);
+      if (Member.Bits) {
+        Bits += Member.Bits;
+        continue;
+      }
+      addBits();
+      if (Union) {
+        T.Size = std::max(T.Size, Member.Size);
+        T.NumFP = std::max(T.NumFP, Member.NumFP);
       } else {
+        T.Size = RoundUpToAlignment(T.Size, Member.Align) + Member.Size;
+        T.NumFP += Member.NumFP;
       }
-      ++type_it;
-      break;
+      T.Align = std::max(T.Align, Member.Align);
+      if (T.Size > UINT64_MAX / 4)
+        return false;
     }
-    case '0':
-    case '1':
-    case '2':
-    case '3':
-    case '4':
-    case '5':
-    case '6':
-    case '7':
-    case '8':
-    case '9': {
-      ++type_it;
+    next();
+    addBits();
+    T.Size = RoundUpToAlignment(T.Size, T.Align);
+    return true;
+  }
+};
+
+struct LayoutCache {
+  std::mutex Lock;
+  StringMap<std::unique_ptr<MethodLayout>> Layouts;
+  uint64_t Lookups = 0;
+};
+
+LayoutCache &getLayoutCache() {
+  // Never destroyed: methods refer to their layouts until the end.
+  static LayoutCache *C = new LayoutCache();
+  return *C;
+}
+} // namespace
+
+MethodLayout MethodLayout::decode(StringRef Encoding) {
+  MethodLayout L;
+  L.Encoding = Encoding;
+  L.Complete = true;
+
+  EncodingParser Parser(Encoding);
+  // The result takes no argument registers, even when it is returned
+  // through X8.
+  EncodedType Result;
+  if (!Parser.atEnd() && !Parser.parseArgument(Result)) {
+    L.Complete = false;
+    return L;
+  }
+
+  // Next GPR, FPR and stack offset, as in AAPCS64.
+  unsigned NGRN = 0, NSRN = 0;
+  uint64_t NSAA = 0;
+  while (!Parser.atEnd()) {
+    EncodedType T;
+    if (!Parser.parseArgument(T) || T.Opaque || T.Bits || !T.Size) {
+      L.Complete = false;
       break;
     }
-    case '[':
-    case '{':
-    case '(':
-    case 'b':
-    case '?':
-    case '^': {
-      return;
+    Arg A;
+    A.Class = T.Class;
+
+    uint64_t FPSize = T.FPKind == 'f' ? 4 : 8;
+    bool HFA = (T.FPKind == 'f' || T.FPKind == 'd') && T.NumFP >= 1 &&
+               T.NumFP <= 4 && T.Size == T.NumFP * FPSize;
+    uint64_t Size = T.Size, Align = T.Align;
+    if (HFA) {
+      if (NSRN + T.NumFP <= 8) {
+        A.Kind = FPR;
+        A.Reg = NSRN;
+        A.NumRegs = T.NumFP;
+        NSRN += T.NumFP;
+        L.Args.push_back(A);
+        continue;
+      }
+      NSRN = 8;
+    } else {
+      if (T.Composite && Size > 16) {
+        // Passed by reference.
+        Size = Align = 8;
+        T.Composite = false;
+      }
+      unsigned NumRegs = (Size + 7) / 8;
+      if (Align == 16)
+        NGRN = RoundUpToAlignment(NGRN, 2);
+      if (NGRN + NumRegs <= 8) {
+        A.Kind = GPR;
+        A.Reg = 5 + NGRN;
+        A.NumRegs = NumRegs;
+        NGRN += NumRegs;
+        if (T.Object && A.Class.size())
+          L.RegTypes.push_back(RegType_t(A.Reg, A.Class));
+        L.Args.push_back(A);
+        continue;
+      }
+      NGRN = 8;
     }
+    // Darwin packs stack arguments at their natural alignment.
+    if (T.Composite) {
+      Align = std::max<uint64_t>(Align, 8);
+      Size = RoundUpToAlignment(Size, 8);
     }
+    NSAA = RoundUpToAlignment(NSAA, std::min<uint64_t>(Align, 16));
+    A.Kind = Stack;
+    A.Reg = NSAA;
+    A.NumRegs = 0;
+    NSAA += Size;
+    L.Args.push_back(A);
   }
+  return L;
+}
+
+const MethodLayout &MethodLayout::get(StringRef Encoding) {
+  LayoutCache &C = getLayoutCache();
+  std::lock_guard<std::mutex> Guard(C.Lock);
+  ++C.Lookups;
+  std::unique_ptr<MethodLayout> &L = C.Layouts[Encoding];
+  if (!L)
+    L.reset(new MethodLayout(decode(Encoding)));
+  return *L;
+}
+
+void MethodLayout::printStatistics(raw_ostream &OS) {
+  LayoutCache &C = getLayoutCache();
+  std::lock_guard<std::mutex> Guard(C.Lock);
+  unsigned Incomplete = 0;
+  for (auto &L : C.Layouts)
+    Incomplete += !L.second->isComplete();
+  OS << "[+]method layouts: " << C.Lookups << " lookups, " << C.Layouts.size()
+     << " encodings, " << Incomplete << " not fully decoded\n";
 }
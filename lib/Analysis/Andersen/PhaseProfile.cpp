@@ -0,0 +1,199 @@
+#include "llvm/Analysis/Andersen/PhaseProfile.h"
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <unistd.h>
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#endif
+
+#include "nlohmann/json.hpp"
+
+using namespace llvm;
+
+static cl::opt<std::string>
+    PhaseProfileFile("phase-profile",
+                     cl::desc("Write the time and memory of each analysis "
+                              "phase to this file as JSON"),
+                     cl::init(""), cl::Hidden);
+
+namespace {
+struct Phase {
+  std::string Name;
+  int Parent;
+  unsigned Depth;
+  TimeRecord Start;
+  TimeRecord Elapsed;
+  uint64_t RSSBefore;
+  uint64_t RSSAfter;
+  uint64_t PeakRSS;
+};
+
+struct Profile {
+  std::mutex Lock;
+  TimerGroup Group{"Slicer phases"};
+  StringMap<std::unique_ptr<Timer>> Timers;
+  std::vector<Phase> Phases;
+  std::vector<unsigned> Open;
+};
+
+Profile &getProfile() {
+  // Never destroyed: the timers must not report from a static destructor.
+  static Profile *P = new Profile();
+  return *P;
+}
+} // namespace
+
+bool PhaseProfile::isEnabled() { return !PhaseProfileFile.empty(); }
+
+void PhaseProfile::begin(StringRef Name) {
+  if (!isEnabled())
+    return;
+  Profile &P = getProfile();
+  std::lock_guard<std::mutex> Guard(P.Lock);
+  Phase Ph;
+  Ph.Name = Name;
+  Ph.Parent = P.Open.empty() ? -1 : (int)P.Open.back();
+  Ph.Depth = P.Open.size();
+  Ph.RSSBefore = getCurrentRSS();
+  Ph.RSSAfter = 0;
+  Ph.PeakRSS = 0;
+
+  std::unique_ptr<Timer> &T = P.Timers[Name];
+  if (!T)
+    T.reset(new Timer(Name, P.Group));
+  // A phase nested in itself is timed by the outermost run only.
+  bool Nested = false;
+  for (unsigned Idx : P.Open)
+    Nested |= P.Phases[Idx].Name == Name;
+  if (!Nested)
+    T->startTimer();
+  P.Open.push_back(P.Phases.size());
+  Ph.Start = TimeRecord::getCurrentTime(true);
+  P.Phases.push_back(Ph);
+}
+
+void PhaseProfile::end() {
+  if (!isEnabled())
+    return;
+  TimeRecord Now = TimeRecord::getCurrentTime(false);
+  Profile &P = getProfile();
+  std::lock_guard<std::mutex> Guard(P.Lock);
+  assert(!P.Open.empty() && "Unbalanced PhaseProfile::end()");
+  Phase &Ph = P.Phases[P.Open.back()];
+  P.Open.pop_back();
+  Ph.Elapsed = Now;
+  Ph.Elapsed -= Ph.Start;
+  Ph.RSSAfter = getCurrentRSS();
+  Ph.PeakRSS = getPeakRSS();
+
+  bool Nested = false;
+  for (unsigned Idx : P.Open)
+    Nested |= P.Phases[Idx].Name == Ph.Name;
+  if (!Nested)
+    P.Timers[Ph.Name]->stopTimer();
+}
+
+PhaseProfile::Scope::Scope(StringRef Name) : Active(isEnabled()) {
+  if (Active)
+    begin(Name);
+}
+
+PhaseProfile::Scope::~Scope() {
+  if (Active)
+    end();
+}
+
+void PhaseProfile::write(raw_ostream &OS) {
+  typedef nlohmann::json json;
+  Profile &P = getProfile();
+  std::lock_guard<std::mutex> Guard(P.Lock);
+
+  json Phases = json::array();
+  std::map<std::string, json> Totals;
+  for (const Phase &Ph : P.Phases) {
+    json J;
+    J["name"] = Ph.Name;
+    J["parent"] = Ph.Parent;
+    J["depth"] = Ph.Depth;
+    J["wall"] = Ph.Elapsed.getWallTime();
+    J["user"] = Ph.Elapsed.getUserTime();
+    J["system"] = Ph.Elapsed.getSystemTime();
+    J["rssBefore"] = Ph.RSSBefore;
+    J["rssAfter"] = Ph.RSSAfter;
+    J["peakRss"] = Ph.PeakRSS;
+    Phases.push_back(J);
+
+    json &T = Totals[Ph.Name];
+    if (T.is_null())
+      T = {{"count", 0}, {"wall", 0.0}, {"user", 0.0}, {"system", 0.0}};
+    T["count"] = T["count"].get<unsigned>() + 1;
+    T["wall"] = T["wall"].get<double>() + Ph.Elapsed.getWallTime();
+    T["user"] = T["user"].get<double>() + Ph.Elapsed.getUserTime();
+    T["system"] = T["system"].get<double>() + Ph.Elapsed.getSystemTime();
+  }
+
+  json Root;
+  Root["peakRss"] = getPeakRSS();
+  Root["phases"] = Phases;
+  Root["totals"] = Totals;
+  OS << Root.dump(2) << "\n";
+}
+
+void PhaseProfile::write() {
+  if (!isEnabled())
+    return;
+  std::error_code EC;
+  raw_fd_ostream OS(PhaseProfileFile, EC, sys::fs::F_None);
+  if (EC) {
+    errs() << EC.message() << '\n';
+    return;
+  }
+  write(OS);
+  getProfile().Group.print(errs());
+}
+
+uint64_t PhaseProfile::getCurrentRSS() {
+#if defined(__linux__)
+  FILE *F = fopen("/proc/self/statm", "r");
+  if (!F)
+    return 0;
+  unsigned long Size = 0, Resident = 0;
+  int N = fscanf(F, "%lu %lu", &Size, &Resident);
+  fclose(F);
+  return N == 2 ? (uint64_t)Resident * sysconf(_SC_PAGESIZE) : 0;
+#elif defined(__APPLE__)
+  mach_task_basic_info Info;
+  mach_msg_type_number_t Count = MACH_TASK_BASIC_INFO_COUNT;
+  if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&Info,
+                &Count) != KERN_SUCCESS)
+    return 0;
+  return Info.resident_size;
+#else
+  return 0;
+#endif
+}
+
+uint64_t PhaseProfile::getPeakRSS() {
+  struct rusage Usage;
+  if (getrusage(RUSAGE_SELF, &Usage))
+    return 0;
+#if defined(__APPLE__)
+  return Usage.ru_maxrss;
+#else
+  // Kilobytes everywhere else.
+  return (uint64_t)Usage.ru_maxrss * 1024;
+#endif
+}
@@ -1,5 +1,8 @@
 #include "llvm/Analysis/Andersen/SimpleCallGraph.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/SparseBitVector.h"
 #include "llvm/Support/Debug.h"
+#include <algorithm>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Instruction.h>
@@ -28,10 +31,65 @@ void SimpleCallGraph::addCallEdge(const Instruction *CallInst,
     ReverseCallGraph[Target] = Callers;
   }
 
-  CalledFunctions->insert(Target);
+  if (CalledFunctions->insert(Target).second) {
+    FunctionID_t From =
+        getFunctionID(CallInst->getParent()->getParent()->getName());
+    FunctionEdges.push_back(std::make_pair(From, getFunctionID(Target)));
+    ++Version;
+  }
   Callers->insert(CallInst);
 }
 
+SimpleCallGraph::NameTable::NameTable(unsigned Size)
+    : Mask(Size - 1), Slots(new std::atomic<const FunctionName *>[Size]) {
+  for (unsigned i = 0; i < Size; ++i)
+    Slots[i].store(nullptr, std::memory_order_relaxed);
+}
+
+// Called with graphLock held.
+SimpleCallGraph::FunctionID_t SimpleCallGraph::getFunctionID(StringRef F) {
+  if (const FunctionName *Known = findFunction(F, FunctionNames.size()))
+    return Known->ID;
+
+  FunctionID_t ID = FunctionNames.size();
+  FunctionNames.push_back(FunctionName{F.str(), ID});
+  const FunctionName *Entry = &FunctionNames.back();
+
+  auto insert = [](const NameTable &T, const FunctionName *E) {
+    unsigned Slot = hash_value(StringRef(E->Name)) & T.Mask;
+    while (T.Slots[Slot].load(std::memory_order_relaxed))
+      Slot = (Slot + 1) & T.Mask;
+    T.Slots[Slot].store(E, std::memory_order_release);
+  };
+
+  // Kept at most half full.
+  if (NameTables.empty() ||
+      2 * FunctionNames.size() > NameTables.back()->Mask) {
+    unsigned Size = NameTables.empty() ? 64 : 2 * (NameTables.back()->Mask + 1);
+    NameTables.emplace_back(new NameTable(Size));
+    for (const FunctionName &E : FunctionNames)
+      insert(*NameTables.back(), &E);
+    Names.store(NameTables.back().get(), std::memory_order_release);
+  } else {
+    insert(*NameTables.back(), Entry);
+  }
+  return ID;
+}
+
+const SimpleCallGraph::FunctionName *
+SimpleCallGraph::findFunction(StringRef F, unsigned NumFunctions) const {
+  const NameTable *T = Names.load(std::memory_order_acquire);
+  if (!T)
+    return nullptr;
+  for (unsigned Slot = hash_value(F) & T->Mask;; Slot = (Slot + 1) & T->Mask) {
+    const FunctionName *E = T->Slots[Slot].load(std::memory_order_acquire);
+    if (!E)
+      return nullptr;
+    if (E->Name == F)
+      return E->ID < NumFunctions ? E : nullptr;
+  }
+}
+
 bool SimpleCallGraph::containtsEdge(const Instruction *Inst, std::string F) {
   std::unique_lock<std::mutex> lock(graphLock);
   FunctionSet_t &Called = getCalled(Inst);
@@ -57,6 +115,14 @@ SimpleCallGraph::getCalled(const Instruction *Inst) {
   return *CalledFunctions;
 }
 
+const SimpleCallGraph::FunctionSet_t *
+SimpleCallGraph::findCalled(const Instruction *Inst) const {
+  CallGraph_t::const_iterator It = CallGraph.find(Inst);
+  if (It == CallGraph.end())
+    return nullptr;
+  return It->second.get();
+}
+
 void SimpleCallGraph::finalize() {
   FunctionSet_t External;
 
@@ -140,44 +206,144 @@ void SimpleCallGraph::print(raw_ostream &ostream) {
 SimpleCallGraph::FunctionSet_t
 SimpleCallGraph::getCalled(const std::string &fun) {
   FunctionSet_t called;
-  for (auto &call_it : CallGraph) {
-    if (call_it.first->getParent()->getParent()->getName() == fun) {
-      called.insert(call_it.second->begin(), call_it.second->end());
-    }
-  }
+  const ReachabilityIndex &I = getIndex();
+  const FunctionName *F = findFunction(fun, I.NumFunctions);
+  if (!F)
+    return called;
+  for (unsigned e = I.CalleeOffsets[F->ID]; e != I.CalleeOffsets[F->ID + 1];
+       ++e)
+    called.insert(I.Callees[e]->Name);
   return called;
 }
 
-bool SimpleCallGraph::hasPath(std::string &from, std::string &to) {
-  std::unique_lock<std::mutex> lock(pathCacheLock);
-  if (pathCache.find(FromTo_t(from, to)) != pathCache.end()) {
-    return pathCache[FromTo_t(from, to)];
-  }
-  lock.unlock();
-  FunctionSet_t worklist(getCalled(from));
-  FunctionSet_t visited;
-  while (worklist.size()) {
-    FunctionSet_t tmp;
-    for (auto &w : worklist) {
-      if (visited.find(w) != visited.end())
+const SimpleCallGraph::ReachabilityIndex &SimpleCallGraph::getIndex() {
+  const ReachabilityIndex *Current = Index.load(std::memory_order_acquire);
+  if (Current && Current->Version == Version.load(std::memory_order_acquire))
+    return *Current;
+
+  std::unique_lock<std::mutex> lock(indexLock);
+  std::unique_lock<std::mutex> glock(graphLock);
+  Current = Index.load(std::memory_order_acquire);
+  if (Current && Current->Version == Version.load())
+    return *Current;
+
+  std::unique_ptr<ReachabilityIndex> I(new ReachabilityIndex());
+  I->Version = Version.load();
+  unsigned N = FunctionNames.size();
+  I->NumFunctions = N;
+
+  std::vector<std::pair<FunctionID_t, FunctionID_t>> Edges(FunctionEdges);
+  std::sort(Edges.begin(), Edges.end());
+  Edges.erase(std::unique(Edges.begin(), Edges.end()), Edges.end());
+  I->CalleeOffsets.assign(N + 1, 0);
+  I->Callees.reserve(Edges.size());
+  for (auto &E : Edges) {
+    ++I->CalleeOffsets[E.first + 1];
+    I->Callees.push_back(&FunctionNames[E.second]);
+  }
+  for (unsigned F = 0; F < N; ++F)
+    I->CalleeOffsets[F + 1] += I->CalleeOffsets[F];
+
+  // Iterative Tarjan. SCCs are numbered in reverse topological order, so the
+  // callees of an SCC always have their rows filled in before it.
+  const unsigned Unvisited = ~0u;
+  std::vector<unsigned> Number(N, Unvisited), Low(N, 0);
+  std::vector<bool> OnStack(N, false);
+  std::vector<FunctionID_t> Stack;
+  std::vector<std::pair<FunctionID_t, unsigned>> Frames;
+  unsigned Counter = 0;
+  std::vector<SparseBitVector<>> Rows;
+  I->SCCOf.assign(N, 0);
+
+  for (FunctionID_t Root = 0; Root < N; ++Root) {
+    if (Number[Root] != Unvisited)
+      continue;
+    Frames.push_back(std::make_pair(Root, I->CalleeOffsets[Root]));
+    Number[Root] = Low[Root] = Counter++;
+    Stack.push_back(Root);
+    OnStack[Root] = true;
+
+    while (!Frames.empty()) {
+      FunctionID_t F = Frames.back().first;
+      unsigned &E = Frames.back().second;
+      if (E != I->CalleeOffsets[F + 1]) {
+        FunctionID_t W = I->Callees[E++]->ID;
+        if (Number[W] == Unvisited) {
+          Number[W] = Low[W] = Counter++;
+          Stack.push_back(W);
+          OnStack[W] = true;
+          Frames.push_back(std::make_pair(W, I->CalleeOffsets[W]));
+        } else if (OnStack[W]) {
+          Low[F] = std::min(Low[F], Number[W]);
+        }
         continue;
-      visited.insert(w);
-      if (w == to) {
-        lock.lock();
-        pathCache[FromTo_t(from, to)] = true;
-        return true;
       }
-      lock.lock();
-      pathCache[FromTo_t(from, w)] = true;
-      lock.unlock();
-      FunctionSet_t called = getCalled(w);
-      tmp.insert(called.begin(), called.end());
+
+      Frames.pop_back();
+      if (!Frames.empty())
+        Low[Frames.back().first] = std::min(Low[Frames.back().first], Low[F]);
+      if (Low[F] != Number[F])
+        continue;
+
+      unsigned SCC = Rows.size();
+      Rows.push_back(SparseBitVector<>());
+      std::vector<FunctionID_t> Members;
+      FunctionID_t W;
+      do {
+        W = Stack.back();
+        Stack.pop_back();
+        OnStack[W] = false;
+        I->SCCOf[W] = SCC;
+        Members.push_back(W);
+      } while (W != F);
+
+      SparseBitVector<> &Row = Rows[SCC];
+      for (auto &M : Members)
+        for (unsigned E = I->CalleeOffsets[M]; E != I->CalleeOffsets[M + 1];
+             ++E) {
+          unsigned Succ = I->SCCOf[I->Callees[E]->ID];
+          // Cycles, self loops included, reach their own members.
+          Row.set(Succ);
+          if (Succ != SCC)
+            Row |= Rows[Succ];
+        }
     }
+  }
+
+  // SparseBitVector::test() moves an internal cursor, so the rows are
+  // flattened into sorted, read-only ranges for the queries.
+  I->ReachableOffsets.push_back(0);
+  for (auto &Row : Rows) {
+    for (SparseBitVector<>::iterator It = Row.begin(); It != Row.end(); ++It)
+      I->Reachable.push_back(*It);
+    I->ReachableOffsets.push_back(I->Reachable.size());
+  }
 
-    std::swap(tmp, worklist);
+  DEBUG(errs() << "Reachability index: " << N << " functions, "
+               << Edges.size() << " edges, " << Rows.size() << " SCCs, "
+               << I->Reachable.size() << " reachable SCC pairs\n");
+
+  Current = I.get();
+  Indexes.push_back(std::move(I));
+  Index.store(Current, std::memory_order_release);
+  return *Current;
+}
+
+bool SimpleCallGraph::hasPath(const std::string &from, const std::string &to) {
+  const ReachabilityIndex &I = getIndex();
+  const FunctionName *From = findFunction(from, I.NumFunctions);
+  const FunctionName *To = findFunction(to, I.NumFunctions);
+  if (!From || !To) {
+    DEBUG(errs() << "No path from " << from << "to " << to << "\n");
+    return false;
+  }
+  unsigned FromSCC = I.SCCOf[From->ID];
+  if (!std::binary_search(I.Reachable.begin() + I.ReachableOffsets[FromSCC],
+                          I.Reachable.begin() +
+                              I.ReachableOffsets[FromSCC + 1],
+                          I.SCCOf[To->ID])) {
+    DEBUG(errs() << "No path from " << from << "to " << to << "\n");
+    return false;
   }
-  lock.lock();
-  DEBUG(errs() << "No path from " << from << "to " << to << "\n");
-  pathCache[FromTo_t(from, to)] = false;
-  return false;
+  return true;
 }
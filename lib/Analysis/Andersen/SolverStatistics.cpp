@@ -0,0 +1,182 @@
+#include "llvm/Analysis/Andersen/Andersen.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/Argument.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+
+using namespace llvm;
+
+static cl::opt<std::string> AndersenStatsFile(
+    "andersen-stats",
+    cl::desc("Write statistics of the Andersen solver to this file as JSON"),
+    cl::init(""), cl::Hidden);
+
+static cl::opt<unsigned>
+    AndersenStatsTop("andersen-stats-top",
+                     cl::desc("Number of the largest points-to sets "
+                              "-andersen-stats reports"),
+                     cl::init(20), cl::Hidden);
+
+bool Andersen::isStatisticsEnabled() { return !AndersenStatsFile.empty(); }
+
+Andersen::SolverIteration &Andersen::getSolverIteration() {
+  if (solverIterations.empty())
+    solverIterations.emplace_back();
+  return solverIterations.back();
+}
+
+void Andersen::countConstraints(uint64_t (&Counts)[4]) const {
+  std::fill(std::begin(Counts), std::end(Counts), 0);
+  for (const AndersConstraint &C : constraints)
+    ++Counts[C.getType()];
+}
+
+namespace {
+typedef nlohmann::json json;
+
+json constraintsToJSON(const uint64_t (&Counts)[4]) {
+  return {{"addrOf", Counts[AndersConstraint::ADDR_OF]},
+          {"copy", Counts[AndersConstraint::COPY]},
+          {"load", Counts[AndersConstraint::LOAD]},
+          {"store", Counts[AndersConstraint::STORE]}};
+}
+
+// The value a node was created for, as printed by LLVM and cut short.
+json valueToJSON(const Value *V) {
+  json J;
+  if (!V)
+    return J;
+  std::string S;
+  raw_string_ostream OS(S);
+  V->print(OS);
+  OS.flush();
+  if (S.size() > 200)
+    S = S.substr(0, 200) + "...";
+  J["value"] = S;
+  const Function *F = nullptr;
+  if (const Instruction *I = dyn_cast<Instruction>(V))
+    F = I->getParent()->getParent();
+  else if (const Argument *A = dyn_cast<Argument>(V))
+    F = A->getParent();
+  if (F)
+    J["function"] = F->getName().str();
+  return J;
+}
+} // namespace
+
+/*
+ * Writes the iterations of runOnModule, a histogram of the sizes of the
+ * points-to sets in powers of two, the largest sets with the values of the
+ * nodes merged into them, and the time spent in each call handler.
+ */
+void Andersen::writeStatistics() {
+  if (!isStatisticsEnabled())
+    return;
+
+  json Iterations = json::array();
+  for (const SolverIteration &It : solverIterations) {
+    json J;
+    J["constraints"] = constraintsToJSON(It.Constraints);
+    J["optimizedConstraints"] = constraintsToJSON(It.Optimized);
+    J["merged"] = {{"hvn", It.MergedHVN},
+                   {"hu", It.MergedHU},
+                   {"hcd", It.MergedHCD},
+                   {"lcd", It.MergedLCD}};
+    J["worklistPops"] = It.WorklistPops;
+    J["calls"] = It.Calls;
+    J["optimizeSeconds"] = It.OptimizeSeconds;
+    J["solveSeconds"] = It.SolveSeconds;
+    J["callSeconds"] = It.CallSeconds;
+    Iterations.push_back(J);
+  }
+
+  // Bucket 0 holds the empty sets, bucket i the sizes in [2^(i-1), 2^i).
+  std::vector<uint64_t> Histogram;
+  std::vector<std::pair<unsigned, NodeIndex>> Sizes;
+  for (auto &P : ptsGraph) {
+    if (nodeFactory.getMergeTarget(P.first) != P.first)
+      continue;
+    unsigned Size = P.second.getSize();
+    unsigned Bucket = Size ? Log2_32(Size) + 1 : 0;
+    if (Histogram.size() <= Bucket)
+      Histogram.resize(Bucket + 1);
+    ++Histogram[Bucket];
+    Sizes.push_back(std::make_pair(Size, P.first));
+  }
+  json HistogramJSON = json::array();
+  for (unsigned Bucket = 0; Bucket < Histogram.size(); ++Bucket) {
+    uint64_t Min = Bucket ? 1ull << (Bucket - 1) : 0;
+    uint64_t Max = Bucket ? (1ull << Bucket) - 1 : 0;
+    HistogramJSON.push_back(
+        {{"min", Min}, {"max", Max}, {"sets", Histogram[Bucket]}});
+  }
+
+  size_t Top = std::min<size_t>(AndersenStatsTop, Sizes.size());
+  std::partial_sort(Sizes.begin(), Sizes.begin() + Top, Sizes.end(),
+                    [](const std::pair<unsigned, NodeIndex> &A,
+                       const std::pair<unsigned, NodeIndex> &B) {
+                      return A.first > B.first ||
+                             (A.first == B.first && A.second < B.second);
+                    });
+  DenseMap<NodeIndex, unsigned> TopIndex;
+  json Largest = json::array();
+  for (size_t Idx = 0; Idx < Top; ++Idx) {
+    NodeIndex Node = Sizes[Idx].second;
+    TopIndex[Node] = Idx;
+    json J = valueToJSON(nodeFactory.getValueForNode(Node));
+    J["node"] = Node;
+    J["size"] = Sizes[Idx].first;
+    J["mergedNodes"] = 0;
+    J["members"] = json::array();
+    Largest.push_back(J);
+  }
+  // The values the other nodes of a set stood for, a few of them per set.
+  for (NodeIndex Node = 0; Node < nodeFactory.getNumNodes(); ++Node) {
+    NodeIndex Rep = nodeFactory.getMergeTarget(Node);
+    auto It = TopIndex.find(Rep);
+    if (Rep == Node || It == TopIndex.end())
+      continue;
+    json &J = Largest[It->second];
+    J["mergedNodes"] = J["mergedNodes"].get<unsigned>() + 1;
+    const Value *V = nodeFactory.getValueForNode(Node);
+    if (V && J["members"].size() < 8)
+      J["members"].push_back(valueToJSON(V));
+  }
+
+  json Handlers = json::array();
+  ObjectiveC::CallHandlerManager &Manager =
+      ObjectiveC::getGlobalCallHandlerManager();
+  for (auto &H : Manager.getStatistics())
+    Handlers.push_back({{"name", H.Name},
+                        {"calls", H.Calls},
+                        {"handled", H.Handled},
+                        {"seconds", H.Seconds}});
+
+  json Root;
+  Root["iterations"] = Iterations;
+  Root["nodes"] = nodeFactory.getNumNodes();
+  Root["pointsToSets"] = Sizes.size();
+  Root["pointsToSetSizes"] = HistogramJSON;
+  Root["largestPointsToSets"] = Largest;
+  Root["callHandlers"] = Handlers;
+  Root["unhandledCalls"] = Manager.getNumUnhandled();
+
+  std::error_code EC;
+  raw_fd_ostream OS(AndersenStatsFile, EC, sys::fs::F_None);
+  if (EC) {
+    errs() << AndersenStatsFile << ": " << EC.message() << "\n";
+    return;
+  }
+  OS << Root.dump(2) << "\n";
+}
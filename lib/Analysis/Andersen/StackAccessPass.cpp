@@ -1,11 +1,17 @@
 #include "llvm/Analysis/Andersen/StackAccessPass.h"
+#include "llvm/Analysis/Andersen/ParallelFor.h"
+#include "llvm/Analysis/Andersen/PhaseProfile.h"
 #include <llvm/IR/InstIterator.h>
 
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SmallPtrSet.h"
+
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include <deque>
 #include <llvm/Analysis/LoopInfo.h>
@@ -20,6 +26,12 @@ using namespace llvm;
 
 #define DEBUG_TYPE "stack_access"
 
+static cl::opt<unsigned>
+    StackAccessThreads("stack-access-threads",
+                       cl::desc("Number of threads used to find the stack "
+                                "accesses (0 = number of hardware threads)"),
+                       cl::init(0), cl::Hidden);
+
 char StackAccessPass::ID = 0;
 static RegisterPass<StackAccessPass> X("stack-access",
                                        "Scans for Stack variables",
@@ -31,40 +43,273 @@ void StackAccessPass::getAnalysisUsage(AnalysisUsage &AU) const {
 }
 
 bool StackAccessPass::runOnModule(Module &M) {
+  PhaseProfile::Scope ProfileScope("stackAccess");
   errs() << "[+]Start StackAccess Pass onModule"
          << "\n";
-  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
-    F->hasName();
-  }
+  // All functions get their entry first, so the map does not change while
+  // the frames are computed.
+  std::vector<std::pair<Function *, std::atomic<StackFrame *> *>> Functions;
   for (auto &F : M.functions()) {
-    if (F.isDeclaration() || F.isIntrinsic())
-      continue;
-    if (Offsets.find(&F) != Offsets.end() &&
-        ValuesForOffset.find(&F) != ValuesForOffset.end()) {
-      return true;
-    }
-    CurrentFunction = &F;
+    auto Entry = Frames.emplace(std::piecewise_construct, std::make_tuple(&F),
+                                std::make_tuple(nullptr));
+    if (Entry.second)
+      Functions.push_back(std::make_pair(&F, &Entry.first->second));
+  }
 
-    Offsets[&F] = std::shared_ptr<OffsetMap_t>(new OffsetMap_t());
-    OffsetMap_t &OffsetMap = *Offsets[&F];
-    ValuesForOffset[&F] =
-        std::shared_ptr<OffsetValueListMap_t>(new OffsetValueListMap_t());
-    OffsetValueListMap_t &OffsetValueListMap = *ValuesForOffset[&F];
+  std::set<uint64_t> SPIdx;
+  SPIdx.insert(3);
+  SPIdx.insert(0);
 
-    std::set<uint64_t> SPIdx;
-    SPIdx.insert(3);
-    SPIdx.insert(0);
+  parallelFor(Functions.size(), StackAccessThreads, [&](size_t Idx) {
+    Function &F = *Functions[Idx].first;
+    StackFrame *Frame = new StackFrame(3);
+    if (!F.isDeclaration() && !F.isIntrinsic())
+      runOnFunction(F, Frame->Offsets, Frame->Values, SPIdx);
+    Functions[Idx].second->store(Frame, std::memory_order_release);
+  });
 
-    runOnFunction(F, OffsetMap, OffsetValueListMap, SPIdx);
+  return true;
+}
+
+StackAccessPass::~StackAccessPass() {
+  for (FrameListMap_t *List : {&Frames, &LateFrames}) {
+    for (auto &F : *List) {
+      StackFrame *Frame = F.second.load();
+      while (Frame) {
+        StackFrame *Next = Frame->Next;
+        delete Frame;
+        Frame = Next;
+      }
+    }
   }
+}
 
-  return true;
+std::atomic<StackAccessPass::StackFrame *> &
+StackAccessPass::getFrameList(const Function *F) {
+  FrameListMap_t::iterator It = Frames.find(F);
+  if (It != Frames.end())
+    return It->second;
+  std::lock_guard<std::mutex> Guard(FramesLock);
+  It = LateFrames.find(F);
+  if (It == LateFrames.end()) {
+    It = LateFrames.emplace(std::piecewise_construct, std::make_tuple(F),
+                            std::make_tuple(nullptr))
+             .first;
+  }
+  return It->second;
+}
+
+const StackAccessPass::StackFrame &
+StackAccessPass::getStackFrame(const Function *F, uint64_t SPIdx) {
+  ++FrameLookups;
+  // Declarations have no accesses. runOnModule made their frame of the
+  // stack pointer already.
+  if (F->isDeclaration() && SPIdx != 3) {
+    static const StackFrame Empty(SPIdx);
+    return Empty;
+  }
+  std::atomic<StackFrame *> &List = getFrameList(F);
+  StackFrame *Head = List.load(std::memory_order_acquire);
+  for (StackFrame *Frame = Head; Frame; Frame = Frame->Next)
+    if (Frame->SPIdx == SPIdx)
+      return *Frame;
+
+  std::unique_ptr<StackFrame> Frame(new StackFrame(SPIdx));
+  std::set<uint64_t> SPSet;
+  SPSet.insert(SPIdx);
+  if (SPIdx == 3)
+    SPSet.insert(0);
+  runOnFunction(*const_cast<Function *>(F), Frame->Offsets, Frame->Values,
+                SPSet);
+  ++FramesComputed;
+
+  // Publish the frame unless another thread got there first.
+  Frame->Next = Head;
+  while (!List.compare_exchange_weak(Frame->Next, Frame.get(),
+                                     std::memory_order_release,
+                                     std::memory_order_acquire)) {
+    for (StackFrame *Other = Frame->Next; Other != Head; Other = Other->Next) {
+      if (Other->SPIdx == SPIdx) {
+        ++FramesRaced;
+        return *Other;
+      }
+    }
+    Head = Frame->Next;
+  }
+  return *Frame.release();
+}
+
+void StackAccessPass::printStatistics(raw_ostream &OS) const {
+  uint64_t Lookups = FrameLookups, Computed = FramesComputed;
+  OS << "[+]stack frames: " << Lookups << " lookups, " << Computed
+     << " computed, " << Lookups - Computed << " reused, " << FramesRaced
+     << " computed concurrently\n";
 }
 
+/*
+ * The offsets from the stack pointer each value of a function may hold. The
+ * stack pointer is the one loaded from the register file where no store to
+ * the register precedes the load in its block.
+ *
+ * Values are visited once, in reverse post order, and build on the offsets
+ * of their operands. Incoming values of a phi over a back edge are not known
+ * yet and contribute nothing, as the walk backward stopped at instructions
+ * it had visited before. The offsets of all values share one pool; a value
+ * maps to its sorted range in it.
+ */
+class StackAccessPass::OffsetTable {
+public:
+  explicit OffsetTable(const std::set<uint64_t> &SPIdx) : SPIdx(SPIdx) {}
+
+  void compute(const Function &F) {
+    SmallPtrSet<const BasicBlock *, 32> Visited;
+    ReversePostOrderTraversal<const Function *> RPOT(&F);
+    for (const BasicBlock *BB : RPOT) {
+      Visited.insert(BB);
+      visit(*BB);
+    }
+    for (const BasicBlock &BB : F)
+      if (!Visited.count(&BB))
+        visit(BB);
+  }
+
+  ArrayRef<int64_t> lookup(const Value *V) const {
+    auto It = Ranges.find(V);
+    if (It == Ranges.end())
+      return ArrayRef<int64_t>();
+    return makeArrayRef(Pool).slice(It->second.first, It->second.second);
+  }
+
+  /*
+   * Walks from Inst to the values its offsets came from. Operands of adds
+   * and subs with a non-constant operand are accesses of their own and are
+   * added to Accesses.
+   */
+  void findAccesses(const Instruction *Inst,
+                    std::deque<const Instruction *> &Accesses) {
+    SmallVector<const Instruction *, 8> Worklist;
+    Worklist.push_back(Inst);
+    while (!Worklist.empty()) {
+      const Instruction *I = Worklist.pop_back_val();
+      if (!I || !Walked.insert(I).second)
+        continue;
+      if (PatternMatch::match(I, PatternMatch::m_BinOp(
+                                     PatternMatch::m_Constant(),
+                                     PatternMatch::m_Constant())))
+        continue;
+      Value *V = nullptr;
+      uint64_t Const = 0;
+      switch (I->getOpcode()) {
+      default:
+        break;
+      case Instruction::Load: {
+        auto Stored = StoredValues.find(I);
+        if (Stored != StoredValues.end())
+          Worklist.push_back(dyn_cast<Instruction>(Stored->second));
+        break;
+      }
+      case Instruction::Add:
+      case Instruction::Sub:
+        if (PatternMatch::match(I, PatternMatch::m_BinOp(
+                                       PatternMatch::m_Value(V),
+                                       PatternMatch::m_ConstantInt(Const))))
+          Worklist.push_back(dyn_cast<Instruction>(V));
+        else if (PatternMatch::match(I->getOperand(0), PatternMatch::m_BinOp()))
+          Accesses.push_back(dyn_cast<Instruction>(I->getOperand(0)));
+        break;
+      case Instruction::PHI:
+        for (const Value *Incoming : cast<PHINode>(I)->incoming_values())
+          Worklist.push_back(dyn_cast<Instruction>(Incoming));
+        break;
+      case Instruction::IntToPtr:
+        Worklist.push_back(dyn_cast<Instruction>(I->getOperand(0)));
+        break;
+      }
+    }
+  }
+
+private:
+  void visit(const BasicBlock &BB) {
+    // The value last stored to each register in this block.
+    DenseMap<const Value *, const Value *> LastStore;
+    SmallVector<int64_t, 4> Offsets;
+    for (const Instruction &I : BB) {
+      Offsets.clear();
+      Value *V = nullptr;
+      uint64_t Const = 0;
+      switch (I.getOpcode()) {
+      default:
+        break;
+      case Instruction::Store:
+        LastStore[I.getOperand(1)] = I.getOperand(0);
+        break;
+      case Instruction::Load: {
+        if (!isStackPointer(I.getOperand(0), SPIdx))
+          break;
+        auto Stored = LastStore.find(I.getOperand(0));
+        if (Stored == LastStore.end()) {
+          Offsets.push_back(0);
+        } else {
+          StoredValues[&I] = Stored->second;
+          ArrayRef<int64_t> StoredOffsets = lookup(Stored->second);
+          Offsets.append(StoredOffsets.begin(), StoredOffsets.end());
+        }
+        break;
+      }
+      case Instruction::Add:
+        if (PatternMatch::match(&I, PatternMatch::m_Add(
+                                        PatternMatch::m_Value(V),
+                                        PatternMatch::m_ConstantInt(Const))))
+          for (int64_t Offset : lookup(V))
+            Offsets.push_back(Offset + (int64_t)Const);
+        break;
+      case Instruction::Sub:
+        if (PatternMatch::match(&I, PatternMatch::m_Sub(
+                                        PatternMatch::m_Value(V),
+                                        PatternMatch::m_ConstantInt(Const))))
+          for (int64_t Offset : lookup(V))
+            Offsets.push_back(Offset - (int64_t)Const);
+        break;
+      case Instruction::PHI:
+        for (const Value *Incoming : cast<PHINode>(I).incoming_values()) {
+          ArrayRef<int64_t> IncomingOffsets = lookup(Incoming);
+          Offsets.append(IncomingOffsets.begin(), IncomingOffsets.end());
+        }
+        break;
+      case Instruction::IntToPtr: {
+        ArrayRef<int64_t> OperandOffsets = lookup(I.getOperand(0));
+        Offsets.append(OperandOffsets.begin(), OperandOffsets.end());
+        break;
+      }
+      }
+      if (Offsets.empty())
+        continue;
+      std::sort(Offsets.begin(), Offsets.end());
+      Offsets.erase(std::unique(Offsets.begin(), Offsets.end()),
+                    Offsets.end());
+      Ranges[&I] = std::make_pair((unsigned)Pool.size(),
+                                  (unsigned)Offsets.size());
+      Pool.append(Offsets.begin(), Offsets.end());
+    }
+  }
+
+  const std::set<uint64_t> &SPIdx;
+  DenseMap<const Value *, std::pair<unsigned, unsigned>> Ranges;
+  SmallVector<int64_t, 64> Pool;
+  // The value a load of a register reads, if it was stored in its block.
+  DenseMap<const Instruction *, const Value *> StoredValues;
+  SmallPtrSet<const Instruction *, 32> Walked;
+};
+
 void StackAccessPass::runOnFunction(Function &F, OffsetMap_t &OffsetMap,
                                     OffsetValueListMap_t &OffsetValueListMap,
                                     std::set<uint64_t> SPIdx) {
   // errs() << "Start StackAccess Pass on Function: " << F.getName() << "\n";
+  if (F.isDeclaration())
+    return;
+
+  OffsetTable Table(SPIdx);
+  Table.compute(F);
 
   std::deque<const Instruction *> IntToPtrInstructions;
 
@@ -87,52 +332,49 @@ void StackAccessPass::runOnFunction(Function &F, OffsetMap_t &OffsetMap,
   DEBUG(errs() << "#IntToPtrInstructions: " << IntToPtrInstructions.size()
                << "\n");
 
-  std::set<const Instruction *> handled;
+  SmallPtrSet<const Instruction *, 32> handled;
+  std::vector<std::pair<const Value *, int64_t>> Offsets;
+  std::vector<std::pair<int64_t, const Value *>> Values;
 
   while (IntToPtrInstructions.size()) {
     const Instruction *I = IntToPtrInstructions.front();
     IntToPtrInstructions.pop_front();
 
-    if (handled.find(I) != handled.end())
+    if (!I || !handled.insert(I).second)
       continue;
-    handled.insert(I);
 
-    std::set<int64_t> Results =
-        backtrackInstruction(I, IntToPtrInstructions, SPIdx);
+    Table.findAccesses(I, IntToPtrInstructions);
+    ArrayRef<int64_t> Results = Table.lookup(I);
     if (!Results.size())
       continue;
     DEBUG(I->dump());
 
-    OffsetMap[I] = std::shared_ptr<Int64List_t>(new Int64List_t());
-    Int64List_t &O = *OffsetMap[I];
-
-    for (std::set<int64_t>::iterator it = Results.begin(); it != Results.end();
-         ++it) {
-      if (OffsetValueListMap.find(*it) == OffsetValueListMap.end())
-        OffsetValueListMap[*it] =
-            std::shared_ptr<ValueList_t>(new ValueList_t());
-      OffsetValueListMap[*it]->insert(I);
-      O.insert(*it);
-      DEBUG(errs() << *it << "\t");
+    for (int64_t Offset : Results) {
+      Offsets.push_back(std::make_pair(I, Offset));
+      Values.push_back(std::make_pair(Offset, I));
+      DEBUG(errs() << Offset << "\t");
     }
     DEBUG(errs() << "\n");
   }
+  OffsetMap.assign(std::move(Offsets));
+  OffsetValueListMap.assign(std::move(Values));
 
   DEBUG(errs() << "Values for Offsets:\n";
         for (OffsetValueListMap_t::iterator OV_it = OffsetValueListMap.begin();
              OV_it != OffsetValueListMap.end(); ++OV_it) {
           errs() << OV_it->first << "\n";
-          for (ValueList_t::iterator V_it = OV_it->second->begin();
-               V_it != OV_it->second->end(); ++V_it) {
+          for (ValueList_t::iterator V_it = OV_it->second.begin();
+               V_it != OV_it->second.end(); ++V_it) {
             (*V_it)->dump();
           }
           errs() << "\n";
         });
 }
 
-bool StackAccessPass::isStackPointer(Value *Ptr, std::set<uint64_t> SPIdx) {
+bool StackAccessPass::isStackPointer(const Value *Ptr,
+                                     const std::set<uint64_t> &SPIdx) {
   assert(SPIdx.size());
-  if (Instruction *I = dyn_cast<Instruction>(Ptr)) {
+  if (const Instruction *I = dyn_cast<Instruction>(Ptr)) {
     if (I->getOpcode() == Instruction::GetElementPtr) {
       if (ConstantInt *Idx = dyn_cast<ConstantInt>(I->getOperand(2))) {
         if (SPIdx.find(Idx->getZExtValue()) != SPIdx.end()) {
@@ -197,16 +439,21 @@ int64_t StackAccessPass::getStackPointerValue(const Instruction *Inst,
     return 0;
   const Instruction *Store = getStore(Inst, StackPtr, true);
 
+  const Instruction *Start =
+      findStackPointer ? dyn_cast<Instruction>(Store->getOperand(0)) : Inst;
+  {
+    std::lock_guard<std::mutex> Guard(StackPointerLock);
+    auto Known = StackPointerValues.find(Start);
+    if (Known != StackPointerValues.end())
+      return Known->second;
+  }
+
   std::deque<std::pair<const Instruction *, int64_t>> Worklist;
-  if (findStackPointer)
-    Worklist.push_back(std::pair<const Instruction *, int64_t>(
-        dyn_cast<Instruction>(Store->getOperand(0)), 0));
-  else
-    Worklist.push_back(std::pair<const Instruction *, int64_t>(Inst, 0));
+  Worklist.push_back(std::pair<const Instruction *, int64_t>(Start, 0));
 
   std::set<int64_t> Results;
 
-  std::map<const Instruction *, int64_t> Visited;
+  SmallPtrSet<const Instruction *, 16> Visited;
 
   std::set<uint64_t> SPIdx;
   SPIdx.insert(3);
@@ -225,10 +472,9 @@ int64_t StackAccessPass::getStackPointerValue(const Instruction *Inst,
         llvm_unreachable("Should not happen...");
       }
 
-      if (Visited.find(CurrentInst) != Visited.end()) {
+      if (!Visited.insert(CurrentInst).second) {
         break;
       }
-      Visited[CurrentInst] = CurrentSize;
       switch (CurrentInst->getOpcode()) {
       default:
         CurrentInst->dump();
@@ -338,140 +584,7 @@ int64_t StackAccessPass::getStackPointerValue(const Instruction *Inst,
     }
     assert(false);
   }
+  std::lock_guard<std::mutex> Guard(StackPointerLock);
+  StackPointerValues[Start] = *Results.begin();
   return *Results.begin();
 }
-
-std::set<int64_t>
-StackAccessPass::backtrackInstruction(const Instruction *Inst,
-                                      std::deque<const Instruction *> &InstList,
-                                      const std::set<uint64_t> SPIdx) {
-  std::function<const Instruction *(const Instruction *, const Value *)>
-      getStore = [](const Instruction *Inst, const Value *Ptr) {
-        const Instruction *Store = nullptr;
-        for (const Instruction *I = Inst;; I = I->getPrevNode()) {
-          if (I->getOpcode() == Instruction::Store && I->getOperand(1) == Ptr) {
-            Store = &*I;
-            break;
-          }
-          if (I == &I->getParent()->front())
-            break;
-        }
-        return Store;
-      };
-
-  std::set<int64_t> Results;
-
-  std::deque<std::pair<const Instruction *, int64_t>> Worklist;
-  Worklist.push_back(std::pair<const Instruction *, int64_t>(Inst, 0));
-
-  std::map<const Instruction *, int64_t> Visited;
-
-  while (Worklist.size()) {
-    std::pair<const Instruction *, int64_t> P = Worklist.front();
-    Worklist.pop_front();
-
-    const Instruction *CurrentInst = P.first;
-    int64_t CurrentSize = P.second;
-
-    bool Run = true;
-    while (Run) {
-      if (!CurrentInst) {
-        break;
-      }
-
-      if (Visited.find(CurrentInst) != Visited.end()) {
-        break;
-      }
-      Visited[CurrentInst] = CurrentSize;
-
-      if (PatternMatch::match(
-              CurrentInst, PatternMatch::m_BinOp(PatternMatch::m_Constant(),
-                                                 PatternMatch::m_Constant()))) {
-        Run = false;
-        continue;
-      }
-      switch (CurrentInst->getOpcode()) {
-      default:
-        Run = false;
-        break;
-      case Instruction::Load: {
-        if (!isStackPointer(CurrentInst->getOperand(0), SPIdx)) {
-          Run = false;
-          break;
-        }
-        assert(isStackPointer(CurrentInst->getOperand(0), SPIdx));
-        const Instruction *Store =
-            getStore(CurrentInst, CurrentInst->getOperand(0));
-        if (!Store) {
-          Run = false;
-          Results.insert(CurrentSize);
-        } else {
-          CurrentInst = dyn_cast<Instruction>(Store->getOperand(0));
-        }
-        break;
-      }
-      case Instruction::Add: {
-        Value *V = nullptr;
-        uint64_t Const = 0;
-        if (PatternMatch::match(
-                CurrentInst,
-                PatternMatch::m_Add(PatternMatch::m_Value(V),
-                                    PatternMatch::m_ConstantInt(Const)))) {
-          CurrentInst = dyn_cast<Instruction>(V);
-          CurrentSize += (int64_t)Const;
-        } else if (PatternMatch::match(
-                       CurrentInst,
-                       PatternMatch::m_Add(PatternMatch::m_BinOp(),
-                                           PatternMatch::m_Value()))) {
-          InstList.push_back(dyn_cast<Instruction>(CurrentInst->getOperand(0)));
-          Run = false;
-          break;
-        }
-        break;
-      }
-      case Instruction::Sub: {
-        Value *V = nullptr;
-        uint64_t Const = 0;
-        if (PatternMatch::match(
-                CurrentInst,
-                PatternMatch::m_Sub(PatternMatch::m_Value(V),
-                                    PatternMatch::m_ConstantInt(Const)))) {
-          CurrentInst = dyn_cast<Instruction>(V);
-          CurrentSize -= (int64_t)Const;
-        } else if (PatternMatch::match(
-                       CurrentInst,
-                       PatternMatch::m_Sub(PatternMatch::m_BinOp(),
-                                           PatternMatch::m_Value()))) {
-          InstList.push_back(dyn_cast<Instruction>(CurrentInst->getOperand(0)));
-          Run = false;
-          break;
-        }
-        break;
-      }
-      case Instruction::PHI: {
-        for (unsigned i = 1; i < CurrentInst->getNumOperands(); ++i) {
-          // Skip Constants
-          if (Instruction *I =
-                  dyn_cast<Instruction>(CurrentInst->getOperand(i))) {
-            Worklist.push_back(
-                std::pair<Instruction *, int64_t>(I, CurrentSize));
-          }
-        }
-        if (Instruction *I =
-                dyn_cast<Instruction>(CurrentInst->getOperand(0))) {
-          CurrentInst = I;
-        } else {
-          Run = false;
-        }
-        break;
-      }
-      case Instruction::IntToPtr: {
-        CurrentInst = dyn_cast<Instruction>(CurrentInst->getOperand(0));
-        break;
-      }
-      }
-    }
-  }
-
-  return Results;
-}
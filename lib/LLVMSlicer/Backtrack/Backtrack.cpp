@@ -41,9 +41,12 @@ bool InsInfo::backtrack(InsInfoProvider *provider, PathElementBase *pathElement,
         }
       }
     }
-    for (auto &p : SlicedPredecessors[pathElement->getRelevantVariable()]) {
-      predecessors.insert(
-          Pred_t(provider->getInsInfo(p), pathElement->getRelevantVariable()));
+    auto sliced = SlicedPredecessors.find(pathElement->getRelevantVariable());
+    if (sliced != SlicedPredecessors.end()) {
+      for (auto &p : sliced->second) {
+        predecessors.insert(Pred_t(provider->getInsInfo(p),
+                                   pathElement->getRelevantVariable()));
+      }
     }
     if (predecessors.size() == 0) {
       return false;
@@ -55,9 +58,12 @@ bool InsInfo::backtrack(InsInfoProvider *provider, PathElementBase *pathElement,
 
     const Module *M = ins->getParent()->getParent()->getParent();
 
-    SimpleCallGraph::FunctionSet_t &called =
-        ptr::getSimpleCallGraph().getCalled(ins);
-    for (auto &functionName : called) {
+    // Paths are backtracked concurrently, so only lookups that never insert
+    // into shared tables may be used from here on.
+    static const SimpleCallGraph::FunctionSet_t noCalls;
+    const SimpleCallGraph::FunctionSet_t *called =
+        ptr::getSimpleCallGraph().findCalled(ins);
+    for (auto &functionName : called ? *called : noCalls) {
       if (functionName == "CCKeyDerivationPBKDF") {
         assert(true);
       }
@@ -117,13 +123,15 @@ bool InsInfo::backtrack(InsInfoProvider *provider, PathElementBase *pathElement,
   }
 
   // FIXME: always skip this when a return was found???
+  ValMapSet_t::const_iterator translation =
+      translations.find(pathElement->getRelevantVariable());
+
   if (predecessors.size() == 0) {
     for (auto &RC_it : SlicedPredecessors) {
 
-      if (hasTranslation(pathElement->getRelevantVariable())) {
-        if (translations[pathElement->getRelevantVariable()].find(
-                (Value *)RC_it.first) ==
-            translations[pathElement->getRelevantVariable()].end()) {
+      if (translation != translations.end()) {
+        if (translation->second.find((Value *)RC_it.first) ==
+            translation->second.end()) {
           continue;
         } else {
         }
@@ -139,9 +147,8 @@ bool InsInfo::backtrack(InsInfoProvider *provider, PathElementBase *pathElement,
         if (I_it == ins) {
           continue;
         }
-        if (hasTranslation(pathElement->getRelevantVariable()) &&
-            translations[pathElement->getRelevantVariable()].find(I_it) !=
-                translations[pathElement->getRelevantVariable()].end()) {
+        if (translation != translations.end() &&
+            translation->second.find(I_it) != translation->second.end()) {
 
         } else {
           InsInfo *pred = provider->getInsInfo(I_it);
@@ -190,9 +197,8 @@ bool InsInfo::backtrack(InsInfoProvider *provider, PathElementBase *pathElement,
 
   if (predecessors.size() == 0) {
 
-    if (hasTranslation(pathElement->getRelevantVariable())) {
-      for (auto &t : translations[pathElement->getRelevantVariable()]) {
-        t->dump();
+    if (translation != translations.end()) {
+      for (auto &t : translation->second) {
         ConstPathElement *e =
             new ConstPathElement(t, pathElement->getRelevantVariable());
         if (pathElement->setNext(e)) {
@@ -1,5 +1,6 @@
 #include "Constraint.h"
 #include "Rule.h"
+#include "RuleProgram.h"
 #include <PointsTo/PointsTo.h>
 #include <llvm/ADT/StringExtras.h>
 #include <sstream>
@@ -92,6 +93,18 @@ bool ChainConstraint::checkConstraint(PathElementBase *pathElement) const {
   return result;
 }
 
+void ChainConstraint::compile(RuleProgram &program) const {
+  for (auto &child : children) {
+    // Nested chains get a program of their own so that their results are
+    // memoized independently of the rule they appear in.
+    if (child->getChildren().size())
+      program.emitSubprogram(RuleProgram::get(*child));
+    else
+      child->compile(program);
+  }
+  program.emitChain(chainType, children.size());
+}
+
 bool ChainConstraint::shouldStop(PathElementBase *pathElement) const {
   bool result = false;
   switch (chainType) {
@@ -283,6 +296,10 @@ bool ConstConstraint::checkConstraint(PathElementBase *pathElement) const {
   return false;
 }
 
+void ConstConstraint::compile(RuleProgram &program) const {
+  program.emitConst(compare, value, strings);
+}
+
 bool ConstConstraint::shouldStop(PathElementBase *pathElement) const {
   if (const Instruction *inst =
           dyn_cast<const Instruction>(pathElement->getElement())) {
@@ -369,7 +386,11 @@ bool Rule::dismissPath(PathElementBase *pathElement) const {
   bool dismiss = false;
   if (const CallInst *callInst =
           dyn_cast<const CallInst>(pathElement->getElement())) {
-    for (auto &calledFunction : ptr::getSimpleCallGraph().getCalled(callInst)) {
+    const SimpleCallGraph::FunctionSet_t *called =
+        ptr::getSimpleCallGraph().findCalled(callInst);
+    if (!called)
+      return false;
+    for (auto &calledFunction : *called) {
       if (calledFunction == "CC_SHA256_Init") {
         dismiss = true;
       } else {
@@ -424,7 +445,7 @@ bool Rule::preconditions() const {
   bool cond = false;
   if (getConstraintType() == PRECONDITION) {
     for (auto &path : paths) {
-      cond |= checkConstraint(path->getLast());
+      cond |= getProgram().evaluate(path);
     }
   } else {
     cond = true;
@@ -571,7 +592,13 @@ bool Rule::checkRule() {
 }
 
 bool Rule::checkRule(Path *path) const {
-  return checkConstraint(path->getLast());
+  return getProgram().evaluate(path);
+}
+
+const RuleProgram &Rule::getProgram() const {
+  if (!program)
+    program = &RuleProgram::get(*this);
+  return *program;
 }
 
 Rule::PathList_t Rule::getPaths(const Instruction *inst) const {
@@ -626,6 +653,10 @@ bool CallConstraint::checkConstraint(PathElementBase *pathElement) const {
   return false;
 }
 
+void CallConstraint::compile(RuleProgram &program) const {
+  program.emitCall(functionName);
+}
+
 bool CallConstraint::shouldStop(PathElementBase *pathElement) const {
   const Instruction *inst =
       dyn_cast<const Instruction>(pathElement->getElement());
@@ -633,9 +664,11 @@ bool CallConstraint::shouldStop(PathElementBase *pathElement) const {
     return false;
   }
   if (inst->getOpcode() == Instruction::Call) {
-    SimpleCallGraph::FunctionSet_t calledFunctions =
-        ptr::getSimpleCallGraph().getCalled(inst);
-    for (auto &calledFunction : calledFunctions) {
+    const SimpleCallGraph::FunctionSet_t *calledFunctions =
+        ptr::getSimpleCallGraph().findCalled(inst);
+    if (!calledFunctions)
+      return false;
+    for (auto &calledFunction : *calledFunctions) {
       if (calledFunction == "objc_retain" ||
           calledFunction == "objc_autoreleaseReturnValue" ||
           calledFunction == "objc_autorelease" ||
@@ -652,29 +685,15 @@ bool CallConstraint::shouldStop(PathElementBase *pathElement) const {
   return false;
 }
 
-HTMLReportPrinter::HTMLReportPrinter(raw_ostream &file_out)
-    : file_out(file_out) {
-  printHeader();
-}
-
-void HTMLReportPrinter::addResults(
-    Rule *rule, const Rule::CompletePathResultList_t &results) {
-
-  static unsigned ruleCounter = 0;
-  static unsigned pathCounter = 0;
-  ruleCounter++;
-  file_out << "<div id=\"rule" << ruleCounter << "\">\n";
-  file_out << "<h1 data-toggle=\"collapse\" href=\"#rule" << ruleCounter
-           << "body\">" << rule->getRuleTitle() << "</h1>\n";
-
-  file_out << "<div class=\"collapse in   \" id=\"rule" << ruleCounter
-           << "body\">\n";
-
+std::vector<const Rule::CompletePathResult_t *>
+ReportWriter::selectResults(Rule *rule,
+                            const Rule::CompletePathResultList_t &results) {
   typedef std::pair<const Value *, const Value *> ValuePair_t;
   typedef std::set<ValuePair_t> ValuePairSet_t;
 
   ValuePairSet_t printed;
-
+  std::vector<const Rule::CompletePathResult_t *> selected;
+  IndexEntry entry = {rule->getRuleTitle(), pathCounter + 1, 0, 0, 0};
   for (auto &r : results) {
     if (PrintSameUseDef) {
       ValuePair_t pair(r.first.second->getEntry()->getElement(),
@@ -683,24 +702,55 @@ void HTMLReportPrinter::addResults(
         continue;
       printed.insert(pair);
     }
+    selected.push_back(&r);
+    entry.paths++;
+    if (r.first.first == Rule::ERROR)
+      entry.errors++;
+    if (isDismissed(r))
+      entry.dismissed++;
+  }
+  index.push_back(entry);
+  return selected;
+}
 
-    bool preCond = r.second.size() ? false : true;
-    for (auto &pre : r.second) {
-      if (std::get<0>(pre) == Rule::VALID) {
-        preCond = true;
-      }
+bool ReportWriter::isDismissed(const Rule::CompletePathResult_t &result) {
+  bool preCond = result.second.size() ? false : true;
+  for (auto &pre : result.second) {
+    if (std::get<0>(pre) == Rule::VALID) {
+      preCond = true;
     }
+  }
+  return !preCond || result.first.first == Rule::VALID;
+}
+
+HTMLReportPrinter::HTMLReportPrinter(raw_ostream &file_out)
+    : ReportWriter(file_out) {
+  printHeader();
+}
+
+void HTMLReportPrinter::addResults(
+    Rule *rule, const Rule::CompletePathResultList_t &results) {
 
+  std::vector<const Rule::CompletePathResult_t *> selected =
+      selectResults(rule, results);
+  unsigned ruleCounter = index.size();
+  file_out << "<div id=\"rule" << ruleCounter << "\">\n";
+  file_out << "<h1 data-toggle=\"collapse\" href=\"#rule" << ruleCounter
+           << "body\">" << rule->getRuleTitle() << "</h1>\n";
+
+  file_out << "<div class=\"collapse in   \" id=\"rule" << ruleCounter
+           << "body\">\n";
+
+  for (auto *r : selected) {
     pathCounter++;
     std::stringstream ruleHeaderClasses;
-    if (r.first.first == Rule::VALID) {
+    if (r->first.first == Rule::VALID) {
       ruleHeaderClasses << "text-success ";
-    } else if (r.first.first == Rule::ERROR) {
+    } else if (r->first.first == Rule::ERROR) {
       ruleHeaderClasses << "text-danger ";
     }
     file_out << "<div class=\"tracebody "
-             << (!preCond || r.first.first == Rule::VALID ? "dismiss" : "")
-             << "\">\n";
+             << (isDismissed(*r) ? "dismiss" : "") << "\">\n";
     file_out << "<div style=\"opacity:0.3; background-color:#000; "
                 "height:10px\"></div>\n";
     file_out << "<h2 data-toggle=\"collapse\" href=\"#pathBody" << pathCounter
@@ -709,7 +759,7 @@ void HTMLReportPrinter::addResults(
              << " #" << pathCounter << "</h2>\n";
     file_out << "<div class=\"collapse in\" id=\"pathBody" << pathCounter
              << "\">\n";
-    for (auto &pre : r.second) {
+    for (auto &pre : r->second) {
 
       std::stringstream preconditionHeaderClasses;
 
@@ -725,13 +775,14 @@ void HTMLReportPrinter::addResults(
     }
 
     file_out << "<h3>Trace</h3>\n";
-    printPath(r.first.second, false);
+    printPath(r->first.second, false);
     file_out << "</div>\n";
     file_out << "</div>\n";
   }
 
   file_out << "</div>\n";
   file_out << "</div>\n";
+  file_out.flush();
 }
 
 void HTMLReportPrinter::printHeader() {
@@ -761,7 +812,24 @@ void HTMLReportPrinter::printFooter() {
               "</html>\n";
 }
 
+void HTMLReportPrinter::printIndex() {
+  file_out << "<div id=\"index\">\n"
+              "<h1>Index</h1>\n"
+              "<table class=\"table\">\n"
+              "<tr><th>Rule</th><th>Paths</th><th>Errors</th>"
+              "<th>Dismissed</th></tr>\n";
+  for (unsigned i = 0; i < index.size(); ++i) {
+    const IndexEntry &entry = index[i];
+    file_out << "<tr><td><a href=\"#rule" << i + 1 << "\">" << entry.title
+             << "</a></td><td>" << entry.paths << "</td><td>" << entry.errors
+             << "</td><td>" << entry.dismissed << "</td></tr>\n";
+  }
+  file_out << "</table>\n"
+              "</div>\n";
+}
+
 void HTMLReportPrinter::close() {
+  printIndex();
   printFooter();
   file_out.flush();
 }
@@ -2,6 +2,7 @@
 #define LLVM_CONSTRAINT_H
 
 #include "Path.h"
+#include <memory>
 #include <set>
 #include <string>
 #include <vector>
@@ -10,6 +11,7 @@ namespace llvm {
 namespace slicing {
 
 class Rule;
+class RuleProgram;
 
 class Parameter {
 public:
@@ -54,6 +56,9 @@ public:
   virtual bool checkConstraint(PathElementBase *pathElement) const = 0;
   virtual bool shouldStop(PathElementBase *pathElement) const = 0;
 
+  // Appends this constraint to program in postfix order.
+  virtual void compile(RuleProgram &program) const = 0;
+
   virtual Type getType() const;
   ConstraintType getConstraintType() const;
 
@@ -74,6 +79,7 @@ public:
 
   virtual bool checkConstraint(PathElementBase *pathElement) const;
   virtual bool shouldStop(PathElementBase *pathElement) const;
+  virtual void compile(RuleProgram &program) const;
 
 protected:
   ChainType chainType;
@@ -132,11 +138,17 @@ public:
   bool checkRule();
   bool checkRule(Path *path) const;
 
+  // The compiled form of this rule's constraint tree, built on first use.
+  const RuleProgram &getProgram() const;
+
   void addPaths(PathList_t paths);
   std::string getRuleTitle() const;
 
   const CompletePathResultList_t &getResults() const { return pathResults; };
 
+  // Drops the results once they have been reported. The paths are kept.
+  void releaseResults() { CompletePathResultList_t().swap(pathResults); }
+
   const PathList_t &getPaths() const { return paths; }
 
   std::vector<const llvm::Value *> getRelevantVariables() const {
@@ -181,6 +193,7 @@ private:
   std::string parentRuleTitle;
   Rule *parentRule;
   std::set<Path *> dismissablePaths;
+  mutable const RuleProgram *program = nullptr;
 };
 
 class ConstConstraint : public Constraint {
@@ -195,6 +208,7 @@ public:
 
   virtual bool checkConstraint(PathElementBase *pathElement) const;
   virtual bool shouldStop(PathElementBase *pathElement) const;
+  virtual void compile(RuleProgram &program) const;
 
 private:
   uint64_t value;
@@ -209,23 +223,86 @@ public:
 
   virtual bool checkConstraint(PathElementBase *pathElement) const;
   virtual bool shouldStop(PathElementBase *pathElement) const;
+  virtual void compile(RuleProgram &program) const;
 
 private:
   std::string functionName;
 };
 
-class HTMLReportPrinter {
+/*
+ * Writes the -r report. The results of a rule are written out as soon as the
+ * rule has been checked and are not kept by the writer, so the size of the
+ * report does not show up in memory. close() appends an index of all rules
+ * with their number of findings.
+ */
+class ReportWriter {
+public:
+  enum Format { HTML, JSONL, SARIF };
+
+  virtual ~ReportWriter() {}
+
+  static std::unique_ptr<ReportWriter> create(raw_ostream &file_out,
+                                              Format format);
+
+  virtual void addResults(Rule *rule,
+                          const Rule::CompletePathResultList_t &results) = 0;
+  virtual void close() = 0;
+
+protected:
+  struct IndexEntry {
+    std::string title;
+    unsigned firstPath;
+    unsigned paths;
+    unsigned errors;
+    unsigned dismissed;
+  };
+
+  ReportWriter(raw_ostream &file_out) : file_out(file_out) {}
+
+  // The results of rule that are reported, honoring -print-same-usedef-only,
+  // and a new index entry for them.
+  std::vector<const Rule::CompletePathResult_t *>
+  selectResults(Rule *rule, const Rule::CompletePathResultList_t &results);
+
+  // Paths that are valid, or whose preconditions all fail, are not findings.
+  static bool isDismissed(const Rule::CompletePathResult_t &result);
+
+  raw_ostream &file_out;
+  std::vector<IndexEntry> index;
+  unsigned pathCounter = 0;
+};
+
+class HTMLReportPrinter : public ReportWriter {
 public:
   HTMLReportPrinter(raw_ostream &file_out);
-  void addResults(Rule *rule, const Rule::CompletePathResultList_t &results);
-  void close();
+  virtual void addResults(Rule *rule,
+                          const Rule::CompletePathResultList_t &results);
+  virtual void close();
 
 private:
-  raw_ostream &file_out;
   void printHeader();
+  void printIndex();
   void printFooter();
   void printPath(Path *path, bool collapsable);
 };
+
+// One JSON object per line for each path, followed by an index line.
+class JSONLReportWriter : public ReportWriter {
+public:
+  JSONLReportWriter(raw_ostream &file_out) : ReportWriter(file_out) {}
+  virtual void addResults(Rule *rule,
+                          const Rule::CompletePathResultList_t &results);
+  virtual void close();
+};
+
+// A SARIF 2.1.0 log with one result per path and the rules as the index.
+class SARIFReportWriter : public ReportWriter {
+public:
+  SARIFReportWriter(raw_ostream &file_out);
+  virtual void addResults(Rule *rule,
+                          const Rule::CompletePathResultList_t &results);
+  virtual void close();
+};
 } // namespace slicing
 } // namespace llvm
 
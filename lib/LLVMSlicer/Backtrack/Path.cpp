@@ -1,6 +1,8 @@
 #include <PointsTo/PointsTo.h>
 #include <llvm/IR/Dominators.h>
+#include <llvm/ADT/Hashing.h>
 #include <llvm/ADT/StringExtras.h>
+#include <algorithm>
 #include <sstream>
 #include "Path.h"
 #include "llvm/Support/raw_ostream.h"
@@ -101,9 +103,89 @@ bool PathElementBase::setNext(PathElementBase *n) {
     }
     n->setParent(parent);
     next = n;
+    if (parent)
+        parent->appended(this, n);
     return true;
 }
 
+PathElementBase *PathElementBase::getPrev() {
+    if (!prev && parent && parent->entry == this)
+        parent->materialize();
+    return prev;
+}
+
+PathStep::PathStep(std::shared_ptr<const PathStep> p, const Value *e, const Value *r)
+        : prev(std::move(p)), element(e), relevantVariable(r) {
+    length = prev ? prev->length + 1 : 1;
+    hash = hash_combine(prev ? prev->hash : (size_t)0, e);
+    fingerprint = (prev ? prev->fingerprint : 0) | getFingerprint(e);
+    shortestLoad = prev ? prev->shortestLoad : UINT64_MAX;
+    if (const LoadInst *inst = dyn_cast<const LoadInst>(e)) {
+        shortestLoad = std::min<uint64_t>(shortestLoad, inst->getType()->getPrimitiveSizeInBits());
+    }
+}
+
+PathStep::~PathStep() {
+    // Release an unshared chain iteratively, long paths would otherwise
+    // recurse once per step.
+    std::shared_ptr<const PathStep> current = std::move(prev);
+    while (current && current.use_count() == 1) {
+        std::shared_ptr<const PathStep> p = std::move(const_cast<PathStep&>(*current).prev);
+        current = std::move(p);
+    }
+}
+
+Path::Path(const Path &p) : entry(nullptr), last(nullptr), unmaterialized(nullptr), trace(p.trace), callStack(p.callStack) {
+    // Forks are extended at their end, so only the last element is copied.
+    if (p.last) {
+        entry = last = p.last->clone(nullptr, this);
+        unmaterialized = trace->prev.get();
+    }
+}
+
+void Path::materialize() const {
+    PathElementBase *first = entry;
+    for (const PathStep *step = unmaterialized; step; step = step->prev.get()) {
+        PathElementBase *e;
+        if (const Instruction *inst = dyn_cast<const Instruction>(step->element))
+            e = new PathElement(inst, step->relevantVariable);
+        else
+            e = new ConstPathElement(step->element, step->relevantVariable);
+        e->parent = const_cast<Path *>(this);
+        e->next = first;
+        if (first)
+            first->prev = e;
+        first = e;
+    }
+    entry = first;
+    unmaterialized = nullptr;
+}
+
+void Path::appended(PathElementBase *e, PathElementBase *n) {
+    if (e != last || n->getNext()) {
+        rebuildTrace();
+        return;
+    }
+    trace = std::allocate_shared<const PathStep>(PathArenaAllocator<PathStep>(), trace, n->getElement(), n->getRelevantVariable());
+    last = n;
+}
+
+void Path::rebuildTrace() {
+    materialize();
+    trace.reset();
+    last = nullptr;
+    for (PathElementBase *current = entry; current; current = current->getNext()) {
+        trace = std::allocate_shared<const PathStep>(PathArenaAllocator<PathStep>(), trace, current->getElement(), current->getRelevantVariable());
+        last = current;
+    }
+}
+
+size_t Path::getHash() const {
+    if (SameUseDef)
+        return trace ? (size_t)hash_combine(getEntry()->getElement(), getLast()->getElement()) : 0;
+    return trace ? trace->hash : 0;
+}
+
 void PathElement::dump() const {
     print(errs());
 }
@@ -141,10 +223,10 @@ void Path::dump(bool useDefOnly) const {
 
 void Path::print(raw_ostream &out, bool useDefOnly) const {
     if (useDefOnly) {
-        out << entry << "\n";
+        out << getEntry() << "\n";
         out << getLast() << "\n";
     } else {
-        PathElementBase *current = entry;
+        PathElementBase *current = getEntry();
         while (current) {
 //        errs() << current->getInstruction()->getParent()->getParent()->getName() << ": ";
 //        current->getInstruction()->print(errs());
@@ -160,8 +242,8 @@ void Path::print(raw_ostream &out, bool useDefOnly) const {
 
 bool Path::operator < (const Path &b) const
 {
-    PathElementBase *x = entry;
-    PathElementBase *y = b.entry;
+    PathElementBase *x = getEntry();
+    PathElementBase *y = b.getEntry();
 
     bool same = true;
     while (x && y) {
@@ -183,29 +265,26 @@ bool Path::operator < (const Path &b) const
 
 bool Path::operator == (const Path &b) const
 {
+    if (getHash() != b.getHash())
+        return false;
+
     if (SameUseDef) {
         return sameUseDef(b);
     }
 
-    PathElementBase *x = entry;
-    PathElementBase *y = b.entry;
-
-    bool same = true;
-    while (x && y) {
-
-        if (x->getElement() != y->getElement()) {
-            same = false;
-            break;
-        }
+    if (getLength() != b.getLength())
+        return false;
 
-        x = x->getNext();
-        y = y->getNext();
+    // Walk both traces backwards; a shared prefix is equal by construction.
+    const PathStep *x = trace.get();
+    const PathStep *y = b.trace.get();
+    while (x != y) {
+        if (x->element != y->element)
+            return false;
+        x = x->prev.get();
+        y = y->prev.get();
     }
-
-    if (same && x == y)
-        return true;
-
-    return false;
+    return true;
 
 
 //    if (entry == b.entry && getLast() == b.getLast()) {
@@ -215,20 +294,11 @@ bool Path::operator == (const Path &b) const
 }
 
 uint64_t Path::getShortestLoad(uint64_t currentMin) const {
-    PathElementBase *current = entry;
-    while (current) {
-        if (const LoadInst *inst = dyn_cast<const LoadInst>(current->getElement())) {
-            if (inst->getType()->getPrimitiveSizeInBits() < currentMin) {
-                currentMin = inst->getType()->getPrimitiveSizeInBits();
-            }
-        }
-        current = current->getNext();
-    }
-    return currentMin;
+    return trace ? std::min(currentMin, trace->shortestLoad) : currentMin;
 }
 
 bool Path::sameUseDef(const Path &other) const {
-    if (*entry == *other.entry && *getLast() == *other.getLast()) {
+    if (*getEntry() == *other.getEntry() && *getLast() == *other.getLast()) {
         return true;
     }
     return false;
@@ -236,8 +306,8 @@ bool Path::sameUseDef(const Path &other) const {
 
 
 bool Path::isSub(const Path &sub) const {
-    PathElementBase *x = entry;
-    PathElementBase *y = sub.entry;
+    PathElementBase *x = getEntry();
+    PathElementBase *y = sub.getEntry();
 
     bool same = true;
     while (x && y) {
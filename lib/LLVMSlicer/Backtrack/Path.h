@@ -1,8 +1,10 @@
 #ifndef LLVM_PATH_H
 #define LLVM_PATH_H
 
+#include <memory>
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Instructions.h"
+#include "PathArena.h"
 
 namespace llvm {
     namespace slicing {
@@ -24,6 +26,9 @@ namespace llvm {
 
             virtual ~PathElementBase() {};
 
+            static void *operator new(size_t size) { return PathArena::allocate(size); }
+            static void operator delete(void *p, size_t size) { PathArena::deallocate(p, size); }
+
             virtual PathElementType getType() const = 0;
 
             virtual bool operator < (const PathElementBase &b) const {
@@ -37,16 +42,15 @@ namespace llvm {
                 return false;
             }
 
+            /*
+             * Copies this element alone; the caller links the copies.
+             */
             virtual PathElementBase *clone(PathElementBase *prev, Path *parent) = 0;
 
             virtual bool setNext(PathElementBase *n);
             void setPrev(PathElementBase *p) { prev = p; }
 
-            void removeNext() {
-                next = nullptr;
-            }
-
-            PathElementBase *getPrev() { return prev; }
+            PathElementBase *getPrev();
             PathElementBase *getNext() { return next; }
 
             const Value *getElement() const { return element; }
@@ -58,6 +62,8 @@ namespace llvm {
             virtual void print(raw_ostream &out) const;
 
         protected:
+            friend class Path;
+
             const Value *element;
             const Value *relevantVariable;
 
@@ -92,11 +98,6 @@ namespace llvm {
         private:
 
             PathElement(const PathElement &p, PathElementBase *prev, Path *parent) : PathElementBase(p.element, p.relevantVariable) {
-                if (p.next)
-                    next = p.next->clone(this, parent);
-                else {
-                    next = NULL;
-                }
                 inst = p.inst;
                 relevantVariable = p.relevantVariable;
 
@@ -130,14 +131,36 @@ namespace llvm {
             virtual bool shouldCreateNewCriterion() const;
         };
 
+        /*
+         * Immutable summary of a path prefix, shared between a path and all
+         * paths forked from it. Every step caches the length, the structural
+         * hash, a 64 bit membership fingerprint and the narrowest load width
+         * of the prefix ending in it.
+         */
+        struct PathStep {
+            PathStep(std::shared_ptr<const PathStep> p, const Value *e, const Value *r);
+            ~PathStep();
+
+            std::shared_ptr<const PathStep> prev;
+            const Value *element;
+            const Value *relevantVariable;
+            size_t length;
+            size_t hash;
+            uint64_t fingerprint;
+            uint64_t shortestLoad;
+
+            static uint64_t getFingerprint(const Value *e) {
+                return 1ULL << ((((uintptr_t)e) >> 4) & 63);
+            }
+        };
+
         class Path {
         public:
-            Path() {}
-            Path(const Path &p) {
-//                entry = new PathElement(*p.entry, NULL, this);
-                entry = p.entry->clone(NULL, this);
-                callStack = std::vector<const CallInst*>(p.callStack);
-            }
+            Path() : entry(nullptr), last(nullptr), unmaterialized(nullptr) {}
+            Path(const Path &p);
+
+            static void *operator new(size_t size) { return PathArena::allocate(size); }
+            static void operator delete(void *p, size_t size) { PathArena::deallocate(p, size); }
 
             virtual ~Path() {
                 PathElementBase *current = entry;
@@ -154,34 +177,36 @@ namespace llvm {
                 assert(!e->getParent());
                 entry = e;
                 entry->setParent(this);
+                rebuildTrace();
             }
             PathElementBase *getLast() const {
                 assert(entry);
-                PathElementBase *current = entry;
-                while (current->getNext())
-                    current = current->getNext();
-                return current;
+                return last;
             }
 
             PathElementBase *getEntry() const {
+                materialize();
                 return entry;
             }
 
             bool contains(const Instruction *inst, const Value *relevant = nullptr) {
+                if (!trace || !(trace->fingerprint & PathStep::getFingerprint(inst)))
+                    return false;
                 if (inst->getOpcode() == Instruction::Ret)
                 {
-                    for (PathElementBase *current = entry; current; current = current->getNext()) {
-                        if (current->getElement() == inst) {
-                            return current->getRelevantVariable() == relevant;
-                        }
+                    // Only the first occurrence counts.
+                    const PathStep *first = nullptr;
+                    for (const PathStep *current = trace.get(); current; current = current->prev.get()) {
+                        if (current->element == inst)
+                            first = current;
                     }
-                    return false;
+                    return first && first->relevantVariable == relevant;
                 }
                 if (getLatestCall() == inst) {
                     return false;
                 }
-                for (PathElementBase *current = entry; current; current = current->getNext()) {
-                    if (current->getElement() == inst) {
+                for (const PathStep *current = trace.get(); current; current = current->prev.get()) {
+                    if (current->element == inst) {
                         return true;
                     }
                 }
@@ -189,15 +214,19 @@ namespace llvm {
             }
 
             size_t getLength() const {
-                PathElementBase *current = entry;
-                size_t l = 0;
-                while (current) {
-                    l++;
-                    current = current->getNext();
-                }
-                return l;
+                return trace ? trace->length : 0;
             }
 
+            /*
+             * Hash consistent with operator==: equal paths hash equally.
+             */
+            size_t getHash() const;
+
+            /*
+             * Called by PathElementBase::setNext() after n was linked behind e.
+             */
+            void appended(PathElementBase *e, PathElementBase *n);
+
             void dump(bool useDefOnly = false) const;
             void print(raw_ostream &out, bool useDefOnly = false) const;
 
@@ -228,8 +257,21 @@ namespace llvm {
             bool sameUseDef(const Path &other) const;
             bool isSub(const Path &sub) const;
         private:
-            PathElementBase *entry;
+            friend class PathElementBase;
+
+            /*
+             * A fork only copies the last element. The ones before it are
+             * recreated from the shared trace, starting at unmaterialized,
+             * when the list is walked; most forks are dropped before that.
+             */
+            mutable PathElementBase *entry;
+            PathElementBase *last;
+            mutable const PathStep *unmaterialized;
+            std::shared_ptr<const PathStep> trace;
             std::vector<const CallInst*> callStack;
+
+            void materialize() const;
+            void rebuildTrace();
         };
 
     }
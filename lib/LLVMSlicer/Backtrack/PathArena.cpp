@@ -0,0 +1,102 @@
+#include "PathArena.h"
+
+#include <mutex>
+
+using namespace llvm;
+using namespace slicing;
+
+namespace {
+
+const size_t Granularity = 16;
+const unsigned NumClasses = 8;
+const size_t SlabSize = 64 * 1024;
+
+struct FreeNode {
+    FreeNode *next;
+};
+
+/*
+ * Slabs are never returned: nodes of a thread's slab may outlive the thread,
+ * and paths stay alive until the slicer is done anyway.
+ */
+struct SharedPool {
+    std::mutex lock;
+    FreeNode *heads[NumClasses] = {};
+};
+
+SharedPool &getSharedPool() {
+    // Not destroyed, threads may still exit during static destruction.
+    static SharedPool *pool = new SharedPool();
+    return *pool;
+}
+
+struct ThreadPool {
+    FreeNode *heads[NumClasses] = {};
+    char *bump = nullptr;
+    char *end = nullptr;
+
+    ~ThreadPool() {
+        SharedPool &shared = getSharedPool();
+        std::lock_guard<std::mutex> guard(shared.lock);
+        for (unsigned c = 0; c < NumClasses; ++c) {
+            FreeNode *head = heads[c];
+            if (!head)
+                continue;
+            FreeNode *tail = head;
+            while (tail->next)
+                tail = tail->next;
+            tail->next = shared.heads[c];
+            shared.heads[c] = head;
+        }
+    }
+};
+
+thread_local ThreadPool threadPool;
+
+}
+
+void *PathArena::allocate(size_t size) {
+    if (!size || size > Granularity * NumClasses)
+        return ::operator new(size);
+    unsigned c = (size - 1) / Granularity;
+    ThreadPool &pool = threadPool;
+
+    if (FreeNode *node = pool.heads[c]) {
+        pool.heads[c] = node->next;
+        return node;
+    }
+
+    size_t bytes = (c + 1) * Granularity;
+    if ((size_t)(pool.end - pool.bump) < bytes) {
+        // Only take the lock once per slab: reuse what exited threads left.
+        {
+            SharedPool &shared = getSharedPool();
+            std::lock_guard<std::mutex> guard(shared.lock);
+            pool.heads[c] = shared.heads[c];
+            shared.heads[c] = nullptr;
+        }
+        if (FreeNode *node = pool.heads[c]) {
+            pool.heads[c] = node->next;
+            return node;
+        }
+        pool.bump = static_cast<char *>(::operator new(SlabSize));
+        pool.end = pool.bump + SlabSize;
+    }
+    void *p = pool.bump;
+    pool.bump += bytes;
+    return p;
+}
+
+void PathArena::deallocate(void *p, size_t size) {
+    if (!p)
+        return;
+    if (!size || size > Granularity * NumClasses) {
+        ::operator delete(p);
+        return;
+    }
+    unsigned c = (size - 1) / Granularity;
+    ThreadPool &pool = threadPool;
+    FreeNode *node = static_cast<FreeNode *>(p);
+    node->next = pool.heads[c];
+    pool.heads[c] = node;
+}
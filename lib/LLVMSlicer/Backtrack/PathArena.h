@@ -0,0 +1,52 @@
+#ifndef LLVM_PATHARENA_H
+#define LLVM_PATHARENA_H
+
+#include <cstddef>
+#include <new>
+
+namespace llvm {
+    namespace slicing {
+
+        /*
+         * Size class free lists for the small nodes paths are made of:
+         * paths, their elements and trace steps. Every backtracking thread
+         * allocates from and frees into lists of its own, so forking and
+         * dropping paths takes no lock. When a thread exits, its lists are
+         * handed to a shared pool the next thread starts from. Larger
+         * requests go to the global allocator.
+         */
+        class PathArena {
+        public:
+            static void *allocate(size_t size);
+            static void deallocate(void *p, size_t size);
+        };
+
+        /*
+         * Allocator for std::allocate_shared, so a trace step and its
+         * control block come from the arena as well.
+         */
+        template <typename T>
+        struct PathArenaAllocator {
+            typedef T value_type;
+
+            PathArenaAllocator() {}
+            template <typename U>
+            PathArenaAllocator(const PathArenaAllocator<U> &) {}
+
+            T *allocate(size_t n) {
+                return static_cast<T *>(PathArena::allocate(n * sizeof(T)));
+            }
+            void deallocate(T *p, size_t n) {
+                PathArena::deallocate(p, n * sizeof(T));
+            }
+
+            template <typename U>
+            bool operator==(const PathArenaAllocator<U> &) const { return true; }
+            template <typename U>
+            bool operator!=(const PathArenaAllocator<U> &) const { return false; }
+        };
+
+    }
+}
+
+#endif //LLVM_PATHARENA_H
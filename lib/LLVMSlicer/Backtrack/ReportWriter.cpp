@@ -0,0 +1,210 @@
+#include "Constraint.h"
+#include "Rule.h"
+#include "nlohmann/json.hpp"
+#include <PointsTo/PointsTo.h>
+#include <llvm/ADT/StringExtras.h>
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+using namespace slicing;
+
+using json = nlohmann::json;
+
+namespace {
+std::string toString(const Value *value) {
+  std::string s;
+  raw_string_ostream ss(s);
+  value->print(ss);
+  return ss.str();
+}
+
+std::string toString(Rule::Result result) {
+  switch (result) {
+  case Rule::ERROR:
+    return "error";
+  case Rule::PRECOND_ERROR:
+    return "precondition-error";
+  case Rule::UNKOWN:
+    return "unknown";
+  case Rule::VALID:
+    return "valid";
+  }
+  llvm_unreachable("");
+}
+
+// The elements of path in the same detail as the HTML report.
+json pathToJSON(Path *path) {
+  json elements = json::array();
+  for (PathElementBase *current = path->getEntry(); current;
+       current = current->getNext()) {
+    json element;
+    element["address"] = utohexstr((uint64_t)current->getElement());
+    if (const Instruction *inst =
+            dyn_cast<const Instruction>(current->getElement()))
+      element["function"] = inst->getParent()->getParent()->getName().str();
+    element["value"] = toString(current->getElement());
+    element["variable"] = toString(current->getRelevantVariable());
+    if (const CallInst *callInst =
+            dyn_cast<const CallInst>(current->getElement())) {
+      const SimpleCallGraph::FunctionSet_t *calledFunctions =
+          ptr::getSimpleCallGraph().findCalled(callInst);
+      if (calledFunctions && calledFunctions->size())
+        element["called"] = *calledFunctions;
+    } else if (current->getType() == PathElementBase::ConstAddressElement) {
+      element["constant"] = ((ConstPathElement *)current)->getValue();
+    }
+    elements.push_back(element);
+  }
+  return elements;
+}
+
+// Function and instruction a path ends in, i.e. the location of the finding.
+json lastLocation(Path *path) {
+  json location;
+  const Value *last = path->getLast()->getElement();
+  json logical;
+  if (const Instruction *inst = dyn_cast<const Instruction>(last))
+    logical["fullyQualifiedName"] =
+        inst->getParent()->getParent()->getName().str();
+  logical["name"] = utohexstr((uint64_t)last);
+  location["logicalLocations"] = json::array({logical});
+  location["message"]["text"] = toString(last);
+  return location;
+}
+} // namespace
+
+std::unique_ptr<ReportWriter> ReportWriter::create(raw_ostream &file_out,
+                                                   Format format) {
+  switch (format) {
+  case HTML:
+    return std::unique_ptr<ReportWriter>(new HTMLReportPrinter(file_out));
+  case JSONL:
+    return std::unique_ptr<ReportWriter>(new JSONLReportWriter(file_out));
+  case SARIF:
+    return std::unique_ptr<ReportWriter>(new SARIFReportWriter(file_out));
+  }
+  llvm_unreachable("Unknown report format");
+}
+
+void JSONLReportWriter::addResults(
+    Rule *rule, const Rule::CompletePathResultList_t &results) {
+  std::vector<const Rule::CompletePathResult_t *> selected =
+      selectResults(rule, results);
+  unsigned ruleID = index.size();
+  for (auto *r : selected) {
+    json finding;
+    finding["type"] = "path";
+    finding["id"] = ++pathCounter;
+    finding["rule"] = rule->getRuleTitle();
+    finding["ruleId"] = ruleID;
+    finding["result"] = toString(r->first.first);
+    finding["dismissed"] = isDismissed(*r);
+    json preconditions = json::array();
+    for (auto &pre : r->second) {
+      json precondition;
+      precondition["rule"] = std::get<1>(pre)->getRuleTitle();
+      precondition["result"] = toString(std::get<0>(pre));
+      precondition["trace"] = pathToJSON(std::get<2>(pre));
+      preconditions.push_back(precondition);
+    }
+    finding["preconditions"] = preconditions;
+    finding["trace"] = pathToJSON(r->first.second);
+    file_out << finding.dump() << "\n";
+  }
+  file_out.flush();
+}
+
+void JSONLReportWriter::close() {
+  json rules = json::array();
+  for (unsigned i = 0; i < index.size(); ++i) {
+    const IndexEntry &entry = index[i];
+    rules.push_back({{"ruleId", i + 1},
+                     {"rule", entry.title},
+                     {"firstPath", entry.firstPath},
+                     {"paths", entry.paths},
+                     {"errors", entry.errors},
+                     {"dismissed", entry.dismissed}});
+  }
+  json last;
+  last["type"] = "index";
+  last["rules"] = rules;
+  file_out << last.dump() << "\n";
+  file_out.flush();
+}
+
+SARIFReportWriter::SARIFReportWriter(raw_ostream &file_out)
+    : ReportWriter(file_out) {
+  // The results are streamed into the array, the tool and its rules follow
+  // once all of them are known.
+  file_out << "{\"version\":\"2.1.0\","
+              "\"$schema\":\"https://json.schemastore.org/sarif-2.1.0.json\","
+              "\"runs\":[{\"results\":[\n";
+}
+
+void SARIFReportWriter::addResults(
+    Rule *rule, const Rule::CompletePathResultList_t &results) {
+  std::vector<const Rule::CompletePathResult_t *> selected =
+      selectResults(rule, results);
+  unsigned ruleIndex = index.size() - 1;
+  for (auto *r : selected) {
+    json result;
+    result["ruleId"] = "rule" + std::to_string(ruleIndex + 1);
+    result["ruleIndex"] = ruleIndex;
+    result["level"] = isDismissed(*r) ? "none" : "error";
+    result["kind"] = r->first.first == Rule::VALID ? "pass" : "fail";
+    result["message"]["text"] = rule->getRuleTitle();
+    result["locations"] = json::array({lastLocation(r->first.second)});
+
+    json flows = json::array();
+    auto addFlow = [&](Path *path, const std::string &message) {
+      json locations = json::array();
+      for (PathElementBase *current = path->getEntry(); current;
+           current = current->getNext()) {
+        json location;
+        const Value *value = current->getElement();
+        if (const Instruction *inst = dyn_cast<const Instruction>(value))
+          location["logicalLocations"] = json::array(
+              {{{"fullyQualifiedName",
+                 inst->getParent()->getParent()->getName().str()},
+                {"name", utohexstr((uint64_t)value)}}});
+        location["message"]["text"] = toString(value);
+        locations.push_back({{"location", location}});
+      }
+      json flow;
+      flow["message"]["text"] = message;
+      flow["threadFlows"] = json::array({{{"locations", locations}}});
+      flows.push_back(flow);
+    };
+    for (auto &pre : r->second)
+      addFlow(std::get<2>(pre), "Precondition " +
+                                    std::get<1>(pre)->getRuleTitle() + ": " +
+                                    toString(std::get<0>(pre)));
+    addFlow(r->first.second, "Trace");
+    result["codeFlows"] = flows;
+
+    file_out << (pathCounter++ ? ",\n" : "") << result.dump();
+  }
+  file_out.flush();
+}
+
+void SARIFReportWriter::close() {
+  json rules = json::array();
+  for (unsigned i = 0; i < index.size(); ++i) {
+    const IndexEntry &entry = index[i];
+    rules.push_back({{"id", "rule" + std::to_string(i + 1)},
+                     {"name", entry.title},
+                     {"shortDescription", {{"text", entry.title}}},
+                     {"properties",
+                      {{"paths", entry.paths},
+                       {"errors", entry.errors},
+                       {"dismissed", entry.dismissed}}}});
+  }
+  json driver;
+  driver["name"] = "llvm-slicer";
+  driver["rules"] = rules;
+  file_out << "\n],\"tool\":{\"driver\":" << driver.dump() << "}}]}\n";
+  file_out.flush();
+}
@@ -1,10 +1,12 @@
 #include <llvm/Support/raw_ostream.h>
 #include "Rule.h"
-#include "json.hpp"
+#include "nlohmann/json.hpp"
 #include "Constraint.h"
+#include "RuleProgram.h"
 
 #include <vector>
 #include <map>
+#include <algorithm>
 #include <llvm/Support/CommandLine.h>
 #include <fstream>
 
@@ -44,6 +46,49 @@ uint64_t translateRegister(string reg) {
 typedef map<string, vector<Parameter>> CallMap_t;
 CallMap_t callMap;
 
+// Parsed constraints by (type, canonical id), see canonicalize().
+typedef map<std::pair<Constraint::ConstraintType, unsigned>, Constraint*> ConstraintPool_t;
+ConstraintPool_t constraintPool;
+unsigned parsedConstraints = 0;
+
+/*
+ * Returns the first parsed constraint that is structurally equal to c and
+ * deletes c if there is one. Shared subtrees then share their canonical id and
+ * with it their entries in the evaluation memo.
+ */
+Constraint *canonicalize(Constraint *c) {
+    ++parsedConstraints;
+    auto key = std::make_pair(c->getConstraintType(), RuleProgram::get(*c).getID());
+    auto it = constraintPool.find(key);
+    if (it != constraintPool.end()) {
+        // Children are canonical themselves and owned by the pool.
+        delete c;
+        return it->second;
+    }
+    constraintPool[key] = c;
+    return c;
+}
+
+/*
+ * Builds a canonical chain. The result of a chain does not depend on the
+ * order or multiplicity of its children, so they are sorted by canonical id
+ * and deduplicated.
+ */
+Constraint *canonicalChain(ChainConstraint::ChainType chainType, vector<Constraint*> &children) {
+    std::vector<std::pair<unsigned, Constraint*>> sorted;
+    for (auto &child : children) {
+        sorted.push_back(std::make_pair(RuleProgram::get(*child).getID(), child));
+    }
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+    ChainConstraint *chain = new ChainConstraint(Constraint::STRICT, chainType);
+    for (auto &child : sorted) {
+        chain->addConstraint(child.second);
+    }
+    return canonicalize(chain);
+}
+
 void dumpJSON(json &j) {
     errs() << j.dump();
 }
@@ -115,28 +160,27 @@ Constraint *parseCondition(json &cond) {
         type = Constraint::PRECONDITION;
     }
     if (cond.find("calls") != cond.end()) {
-        ChainConstraint *orConstraint = new ChainConstraint(Constraint::STRICT, ChainConstraint::OR);
+        vector<Constraint*> calls;
 
         if (callMap.find(cond["calls"].get<string>()) == callMap.end()) {
             errs() << cond["calls"].dump() << "\n";
             llvm_unreachable("");
         }
         for (auto &p : callMap[cond["calls"].get<string>()]) {
-            CallConstraint *constr = new CallConstraint(Constraint::STRICT, p.getFunctionName());
-            orConstraint->addConstraint(constr);
+            calls.push_back(canonicalize(new CallConstraint(Constraint::STRICT, p.getFunctionName())));
         }
-        return orConstraint;
+        return canonicalChain(ChainConstraint::OR, calls);
     } else if (cond["conditionType"].get<string>() == "ConstInt") {
         if (cond.find("equal") != cond.end()) {
-            return new llvm::slicing::ConstConstraint(ConstConstraint::EQUAL, type, cond["equal"].get<int>(), "", std::vector<std::string>());
+            return canonicalize(new llvm::slicing::ConstConstraint(ConstConstraint::EQUAL, type, cond["equal"].get<int>(), "", std::vector<std::string>()));
         } else if (cond.find("greater") != cond.end()) {
-            return new llvm::slicing::ConstConstraint(ConstConstraint::GREATER, type, cond["greater"].get<int>(), "", std::vector<std::string>());
+            return canonicalize(new llvm::slicing::ConstConstraint(ConstConstraint::GREATER, type, cond["greater"].get<int>(), "", std::vector<std::string>()));
         } else if (cond.find("loreq") != cond.end()) {
-            return new llvm::slicing::ConstConstraint(ConstConstraint::LOREQ, type, cond["loreq"].get<int>(), "", std::vector<std::string>());
+            return canonicalize(new llvm::slicing::ConstConstraint(ConstConstraint::LOREQ, type, cond["loreq"].get<int>(), "", std::vector<std::string>()));
         }else if (cond.find("lorneq") != cond.end()) {
-            return new llvm::slicing::ConstConstraint(ConstConstraint::LORNEQ, type, cond["lorneq"].get<int>(), "", std::vector<std::string>());
+            return canonicalize(new llvm::slicing::ConstConstraint(ConstConstraint::LORNEQ, type, cond["lorneq"].get<int>(), "", std::vector<std::string>()));
         } else {
-            return new llvm::slicing::ConstConstraint(ConstConstraint::ANY, type, 0, "", std::vector<std::string>());
+            return canonicalize(new llvm::slicing::ConstConstraint(ConstConstraint::ANY, type, 0, "", std::vector<std::string>()));
         }
     } else if (cond["conditionType"].get<string>() == "ConstStr" || cond["conditionType"].get<string>() == "ConstType") {
         // condition string can be a const string or string list, we insert strings into a vector.
@@ -151,7 +195,7 @@ Constraint *parseCondition(json &cond) {
                 vs.push_back(cond["in"]);
             }
             errs() << "[+]vs.size: " << vs.size() << "\n";
-            return new llvm::slicing::ConstConstraint(ConstConstraint::IN, type, 0, "", vs);
+            return canonicalize(new llvm::slicing::ConstConstraint(ConstConstraint::IN, type, 0, "", vs));
         } else if (cond.find("notin") != cond.end()) {
             std::vector<std::string> vs;
             if(cond["notin"].is_array()) {
@@ -161,16 +205,16 @@ Constraint *parseCondition(json &cond) {
             } else {
                 vs.push_back(cond["notin"]);
             }
-            return new llvm::slicing::ConstConstraint(ConstConstraint::NOTIN, type, 0, "", vs);
+            return canonicalize(new llvm::slicing::ConstConstraint(ConstConstraint::NOTIN, type, 0, "", vs));
         } else {
-            return new llvm::slicing::ConstConstraint(ConstConstraint::ANY, type, 0, "", std::vector<std::string>());
+            return canonicalize(new llvm::slicing::ConstConstraint(ConstConstraint::ANY, type, 0, "", std::vector<std::string>()));
         }
     } else if (cond["conditionType"].get<string>() == "NOT") {
-        ChainConstraint *notChain = new llvm::slicing::ChainConstraint(Constraint::STRICT, ChainConstraint::NOT_AND);
+        vector<Constraint*> subConditions;
         for (auto &subCond : cond["conditions"]) {
-            notChain->addConstraint(parseCondition(subCond));
+            subConditions.push_back(parseCondition(subCond));
         }
-        return notChain;
+        return canonicalChain(ChainConstraint::NOT_AND, subConditions);
     } else {
         llvm_unreachable("");
     }
@@ -343,5 +387,7 @@ std::vector<Rule*> llvm::slicing::parseRules() {
 //
 //        rules.push_back(r);
     }
+    errs() << "[+]rules: " << parsedConstraints << " parsed constraints, "
+           << constraintPool.size() << " after canonicalization\n";
     return rules;
 }
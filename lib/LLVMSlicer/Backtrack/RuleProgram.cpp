@@ -0,0 +1,313 @@
+#include "RuleProgram.h"
+#include <PointsTo/PointsTo.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/Support/raw_ostream.h"
+
+#define DEBUG_TYPE "rule-program"
+
+using namespace llvm;
+using namespace slicing;
+
+STATISTIC(NumRulePrograms, "Number of distinct compiled rule programs");
+STATISTIC(NumRuleEvaluations, "Number of rule program evaluations");
+STATISTIC(NumRuleCacheHits, "Number of rule evaluations answered from cache");
+STATISTIC(NumSubprogramEvaluations,
+          "Number of nested constraint chains evaluated through the memo");
+
+namespace {
+struct ProgramRegistry {
+  std::mutex lock;
+  std::unordered_multimap<size_t, std::unique_ptr<RuleProgram>> programs;
+  // (element, program id << 8 | load width) -> result
+  DenseMap<std::pair<const Value *, uint64_t>, bool> results;
+  // Strings the binary holds at an address, as seen by IN/NOTIN.
+  DenseMap<uint64_t, std::string> strings;
+  // Statistics are compiled out of release builds; keep our own counts.
+  std::atomic<uint64_t> evaluations{0};
+  std::atomic<uint64_t> cacheHits{0};
+};
+
+ProgramRegistry &getRegistry() {
+  static ProgramRegistry registry;
+  return registry;
+}
+
+std::string resolveString(uint64_t addr) {
+  ProgramRegistry &R = getRegistry();
+  std::lock_guard<std::mutex> guard(R.lock);
+  auto it = R.strings.find(addr);
+  if (it != R.strings.end())
+    return it->second;
+
+  StringRef ref;
+  ObjectiveCBinary &MachO = ptr::getAndersen()->getMachO();
+  if (MachO.isCFString(addr) || MachO.isCString(addr)) {
+    ref = MachO.getString(addr);
+  } else if (MachO.isClassRef(addr)) {
+    MachO.getClass(addr, ref);
+  } else if (MachO.isData(addr)) {
+    MachO.getData(addr, ref);
+  }
+  // The constraint compares the NUL terminated string at ref.data().
+  std::string s = ref.data() ? std::string(ref.data()) : std::string();
+  R.strings[addr] = s;
+  return s;
+}
+} // namespace
+
+void RuleProgram::emitConst(ConstConstraint::Compare compare, uint64_t value,
+                            const std::vector<std::string> &strings) {
+  Op op = {CONST, compare, value, 0};
+  if (compare == ConstConstraint::IN || compare == ConstConstraint::NOTIN) {
+    std::vector<std::string> sorted(strings);
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+    op.operand = stringSets.size();
+    stringSets.push_back(sorted);
+  }
+  needsLoadWidth = true;
+  ops.push_back(op);
+}
+
+void RuleProgram::emitCall(const std::string &functionName) {
+  Op op = {CALL, ConstConstraint::ANY, 0, (unsigned)callees.size()};
+  callees.push_back(functionName);
+  ops.push_back(op);
+}
+
+void RuleProgram::emitSubprogram(const RuleProgram &program) {
+  Op op = {SUB, ConstConstraint::ANY, 0, (unsigned)subprograms.size()};
+  subprograms.push_back(&program);
+  needsLoadWidth |= program.needsLoadWidth;
+  ops.push_back(op);
+}
+
+void RuleProgram::emitChain(ChainConstraint::ChainType chainType,
+                            unsigned numOperands) {
+  OpCode code = AND;
+  switch (chainType) {
+  case ChainConstraint::AND:
+    code = AND;
+    break;
+  case ChainConstraint::OR:
+    code = OR;
+    break;
+  case ChainConstraint::NOT_AND:
+    code = NOT_AND;
+    break;
+  }
+  Op op = {code, ConstConstraint::ANY, 0, numOperands};
+  ops.push_back(op);
+}
+
+size_t RuleProgram::hash() const {
+  hash_code h = hash_value(ops.size());
+  for (auto &op : ops)
+    h = hash_combine(h, op.code, op.compare, op.value, op.operand);
+  for (auto &set : stringSets)
+    for (auto &s : set)
+      h = hash_combine(h, s);
+  for (auto &c : callees)
+    h = hash_combine(h, c);
+  for (auto &sub : subprograms)
+    h = hash_combine(h, sub->id);
+  return h;
+}
+
+bool RuleProgram::operator==(const RuleProgram &o) const {
+  // Subprograms are interned, so comparing pointers compares structure.
+  return ops == o.ops && stringSets == o.stringSets && callees == o.callees &&
+         subprograms == o.subprograms;
+}
+
+const RuleProgram &RuleProgram::get(const Constraint &root) {
+  std::unique_ptr<RuleProgram> P(new RuleProgram());
+  root.compile(*P);
+
+  ProgramRegistry &R = getRegistry();
+  size_t h = P->hash();
+  std::lock_guard<std::mutex> guard(R.lock);
+  auto range = R.programs.equal_range(h);
+  for (auto it = range.first; it != range.second; ++it)
+    if (*it->second == *P)
+      return *it->second;
+
+  P->id = R.programs.size();
+  ++NumRulePrograms;
+  return *R.programs.insert(std::make_pair(h, std::move(P)))->second;
+}
+
+bool RuleProgram::evaluateConst(const Op &op, PathElementBase *pathElement,
+                                uint64_t width) const {
+  uint64_t value = op.value;
+  auto inStrings = [&](uint64_t addr) {
+    const std::vector<std::string> &set = stringSets[op.operand];
+    return std::binary_search(set.begin(), set.end(), resolveString(addr));
+  };
+
+  if (const Instruction *inst =
+          dyn_cast<const Instruction>(pathElement->getElement())) {
+    if (inst->getOpcode() != Instruction::Store)
+      return false;
+    const ConstantInt *constInt =
+        dyn_cast<const ConstantInt>(inst->getOperand(0));
+    if (!constInt)
+      return false;
+    uint64_t c = constInt->getZExtValue();
+    switch (op.compare) {
+    case ConstConstraint::EQUAL:
+      return c == value;
+    case ConstConstraint::GREATER:
+      return c > value;
+    case ConstConstraint::LOREQ:
+      return (c | value) == value;
+    case ConstConstraint::LORNEQ:
+      return (c & value) != value;
+    case ConstConstraint::IN:
+      return inStrings(c);
+    case ConstConstraint::NOTIN:
+      return !inStrings(c);
+    case ConstConstraint::ANY:
+      return true;
+    }
+  } else if (const ConstantInt *constAddress =
+                 dyn_cast<const ConstantInt>(pathElement->getElement())) {
+    uint64_t data = 0;
+    switch (width) {
+    case 32:
+      data = ptr::getAndersen()->getMachO().getRAWData<uint32_t>(
+          constAddress->getZExtValue());
+      break;
+    case 64:
+      data = ptr::getAndersen()->getMachO().getRAWData<uint64_t>(
+          constAddress->getZExtValue());
+      break;
+    default:
+      llvm_unreachable("");
+    }
+    switch (op.compare) {
+    case ConstConstraint::EQUAL:
+      return data == value;
+    case ConstConstraint::GREATER:
+      return data > value;
+    case ConstConstraint::LORNEQ:
+      return (data & value) != value;
+    case ConstConstraint::ANY:
+      return true;
+    case ConstConstraint::IN:
+      return inStrings(data);
+    case ConstConstraint::LOREQ:
+    case ConstConstraint::NOTIN:
+      // ConstConstraint::checkConstraint falls through to false here.
+      return false;
+    }
+  }
+  llvm_unreachable("");
+}
+
+bool RuleProgram::evaluate(PathElementBase *pathElement,
+                           uint64_t width) const {
+  ++NumRuleEvaluations;
+  ++getRegistry().evaluations;
+  SmallVector<bool, 16> stack;
+  for (auto &op : ops) {
+    switch (op.code) {
+    case CONST:
+      stack.push_back(evaluateConst(op, pathElement, width));
+      break;
+    case CALL: {
+      bool called = false;
+      if (const Instruction *inst =
+              dyn_cast<const Instruction>(pathElement->getElement())) {
+        const SimpleCallGraph::FunctionSet_t *calledFunctions =
+            ptr::getSimpleCallGraph().findCalled(inst);
+        called = calledFunctions &&
+                 calledFunctions->count(callees[op.operand]);
+      }
+      stack.push_back(called);
+      break;
+    }
+    case SUB:
+      ++NumSubprogramEvaluations;
+      stack.push_back(subprograms[op.operand]->evaluateMemo(pathElement, width));
+      break;
+    case AND:
+    case OR:
+    case NOT_AND: {
+      assert(stack.size() >= op.operand);
+      bool result = op.code != OR;
+      for (unsigned i = stack.size() - op.operand; i < stack.size(); ++i) {
+        if (op.code == AND)
+          result &= stack[i];
+        else if (op.code == OR)
+          result |= stack[i];
+        else
+          result &= !stack[i];
+      }
+      stack.resize(stack.size() - op.operand);
+      stack.push_back(result);
+      break;
+    }
+    }
+  }
+  assert(stack.size() == 1);
+  return stack.back();
+}
+
+bool RuleProgram::evaluate(PathElementBase *pathElement) const {
+  uint64_t width = 0;
+  if (needsLoadWidth && isa<ConstantInt>(pathElement->getElement()))
+    width = pathElement->getParent()->getShortestLoad();
+  return evaluate(pathElement, width);
+}
+
+bool RuleProgram::evaluate(Path *path) const {
+  PathElementBase *last = path->getLast();
+  uint64_t width = 0;
+  if (needsLoadWidth && isa<ConstantInt>(last->getElement()))
+    width = path->getShortestLoad();
+  return evaluateMemo(last, width);
+}
+
+bool RuleProgram::evaluateMemo(PathElementBase *pathElement,
+                               uint64_t width) const {
+  ProgramRegistry &R = getRegistry();
+  std::pair<const Value *, uint64_t> key(pathElement->getElement(),
+                                         ((uint64_t)id << 8) | width);
+  {
+    std::lock_guard<std::mutex> guard(R.lock);
+    auto it = R.results.find(key);
+    if (it != R.results.end()) {
+      ++NumRuleCacheHits;
+      ++R.cacheHits;
+      return it->second;
+    }
+  }
+
+  bool result = evaluate(pathElement, width);
+  std::lock_guard<std::mutex> guard(R.lock);
+  R.results[key] = result;
+  return result;
+}
+
+void RuleProgram::printStatistics(raw_ostream &OS) {
+  ProgramRegistry &R = getRegistry();
+  size_t programs;
+  {
+    std::lock_guard<std::mutex> guard(R.lock);
+    programs = R.programs.size();
+  }
+  OS << "[+]rule programs: " << programs << " distinct, "
+     << R.evaluations.load() << " evaluations, " << R.cacheHits.load()
+     << " evaluations saved by the memo\n";
+}
@@ -0,0 +1,89 @@
+#ifndef LLVM_RULEPROGRAM_H
+#define LLVM_RULEPROGRAM_H
+
+#include "Constraint.h"
+#include <string>
+#include <vector>
+
+namespace llvm {
+class raw_ostream;
+
+namespace slicing {
+
+/*
+ * A constraint tree compiled into a flat postfix program over booleans.
+ * Evaluating it gives the same result as Constraint::checkConstraint on the
+ * root, but without virtual calls, and with the string operands of IN/NOTIN
+ * sorted once. Strings read from the binary are resolved once per address.
+ *
+ * Programs are interned: structurally equal trees, e.g. the same precondition
+ * parsed for several rules, share one program and therefore one entry per
+ * path in the evaluation cache. Nested chains are compiled into programs of
+ * their own, so a subtree shared by different rules is memoized as well. The
+ * program id doubles as the canonical id of a constraint subtree.
+ */
+class RuleProgram {
+public:
+  enum OpCode { CONST, CALL, SUB, AND, OR, NOT_AND };
+
+  struct Op {
+    OpCode code;
+    ConstConstraint::Compare compare;
+    uint64_t value;
+    // CONST: index into stringSets; CALL: index into callees;
+    // SUB: index into subprograms; chains: number of operands.
+    unsigned operand;
+
+    bool operator==(const Op &o) const {
+      return code == o.code && compare == o.compare && value == o.value &&
+             operand == o.operand;
+    }
+  };
+
+  // Used by Constraint::compile() to emit the tree in postfix order.
+  void emitConst(ConstConstraint::Compare compare, uint64_t value,
+                 const std::vector<std::string> &strings);
+  void emitCall(const std::string &functionName);
+  void emitSubprogram(const RuleProgram &program);
+  void emitChain(ChainConstraint::ChainType chainType, unsigned numOperands);
+
+  /*
+   * Compiles root, or returns the interned program of an equal tree. The
+   * program lives until the end of the analysis.
+   */
+  static const RuleProgram &get(const Constraint &root);
+
+  bool evaluate(PathElementBase *pathElement) const;
+
+  /*
+   * Evaluates the program on the last element of path. The result only
+   * depends on that element and the path's shortest load, so it is memoized
+   * per (element, load width, program) and shared by every rule and every
+   * path ending there.
+   */
+  bool evaluate(Path *path) const;
+
+  unsigned getID() const { return id; }
+
+  static void printStatistics(raw_ostream &OS);
+
+private:
+  std::vector<Op> ops;
+  std::vector<std::vector<std::string>> stringSets;
+  std::vector<std::string> callees;
+  std::vector<const RuleProgram *> subprograms;
+  unsigned id = 0;
+  bool needsLoadWidth = false;
+
+  size_t hash() const;
+  bool operator==(const RuleProgram &o) const;
+
+  bool evaluateConst(const Op &op, PathElementBase *pathElement,
+                     uint64_t width) const;
+  bool evaluate(PathElementBase *pathElement, uint64_t width) const;
+  bool evaluateMemo(PathElementBase *pathElement, uint64_t width) const;
+};
+} // namespace slicing
+} // namespace llvm
+
+#endif // LLVM_RULEPROGRAM_H
@@ -1,12 +1,20 @@
 // This file is distributed under the University of Illinois Open Source
 // License. See LICENSE.TXT for details.
 
+#include "llvm/ADT/Statistic.h"
+
 #include "../PointsTo/PointsTo.h"
 #include "Callgraph.h"
 
+#define DEBUG_TYPE "callgraph"
+
 using namespace llvm;
 using namespace callgraph;
 
+STATISTIC(NumDirectCalls, "Number of direct call graph edges");
+STATISTIC(NumCallgraphSCCs, "Number of call graph SCCs");
+STATISTIC(NumClosureCalls, "Number of transitive call graph edges");
+
 Callgraph::Callgraph(Module &M, ptr::PointsToSets const& PS) {
   typedef Module::iterator FunctionsIter;
   for (FunctionsIter f = M.begin(); f != M.end(); ++f)
@@ -16,15 +24,42 @@ Callgraph::Callgraph(Module &M, ptr::PointsToSets const& PS) {
         if (const CallInst *CI = dyn_cast<CallInst const>(&*i))
           handleCall(&*f, CI, PS);
     }
-  detail::computeTransitiveClosure(directCallsMap, callsMap);
   for (const_iterator it = begin(); it != end(); ++it) {
     //errs() << "[+]directCallsMap it->second, it->first: " << it->second->getName() << it->first->getName() << "\n"; 
     directCalleesMap.insert(value_type(it->second,it->first));
   }
-  for (const_iterator it = callsMap.begin(); it != callsMap.end(); ++it) {
-    //errs() << "[+]callsMap it->second, it->first" << it->second->getName() << it->first->getName() << "\n";
-    calleesMap.insert(value_type(it->second,it->first));
+
+  // Successors come first, so each row is the union of the rows of the
+  // SCCs it calls.
+  condensed.compute(directCallsMap);
+  reachable.resize(condensed.SCCs.size());
+  uint64_t closure = 0;
+  for (unsigned idx = 0; idx < condensed.SCCs.size(); ++idx) {
+    SparseBitVector<> &row = reachable[idx];
+    if (condensed.cyclic[idx])
+      row.set(idx);
+    for (unsigned succ : condensed.successors[idx]) {
+      row.set(succ);
+      row |= reachable[succ];
+    }
+    for (unsigned reached : row)
+      closure += condensed.SCCs[idx].size() * condensed.SCCs[reached].size();
+  }
+  // Callers come last, so each row is complete by the time it is handed
+  // down to the SCCs it calls.
+  reachedBy.resize(condensed.SCCs.size());
+  for (unsigned idx = condensed.SCCs.size(); idx-- > 0; ) {
+    if (condensed.cyclic[idx])
+      reachedBy[idx].set(idx);
+    for (unsigned succ : condensed.successors[idx]) {
+      reachedBy[succ].set(idx);
+      reachedBy[succ] |= reachedBy[idx];
+    }
   }
+
+  NumDirectCalls += directCallsMap.size();
+  NumCallgraphSCCs += condensed.SCCs.size();
+  NumClosureCalls += closure;
 }
 
 void Callgraph::handleCall(const Function *parent,
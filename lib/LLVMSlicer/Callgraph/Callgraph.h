@@ -5,17 +5,155 @@
 #define CALLGRAPH_CALLGRAPH_H
 
 #include <map>
+#include <vector>
 #include <algorithm>
 #include <iterator>
 #include <utility>
 
 #include "llvm/IR/Function.h"
 #include "llvm/ADT/STLExtras.h" /* tie */
+#include "llvm/ADT/SparseBitVector.h"
 
 #include "../Languages/LLVM.h"
 #include "../Languages/LLVMSupport.h"
 #include "../PointsTo/PointsTo.h"
 
+namespace llvm { namespace callgraph { namespace detail {
+
+  /*
+   * Tarjan's algorithm over R, a multimap from a node to its successors.
+   * The SCCs are appended to Out in reverse topological order, i.e. an SCC
+   * always comes after every SCC reachable from it.
+   */
+  template<typename Relation>
+  void computeSCCs(Relation const& R,
+                   std::vector<std::vector<typename Relation::key_type> >& Out) {
+    typedef typename Relation::key_type Node;
+    typedef typename Relation::const_iterator Iter;
+
+    struct Info {
+      unsigned index;
+      unsigned low;
+      bool onStack;
+    };
+    struct Frame {
+      Node node;
+      Iter cur, end;
+    };
+
+    std::map<Node, Info> info;
+    std::vector<Node> stack;
+    std::vector<Frame> frames;
+    unsigned counter = 0;
+
+    auto visit = [&](Node n) {
+      Info &I = info[n];
+      I.index = I.low = counter++;
+      I.onStack = true;
+      stack.push_back(n);
+      Frame F;
+      F.node = n;
+      std::tie(F.cur, F.end) = R.equal_range(n);
+      frames.push_back(F);
+    };
+
+    auto run = [&](Node root) {
+      if (info.count(root))
+        return;
+      visit(root);
+      while (!frames.empty()) {
+        Frame &F = frames.back();
+        if (F.cur != F.end) {
+          Node w = F.cur->second;
+          Node n = F.node;
+          ++F.cur;
+          typename std::map<Node, Info>::iterator it = info.find(w);
+          if (it == info.end())
+            visit(w);
+          else if (it->second.onStack)
+            info[n].low = std::min(info[n].low, it->second.index);
+          continue;
+        }
+
+        Node n = F.node;
+        frames.pop_back();
+        Info &I = info[n];
+        if (!frames.empty()) {
+          Info &P = info[frames.back().node];
+          P.low = std::min(P.low, I.low);
+        }
+        if (I.low != I.index)
+          continue;
+
+        Out.push_back(std::vector<Node>());
+        Node w;
+        do {
+          w = stack.back();
+          stack.pop_back();
+          info[w].onStack = false;
+          Out.back().push_back(w);
+        } while (w != n);
+      }
+    };
+
+    for (Iter it = R.begin(); it != R.end(); ++it) {
+      run(it->first);
+      run(it->second);
+    }
+  }
+
+  /*
+   * R condensed into its SCCs, numbered as computeSCCs returns them, so the
+   * successors of an SCC always have lower numbers than the SCC itself.
+   */
+  template<typename Relation>
+  struct Condensation {
+    typedef typename Relation::key_type Node;
+    static const unsigned None = ~0u;
+
+    std::vector<std::vector<Node> > SCCs;
+    std::map<Node, unsigned> sccOf;
+    // The other SCCs an SCC has edges to, without duplicates.
+    std::vector<std::vector<unsigned> > successors;
+    // Whether an SCC is a cycle, i.e. has more than one node or a self loop.
+    std::vector<bool> cyclic;
+
+    void compute(Relation const& R) {
+      computeSCCs(R, SCCs);
+      for (unsigned idx = 0; idx < SCCs.size(); ++idx)
+        for (typename std::vector<Node>::const_iterator n = SCCs[idx].begin();
+             n != SCCs[idx].end(); ++n)
+          sccOf[*n] = idx;
+
+      successors.resize(SCCs.size());
+      cyclic.resize(SCCs.size());
+      for (unsigned idx = 0; idx < SCCs.size(); ++idx) {
+        std::vector<unsigned> &succs = successors[idx];
+        cyclic[idx] = SCCs[idx].size() > 1;
+        for (typename std::vector<Node>::const_iterator n = SCCs[idx].begin();
+             n != SCCs[idx].end(); ++n) {
+          typename Relation::const_iterator b, e;
+          for (std::tie(b, e) = R.equal_range(*n); b != e; ++b) {
+            unsigned succ = sccOf.find(b->second)->second;
+            if (succ == idx)
+              cyclic[idx] = true;
+            else
+              succs.push_back(succ);
+          }
+        }
+        std::sort(succs.begin(), succs.end());
+        succs.erase(std::unique(succs.begin(), succs.end()), succs.end());
+      }
+    }
+
+    unsigned getSCC(Node n) const {
+      typename std::map<Node, unsigned>::const_iterator it = sccOf.find(n);
+      return it == sccOf.end() ? None : it->second;
+    }
+  };
+
+}}}
+
 namespace llvm { namespace callgraph {
 
     struct Callgraph {
@@ -36,11 +174,72 @@ namespace llvm { namespace callgraph {
         range_iterator directCallees(key_type const& key) const
         { return directCalleesMap.equal_range(key); }
 
-        range_iterator calls(key_type const& key) const
-        { return callsMap.equal_range(key); }
-
-        range_iterator callees(key_type const& key) const
-        { return calleesMap.equal_range(key); }
+        /*
+         * Iterates the transitive closure of one function as the pairs of
+         * it and every function in the SCCs set in its reachability row.
+         */
+        class closure_iterator
+            : public std::iterator<std::forward_iterator_tag,
+                                   const std::pair<key_type, mapped_type> > {
+        public:
+          closure_iterator() : condensed(nullptr), member(0) {}
+          closure_iterator(const detail::Condensation<Container> &condensed,
+                           key_type key, const SparseBitVector<> &row,
+                           bool atEnd)
+              : condensed(&condensed), bit(atEnd ? row.end() : row.begin()),
+                bitEnd(row.end()), member(0), current(key, nullptr) {
+            settle();
+          }
+
+          reference operator*() const { return current; }
+          pointer operator->() const { return &current; }
+
+          closure_iterator &operator++() {
+            if (++member == condensed->SCCs[*bit].size()) {
+              member = 0;
+              ++bit;
+            }
+            settle();
+            return *this;
+          }
+          closure_iterator operator++(int) {
+            closure_iterator tmp = *this;
+            ++*this;
+            return tmp;
+          }
+
+          bool operator==(const closure_iterator &RHS) const
+          { return bit == RHS.bit && member == RHS.member; }
+          bool operator!=(const closure_iterator &RHS) const
+          { return !(*this == RHS); }
+
+        private:
+          const detail::Condensation<Container> *condensed;
+          SparseBitVector<>::iterator bit, bitEnd;
+          unsigned member;
+          std::pair<key_type, mapped_type> current;
+
+          void settle() {
+            if (bit != bitEnd)
+              current.second = condensed->SCCs[*bit][member];
+          }
+        };
+        typedef std::pair<closure_iterator, closure_iterator> closure_range;
+
+        /*
+         * The transitive closure is answered from the call graph condensed
+         * into its SCCs: each SCC keeps sparse bit rows of the SCCs it
+         * reaches and is reached from, instead of a pair for every caller
+         * and transitive callee.
+         */
+        closure_range calls(key_type const& key) const
+        { return closure(key, reachable); }
+
+        closure_range callees(key_type const& key) const
+        { return closure(key, reachedBy); }
+
+        const detail::Condensation<Container> &getCondensation() const
+        { return condensed; }
 
         bool contains(key_type const key, mapped_type const value) const {
           range_iterator rng = directCalls(key);
@@ -54,8 +253,6 @@ namespace llvm { namespace callgraph {
         iterator begin() { return directCallsMap.begin(); }
         const_iterator end() const { return directCallsMap.end(); }
         iterator end() { return directCallsMap.end(); }
-        const_iterator begin_closure() const { return callsMap.begin(); }
-        const_iterator end_closure() const { return callsMap.end(); }
         Container const& getContainer() const { return directCallsMap; }
         Container& getContainer() { return directCallsMap; }
 
@@ -66,47 +263,25 @@ namespace llvm { namespace callgraph {
     private:
         Container directCallsMap;
         Container directCalleesMap;
-        Container callsMap;
-        Container calleesMap;
+        detail::Condensation<Container> condensed;
+        // Per SCC, the SCCs it calls and the SCCs calling it, transitively.
+        std::vector<SparseBitVector<> > reachable;
+        std::vector<SparseBitVector<> > reachedBy;
+        SparseBitVector<> none;
+
+        closure_range closure(key_type key,
+                              const std::vector<SparseBitVector<> > &rows) const {
+          unsigned idx = condensed.getSCC(key);
+          const SparseBitVector<> &row = idx == condensed.None ? none : rows[idx];
+          return closure_range(closure_iterator(condensed, key, row, false),
+                               closure_iterator(condensed, key, row, true));
+        }
 
         void handleCall(const llvm::Function *parent, const llvm::CallInst *CI,
                         const llvm::ptr::PointsToSets &PS);
     };
 }}
 
-namespace llvm { namespace callgraph { namespace detail {
-
-  template<typename Relation>
-  void computeTransitiveClosure(Relation const& R, Relation& TCR) {
-    typedef std::set<typename Relation::value_type> Set;
-    typedef std::multimap<typename Relation::value_type::first_type,
-                          typename Relation::value_type::second_type> Dict;
-
-    Set S;
-    std::copy(R.begin(),R.end(),std::inserter(S,S.end()));
-
-    Dict D;
-    std::copy(R.begin(),R.end(),std::inserter(D,D.end()));
-
-    while (true)
-    {
-      std::size_t const old_size = S.size();
-
-      for (typename Set::const_iterator it = S.begin(); it != S.end(); ++it) {
-        typename Dict::const_iterator b,e;
-        std::tie(b,e) = D.equal_range(it->second);
-        for ( ; b != e; ++b)
-          S.insert(typename Set::value_type(it->first,b->second));
-      }
-
-      if (old_size == S.size())
-          break;
-    }
-
-    std::copy(S.begin(),S.end(),std::inserter(TCR,TCR.end()));
-  }
-
-}}}
 
 namespace llvm { namespace callgraph {
 
@@ -120,12 +295,12 @@ namespace llvm { namespace callgraph {
         return CG.directCallees(key);
     }
 
-    static inline Callgraph::range_iterator
+    static inline Callgraph::closure_range
     getCalls(Callgraph::key_type const& key, Callgraph const& CG) {
         return CG.calls(key);
     }
 
-    static inline Callgraph::range_iterator
+    static inline Callgraph::closure_range
     getCallees(Callgraph::key_type const& key, Callgraph const& CG) {
         return CG.callees(key);
     }
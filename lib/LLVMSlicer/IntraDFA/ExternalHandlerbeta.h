@@ -1,27 +1,33 @@
 #include "llvm/Analysis/Andersen/DetectParametersPass.h"
+#include "llvm/ADT/StringRef.h"
+#include <algorithm>
+#include <iterator>
 namespace llvm {
 
 namespace {
-int translateRegister(std::string RegName) {
-  if (RegName == "X0") 
-    return 5;
-  if (RegName == "X1") 
-    return 6;
-  if (RegName == "X2") 
-    return 7;
-  if (RegName == "X3") 
-    return 8;
-  if (RegName == "X4") 
-    return 9;
-  if (RegName == "X5") 
-    return 10;
-  if (RegName == "X6") 
-    return 11;
-  if (RegName == "X7") 
-    return 12;
+struct RegisterName {
+  const char *Name;
+  int Idx;
+};
+
+const RegisterName RegisterNames[] = {
+    {"X0", 5},
+    {"X1", 6},
+    {"X2", 7},
+    {"X3", 8},
+    {"X4", 9},
+    {"X5", 10},
+    {"X6", 11},
+    {"X7", 12},
+};
+
+int translateRegister(StringRef RegName) {
+  for (const RegisterName &R : RegisterNames)
+    if (RegName == R.Name)
+      return R.Idx;
   llvm_unreachable("Unknown Register");
 }
-}
+} // namespace
 void anonymous_1005(llvm::beta::InsInfo *CallInst, const ptr::PointsToSets &PS) {
 //Handle "malloc"
 }
@@ -4650,678 +4656,381 @@ for (auto S : Src) {
 } //End Ref1
 }
 
+namespace {
+struct ExternalCall {
+  const char *Name;
+  unsigned Length;
+  unsigned Begin;
+  unsigned End;
+};
+
+const ExternalCall ExternalCalls[] = {
+    {"+[NSArray arrayWithArray:]", 26, 0, 1},
+    {"+[NSArray arrayWithObject:]", 27, 1, 2},
+    {"+[NSArray arrayWithObjects:]", 28, 2, 3},
+    {"+[NSArray array]", 16, 3, 4},
+    {"+[NSBundle bundleForClass:]", 27, 4, 5},
+    {"+[NSBundle bundleWithPath:]", 27, 5, 6},
+    {"+[NSBundle mainBundle]", 22, 6, 7},
+    {"+[NSData dataWithBytes:length:]", 31, 7, 8},
+    {"+[NSData dataWithBytesNoCopy:length:]", 37, 8, 9},
+    {"+[NSData dataWithBytesNoCopy:length:freeWhenDone:]", 50, 9, 10},
+    {"+[NSData dataWithContentsOfFile:]", 33, 10, 11},
+    {"+[NSData dataWithContentsOfFile:options:error:]", 47, 11, 12},
+    {"+[NSData dataWithContentsOfURL:]", 32, 12, 13},
+    {"+[NSData dataWithData:]", 23, 13, 14},
+    {"+[NSData data]", 14, 14, 15},
+    {"+[NSDictionary dictionaryWithContentsOfFile:]", 45, 15, 16},
+    {"+[NSDictionary dictionaryWithDictionary:]", 41, 16, 17},
+    {"+[NSDictionary dictionaryWithObject:forKey:]", 44, 17, 18},
+    {"+[NSDictionary dictionaryWithObjects:forKeys:]", 46, 18, 19},
+    {"+[NSDictionary dictionaryWithObjects:forKeys:count:]", 52, 19, 20},
+    {"+[NSDictionary dictionaryWithObjectsAndKeys:]", 45, 20, 21},
+    {"+[NSDictionary dictionary]", 26, 21, 22},
+    {"+[NSFileHandle fileHandleForReadingAtPath:]", 43, 22, 23},
+    {"+[NSJSONSerialization dataWithJSONObject:options:error:]", 56, 23, 24},
+    {"+[NSKeyedArchiver archivedDataWithRootObject:]", 46, 24, 25},
+    {"+[NSMutableData dataWithBytes:length:]", 38, 25, 26},
+    {"+[NSMutableData dataWithBytesNoCopy:length:freeWhenDone:]", 57, 26, 27},
+    {"+[NSMutableData dataWithCapacity:]", 34, 27, 28},
+    {"+[NSMutableData dataWithContentsOfFile:]", 40, 28, 29},
+    {"+[NSMutableData dataWithContentsOfFile:options:error:]", 54, 29, 30},
+    {"+[NSMutableData dataWithContentsOfURL:]", 39, 30, 31},
+    {"+[NSMutableData dataWithData:]", 30, 31, 32},
+    {"+[NSMutableData dataWithLength:]", 32, 32, 33},
+    {"+[NSMutableData data]", 21, 33, 34},
+    {"+[NSMutableDictionary dictionaryWithContentsOfFile:]", 52, 34, 35},
+    {"+[NSMutableDictionary dictionaryWithDictionary:]", 48, 35, 36},
+    {"+[NSMutableDictionary dictionaryWithObject:forKey:]", 51, 36, 37},
+    {"+[NSMutableDictionary dictionaryWithObjectsAndKeys:]", 52, 37, 38},
+    {"+[NSMutableDictionary dictionary]", 33, 38, 39},
+    {"+[NSMutableString stringWithCapacity:]", 38, 39, 40},
+    {"+[NSMutableString stringWithCharacters:length:]", 47, 40, 41},
+    {"+[NSMutableString stringWithString:]", 36, 41, 42},
+    {"+[NSMutableString stringWithUTF8String:]", 40, 42, 43},
+    {"+[NSMutableString string]", 25, 43, 44},
+    {"+[NSNull null]", 14, 44, 45},
+    {"+[NSNumber numberWithInt:]", 26, 45, 46},
+    {"+[NSString stringWithCString:]", 30, 46, 47},
+    {"+[NSString stringWithCString:encoding:]", 39, 47, 49},
+    {"+[NSString stringWithCharacters:length:]", 40, 49, 50},
+    {"+[NSString stringWithContentsOfFile:encoding:error:]", 52, 50, 51},
+    {"+[NSString stringWithFormat:]", 29, 51, 52},
+    {"+[NSString stringWithString:]", 29, 52, 53},
+    {"+[NSString stringWithUTF8String:]", 33, 53, 54},
+    {"+[NSString string]", 18, 54, 55},
+    {"+[UIApplication sharedApplication]", 34, 55, 56},
+    {"-[NSArray objectAtIndex:]", 25, 56, 57},
+    {"-[NSArray objectAtIndexedSubscript:]", 36, 57, 58},
+    {"-[NSData bytes]", 15, 58, 59},
+    {"-[NSData copy]", 14, 59, 60},
+    {"-[NSData getBytes:length:]", 26, 60, 61},
+    {"-[NSData getBytes:range:]", 25, 61, 62},
+    {"-[NSData initWithBase64EncodedData:options:]", 44, 62, 63},
+    {"-[NSData initWithBase64EncodedString:options:]", 46, 63, 65},
+    {"-[NSData initWithBytes:length:]", 31, 65, 67},
+    {"-[NSData initWithContentsOfFile:]", 33, 67, 68},
+    {"-[NSData initWithData:]", 23, 68, 69},
+    {"-[NSData init]", 14, 69, 70},
+    {"-[NSData isEqual:]", 18, 70, 71},
+    {"-[NSData length]", 16, 71, 72},
+    {"-[NSData mutableCopy]", 21, 72, 73},
+    {"-[NSData subdataWithRange:]", 27, 73, 74},
+    {"-[NSData writeToFile:options:error:]", 36, 74, 75},
+    {"-[NSDictionary initWithObjectsAndKeys:]", 39, 75, 76},
+    {"-[NSDictionary init]", 20, 76, 77},
+    {"-[NSDictionary objectForKey:]", 29, 77, 79},
+    {"-[NSDictionary setObject:forKey:]", 33, 79, 80},
+    {"-[NSDictionary setValue:forKey:]", 32, 80, 81},
+    {"-[NSDictionary valueForKey:]", 28, 81, 83},
+    {"-[NSFileHandle readDataOfLength:]", 33, 83, 84},
+    {"-[NSMutableData appendBytes:length:]", 36, 84, 85},
+    {"-[NSMutableData appendData:]", 28, 85, 86},
+    {"-[NSMutableData init]", 21, 86, 87},
+    {"-[NSMutableData mutableBytes]", 29, 87, 88},
+    {"-[NSMutableData setLength:]", 27, 88, 89},
+    {"-[NSMutableDictionary init]", 27, 89, 90},
+    {"-[NSMutableString copy]", 23, 90, 91},
+    {"-[NSNumber integerValue]", 24, 91, 92},
+    {"-[NSObject autorelease]", 23, 92, 93},
+    {"-[NSObject dealloc]", 19, 93, 94},
+    {"-[NSObject init]", 16, 94, 95},
+    {"-[NSObject release]", 19, 95, 96},
+    {"-[NSObject respondsToSelector:]", 31, 96, 97},
+    {"-[NSObject retain]", 18, 97, 98},
+    {"-[NSString UTF8String]", 22, 98, 99},
+    {"-[NSString cStringUsingEncoding:]", 33, 99, 100},
+    {"-[NSString componentsSeparatedByString:]", 40, 100, 101},
+    {"-[NSString copy]", 16, 101, 102},
+    {"-[NSString dataUsingEncoding:]", 30, 102, 103},
+    {"-[NSString getBytes:maxLength:usedLength:encoding:options:range:remainingRange:]", 80, 103, 104},
+    {"-[NSString getCString:maxLength:encoding:]", 42, 104, 105},
+    {"-[NSString initWithBytes:length:encoding:]", 42, 105, 106},
+    {"-[NSString initWithData:encoding:]", 34, 106, 108},
+    {"-[NSString initWithFormat:]", 27, 108, 109},
+    {"-[NSString initWithString:]", 27, 109, 110},
+    {"-[NSString intValue]", 20, 110, 111},
+    {"-[NSString integerValue]", 24, 111, 112},
+    {"-[NSString lowercaseString]", 27, 112, 113},
+    {"-[NSString stringByAppendingString:]", 36, 113, 114},
+    {"-[NSString stringByTrimmingCharactersInSet:]", 44, 114, 115},
+    {"-[NSUserDefaults objectForKey:]", 31, 115, 116},
+    {"-[NSUserDefaults setObject:forKey:]", 35, 116, 117},
+    {"-[UIAlertView textFieldAtIndex:]", 32, 117, 118},
+    {"-[UILabel text]", 15, 118, 119},
+    {"-[UITableViewController init]", 29, 119, 120},
+    {"-[UITextField text]", 19, 120, 121},
+    {"-[UITextView text]", 18, 121, 122},
+    {"-[UIView initWithFrame:]", 24, 122, 123},
+    {"-[UIViewController initWithNibName:bundle:]", 43, 123, 124},
+    {"CCCalibratePBKDF", 16, 124, 125},
+    {"CCCrypt", 7, 125, 126},
+    {"CCCryptorCreate", 15, 126, 127},
+    {"CCCryptorCreateWithMode", 23, 127, 128},
+    {"CCCryptorUpdate", 15, 128, 129},
+    {"CCKeyDerivationPBKDF", 20, 129, 130},
+    {"CC_MD5", 6, 130, 131},
+    {"CC_SHA256", 9, 131, 132},
+    {"CC_SHA256_Final", 15, 132, 133},
+    {"CC_SHA256_Init", 14, 133, 134},
+    {"CC_SHA256_Update", 16, 134, 135},
+    {"NSLog", 5, 135, 136},
+    {"SecRandomCopyBytes", 18, 136, 137},
+    {"_Znam", 5, 137, 138},
+    {"_Znwm", 5, 138, 139},
+    {"_ZnwmRKSt9nothrow_t", 19, 139, 140},
+    {"__stack_chk_fail", 16, 140, 141},
+    {"arc4random", 10, 141, 142},
+    {"bzero", 5, 142, 143},
+    {"malloc", 6, 143, 144},
+    {"memcpy", 6, 144, 145},
+    {"objc_autorelease", 16, 145, 146},
+    {"objc_autoreleaseReturnValue", 27, 146, 147},
+    {"objc_begin_catch", 16, 147, 148},
+    {"objc_destroyWeak", 16, 148, 149},
+    {"objc_end_catch", 14, 149, 150},
+    {"objc_enumerationMutation", 24, 150, 151},
+    {"objc_exception_rethrow", 22, 151, 152},
+    {"objc_exception_throw", 20, 152, 153},
+    {"objc_getClass", 13, 153, 154},
+    {"objc_getProperty", 16, 154, 155},
+    {"objc_loadWeakRetained", 21, 155, 156},
+    {"objc_release", 12, 156, 157},
+    {"objc_retain", 11, 157, 158},
+    {"objc_retainAutorelease", 22, 158, 159},
+    {"objc_retainAutoreleaseReturnValue", 33, 159, 160},
+    {"objc_retainAutoreleasedReturnValue", 34, 160, 161},
+    {"objc_setProperty", 16, 161, 162},
+    {"objc_setProperty_atomic", 23, 162, 163},
+    {"objc_setProperty_nonatomic", 26, 163, 164},
+    {"objc_setProperty_nonatomic_copy", 31, 164, 165},
+    {"objc_storeStrong", 16, 165, 166},
+    {"objc_storeWeak", 14, 166, 167},
+    {"objc_sync_enter", 15, 167, 168},
+    {"objc_sync_exit", 14, 168, 169},
+    {"objc_terminate", 14, 169, 170},
+    {"open", 4, 170, 171},
+    {"read", 4, 171, 172},
+};
+
+void (*const ExternalHandlers[])(llvm::beta::InsInfo *,
+                                 const ptr::PointsToSets &) = {
+    anonymous_731,
+    anonymous_734,
+    anonymous_735,
+    anonymous_736,
+    anonymous_923,
+    anonymous_915,
+    anonymous_924,
+    anonymous_33,
+    anonymous_46,
+    anonymous_67,
+    anonymous_80,
+    anonymous_93,
+    anonymous_106,
+    anonymous_119,
+    anonymous_59,
+    anonymous_383,
+    anonymous_410,
+    anonymous_389,
+    anonymous_416,
+    anonymous_422,
+    anonymous_398,
+    anonymous_404,
+    anonymous_1008,
+    anonymous_482,
+    anonymous_1115,
+    anonymous_149,
+    anonymous_170,
+    anonymous_235,
+    anonymous_183,
+    anonymous_196,
+    anonymous_209,
+    anonymous_222,
+    anonymous_243,
+    anonymous_162,
+    anonymous_449,
+    anonymous_476,
+    anonymous_455,
+    anonymous_464,
+    anonymous_470,
+    anonymous_757,
+    anonymous_372,
+    anonymous_361,
+    anonymous_763,
+    anonymous_764,
+    anonymous_1095,
+    anonymous_977,
+    anonymous_277,
+    anonymous_765,
+    anonymous_774,
+    anonymous_288,
+    anonymous_771,
+    anonymous_772,
+    anonymous_266,
+    anonymous_773,
+    anonymous_260,
+    anonymous_1098,
+    anonymous_737,
+    anonymous_747,
+    anonymous_488,
+    anonymous_834,
+    anonymous_517,
+    anonymous_500,
+    anonymous_790,
+    anonymous_794,
+    anonymous_810,
+    anonymous_789,
+    anonymous_801,
+    anonymous_791,
+    anonymous_792,
+    anonymous_793,
+    anonymous_145,
+    anonymous_577,
+    anonymous_132,
+    anonymous_537,
+    anonymous_148,
+    anonymous_428,
+    anonymous_799,
+    anonymous_1127,
+    anonymous_435,
+    anonymous_1131,
+    anonymous_1142,
+    anonymous_1138,
+    anonymous_442,
+    anonymous_1019,
+    anonymous_565,
+    anonymous_553,
+    anonymous_788,
+    anonymous_251,
+    anonymous_550,
+    anonymous_798,
+    anonymous_825,
+    anonymous_987,
+    anonymous_23,
+    anonymous_26,
+    anonymous_781,
+    anonymous_25,
+    anonymous_27,
+    anonymous_22,
+    anonymous_718,
+    anonymous_341,
+    anonymous_1069,
+    anonymous_816,
+    anonymous_580,
+    anonymous_332,
+    anonymous_323,
+    anonymous_795,
+    anonymous_299,
+    anonymous_796,
+    anonymous_797,
+    anonymous_311,
+    anonymous_993,
+    anonymous_999,
+    anonymous_350,
+    anonymous_1057,
+    anonymous_1048,
+    anonymous_1101,
+    anonymous_1108,
+    anonymous_1121,
+    anonymous_1042,
+    anonymous_800,
+    anonymous_1030,
+    anonymous_1036,
+    anonymous_1081,
+    anonymous_1088,
+    anonymous_621,
+    anonymous_631,
+    anonymous_626,
+    anonymous_627,
+    anonymous_632,
+    anonymous_604,
+    anonymous_951,
+    anonymous_958,
+    anonymous_857,
+    anonymous_843,
+    anonymous_847,
+    anonymous_925,
+    anonymous_870,
+    anonymous_936,
+    anonymous_941,
+    anonymous_946,
+    anonymous_926,
+    anonymous_864,
+    anonymous_907,
+    anonymous_1005,
+    anonymous_593,
+    anonymous_18,
+    anonymous_17,
+    anonymous_935,
+    anonymous_933,
+    anonymous_934,
+    anonymous_927,
+    anonymous_931,
+    anonymous_932,
+    anonymous_898,
+    anonymous_654,
+    anonymous_704,
+    anonymous_24,
+    anonymous_8,
+    anonymous_21,
+    anonymous_20,
+    anonymous_19,
+    anonymous_692,
+    anonymous_680,
+    anonymous_668,
+    anonymous_645,
+    anonymous_878,
+    anonymous_888,
+    anonymous_930,
+    anonymous_929,
+    anonymous_928,
+    anonymous_971,
+    anonymous_965,
+    // Keeps the table non-empty.
+    nullptr,
+};
+
+const ExternalCall *findExternalCall(StringRef FName) {
+  const ExternalCall *Begin = std::begin(ExternalCalls);
+  const ExternalCall *End = std::end(ExternalCalls);
+  const ExternalCall *It = std::lower_bound(
+      Begin, End, FName, [](const ExternalCall &C, StringRef Name) {
+        return StringRef(C.Name, C.Length) < Name;
+      });
+  if (It == End || StringRef(It->Name, It->Length) != FName)
+    return nullptr;
+  return It;
+}
+} // namespace
+
 bool handleCall(llvm::beta::InsInfo *CallInst, std::string FName, const ptr::PointsToSets &PS) {
-  if (FName == "+[NSArray arrayWithArray:]") {
-    anonymous_731(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSArray arrayWithObject:]") {
-    anonymous_734(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSArray arrayWithObjects:]") {
-    anonymous_735(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSArray array]") {
-    anonymous_736(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSBundle bundleForClass:]") {
-    anonymous_923(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSBundle bundleWithPath:]") {
-    anonymous_915(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSBundle mainBundle]") {
-    anonymous_924(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSData dataWithBytes:length:]") {
-    anonymous_33(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSData dataWithBytesNoCopy:length:]") {
-    anonymous_46(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSData dataWithBytesNoCopy:length:freeWhenDone:]") {
-    anonymous_67(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSData dataWithContentsOfFile:]") {
-    anonymous_80(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSData dataWithContentsOfFile:options:error:]") {
-    anonymous_93(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSData dataWithContentsOfURL:]") {
-    anonymous_106(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSData dataWithData:]") {
-    anonymous_119(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSData data]") {
-    anonymous_59(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSDictionary dictionaryWithContentsOfFile:]") {
-    anonymous_383(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSDictionary dictionaryWithDictionary:]") {
-    anonymous_410(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSDictionary dictionaryWithObject:forKey:]") {
-    anonymous_389(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSDictionary dictionaryWithObjects:forKeys:]") {
-    anonymous_416(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSDictionary dictionaryWithObjects:forKeys:count:]") {
-    anonymous_422(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSDictionary dictionaryWithObjectsAndKeys:]") {
-    anonymous_398(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSDictionary dictionary]") {
-    anonymous_404(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSFileHandle fileHandleForReadingAtPath:]") {
-    anonymous_1008(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSJSONSerialization dataWithJSONObject:options:error:]") {
-    anonymous_482(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSKeyedArchiver archivedDataWithRootObject:]") {
-    anonymous_1115(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSMutableData dataWithBytes:length:]") {
-    anonymous_149(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSMutableData dataWithBytesNoCopy:length:freeWhenDone:]") {
-    anonymous_170(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSMutableData dataWithCapacity:]") {
-    anonymous_235(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSMutableData dataWithContentsOfFile:]") {
-    anonymous_183(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSMutableData dataWithContentsOfFile:options:error:]") {
-    anonymous_196(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSMutableData dataWithContentsOfURL:]") {
-    anonymous_209(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSMutableData dataWithData:]") {
-    anonymous_222(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSMutableData dataWithLength:]") {
-    anonymous_243(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSMutableData data]") {
-    anonymous_162(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSMutableDictionary dictionaryWithContentsOfFile:]") {
-    anonymous_449(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSMutableDictionary dictionaryWithDictionary:]") {
-    anonymous_476(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSMutableDictionary dictionaryWithObject:forKey:]") {
-    anonymous_455(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSMutableDictionary dictionaryWithObjectsAndKeys:]") {
-    anonymous_464(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSMutableDictionary dictionary]") {
-    anonymous_470(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSMutableString stringWithCapacity:]") {
-    anonymous_757(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSMutableString stringWithCharacters:length:]") {
-    anonymous_372(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSMutableString stringWithString:]") {
-    anonymous_361(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSMutableString stringWithUTF8String:]") {
-    anonymous_763(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSMutableString string]") {
-    anonymous_764(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSNull null]") {
-    anonymous_1095(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSNumber numberWithInt:]") {
-    anonymous_977(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSString stringWithCString:]") {
-    anonymous_277(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSString stringWithCString:encoding:]") {
-    anonymous_765(CallInst, PS);
-    anonymous_774(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSString stringWithCharacters:length:]") {
-    anonymous_288(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSString stringWithContentsOfFile:encoding:error:]") {
-    anonymous_771(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSString stringWithFormat:]") {
-    anonymous_772(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSString stringWithString:]") {
-    anonymous_266(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSString stringWithUTF8String:]") {
-    anonymous_773(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[NSString string]") {
-    anonymous_260(CallInst, PS);
-    return true;
-  }
-  if (FName == "+[UIApplication sharedApplication]") {
-    anonymous_1098(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSArray objectAtIndex:]") {
-    anonymous_737(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSArray objectAtIndexedSubscript:]") {
-    anonymous_747(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSData bytes]") {
-    anonymous_488(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSData copy]") {
-    anonymous_834(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSData getBytes:length:]") {
-    anonymous_517(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSData getBytes:range:]") {
-    anonymous_500(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSData initWithBase64EncodedData:options:]") {
-    anonymous_790(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSData initWithBase64EncodedString:options:]") {
-    anonymous_794(CallInst, PS);
-    anonymous_810(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSData initWithBytes:length:]") {
-    anonymous_789(CallInst, PS);
-    anonymous_801(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSData initWithContentsOfFile:]") {
-    anonymous_791(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSData initWithData:]") {
-    anonymous_792(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSData init]") {
-    anonymous_793(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSData isEqual:]") {
-    anonymous_145(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSData length]") {
-    anonymous_577(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSData mutableCopy]") {
-    anonymous_132(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSData subdataWithRange:]") {
-    anonymous_537(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSData writeToFile:options:error:]") {
-    anonymous_148(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSDictionary initWithObjectsAndKeys:]") {
-    anonymous_428(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSDictionary init]") {
-    anonymous_799(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSDictionary objectForKey:]") {
-    anonymous_1127(CallInst, PS);
-    anonymous_435(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSDictionary setObject:forKey:]") {
-    anonymous_1131(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSDictionary setValue:forKey:]") {
-    anonymous_1142(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSDictionary valueForKey:]") {
-    anonymous_1138(CallInst, PS);
-    anonymous_442(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSFileHandle readDataOfLength:]") {
-    anonymous_1019(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSMutableData appendBytes:length:]") {
-    anonymous_565(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSMutableData appendData:]") {
-    anonymous_553(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSMutableData init]") {
-    anonymous_788(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSMutableData mutableBytes]") {
-    anonymous_251(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSMutableData setLength:]") {
-    anonymous_550(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSMutableDictionary init]") {
-    anonymous_798(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSMutableString copy]") {
-    anonymous_825(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSNumber integerValue]") {
-    anonymous_987(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSObject autorelease]") {
-    anonymous_23(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSObject dealloc]") {
-    anonymous_26(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSObject init]") {
-    anonymous_781(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSObject release]") {
-    anonymous_25(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSObject respondsToSelector:]") {
-    anonymous_27(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSObject retain]") {
-    anonymous_22(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSString UTF8String]") {
-    anonymous_718(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSString cStringUsingEncoding:]") {
-    anonymous_341(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSString componentsSeparatedByString:]") {
-    anonymous_1069(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSString copy]") {
-    anonymous_816(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSString dataUsingEncoding:]") {
-    anonymous_580(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSString getBytes:maxLength:usedLength:encoding:options:range:remainingRange:]") {
-    anonymous_332(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSString getCString:maxLength:encoding:]") {
-    anonymous_323(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSString initWithBytes:length:encoding:]") {
-    anonymous_795(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSString initWithData:encoding:]") {
-    anonymous_299(CallInst, PS);
-    anonymous_796(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSString initWithFormat:]") {
-    anonymous_797(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSString initWithString:]") {
-    anonymous_311(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSString intValue]") {
-    anonymous_993(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSString integerValue]") {
-    anonymous_999(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSString lowercaseString]") {
-    anonymous_350(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSString stringByAppendingString:]") {
-    anonymous_1057(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSString stringByTrimmingCharactersInSet:]") {
-    anonymous_1048(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSUserDefaults objectForKey:]") {
-    anonymous_1101(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[NSUserDefaults setObject:forKey:]") {
-    anonymous_1108(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[UIAlertView textFieldAtIndex:]") {
-    anonymous_1121(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[UILabel text]") {
-    anonymous_1042(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[UITableViewController init]") {
-    anonymous_800(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[UITextField text]") {
-    anonymous_1030(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[UITextView text]") {
-    anonymous_1036(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[UIView initWithFrame:]") {
-    anonymous_1081(CallInst, PS);
-    return true;
-  }
-  if (FName == "-[UIViewController initWithNibName:bundle:]") {
-    anonymous_1088(CallInst, PS);
-    return true;
-  }
-  if (FName == "CCCalibratePBKDF") {
-    anonymous_621(CallInst, PS);
-    return true;
-  }
-  if (FName == "CCCrypt") {
-    anonymous_631(CallInst, PS);
-    return true;
-  }
-  if (FName == "CCCryptorCreate") {
-    anonymous_626(CallInst, PS);
-    return true;
-  }
-  if (FName == "CCCryptorCreateWithMode") {
-    anonymous_627(CallInst, PS);
-    return true;
-  }
-  if (FName == "CCCryptorUpdate") {
-    anonymous_632(CallInst, PS);
-    return true;
-  }
-  if (FName == "CCKeyDerivationPBKDF") {
-    anonymous_604(CallInst, PS);
-    return true;
-  }
-  if (FName == "CC_MD5") {
-    anonymous_951(CallInst, PS);
-    return true;
-  }
-  if (FName == "CC_SHA256") {
-    anonymous_958(CallInst, PS);
-    return true;
-  }
-  if (FName == "CC_SHA256_Final") {
-    anonymous_857(CallInst, PS);
-    return true;
-  }
-  if (FName == "CC_SHA256_Init") {
-    anonymous_843(CallInst, PS);
-    return true;
-  }
-  if (FName == "CC_SHA256_Update") {
-    anonymous_847(CallInst, PS);
-    return true;
-  }
-  if (FName == "NSLog") {
-    anonymous_925(CallInst, PS);
-    return true;
-  }
-  if (FName == "SecRandomCopyBytes") {
-    anonymous_870(CallInst, PS);
-    return true;
-  }
-  if (FName == "_Znam") {
-    anonymous_936(CallInst, PS);
-    return true;
-  }
-  if (FName == "_Znwm") {
-    anonymous_941(CallInst, PS);
-    return true;
-  }
-  if (FName == "_ZnwmRKSt9nothrow_t") {
-    anonymous_946(CallInst, PS);
-    return true;
-  }
-  if (FName == "__stack_chk_fail") {
-    anonymous_926(CallInst, PS);
-    return true;
-  }
-  if (FName == "arc4random") {
-    anonymous_864(CallInst, PS);
-    return true;
-  }
-  if (FName == "bzero") {
-    anonymous_907(CallInst, PS);
-    return true;
-  }
-  if (FName == "malloc") {
-    anonymous_1005(CallInst, PS);
-    return true;
-  }
-  if (FName == "memcpy") {
-    anonymous_593(CallInst, PS);
-    return true;
-  }
-  if (FName == "objc_autorelease") {
-    anonymous_18(CallInst, PS);
-    return true;
-  }
-  if (FName == "objc_autoreleaseReturnValue") {
-    anonymous_17(CallInst, PS);
-    return true;
-  }
-  if (FName == "objc_begin_catch") {
-    anonymous_935(CallInst, PS);
-    return true;
-  }
-  if (FName == "objc_destroyWeak") {
-    anonymous_933(CallInst, PS);
-    return true;
-  }
-  if (FName == "objc_end_catch") {
-    anonymous_934(CallInst, PS);
-    return true;
-  }
-  if (FName == "objc_enumerationMutation") {
-    anonymous_927(CallInst, PS);
-    return true;
-  }
-  if (FName == "objc_exception_rethrow") {
-    anonymous_931(CallInst, PS);
-    return true;
-  }
-  if (FName == "objc_exception_throw") {
-    anonymous_932(CallInst, PS);
-    return true;
-  }
-  if (FName == "objc_getClass") {
-    anonymous_898(CallInst, PS);
-    return true;
-  }
-  if (FName == "objc_getProperty") {
-    anonymous_654(CallInst, PS);
-    return true;
-  }
-  if (FName == "objc_loadWeakRetained") {
-    anonymous_704(CallInst, PS);
-    return true;
-  }
-  if (FName == "objc_release") {
-    anonymous_24(CallInst, PS);
-    return true;
-  }
-  if (FName == "objc_retain") {
-    anonymous_8(CallInst, PS);
-    return true;
-  }
-  if (FName == "objc_retainAutorelease") {
-    anonymous_21(CallInst, PS);
-    return true;
-  }
-  if (FName == "objc_retainAutoreleaseReturnValue") {
-    anonymous_20(CallInst, PS);
-    return true;
-  }
-  if (FName == "objc_retainAutoreleasedReturnValue") {
-    anonymous_19(CallInst, PS);
-    return true;
-  }
-  if (FName == "objc_setProperty") {
-    anonymous_692(CallInst, PS);
-    return true;
-  }
-  if (FName == "objc_setProperty_atomic") {
-    anonymous_680(CallInst, PS);
-    return true;
-  }
-  if (FName == "objc_setProperty_nonatomic") {
-    anonymous_668(CallInst, PS);
-    return true;
-  }
-  if (FName == "objc_setProperty_nonatomic_copy") {
-    anonymous_645(CallInst, PS);
-    return true;
-  }
-  if (FName == "objc_storeStrong") {
-    anonymous_878(CallInst, PS);
-    return true;
-  }
-  if (FName == "objc_storeWeak") {
-    anonymous_888(CallInst, PS);
-    return true;
-  }
-  if (FName == "objc_sync_enter") {
-    anonymous_930(CallInst, PS);
-    return true;
-  }
-  if (FName == "objc_sync_exit") {
-    anonymous_929(CallInst, PS);
-    return true;
-  }
-  if (FName == "objc_terminate") {
-    anonymous_928(CallInst, PS);
-    return true;
-  }
-  if (FName == "open") {
-    anonymous_971(CallInst, PS);
-    return true;
-  }
-  if (FName == "read") {
-    anonymous_965(CallInst, PS);
-    return true;
-  }
-  return false;
+  const ExternalCall *Call = findExternalCall(FName);
+  if (!Call)
+    return false;
+  for (unsigned i = Call->Begin; i != Call->End; ++i)
+    ExternalHandlers[i](CallInst, PS);
+  return true;
 }
 
 }
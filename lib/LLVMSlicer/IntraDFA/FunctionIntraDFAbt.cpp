@@ -580,11 +580,12 @@ InsInfo::InsInfo(const Instruction *i, const ptr::PointsToSets &PS,
                 if (!SAP)
                   SAP = &ptr::getAndersen()->getAnalysis<StackAccessPass>();
 
-                for (auto &baseStackOffset_it : *SAP->getOffsets(f)[baseInst]) {
+                const StackAccessPass::OffsetValueListMap_t &OffsetValues =
+                    SAP->getOffsetValues(f);
+                for (auto &baseStackOffset_it :
+                     SAP->getOffsets(f).lookup(baseInst)) {
                   int64_t targetOffset = baseStackOffset_it + offset;
-                  if (!SAP->getOffsetValues(f)[targetOffset])
-                    continue;
-                  for (auto &target : *SAP->getOffsetValues(f)[targetOffset]) {
+                  for (auto &target : OffsetValues.lookup(targetOffset)) {
                     ptr::PointsToSets::PointsToSet PtsTo =
                         ptr::getPointsToSet(target, PS);
                     for (auto &PtsTo_it : PtsTo) {
@@ -944,15 +945,13 @@ InsInfo::InsInfo(const Instruction *i, const ptr::PointsToSets &PS,
                 int64_t hi = p_it.second + size->getZExtValue();
 
                 Function *f = (Function *)p_it.first;
-                StackAccessPass::OffsetValueListMap_t &OffsetValues =
+                const StackAccessPass::OffsetValueListMap_t &OffsetValues =
                     andersen->getAnalysis<StackAccessPass>().getOffsetValues(f);
                 for (auto &O_it : OffsetValues) {
                   if (O_it.first <= lo || O_it.first >= hi)
                     continue;
 
-                  if (!O_it.second)
-                    continue;
-                  for (auto &V_it : *O_it.second) {
+                  for (auto &V_it : O_it.second) {
                     ptr::PointsToSets::PointsToSet defPtsTo =
                         ptr::getPointsToSet(V_it, PS);
                     for (auto &def_it : defPtsTo) {
@@ -1301,11 +1300,12 @@ bool FunctionIntraDFA::computeRCi(InsInfo *insInfoi, InsInfo *insInfoj) {
               if (!SAP)
                 SAP = &ptr::getAndersen()->getAnalysis<StackAccessPass>();
 
-              for (auto &baseStackOffset_it : *SAP->getOffsets(f)[baseInst]) {
+              const StackAccessPass::OffsetValueListMap_t &OffsetValues =
+                  SAP->getOffsetValues(f);
+              for (auto &baseStackOffset_it :
+                   SAP->getOffsets(f).lookup(baseInst)) {
                 int64_t targetOffset = baseStackOffset_it + offset;
-                if (!SAP->getOffsetValues(f)[targetOffset])
-                  continue;
-                for (auto &target : *SAP->getOffsetValues(f)[targetOffset]) {
+                for (auto &target : OffsetValues.lookup(targetOffset)) {
                   ptr::PointsToSets::PointsToSet PtsTo =
                       ptr::getPointsToSet(target, PS);
                   for (auto &PtsTo_it : PtsTo) {
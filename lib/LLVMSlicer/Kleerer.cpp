@@ -419,7 +419,7 @@ bool Kleerer::run() {
   if (!F__assert_fail) /* nothing to find here bro */
     return false;
 
-  callgraph::Callgraph::range_iterator RI = CG.callees(F__assert_fail);
+  callgraph::Callgraph::closure_range RI = CG.callees(F__assert_fail);
   if (std::distance(RI.first, RI.second) == 0)
     return false;
 
@@ -432,7 +432,7 @@ bool Kleerer::run() {
     assert(CE->getOpcode() == Instruction::BitCast);
     Function &F = *cast<Function>(CE->getOperand(0));
 
-    callgraph::Callgraph::const_iterator II, EE;
+    callgraph::Callgraph::closure_iterator II, EE;
     std::tie(II, EE) = CG.calls(&F);
     for (; II != EE; ++II) {
       const Function *callee = (*II).second;
@@ -289,7 +289,7 @@ void StatsComputer::run() {
     assert(CE->getOpcode() == Instruction::BitCast);
     const Function &F = *cast<Function>(CE->getOperand(0));
     FunInfo *funInfo = modInfo.getFunInfo(&F);
-    callgraph::Callgraph::const_iterator II, EE;
+    callgraph::Callgraph::closure_iterator II, EE;
     std::tie(II, EE) = CG.calls(&F);
 #ifdef DEBUG_NESTED
     errs() << "at " << F.getName() << " flags [" << getFlags(funInfo) << "]\n";
@@ -3,9 +3,12 @@
 
 #include <algorithm>
 #include <iterator>
+#include <mutex>
 #include <llvm/Analysis/Andersen/StackAccessPass.h>
 #include <llvm/IR/PatternMatch.h>
 
+#include "llvm/Analysis/Andersen/ExternalModel.h"
+#include "llvm/Analysis/Andersen/ParallelFor.h"
 #include "llvm/IR/Constant.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Instructions.h"
@@ -31,35 +34,36 @@ getMemcpyDefs(const Instruction *call, const ptr::PointsToSets &PS) {
 
   Andersen *andersen = ptr::getAndersen();
 
-  Andersen::StackOffsetMap_t stackOffsetMap = andersen->getStackOffsets();
+  const Andersen::StackOffsetMap_t &stackOffsetMap =
+      andersen->getStackOffsets();
 
   for (auto &X2_it : X2_pre) {
     if (const ConstantInt *size = dyn_cast<const ConstantInt>(X2_it)) {
 
       for (auto &X0_it : X0_pre) {
 
-        ptr::PointsToSets::PointsToSet X0_ptsTo =
+        const ptr::PointsToSets::PointsToSet &X0_ptsTo =
             ptr::getPointsToSet(X0_it, PS);
 
         for (auto &X0pts_it : X0_ptsTo) {
-          auto &pairs = stackOffsetMap[X0pts_it.first];
+          auto pairs = stackOffsetMap.find(X0pts_it.first);
+          if (pairs == stackOffsetMap.end())
+            continue;
 
-          for (auto &p_it : pairs) {
+          for (auto &p_it : pairs->second) {
 
             int64_t lo = p_it.second;
             int64_t hi = p_it.second + size->getZExtValue();
 
             Function *f = (Function *)p_it.first;
-            StackAccessPass::OffsetValueListMap_t &OffsetValues =
+            const StackAccessPass::OffsetValueListMap_t &OffsetValues =
                 andersen->getAnalysis<StackAccessPass>().getOffsetValues(f);
             for (auto &O_it : OffsetValues) {
               if (O_it.first <= lo || O_it.first >= hi)
                 continue;
 
-              if (!O_it.second)
-                continue;
-              for (auto &V_it : *O_it.second) {
-                ptr::PointsToSets::PointsToSet defPtsTo =
+              for (auto &V_it : O_it.second) {
+                const ptr::PointsToSets::PointsToSet &defPtsTo =
                     ptr::getPointsToSet(V_it, PS);
                 for (auto &def_it : defPtsTo) {
                   int64_t offset = O_it.first - lo;
@@ -95,22 +99,84 @@ namespace mods {
 //          }
 //  }
 
+static cl::opt<unsigned>
+    ModsThreads("mods-threads",
+                cl::desc("Number of threads used to compute mod sets "
+                         "(0 = number of hardware threads)"),
+                cl::init(0), cl::Hidden);
+
+static DetectParametersPass *getDPP() {
+  DetectParametersPass *DPP =
+      ptr::getAndersen()->getAnalysisIfAvailable<DetectParametersPass>();
+  if (!DPP)
+    DPP = &ptr::getAndersen()->getAnalysis<DetectParametersPass>();
+  return DPP;
+}
+
+/*
+ * Adds the definitions of an external function through its pointer
+ * arguments. Uses the -external-models file if one was given, the generated
+ * handlers otherwise. The model is only read, so this runs on every worker.
+ */
+static void handleExternalCall(Instruction *I, const ptr::PointsToSets &PS,
+                               const std::string &FName,
+                               ProgramStructure::Commands &commands,
+                               std::mutex &lock) {
+  const ExternalModel *Model = ExternalModel::get();
+  if (!Model) {
+    handleCall(I, PS, FName, commands, lock);
+    return;
+  }
+  const ExternalModel::Function *F = Model->lookup(FName);
+  if (!F)
+    return;
+
+  auto PointsTo = [&PS](const Value *V, ExternalModel::UserSet_t &Out) {
+    for (auto &P : ptr::getPointsToSet(V, PS)) {
+      Out.insert(const_cast<User *>(cast<User>(P.first)));
+    }
+  };
+  for (const ExternalModel::Operation &Op : F->SliceOps) {
+    if (Op.Kind != ExternalModel::DEF && Op.Kind != ExternalModel::DEF_MOD)
+      continue;
+    // Only definitions through memory are modifications.
+    if (!Model->isPointsTo(Op.A))
+      continue;
+    ExternalModel::UserSet_t Defs;
+    Model->evaluate(Op.A, I, nullptr, PointsTo, Defs);
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto D : Defs)
+      commands.push_back(ProgramStructure::Command(
+          Op.Kind == ExternalModel::DEF_MOD ? CMD_FRC_DEF : CMD_DEF, D));
+  }
+}
+
 ProgramStructure::ProgramStructure(Module &M,
                                    const llvm::ptr::PointsToSets &PS) {
   errs() << "[+]init mods::ProgramStructure\n";
-  auto task = [&](Module::iterator &f, inst_iterator &i) {
-    SimpleCallGraph::FunctionSet_t &called =
-        ptr::getAndersen()->getCallGraph().getCalled(&*i);
-    for (auto &functioNName : called) {
-      // errs() << "[+]Program Structure functionName: "
-      //        << *(std::string *)&functioNName << "\n";
-      handleCall(&*i, PS, *(std::string *)&functioNName,
-                 this->getContainer()[&*f], lockC);
-    }
-  };
+
+  DetectParametersPass *DPP = getDPP();
+  const SimpleCallGraph &CallGraph = ptr::getAndersen()->getCallGraph();
+
+  // The lookups below insert on a miss, so fill them in before the workers
+  // start. Afterwards they are only read.
+  std::vector<Function *> functions;
   for (Module::iterator f = M.begin(); f != M.end(); ++f) {
-    // errs() << "[+]programStructure f: " << f->getName() << "\n";
-    if (!f->isDeclaration() && !memoryManStuff(&*f)) {
+    functions.push_back(&*f);
+    DPP->getParameterRegisterIndexes(&*f);
+    DPP->getReturnRegisterIndexes(&*f);
+  }
+
+  // Every function is scanned on its own into a local command list, only
+  // publishing the result needs the lock.
+  auto task = [&](size_t idx) {
+    Function *f = functions[idx];
+    Commands commands;
+    std::mutex commandsLock;
+    bool hasEntry = false;
+
+    if (!f->isDeclaration() && !memoryManStuff(f)) {
+      ptr::prefetchPointsToSets(*f);
       for (inst_iterator i = inst_begin(*f); i != inst_end(*f); ++i) {
         if (const StoreInst *s = dyn_cast<StoreInst>(&*i)) {
           //                            const Value *l =
@@ -124,36 +190,35 @@ ProgramStructure::ProgramStructure(Module &M,
                   s->getOperand(1),
                   PatternMatch::m_IntToPtr(
                       PatternMatch::m_ConstantInt(constantInt)))) {
-            if (constantInt->getZExtValue() == 4301043416) {
-              assert(true);
-            }
-            ptr::PointsToSets::PointsToSet pts =
+            const ptr::PointsToSets::PointsToSet &pts =
                 ptr::getPointsToSet(s->getOperand(1), PS);
-            for (auto &p : pts) {
-              lockC.lock();
-              this->getContainer()[&*f].push_back(
+            hasEntry = true;
+            for (auto &p : pts)
+              commands.push_back(
                   ProgramStructure::Command(CMD_FRC_DEF, p.first));
-              lockC.unlock();
-            }
           } else if (const Instruction *locationInstruction =
                          dyn_cast<const Instruction>(s->getOperand(1))) {
             if (locationInstruction->getOpcode() !=
                 Instruction::GetElementPtr) {
-              ptr::PointsToSets::PointsToSet pts =
+              const ptr::PointsToSets::PointsToSet &pts =
                   ptr::getPointsToSet(locationInstruction, PS);
-              for (auto &p : pts) {
-                lockC.lock();
-                this->getContainer()[&*f].push_back(
+              hasEntry = true;
+              for (auto &p : pts)
+                commands.push_back(
                     ProgramStructure::Command(CMD_FRC_DEF, p.first));
-                lockC.unlock();
-              }
             }
           }
           //                        } else if (const CallInst *c =
           //                        dyn_cast<const CallInst>(&*i)) {
         } else if (i->getOpcode() == Instruction::Call) {
-          //                            pool.async(task, f, i);
-          task(f, i);
+          hasEntry = true;
+          const SimpleCallGraph::FunctionSet_t *called =
+              CallGraph.findCalled(&*i);
+          if (!called)
+            continue;
+          for (auto &functioNName : *called) {
+            handleExternalCall(&*i, PS, functioNName, commands, commandsLock);
+          }
         } else if (i->getOpcode() == Instruction::Load) {
           Value *Base = nullptr;
           Instruction *IVAR = nullptr;
@@ -163,40 +228,42 @@ ProgramStructure::ProgramStructure(Module &M,
                       PatternMatch::m_Value(Base),
                       PatternMatch::m_SExt(
                           PatternMatch::m_Instruction(IVAR)))))) {
-            ptr::PointsToSets::PointsToSet pts = ptr::getPointsToSet(&*i, PS);
-            for (auto &p : pts) {
-              lockC.lock();
-              this->getContainer()[&*f].push_back(
+            const ptr::PointsToSets::PointsToSet &pts =
+                ptr::getPointsToSet(&*i, PS);
+            hasEntry = true;
+            for (auto &p : pts)
+              commands.push_back(
                   ProgramStructure::Command(CMD_FRC_DEF, p.first));
-              lockC.unlock();
-            }
           }
         }
       }
     }
 
-    DetectParametersPass *DPP =
-        ptr::getAndersen()->getAnalysisIfAvailable<DetectParametersPass>();
-    if (!DPP)
-      DPP = &ptr::getAndersen()->getAnalysis<DetectParametersPass>();
-
     DetectParametersPass::ParameterAccessPairSet_t &Ret =
         DPP->getReturnRegisterIndexes(f);
     for (auto &r : Ret) {
       if (const StoreInst *store = dyn_cast<StoreInst>(r.second)) {
-        this->getContainer()[&*f].push_back(
+        hasEntry = true;
+        commands.push_back(
             ProgramStructure::Command(CMD_DEF, store->getOperand(0)));
-        ptr::PointsToSets::PointsToSet pts =
+        const ptr::PointsToSets::PointsToSet &pts =
             ptr::getPointsToSet(store->getOperand(0), PS);
         for (auto &p : pts) {
-          this->getContainer()[&*f].push_back(
-              ProgramStructure::Command(CMD_DEF, p.first));
+          commands.push_back(ProgramStructure::Command(CMD_DEF, p.first));
         }
       } else {
         assert(false);
       }
     }
-  }
+
+    if (!hasEntry)
+      return;
+    std::lock_guard<std::mutex> guard(lockC);
+    Commands &dst = this->getContainer()[f];
+    dst.insert(dst.end(), commands.begin(), commands.end());
+  };
+
+  parallelFor(functions.size(), ModsThreads, task);
 }
 
 const Modifies::ModSet &getModSet(const llvm::Function *const &f,
@@ -277,155 +344,186 @@ const Modifies::ModSet &getModSet(const llvm::Function *const &f,
 //#endif
 //  }
 
-void computeModifies(const ProgramStructure &P, const callgraph::Callgraph &CG,
-                     const ptr::PointsToSets &PS, Modifies &MOD) {
+/*
+ * Computes the values written by the commands of a single function, without
+ * looking at its callees. The result is sorted and free of duplicates.
+ */
+static void computeLocalModifies(const ProgramStructure::value_type &f,
+                                 DetectParametersPass *DPP,
+                                 const ptr::PointsToSets &PS,
+                                 std::vector<ptr::PointsToSets::Pointee> &Out) {
   typedef ptr::PointsToSets::Pointee Pointee;
 
-  DetectParametersPass *DPP =
-      ptr::getAndersen()->getAnalysisIfAvailable<DetectParametersPass>();
-  if (!DPP)
-    DPP = &ptr::getAndersen()->getAnalysis<DetectParametersPass>();
-
-  errs() << "Compute Modifies\n";
+  std::set<const Value *> passedReferences, workSet, tmp;
 
-  for (ProgramStructure::const_iterator f = P.begin(); f != P.end(); ++f) {
-    errs() << "[+]compute modifies f: " << ((Function*)f->first)->getName() << "\n";
-    std::set<const Value *> passedReferences, workSet, tmp;
-
-    DetectParametersPass::ParameterAccessPairSet_t &regParams =
-        DPP->getParameterRegisterIndexes((Function *)f->first);
-    for (auto &regParam : regParams) {
-      ptr::PointsToSets::PointsToSet ps =
-          ptr::getPointsToSet(regParam.second, PS);
-      for (auto &p : ps) {
-        workSet.insert(p.first);
-      }
+  DetectParametersPass::ParameterAccessPairSet_t &regParams =
+      DPP->getParameterRegisterIndexes(f.first);
+  for (auto &regParam : regParams) {
+    const ptr::PointsToSets::PointsToSet &ps =
+        ptr::getPointsToSet(regParam.second, PS);
+    for (auto &p : ps) {
+      workSet.insert(p.first);
     }
+  }
 
-    //                std::set<uint64_t> SPIdx;
-    //                SPIdx.insert(4);
-    //                DetectParametersPass::ParameterAccessPairSet_t stackParams
-    //                = DPP->getStackParameters(*(Function*)f->first, SPIdx);
-    //                for (auto &stackParam : stackParams) {
-    //                    ptr::PointsToSets::PointsToSet ps =
-    //                    ptr::getPointsToSet(stackParam.second, PS); for (auto
-    //                    &p : ps) {
-    //                        workSet.insert(p.first);
-    //                    }
-    //                }
-
-    while (workSet.size()) {
-      for (auto &w : workSet) {
-        if (dyn_cast<const ConstantDataArray>(w)) {
-          continue;
-        }
-        passedReferences.insert(w);
+  while (workSet.size()) {
+    for (auto &w : workSet) {
+      if (dyn_cast<const ConstantDataArray>(w)) {
+        continue;
+      }
+      passedReferences.insert(w);
 
-        ptr::PointsToSets::PointsToSet ps = ptr::getPointsToSet(w, PS);
-        for (auto &p : ps) {
-          if (passedReferences.find(p.first) == passedReferences.end()) {
-            tmp.insert(p.first);
-          }
+      const ptr::PointsToSets::PointsToSet &ps = ptr::getPointsToSet(w, PS);
+      for (auto &p : ps) {
+        if (passedReferences.find(p.first) == passedReferences.end()) {
+          tmp.insert(p.first);
         }
       }
-      std::swap(workSet, tmp);
-      tmp.clear();
     }
+    std::swap(workSet, tmp);
+    tmp.clear();
+  }
 
-    const Instruction *retInst = nullptr;
-    for (const_inst_iterator i_it = inst_begin(*f->first);
-         i_it != inst_end(*f->first); ++i_it) {
-      if (i_it->getOpcode() == Instruction::Ret) {
-        retInst = &*i_it;
-        break;
-      }
+  const Instruction *retInst = nullptr;
+  for (const_inst_iterator i_it = inst_begin(*f.first);
+       i_it != inst_end(*f.first); ++i_it) {
+    if (i_it->getOpcode() == Instruction::Ret) {
+      retInst = &*i_it;
+      break;
     }
+  }
 
-    if (retInst) {
-      DetectParametersPass::UserSet_t x8Vals =
-          DetectParametersPass::getRegisterValuesBeforeCall(13, retInst, false);
-      for (auto &v : x8Vals) {
-        ptr::PointsToSets::PointsToSet pts = ptr::getPointsToSet(v, PS);
-        for (auto &p : pts) {
-          passedReferences.insert(p.first);
-        }
+  if (retInst) {
+    DetectParametersPass::UserSet_t x8Vals =
+        DetectParametersPass::getRegisterValuesBeforeCall(13, retInst, false);
+    for (auto &v : x8Vals) {
+      const ptr::PointsToSets::PointsToSet &pts = ptr::getPointsToSet(v, PS);
+      for (auto &p : pts) {
+        passedReferences.insert(p.first);
       }
     }
+  }
 
-    DetectParametersPass::ParameterAccessPairSet_t &Ret =
-        DPP->getReturnRegisterIndexes((Function *)f->first);
-    for (auto &r : Ret) {
-      if (const StoreInst *store = dyn_cast<StoreInst>(r.second)) {
-        passedReferences.insert(store->getOperand(0));
-        ptr::PointsToSets::PointsToSet pts =
-            ptr::getPointsToSet(store->getOperand(0), PS);
-        for (auto &p : pts) {
-          passedReferences.insert(p.first);
-        }
-      } else {
-        assert(false);
+  DetectParametersPass::ParameterAccessPairSet_t &Ret =
+      DPP->getReturnRegisterIndexes(f.first);
+  for (auto &r : Ret) {
+    if (const StoreInst *store = dyn_cast<StoreInst>(r.second)) {
+      passedReferences.insert(store->getOperand(0));
+      const ptr::PointsToSets::PointsToSet &pts =
+          ptr::getPointsToSet(store->getOperand(0), PS);
+      for (auto &p : pts) {
+        passedReferences.insert(p.first);
       }
+    } else {
+      assert(false);
     }
+  }
 
-    for (ProgramStructure::mapped_type::const_iterator c = f->second.begin();
-         c != f->second.end(); ++c) {
+  for (ProgramStructure::mapped_type::const_iterator c = f.second.begin();
+       c != f.second.end(); ++c) {
 
-      if (c->getType() == CMD_VAR) {
-        if (!isLocalToFunction(c->getVar(), f->first))
-          MOD[f->first].insert(Pointee(c->getVar(), -1));
-        else {
-          c->getVar()->dump();
-          llvm_unreachable("");
-        }
-      } else if (c->getType() == CMD_DREF_VAR) {
-        typedef ptr::PointsToSets::PointsToSet PTSet;
-        const PTSet &S = ptr::getPointsToSet(c->getVar(), PS);
-
-        for (PTSet::const_iterator p = S.begin(); p != S.end(); ++p)
-          if (!isLocalToFunction(p->first, f->first) &&
-              !isConstantValue(p->first))
-            MOD[f->first].insert(*p);
-      } else if (c->getType() == CMD_EXT_ARG) {
-        std::set<std::pair<int64_t, const Value *>> defs =
-            llvm::getMemcpyDefs(dyn_cast<const Instruction>(c->getVar()), PS);
-        for (auto &d_it : defs) {
-          MOD[f->first].insert(Pointee(d_it.second, -1));
-        }
-      } else if (c->getType() == CMD_DEF) {
-        if (passedReferences.find(c->getVar()) != passedReferences.end()) {
-          MOD[f->first].insert(Pointee(c->getVar(), -1));
-        }
-      } else if (c->getType() == CMD_FRC_DEF) {
-        MOD[f->first].insert(Pointee(c->getVar(), -1));
+    if (c->getType() == CMD_VAR) {
+      if (!isLocalToFunction(c->getVar(), f.first))
+        Out.push_back(Pointee(c->getVar(), -1));
+      else {
+        c->getVar()->dump();
+        llvm_unreachable("");
       }
+    } else if (c->getType() == CMD_DREF_VAR) {
+      typedef ptr::PointsToSets::PointsToSet PTSet;
+      const PTSet &S = ptr::getPointsToSet(c->getVar(), PS);
+
+      for (PTSet::const_iterator p = S.begin(); p != S.end(); ++p)
+        if (!isLocalToFunction(p->first, f.first) &&
+            !isConstantValue(p->first))
+          Out.push_back(*p);
+    } else if (c->getType() == CMD_EXT_ARG) {
+      std::set<std::pair<int64_t, const Value *>> defs =
+          llvm::getMemcpyDefs(dyn_cast<const Instruction>(c->getVar()), PS);
+      for (auto &d_it : defs) {
+        Out.push_back(Pointee(d_it.second, -1));
+      }
+    } else if (c->getType() == CMD_DEF) {
+      if (passedReferences.find(c->getVar()) != passedReferences.end()) {
+        Out.push_back(Pointee(c->getVar(), -1));
+      }
+    } else if (c->getType() == CMD_FRC_DEF) {
+      Out.push_back(Pointee(c->getVar(), -1));
     }
   }
 
-  typedef callgraph::Callgraph Callgraph;
-  for (Callgraph::const_iterator i = CG.begin_closure(); i != CG.end_closure();
-       ++i) {
-    const Modifies::mapped_type &src = MOD[i->second];
-    typedef Modifies::mapped_type dst_t;
-    dst_t &dst = MOD[i->first];
-
-    std::copy(src.begin(), src.end(), std::inserter(dst, dst.end()));
-#if 0 /* original boost+STL uncompilable crap */
-                using std::tr1::bind;
-      using std::tr1::placeholders::_1;
-      using std::tr1::cref;
-      dst.erase(std::remove_if(dst.begin(), dst.end(),
-		bind(&ProgramStructure::isLocalToFunction, cref(P), _1, i->first)),
-		dst.end());
-#endif
-    // We don't need to check for local variables since only 'dummy' locations
-    // and return values are added anyway.
-    //                for (dst_t::iterator I = dst.begin(), E = dst.end(); I !=
-    //                E; ) {
-    //                    if (isLocalToFunction(I->first, i->first))
-    //                        dst.erase(I++);
-    //                    else
-    //                        ++I;
-    //                }
+  std::sort(Out.begin(), Out.end());
+  Out.erase(std::unique(Out.begin(), Out.end()), Out.end());
+}
+
+void computeModifies(const ProgramStructure &P, const callgraph::Callgraph &CG,
+                     const ptr::PointsToSets &PS, Modifies &MOD) {
+  typedef ptr::PointsToSets::Pointee Pointee;
+  typedef std::vector<Pointee> SortedModSet;
+
+  DetectParametersPass *DPP = getDPP();
+
+  errs() << "Compute Modifies\n";
+
+  // The local mod sets are independent of each other. The DPP entries of all
+  // functions in P were already created by the ProgramStructure, so the
+  // workers only read them.
+  std::vector<ProgramStructure::const_iterator> functions;
+  for (ProgramStructure::const_iterator f = P.begin(); f != P.end(); ++f)
+    functions.push_back(f);
+
+  std::vector<SortedModSet> local(functions.size());
+  parallelFor(functions.size(), ModsThreads, [&](size_t idx) {
+    computeLocalModifies(*functions[idx], DPP, PS, local[idx]);
+  });
+
+  std::map<const Function *, const SortedModSet *> localOf;
+  for (size_t idx = 0; idx < functions.size(); ++idx) {
+    if (local[idx].empty())
+      continue;
+    localOf[functions[idx]->first] = &local[idx];
+  }
+
+  // A function modifies everything its transitive callees modify. All
+  // functions of a call graph cycle share the same set, so the sets are
+  // merged once per strongly connected component, callees first.
+  const auto &condensed = CG.getCondensation();
+  const auto &SCCs = condensed.SCCs;
+
+  std::vector<SortedModSet> total(SCCs.size());
+  SortedModSet merged;
+  for (size_t idx = 0; idx < SCCs.size(); ++idx) {
+    SortedModSet &dst = total[idx];
+    auto addAll = [&](const SortedModSet &src) {
+      merged.clear();
+      std::set_union(dst.begin(), dst.end(), src.begin(), src.end(),
+                     std::back_inserter(merged));
+      dst.swap(merged);
+    };
+
+    for (auto &f : SCCs[idx]) {
+      auto l = localOf.find(f);
+      if (l != localOf.end())
+        addAll(*l->second);
+    }
+    for (unsigned succ : condensed.successors[idx])
+      addAll(total[succ]);
+
+    for (auto &f : SCCs[idx]) {
+      Modifies::ModSet &out = MOD[f];
+      // dst is sorted, so every element goes to the end of the set.
+      for (auto &p : dst)
+        out.insert(out.end(), p);
+    }
+  }
+
+  // Functions outside of the call graph keep their local set.
+  for (auto &l : localOf) {
+    if (condensed.getSCC(l.first) != condensed.None)
+      continue;
+    Modifies::ModSet &out = MOD[l.first];
+    for (auto &p : *l.second)
+      out.insert(out.end(), p);
   }
 
 #ifdef DEBUG_DUMP
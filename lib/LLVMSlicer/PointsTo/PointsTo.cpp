@@ -1,15 +1,25 @@
 // This file is distributed under the University of Illinois Open Source
 // License. See LICENSE.TXT for details.
 
+#include <atomic>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/GetElementPtrTypeIterator.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/Format.h"
 #include <llvm/IR/PatternMatch.h>
 
 #include "PointsTo.h"
@@ -598,11 +608,222 @@ static PointsToSets &fixpoint(const ProgramStructure &P, PointsToSets &S) {
 static Andersen *andersen = nullptr;
 static DetectParametersPass *DPP = nullptr;
 
+namespace detail {
+
+static cl::opt<unsigned> PointsToCacheBudget(
+    "pts-cache-budget",
+    cl::desc("Memory budget of the points-to query cache index in MiB (0 = "
+             "unlimited)"),
+    cl::init(0), cl::Hidden);
+
+/*
+ * Answers points-to queries from the Andersen result. Every distinct
+ * pointee set is interned once and never modified or freed while the cache
+ * lives, so callers may keep the returned references. The value -> set
+ * index is split into shards with their own locks, thus concurrent queries
+ * on different values rarely contend.
+ *
+ * The memory budget applies to the index only: when it is exceeded the
+ * index is flushed and rebuilt on demand. Interned sets are not counted,
+ * they stay alive because their references may still be held by callers.
+ */
+class PointsToCache {
+public:
+  PointsToCache() : hits(0), misses(0), flushes(0), indexBytes(0),
+                    internBytes(0), internedSets(0) {}
+
+  const PTSet &get(const llvm::Value *V);
+  void prefetch(const llvm::Function &F);
+  void print(raw_ostream &OS) const;
+
+private:
+  typedef std::vector<const llvm::Value *> ValueList_t;
+
+  static const unsigned NumShards = 64;
+
+  struct IndexShard {
+    std::mutex lock;
+    DenseMap<const llvm::Value *, const PTSet *> index;
+  };
+
+  struct InternShard {
+    std::mutex lock;
+    std::unordered_multimap<size_t, std::unique_ptr<const PTSet>> sets;
+  };
+
+  IndexShard indexShards[NumShards];
+  InternShard internShards[NumShards];
+
+  std::atomic<uint64_t> hits;
+  std::atomic<uint64_t> misses;
+  std::atomic<uint64_t> flushes;
+  std::atomic<uint64_t> indexBytes;
+  std::atomic<uint64_t> internBytes;
+  std::atomic<uint64_t> internedSets;
+
+  static const PTSet emptySet;
+
+  static unsigned shardOf(const void *P) {
+    return (unsigned)(hash_value(P) % NumShards);
+  }
+
+  const PTSet *compute(const llvm::Value *V);
+  const PTSet *intern(ValueList_t &PT);
+  void record(IndexShard &Shard, const llvm::Value *V, const PTSet *Set);
+  void enforceBudget();
+};
+
+const PTSet PointsToCache::emptySet;
+
+const PTSet *PointsToCache::intern(ValueList_t &PT) {
+  if (PT.empty())
+    return &emptySet;
+
+  std::sort(PT.begin(), PT.end());
+  PT.erase(std::unique(PT.begin(), PT.end()), PT.end());
+
+  const size_t Hash = hash_combine_range(PT.begin(), PT.end());
+  InternShard &Shard = internShards[Hash % NumShards];
+
+  std::lock_guard<std::mutex> guard(Shard.lock);
+  auto Range = Shard.sets.equal_range(Hash);
+  for (auto I = Range.first; I != Range.second; ++I) {
+    const PTSet &Candidate = *I->second;
+    if (Candidate.size() != PT.size())
+      continue;
+    /* both sequences are ordered by location, offsets are always -1 */
+    if (std::equal(PT.begin(), PT.end(), Candidate.begin(),
+                   [](const llvm::Value *V, const PointsToSets::Pointee &P) {
+                     return V == P.first;
+                   }))
+      return I->second.get();
+  }
+
+  PTSet *Set = new PTSet();
+  for (const llvm::Value *V : PT)
+    Set->insert(Set->end(), PointsToSets::Pointee(V, -1));
+  Shard.sets.insert(std::make_pair(Hash, std::unique_ptr<const PTSet>(Set)));
+
+  ++internedSets;
+  /* rough estimate of the red-black tree footprint */
+  internBytes += sizeof(PTSet) + PT.size() * (sizeof(PointsToSets::Pointee) +
+                                              4 * sizeof(void *));
+  return Set;
+}
+
+const PTSet *PointsToCache::compute(const llvm::Value *V) {
+  ValueList_t PT;
+  andersen->getPointsToSetOnDemand(V, PT);
+  return intern(PT);
+}
+
+void PointsToCache::record(IndexShard &Shard, const llvm::Value *V,
+                           const PTSet *Set) {
+  if (Shard.index.insert(std::make_pair(V, Set)).second)
+    indexBytes += 2 * sizeof(std::pair<const llvm::Value *, const PTSet *>);
+}
+
+void PointsToCache::enforceBudget() {
+  if (!PointsToCacheBudget)
+    return;
+  const uint64_t Budget = (uint64_t)PointsToCacheBudget << 20;
+  if (indexBytes <= Budget)
+    return;
+
+  for (IndexShard &Shard : indexShards) {
+    std::lock_guard<std::mutex> guard(Shard.lock);
+    Shard.index.shrink_and_clear();
+  }
+  indexBytes = 0;
+  ++flushes;
+}
+
+const PTSet &PointsToCache::get(const llvm::Value *V) {
+  IndexShard &Shard = indexShards[shardOf(V)];
+  {
+    std::lock_guard<std::mutex> guard(Shard.lock);
+    auto It = Shard.index.find(V);
+    if (It != Shard.index.end()) {
+      ++hits;
+      return *It->second;
+    }
+  }
+
+  /* Query Andersen without holding the shard lock, racing threads will
+   * intern the very same set anyway. */
+  ++misses;
+  const PTSet *Set = compute(V);
+  {
+    std::lock_guard<std::mutex> guard(Shard.lock);
+    record(Shard, V, Set);
+  }
+  enforceBudget();
+  return *Set;
+}
+
+void PointsToCache::prefetch(const llvm::Function &F) {
+  typedef std::pair<const llvm::Value *, const PTSet *> Entry_t;
+  std::vector<Entry_t> Batches[NumShards];
+
+  /* Lifted code keeps addresses in 64-bit registers, so integers as wide as
+   * a pointer are queried as well. */
+  const unsigned PointerBits =
+      F.getParent()->getDataLayout().getPointerSizeInBits();
+  for (const_inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
+    const llvm::Value *V = &*I;
+    llvm::Type *Ty = V->getType();
+    if (!Ty->isPointerTy() && !Ty->isIntegerTy(PointerBits))
+      continue;
+    Batches[shardOf(V)].push_back(Entry_t(V, nullptr));
+  }
+
+  for (unsigned i = 0; i < NumShards; ++i) {
+    std::vector<Entry_t> &Batch = Batches[i];
+    if (Batch.empty())
+      continue;
+
+    IndexShard &Shard = indexShards[i];
+    {
+      std::lock_guard<std::mutex> guard(Shard.lock);
+      Batch.erase(std::remove_if(Batch.begin(), Batch.end(),
+                                 [&Shard](const Entry_t &E) {
+                                   return Shard.index.count(E.first);
+                                 }),
+                  Batch.end());
+    }
+
+    for (Entry_t &E : Batch)
+      E.second = compute(E.first);
+    misses += Batch.size();
+
+    std::lock_guard<std::mutex> guard(Shard.lock);
+    for (Entry_t &E : Batch)
+      record(Shard, E.first, E.second);
+  }
+  enforceBudget();
+}
+
+void PointsToCache::print(raw_ostream &OS) const {
+  const uint64_t Queries = hits + misses;
+  OS << "Points-to cache: " << Queries << " queries, " << hits << " hits";
+  if (Queries)
+    OS << format(" (%.1f%%)", 100.0 * hits / Queries);
+  OS << ", " << internedSets << " interned sets of "
+     << (internBytes >> 10) << " KiB, index " << (indexBytes >> 10)
+     << " KiB, " << flushes << " flushes\n";
+  andersen->printDemandStatistics(OS);
+}
+
+static std::unique_ptr<PointsToCache> cache;
+
+} // namespace detail
+
 PointsToSets &computePointsToSets(const ProgramStructure &P, PointsToSets &S, std::vector<llvm::slicing::Rule *> rules) {
   legacy::PassManager *PM = new legacy::PassManager();
   DPP = new DetectParametersPass();
   andersen = new Andersen();
   andersen->setRules(rules);
+  detail::cache.reset(new detail::PointsToCache());
   PM->add(DPP);
   PM->add(andersen);
   PM->run(P.getModule());
@@ -616,30 +837,18 @@ PointsToSets &computePointsToSets(const ProgramStructure &P, PointsToSets &S, st
 const PTSet &getPointsToSet(const llvm::Value *const &memLoc,
                             const PointsToSets &S, const int idx) {
   const PointsToSets::const_iterator it = S.find(Ptr(memLoc, idx));
-  if (it == S.end()) {
-    std::vector<const llvm::Value *> PT;
-    andersen->getPointsToSet(memLoc, PT);
-
-    static const PTSet emptySet;
-    if (PT.size() == 0) {
-      // errs() << "WARNING[PointsTo]: No points-to set has been found: ";
-      // memLoc->print(errs());
-      // errs() << '\n';
-      return emptySet;
-    }
-
-    PTSet *newSet = new PTSet();
-
-    for (std::vector<const llvm::Value *>::iterator p_it = PT.begin();
-         p_it != PT.end(); ++p_it) {
-      newSet->insert(PointsToSets::Pointee(*p_it, -1));
-    }
+  if (it != S.end())
+    return it->second;
+  return detail::cache->get(memLoc);
+}
 
-    ((PointsToSets &)S)[PointsToSets::Pointer(memLoc, -1)] = *newSet;
+void prefetchPointsToSets(const llvm::Function &F) {
+  detail::cache->prefetch(F);
+}
 
-    return *newSet;
-  }
-  return it->second;
+void printPointsToCacheStatistics(raw_ostream &OS) {
+  if (detail::cache && AreStatisticsEnabled())
+    detail::cache->print(OS);
 }
 
 SimpleCallGraph &getSimpleCallGraph() { return andersen->getCallGraph(); }
@@ -101,10 +101,19 @@ private:
 namespace llvm {
 namespace ptr {
 
+/*
+ * The returned set is interned and immutable: it stays valid for the rest of
+ * the analysis and may be shared between threads.
+ */
 const PointsToSets::PointsToSet &
 getPointsToSet(const llvm::Value *const &memLoc, const PointsToSets &S,
                const int offset = -1);
 
+/* Resolves the points-to sets of all instructions of F in one batch. */
+void prefetchPointsToSets(const llvm::Function &F);
+
+void printPointsToCacheStatistics(llvm::raw_ostream &OS);
+
 SimpleCallGraph &getSimpleCallGraph();
 DetectParametersPass &getDetectParametersPass();
 Andersen *getAndersen();
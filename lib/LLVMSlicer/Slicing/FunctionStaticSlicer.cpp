@@ -13,6 +13,7 @@
 #include <ctype.h>
 #include <map>
 #include <llvm/IR/PatternMatch.h>
+#include <llvm/Analysis/Andersen/ExternalModel.h>
 #include <llvm/Analysis/Andersen/StackAccessPass.h>
 #include <llvm/ADT/StringExtras.h>
 #include <llvm/ProfileData/InstrProfReader.h>
@@ -85,6 +86,49 @@ static uint64_t getSizeOfMem(const Value *val) {
   return 64;
 }
 
+/*
+ * Applies the slice operations of an external function, interpreting the
+ * -external-models file if one was given and falling back to the generated
+ * handlers otherwise.
+ */
+static void handleExternalCall(InsInfo *Info, const std::string &FName,
+                               const ptr::PointsToSets &PS) {
+  const ExternalModel *Model = ExternalModel::get();
+  if (!Model) {
+    handleCall(Info, FName, PS);
+    return;
+  }
+  const ExternalModel::Function *F = Model->lookup(FName);
+  if (!F)
+    return;
+
+  auto PointsTo = [&PS](const Value *V, ExternalModel::UserSet_t &Out) {
+    for (auto &P : ptr::getPointsToSet(V, PS)) {
+      Out.insert(const_cast<User *>(cast<User>(P.first)));
+    }
+  };
+  for (const ExternalModel::Operation &Op : F->SliceOps) {
+    ExternalModel::UserSet_t Regs;
+    Model->evaluate(Op.A, Info->getIns(), nullptr, PointsTo, Regs);
+    for (auto R : Regs) {
+      switch (Op.Kind) {
+      case ExternalModel::DEF:
+      case ExternalModel::DEF_MOD:
+        Info->addDEF(ptr::PointsToSets::Pointee(R, -1));
+        break;
+      case ExternalModel::REF1:
+        Info->addREF(ptr::PointsToSets::Pointee(R, -1), 1.0);
+        break;
+      case ExternalModel::REF:
+        Info->addREF(ptr::PointsToSets::Pointee(R, -1));
+        break;
+      default:
+        llvm_unreachable("Points-to operation in slice operations");
+      }
+    }
+  }
+}
+
 void InsInfo::addDEFArray(const ptr::PointsToSets &PS, const Value *V,
                           uint64_t lenConst) {
   if (isPointerValue(V)) {
@@ -169,10 +213,10 @@ void InsInfo::handleVariousFuns(const ptr::PointsToSets &PS, const CallInst *C)
   for (SimpleCallGraph::FunctionSet_t::iterator F_it = CG.getCalled(C).begin(); F_it != CG.getCalled(C).end(); ++F_it) {
     const Function *F = M->getFunction(*F_it);
     if (!F) {
-      handleCall(this, *F_it, PS);
+      handleExternalCall(this, *F_it, PS);
     } else {
       DEBUG(errs() << "[+]handle various function: " << F->getName() << "\n");
-      handleCall(this, F->getName(), PS);
+      handleExternalCall(this, F->getName(), PS);
     }
   }
 //  } else {
@@ -337,11 +381,17 @@ InsInfo::InsInfo(const Instruction *i, const ptr::PointsToSets &PS,
                   if (!SAP)
                     SAP = &ptr::getAndersen()->getAnalysis<StackAccessPass>();
 
-                  for (auto &baseStackOffset_it : *SAP->getOffsets(f)[baseInst]) {
+                  const StackAccessPass::OffsetMap_t &Offsets = SAP->getOffsets(f);
+                  StackAccessPass::OffsetMap_t::const_iterator baseStackOffsets = Offsets.find(baseInst);
+                  if (baseStackOffsets == Offsets.end())
+                    return found;
+                  const StackAccessPass::OffsetValueListMap_t &OffsetValues = SAP->getOffsetValues(f);
+                  for (auto &baseStackOffset_it : baseStackOffsets->second) {
                     int64_t targetOffset = baseStackOffset_it + offset;
-                    if (!SAP->getOffsetValues(f)[targetOffset])
+                    StackAccessPass::OffsetValueListMap_t::const_iterator targets = OffsetValues.find(targetOffset);
+                    if (targets == OffsetValues.end())
                       continue;
-                    for (auto &target : *SAP->getOffsetValues(f)[targetOffset]) {
+                    for (auto &target : targets->second) {
                       ptr::PointsToSets::PointsToSet PtsTo = ptr::getPointsToSet(target, PS);
                       for (auto &PtsTo_it : PtsTo) {
                         REFs.insert(PtsTo_it);
@@ -706,15 +756,13 @@ InsInfo::InsInfo(const Instruction *i, const ptr::PointsToSets &PS,
                   int64_t hi = p_it.second + size->getZExtValue();
 
                   Function *f = (Function *) p_it.first;
-                  StackAccessPass::OffsetValueListMap_t &OffsetValues = andersen->getAnalysis<StackAccessPass>().getOffsetValues(
+                  const StackAccessPass::OffsetValueListMap_t &OffsetValues = andersen->getAnalysis<StackAccessPass>().getOffsetValues(
                     f);
                   for (auto &O_it : OffsetValues) {
                     if (O_it.first <= lo || O_it.first >= hi)
                       continue;
 
-                    if (!O_it.second)
-                      continue;
-                    for (auto &V_it: *O_it.second) {
+                    for (auto &V_it: O_it.second) {
                       ptr::PointsToSets::PointsToSet defPtsTo = ptr::getPointsToSet(V_it, PS);
                       for (auto &def_it : defPtsTo) {
                         addDEF(def_it);
@@ -1136,11 +1184,17 @@ bool FunctionStaticSlicer::computeRCi(InsInfo *insInfoi, InsInfo *insInfoj) {
               if (!SAP)
                 SAP = &ptr::getAndersen()->getAnalysis<StackAccessPass>();
 
-              for (auto &baseStackOffset_it : *SAP->getOffsets(f)[baseInst]) {
+              const StackAccessPass::OffsetMap_t &Offsets = SAP->getOffsets(f);
+              StackAccessPass::OffsetMap_t::const_iterator baseStackOffsets = Offsets.find(baseInst);
+              if (baseStackOffsets == Offsets.end())
+                return found;
+              const StackAccessPass::OffsetValueListMap_t &OffsetValues = SAP->getOffsetValues(f);
+              for (auto &baseStackOffset_it : baseStackOffsets->second) {
                 int64_t targetOffset = baseStackOffset_it + offset;
-                if (!SAP->getOffsetValues(f)[targetOffset])
+                StackAccessPass::OffsetValueListMap_t::const_iterator targets = OffsetValues.find(targetOffset);
+                if (targets == OffsetValues.end())
                   continue;
-                for (auto &target : *SAP->getOffsetValues(f)[targetOffset]) {
+                for (auto &target : targets->second) {
                   ptr::PointsToSets::PointsToSet PtsTo = ptr::getPointsToSet(target, PS);
                   for (auto &PtsTo_it : PtsTo) {
                     REFs.insert(PtsTo_it);
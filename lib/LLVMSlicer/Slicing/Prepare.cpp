@@ -256,7 +256,7 @@ bool Prepare::addInitFun(const callgraph::Callgraph &CG,
   if (F.isDeclaration())
     return false;
   if (starting) {
-    callgraph::Callgraph::range_iterator callees = CG.callees(&F);
+    callgraph::Callgraph::closure_range callees = CG.callees(&F);
     if (std::distance(callees.first, callees.second))
       return false;
   }
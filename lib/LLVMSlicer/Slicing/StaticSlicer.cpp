@@ -1,6 +1,10 @@
 // This file is distributed under the University of Illinois Open Source
 // License. See LICENSE.TXT for details.
 
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/Andersen/ParallelFor.h"
+#include "llvm/Analysis/Andersen/PhaseProfile.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
@@ -8,16 +12,19 @@
 #include "llvm/IR/Value.h"
 #include "llvm/Pass.h"
 #include "llvm/PassSupport.h"
+#include <climits>
 #include <future>
 #include <llvm/Analysis/Andersen/DetectParametersPass.h>
 #include <llvm/Support/UniqueLock.h>
 #include <signal.h>
 #include <thread>
+#include <unordered_map>
 #include <utility>
 
 #include "../Backtrack/Constraint.h"
 #include "../Backtrack/Path.h"
 #include "../Backtrack/Rule.h"
+#include "../Backtrack/RuleProgram.h"
 #include "../Callgraph/Callgraph.h"
 #include "../Modifies/Modifies.h"
 #include "../PointsTo/PointsTo.h"
@@ -33,9 +40,19 @@
 using namespace llvm;
 
 static cl::opt<std::string>
-    ReportFilename("r", cl::desc("Path to HTML report output file"),
+    ReportFilename("r", cl::desc("Path to the report output file"),
                    cl::value_desc("report"));
 
+static cl::opt<llvm::slicing::ReportWriter::Format> ReportFormat(
+    "report-format", cl::desc("Format of the -r report"),
+    cl::values(clEnumValN(llvm::slicing::ReportWriter::HTML, "html", "HTML"),
+               clEnumValN(llvm::slicing::ReportWriter::JSONL, "jsonl",
+                          "One JSON object per line"),
+               clEnumValN(llvm::slicing::ReportWriter::SARIF, "sarif",
+                          "SARIF 2.1.0"),
+               clEnumValEnd),
+    cl::init(llvm::slicing::ReportWriter::HTML), cl::Hidden);
+
 namespace llvm {
 namespace slicing {
 namespace detail {
@@ -346,6 +363,23 @@ namespace slicing {
 
 static cl::opt<int> limitCalls("limit-calls", cl::init(0), cl::Hidden);
 
+static cl::opt<unsigned>
+    BacktrackThreads("backtrack-threads",
+                     cl::desc("Number of threads used to backtrack the rules' "
+                              "criteria (0 = number of hardware threads)"),
+                     cl::init(0), cl::Hidden);
+
+static cl::opt<bool> BacktrackVerify(
+    "backtrack-verify",
+    cl::desc("Backtrack every criterion a second time on one thread and "
+             "abort if the paths differ from the parallel run"),
+    cl::init(false), cl::Hidden);
+
+STATISTIC(NumScopeQueries, "Number of relevant variable scope queries");
+STATISTIC(NumScopeHits, "Number of scope queries answered from the memo");
+STATISTIC(NumScopeCallerHits,
+          "Number of callers whose memoized scope answered for their callers");
+
 class StaticSlicer : public InsInfoProvider {
 public:
   typedef std::map<llvm::Function const *, FunctionStaticSlicer *> Slicers;
@@ -372,6 +406,9 @@ public:
   bool addRule(Rule *rule);
   const std::vector<Rule *> getRules() const { return rules; }
 
+  // Rules are reported to writer as soon as they have been checked.
+  void setReportWriter(ReportWriter *writer) { reportWriter = writer; }
+
 private:
   typedef llvm::SmallVector<const llvm::Function *, 20> InitFuns;
 
@@ -382,6 +419,7 @@ private:
 
   std::vector<Rule *> rules;
   std::vector<Rule *> ruleWorklist;
+  ReportWriter *reportWriter = nullptr;
 
   void buildDicts(const ptr::PointsToSets &PS, const CallInst *c);
   void buildDicts(const ptr::PointsToSets &PS);
@@ -394,6 +432,14 @@ private:
   template <typename OutIterator>
   void emitToExits(llvm::Function const *const f, OutIterator out);
 
+  // Answers whether the relevant variable r may be modified by g or by any
+  // of its (transitive) callers. Results are memoized per (callee, pointee);
+  // the mod sets are final before slicing starts, so entries never go stale.
+  bool isInScope(const Value *r, const Function *g);
+  bool isModifiedIn(const Value *r, const Function *f) const;
+  bool lookupScope(const Function *f, const Value *r, bool &inScope) const;
+  void printScopeStatistics(raw_ostream &OS) const;
+
   void runFSS(Function &F, const ptr::PointsToSets &PS,
               const callgraph::Callgraph &CG, const mods::Modifies &MOD);
 
@@ -406,8 +452,91 @@ private:
   CallsToFuncs callsToFuncs;
 
   std::set<const Instruction *> InitialCriterions;
+
+  typedef std::pair<const Function *, const Value *> ScopeKey_t;
+  typedef std::map<ScopeKey_t, bool> ScopeCache_t;
+  ScopeCache_t scopeCache;
+  uint64_t scopeQueries = 0;
+  uint64_t scopeHits = 0;
+  uint64_t scopeCallerHits = 0;
 };
 
+bool StaticSlicer::isModifiedIn(const Value *r, const Function *f) const {
+  // Mod sets are ordered by (location, offset), so all entries for r are
+  // adjacent and the first one is found by a single lookup.
+  const mods::Modifies::ModSet &M = getModSet(f, MOD);
+  mods::Modifies::ModSet::const_iterator v =
+      M.lower_bound(detail::Pointee(r, INT_MIN));
+  return v != M.end() && v->first == r;
+}
+
+bool StaticSlicer::lookupScope(const Function *f, const Value *r,
+                               bool &inScope) const {
+  ScopeCache_t::const_iterator it = scopeCache.find(ScopeKey_t(f, r));
+  if (it == scopeCache.end())
+    return false;
+  inScope = it->second;
+  return true;
+}
+
+bool StaticSlicer::isInScope(const Value *r, const Function *g) {
+  // probably a constant inst stored in a register. needs to be kept
+  if (isa<const StoreInst>(r) || isa<const Constant>(r))
+    return true;
+
+  ++scopeQueries;
+  ++NumScopeQueries;
+
+  bool inScope = false;
+  if (lookupScope(g, r, inScope)) {
+    ++scopeHits;
+    ++NumScopeHits;
+    return inScope;
+  }
+
+  SmallPtrSet<const Function *, 16> visited;
+  SmallVector<const Function *, 16> worklist;
+  worklist.push_back(g);
+
+  while (!worklist.empty() && !inScope) {
+    const Function *f = worklist.pop_back_val();
+    if (!visited.insert(f).second)
+      continue;
+
+    // A memoized answer for a caller covers all of its callers as well, so
+    // its subtree can either decide the query or be skipped entirely.
+    bool cached = false;
+    if (f != g && lookupScope(f, r, cached)) {
+      ++scopeCallerHits;
+      ++NumScopeCallerHits;
+      if (cached)
+        inScope = true;
+      continue;
+    }
+
+    if (isModifiedIn(r, f)) {
+      inScope = true;
+      break;
+    }
+
+    FuncsToCalls::const_iterator calledBy_b, calledBy_e;
+    std::tie(calledBy_b, calledBy_e) = funcsToCalls.equal_range(f);
+    for (; calledBy_b != calledBy_e; ++calledBy_b)
+      worklist.push_back(calledBy_b->second->getParent()->getParent());
+  }
+
+  scopeCache[ScopeKey_t(g, r)] = inScope;
+  return inScope;
+}
+
+void StaticSlicer::printScopeStatistics(raw_ostream &OS) const {
+  OS << "Scope queries: " << scopeQueries << ", hits: " << scopeHits;
+  if (scopeQueries)
+    OS << format(" (%.1f%%)", 100.0 * scopeHits / scopeQueries);
+  OS << ", caller hits: " << scopeCallerHits
+     << ", entries: " << scopeCache.size() << "\n";
+}
+
 template <typename OutIterator>
 void StaticSlicer::emitToCalls(const Function *f, OutIterator out) {
   const Instruction *entry = getFunctionEntry(f);
@@ -465,69 +594,10 @@ void StaticSlicer::emitToCalls(const Function *f, OutIterator out) {
       continue;
     }
 
-    typedef std::set<const Function *> FunctionSet_t;
-    std::function<bool(const Value *, const Function *, FunctionSet_t &)>
-        isInScope =
-            [&](const Value *r, const Function *f, FunctionSet_t &visited) {
-              if (visited.find(f) != visited.end()) {
-                return false;
-              }
-              visited.insert(f);
-
-              // probably a constant inst stored in a register. needs to be kept
-              if (dyn_cast<const StoreInst>(r)) {
-                return true;
-              }
-
-              if (dyn_cast<const Constant>(r)) {
-                return true;
-              }
-
-              mods::Modifies::mapped_type const &M = getModSet(f, MOD);
-              bool isModified = false;
-
-              for (mods::Modifies::mapped_type::const_iterator v = M.begin();
-                   v != M.end(); ++v) {
-                if (v->first == r) {
-                  isModified = true;
-                  break;
-                }
-              }
-
-              if (isModified) {
-
-              } else {
-                FuncsToCalls::const_iterator calledBy_b, callledBy_e;
-                std::tie(calledBy_b, callledBy_e) = funcsToCalls.equal_range(f);
-
-                for (; calledBy_b != callledBy_e; ++calledBy_b) {
-                  if (isInScope(r, calledBy_b->second->getParent()->getParent(),
-                                visited)) {
-                    isModified = true;
-                    break;
-                  }
-                }
-              }
-              //
-              //                if (!isModified) {
-              //                    for (auto &infos : structSliceInfos) {
-              //                        for (auto &ssi : infos.second) {
-              //                            for (auto &l : ssi->locations) {
-              //                                if (r == l.first) {
-              //                                    llvm_unreachable("");
-              //                                }
-              //                            }
-              //                        }
-              //                    }
-              //                }
-              return isModified;
-            };
-
     detail::RelevantSet toRemove;
 
     for (auto &r : R) {
-      FunctionSet_t visited;
-      if (!isInScope(r.first, g, visited)) {
+      if (!isInScope(r.first, g)) {
         toRemove.insert(r);
       }
     }
@@ -712,6 +782,7 @@ void StaticSlicer::runFSS(Function &F, const ptr::PointsToSets &PS,
 }
 
 void StaticSlicer::ruleIteration() {
+  PhaseProfile::Scope ProfileScope("ruleIteration");
   findInitialCriterions();
 
   struct FunctionCmp {
@@ -731,6 +802,7 @@ void StaticSlicer::ruleIteration() {
 
   initFuns.clear();
 
+  PhaseProfile::begin("sliceFunctions");
   uint64_t numSlices = 0;
 
   while (!Q.empty()) {
@@ -763,6 +835,7 @@ void StaticSlicer::ruleIteration() {
   }
 
   errs() << "Num function slices: " << numSlices << "\n";
+  PhaseProfile::end();
 
   std::vector<Rule *> toCheck(ruleWorklist);
   std::vector<Rule *> worklist(ruleWorklist);
@@ -783,10 +856,23 @@ void StaticSlicer::ruleIteration() {
     std::swap(worklist, tmp);
   }
 
-  std::vector<Path *> paths;
+  // Each (rule, criterion) pair is backtracked as an independent task into
+  // its own path buffer. The buffers are handed to the rules in task order
+  // afterwards, so the result does not depend on the thread count.
+  struct BacktrackTask {
+    const Instruction *call;
+    const Instruction *inst;
+    Rule *rule;
+    Path *parent;
+    std::vector<Path *> paths;
+  };
+
+  auto createPath = [&](BacktrackTask &task) {
+    const Instruction *call = task.call;
+    const Instruction *inst = task.inst;
+    Path *parent = task.parent;
+    std::vector<Path *> &p = task.paths;
 
-  auto createPath = [&](const Instruction *call, const Instruction *inst,
-                        Rule *rule, Path *parent = nullptr) {
     InsInfo *C_info = getInsInfo(inst);
     assert(C_info);
 
@@ -819,9 +905,8 @@ void StaticSlicer::ruleIteration() {
       path->setEntry(element);
     }
 
-    std::vector<Path *> p;
     std::mutex pathLock;
-    if (C_info->backtrack(this, element, p, pathLock, *rule)) {
+    if (C_info->backtrack(this, element, p, pathLock, *task.rule)) {
       pathLock.lock();
       if (std::find_if(p.begin(), p.end(), [path](const Path *other) {
             return *path == *other;
@@ -832,64 +917,142 @@ void StaticSlicer::ruleIteration() {
     } else {
       delete (path);
     }
-    std::sort(p.begin(), p.end());
-
-    bool modified = false;
-    do {
-      modified = false;
-      for (std::vector<Path *>::iterator i = p.begin();
-           i != p.end() && !modified; ++i) {
-        std::vector<Path *>::iterator j = i;
-        std::advance(j, 1);
-        for (; j != p.end(); ++j) {
-          if (i == j)
-            continue;
-          if (**i == **j) {
-            p.erase(j);
-            modified = true;
-            break;
-          }
-        }
-      }
-    } while (modified);
 
-    rule->addPaths(p);
+    // Keep the first of every group of equal paths, in the order backtracking
+    // found them. Only paths with the same structural hash need to be
+    // compared.
+    std::unordered_map<size_t, std::vector<Path *>> seen;
+    std::vector<Path *> unique;
+    for (auto &path : p) {
+      std::vector<Path *> &bucket = seen[path->getHash()];
+      if (std::find_if(bucket.begin(), bucket.end(), [path](const Path *other) {
+            return *path == *other;
+          }) != bucket.end())
+        continue;
+      bucket.push_back(path);
+      unique.push_back(path);
+    }
+    p.swap(unique);
+  };
+
+  // Rules that continue the paths of a parent rule can only start once the
+  // parent's paths are complete, so the rules are backtracked in
+  // generations: a rule runs one generation after its parent.
+  std::map<Rule *, unsigned> generation;
+  std::function<unsigned(Rule *, unsigned)> getGeneration =
+      [&](Rule *rule, unsigned depth) -> unsigned {
+    auto known = generation.find(rule);
+    if (known != generation.end())
+      return known->second;
+    unsigned g = 0;
+    if (rule->getParentRuleTitle().size() && depth < toCheck.size()) {
+      for (auto &r : toCheck) {
+        if (r != rule && r->getRuleTitle() == rule->getParentRuleTitle())
+          g = std::max(g, getGeneration(r, depth + 1) + 1);
+      }
+    }
+    return generation[rule] = g;
   };
 
+  unsigned lastGeneration = 0;
+  for (auto &rule : toCheck)
+    lastGeneration = std::max(lastGeneration, getGeneration(rule, 0));
+
   errs() << "Backtrack\n";
-  for (std::vector<Rule *>::iterator rule = toCheck.begin();
-       rule != toCheck.end(); ++rule) {
-    errs() << (*rule)->getRuleTitle() << "\n";
-    for (auto &C : (*rule)->getInitialInstruction()) {
-      for (auto &C_pre : C.second) {
-        createPath(C.first.first, C_pre.first, C_pre.second);
-      }
+  PhaseProfile::begin("backtrack");
+  for (unsigned g = 0; g <= lastGeneration; ++g) {
+    std::vector<BacktrackTask> tasks;
+    auto addTask = [&](const Instruction *call, const Instruction *inst,
+                       Rule *rule, Path *parent) {
+      BacktrackTask task;
+      task.call = call;
+      task.inst = inst;
+      task.rule = rule;
+      task.parent = parent;
+      tasks.push_back(task);
+    };
+
+    for (std::vector<Rule *>::iterator rule = toCheck.begin();
+         rule != toCheck.end(); ++rule) {
+      if (generation[*rule] != g)
+        continue;
+      errs() << (*rule)->getRuleTitle() << "\n";
+      for (auto &C : (*rule)->getInitialInstruction()) {
+        for (auto &C_pre : C.second) {
+          addTask(C.first.first, C_pre.first, C_pre.second, nullptr);
+        }
 
-      if ((*rule)->getParentRuleTitle().size()) {
-        for (auto &p : rules) {
-          if (p->getRuleTitle() == (*rule)->getParentRuleTitle()) {
-            for (auto &path : p->getPaths()) {
-              if (path->getLast()->getElement() == C.first.first) {
-                p->setDismissable(path);
-                createPath(C.first.first, C.first.second, *rule,
-                           new Path(*path));
+        if ((*rule)->getParentRuleTitle().size()) {
+          for (auto &p : rules) {
+            if (p->getRuleTitle() == (*rule)->getParentRuleTitle()) {
+              for (auto &path : p->getPaths()) {
+                if (path->getLast()->getElement() == C.first.first) {
+                  p->setDismissable(path);
+                  addTask(C.first.first, C.first.second, *rule,
+                          new Path(*path));
+                }
               }
             }
           }
+        } else {
+          addTask(C.first.first, C.first.second, *rule, nullptr);
         }
-      } else {
-        createPath(C.first.first, C.first.second, *rule);
       }
     }
+
+    // Tasks extend their parent path in place, so the sequential run
+    // starts from copies taken before the parallel one.
+    std::vector<BacktrackTask> sequential;
+    if (BacktrackVerify) {
+      sequential = tasks;
+      for (auto &task : sequential)
+        if (task.parent)
+          task.parent = new Path(*task.parent);
+    }
+
+    parallelFor(tasks.size(), BacktrackThreads,
+                [&](size_t idx) { createPath(tasks[idx]); });
+
+    if (BacktrackVerify) {
+      for (size_t idx = 0; idx < tasks.size(); ++idx) {
+        BacktrackTask &task = sequential[idx];
+        createPath(task);
+        std::vector<Path *> &expected = task.paths;
+        std::vector<Path *> &actual = tasks[idx].paths;
+        bool same = expected.size() == actual.size();
+        for (size_t i = 0; same && i < expected.size(); ++i)
+          same = *expected[i] == *actual[i];
+        if (!same)
+          report_fatal_error("parallel backtracking of " +
+                             task.rule->getRuleTitle() +
+                             " differs from the sequential run");
+        for (auto &path : expected)
+          delete (path);
+      }
+    }
+
+    for (auto &task : tasks)
+      task.rule->addPaths(task.paths);
   }
 
+  PhaseProfile::end();
   errs() << "Backtrack done\n";
 
+  PhaseProfile::begin("checkRules");
+
   for (auto &rule : ruleWorklist) {
     rule->removeDismissablePaths();
     errs() << rule->getRuleTitle() << "\n";
     rule->checkRule();
+    if (reportWriter) {
+      errs() << rule->getResults().size() << " paths\n";
+      reportWriter->addResults(rule, rule->getResults());
+      rule->releaseResults();
+    }
   }
+  PhaseProfile::end();
+  if (AreStatisticsEnabled())
+    RuleProgram::printStatistics(errs());
 
   std::vector<Rule *> checkRules(ruleWorklist);
   ruleWorklist.clear();
@@ -911,6 +1074,8 @@ void StaticSlicer::computeSlice() {
   while (ruleWorklist.size()) {
     ruleIteration();
   }
+  if (AreStatisticsEnabled())
+    printScopeStatistics(errs());
 }
 
 // TODO: slice function.
@@ -969,8 +1134,9 @@ InsInfo *StaticSlicer::getInsInfo(const Instruction *I) {
     return nullptr;
   }
   const Function *f = I->getParent()->getParent();
-  FunctionStaticSlicer *fss = slicers[f];
-  if (!fss->isInitialized())
+  Slicers::const_iterator it = slicers.find(f);
+  FunctionStaticSlicer *fss = it != slicers.end() ? it->second : nullptr;
+  if (!fss || !fss->isInitialized())
     return nullptr;
   return fss->getInsInfo(I);
 }
@@ -987,24 +1153,35 @@ bool Slicer::runOnModule(Module &M) {
   using llvm::slicing::Constraint;
   using llvm::slicing::Parameter;
   using llvm::slicing::Rule;
+  PhaseProfile::begin("slicer");
+  PhaseProfile::begin("parseRules");
   std::vector<Rule *> rules = llvm::slicing::parseRules();
+  PhaseProfile::end();
 
   ptr::PointsToSets *PS = new ptr::PointsToSets();
   {
+    PhaseProfile::Scope ProfileScope("pointsTo");
     ptr::ProgramStructure P(M);
     errs() << "[i]first ProgramStructure\n";
     computePointsToSets(P, *PS, rules);
   }
 
+  PhaseProfile::begin("callgraph");
   callgraph::Callgraph CG(M, *PS);
+  PhaseProfile::end();
 
   mods::Modifies MOD;
   {
+    PhaseProfile::Scope ProfileScope("mods");
+    PhaseProfile::begin("mods.programStructure");
     mods::ProgramStructure P1(M, *PS);
+    PhaseProfile::end();
     errs() << "[i]second programStructure\n";
+    PhaseProfile::Scope ComputeScope("mods.computeModifies");
     computeModifies(P1, CG, *PS, MOD);
   }
   errs() << "done\n";
+  ptr::printPointsToCacheStatistics(errs());
 
   for (auto &r : rules) {
     if (r->getParentRuleTitle().size()) {
@@ -1016,12 +1193,6 @@ bool Slicer::runOnModule(Module &M) {
     }
   }
 
-  slicing::StaticSlicer SS(this, M, (*PS), CG, MOD, rules);
-  SS.computeSlice();
-
-  free(PS);
-  bool s = SS.sliceModule();
-
   raw_fd_ostream *report_stream = nullptr;
   if (ReportFilename.length()) {
     std::error_code EC;
@@ -1033,15 +1204,26 @@ bool Slicer::runOnModule(Module &M) {
     }
   }
 
-  llvm::slicing::HTMLReportPrinter reportPrinter(report_stream ? *report_stream
-                                                               : nulls());
-  for (auto &rule : SS.getRules()) {
-    errs() << "Print results of \"" << rule->getRuleTitle() << "\"\n";
-    const Rule::CompletePathResultList_t &results = rule->getResults();
-    errs() << results.size() << " paths\n";
-    reportPrinter.addResults(rule, results);
-  }
-  reportPrinter.close();
+  // The report is written while the rules are checked, so results do not
+  // pile up until the end of the analysis.
+  std::unique_ptr<llvm::slicing::ReportWriter> reportWriter =
+      llvm::slicing::ReportWriter::create(
+          report_stream ? *report_stream : nulls(), ReportFormat);
+
+  slicing::StaticSlicer SS(this, M, (*PS), CG, MOD, rules);
+  SS.setReportWriter(reportWriter.get());
+  PhaseProfile::begin("computeSlice");
+  SS.computeSlice();
+  PhaseProfile::end();
+
+  free(PS);
+  PhaseProfile::begin("sliceModule");
+  bool s = SS.sliceModule();
+  PhaseProfile::end();
+
+  reportWriter->close();
+  PhaseProfile::end();
+  PhaseProfile::write();
 
   if (report_stream) {
     report_stream->close();
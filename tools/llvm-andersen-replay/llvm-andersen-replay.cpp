@@ -0,0 +1,192 @@
+//===--- llvm-andersen-replay.cpp - Replay the Andersen solver ------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Runs the Andersen solver on constraints written by -dump-cons-binary,
+// without the module or the Mach-O binary they were collected from, once
+// for each -config of HVN, HU, HCD and LCD:
+//
+//   llvm-andersen-replay cons.andc -config=none,hvn+hu,hvn+hu+hcd+lcd
+//
+// Each configuration is run -repeat times on a fresh copy of the dump and
+// reported with its fastest run. The points-to sets of all nodes must come
+// out the same in every configuration.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Analysis/Andersen/Andersen.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+extern cl::opt<bool> EnableHVN;
+extern cl::opt<bool> EnableHU;
+extern cl::opt<bool> EnableHCD;
+extern cl::opt<bool> EnableLCD;
+
+static cl::opt<std::string> InputFilename(cl::Positional,
+                                          cl::desc("<constraint dump>"),
+                                          cl::Required);
+
+static cl::list<std::string>
+    Configs("config",
+            cl::desc("Solver configurations to run, each none or a "
+                     "'+'-separated list of hvn, hu, hcd and lcd"),
+            cl::CommaSeparated);
+
+static cl::opt<unsigned> Repeat("repeat",
+                                cl::desc("Runs of each configuration"),
+                                cl::init(3));
+
+namespace {
+struct Config {
+  std::string Name;
+  bool HVN, HU, HCD, LCD;
+};
+
+bool parseConfig(StringRef Name, Config &C) {
+  C = {Name, false, false, false, false};
+  if (Name == "none")
+    return true;
+  SmallVector<StringRef, 4> Parts;
+  Name.split(Parts, '+');
+  for (StringRef Part : Parts) {
+    if (Part == "hvn")
+      C.HVN = true;
+    else if (Part == "hu")
+      C.HU = true;
+    else if (Part == "hcd")
+      C.HCD = true;
+    else if (Part == "lcd")
+      C.LCD = true;
+    else
+      return false;
+  }
+  return true;
+}
+
+// The points-to set of every node, through the node it was merged into.
+std::string digestSolution(Andersen &A) {
+  AndersNodeFactory &Nodes = A.getNodeFactory();
+  const std::map<NodeIndex, AndersPtsSet> &Graph = A.getPointsToGraph();
+  std::map<NodeIndex, uint64_t> SetHashes;
+  MD5 Hash;
+  for (NodeIndex Node = 0; Node < Nodes.getNumNodes(); ++Node) {
+    NodeIndex Rep = Nodes.getMergeTarget(Node);
+    auto Cached = SetHashes.find(Rep);
+    if (Cached == SetHashes.end()) {
+      uint64_t SetHash = 0;
+      auto Set = Graph.find(Rep);
+      if (Set != Graph.end()) {
+        std::vector<NodeIndex> Elements;
+        for (NodeIndex Element : Set->second)
+          Elements.push_back(Element);
+        SetHash = hash_combine_range(Elements.begin(), Elements.end());
+      }
+      Cached = SetHashes.insert(std::make_pair(Rep, SetHash)).first;
+    }
+    uint64_t Entry[2] = {Node, Cached->second};
+    Hash.update(ArrayRef<uint8_t>((const uint8_t *)Entry, sizeof(Entry)));
+  }
+  MD5::MD5Result Result;
+  Hash.final(Result);
+  SmallString<32> Digest;
+  MD5::stringifyResult(Result, Digest);
+  return Digest.str();
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  sys::PrintStackTraceOnErrorSignal();
+  PrettyStackTraceProgram X(argc, argv);
+  llvm_shutdown_obj Y;
+  cl::ParseCommandLineOptions(argc, argv, "Andersen solver replay\n");
+
+  ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer =
+      MemoryBuffer::getFile(InputFilename);
+  if (!Buffer) {
+    errs() << InputFilename << ": " << Buffer.getError().message() << "\n";
+    return 1;
+  }
+
+  std::vector<std::string> Names(Configs.begin(), Configs.end());
+  if (Names.empty())
+    Names = {"none", "hvn", "hu", "hvn+hu", "hcd", "lcd", "hcd+lcd",
+             "hvn+hu+hcd+lcd"};
+  std::vector<Config> Runs;
+  for (const std::string &Name : Names) {
+    Config C;
+    if (!parseConfig(Name, C)) {
+      errs() << "unknown configuration " << Name << "\n";
+      return 1;
+    }
+    Runs.push_back(C);
+  }
+
+  outs() << "config             optimize      solve      hvn       hu      hcd"
+            "      lcd         pops  solution\n";
+  std::string Expected;
+  bool Differs = false;
+  for (const Config &C : Runs) {
+    EnableHVN = C.HVN;
+    EnableHU = C.HU;
+    EnableHCD = C.HCD;
+    EnableLCD = C.LCD;
+
+    Andersen::SolverIteration Best;
+    std::string Digest;
+    for (unsigned R = 0; R < std::max(1u, (unsigned)Repeat); ++R) {
+      Andersen A;
+      std::string Error;
+      if (!A.readConstraintDump((*Buffer)->getBuffer(), Error)) {
+        errs() << InputFilename << ": " << Error << "\n";
+        return 1;
+      }
+      A.replaySolver();
+      const Andersen::SolverIteration &It = A.getSolverIterations().back();
+      if (!R || It.OptimizeSeconds + It.SolveSeconds <
+                    Best.OptimizeSeconds + Best.SolveSeconds)
+        Best = It;
+      if (!R)
+        Digest = digestSolution(A);
+    }
+
+    if (Expected.empty())
+      Expected = Digest;
+    bool Same = Digest == Expected;
+    Differs |= !Same;
+    outs() << format("%-16s %10.4f %10.4f %8llu %8llu %8llu %8llu %12llu  ",
+                     C.Name.c_str(), Best.OptimizeSeconds, Best.SolveSeconds,
+                     (unsigned long long)Best.MergedHVN,
+                     (unsigned long long)Best.MergedHU,
+                     (unsigned long long)Best.MergedHCD,
+                     (unsigned long long)Best.MergedLCD,
+                     (unsigned long long)Best.WorklistPops)
+           << Digest.substr(0, 8) << (Same ? "" : " differs") << "\n";
+  }
+
+  if (Differs) {
+    errs() << "configurations disagree on the points-to sets\n";
+    return 1;
+  }
+  return 0;
+}
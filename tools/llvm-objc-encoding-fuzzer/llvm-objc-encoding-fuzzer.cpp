@@ -0,0 +1,75 @@
+//===--- llvm-objc-encoding-fuzzer.cpp - Fuzzer for MethodLayout ----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Build tool to fuzz the decoder of Objective-C method type encodings using
+// lib/Fuzzer. Encodings come straight from the binary under analysis, so the
+// decoder must not crash on anything. llvm-slicer-bench -mode=encodings
+// -corpus=<dir> writes those of a real binary as a seed corpus.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Analysis/Andersen/ObjectiveCClassInfo.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdlib>
+
+using namespace llvm;
+using namespace llvm::ObjectiveC;
+
+// Aborts rather than exiting, so libFuzzer sees a crash and keeps the input.
+static void fail(const char *Msg) {
+  errs() << Msg << "\n";
+  abort();
+}
+
+static bool sameArgs(const MethodLayout &A, const MethodLayout &B) {
+  if (A.getArgs().size() != B.getArgs().size())
+    return false;
+  for (size_t I = 0; I < A.getArgs().size(); ++I) {
+    const MethodLayout::Arg &X = A.getArgs()[I];
+    const MethodLayout::Arg &Y = B.getArgs()[I];
+    if (X.Kind != Y.Kind || X.Reg != Y.Reg || X.NumRegs != Y.NumRegs ||
+        X.Class != Y.Class)
+      return false;
+  }
+  return true;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *Data, size_t Size) {
+  StringRef Encoding((const char *)Data, Size);
+  MethodLayout Decoded = MethodLayout::decode(Encoding);
+  for (const MethodLayout::Arg &A : Decoded.getArgs()) {
+    switch (A.Kind) {
+    case MethodLayout::GPR:
+      // X0 to X7 are register file indices 5 to 12.
+      if (A.Reg < 5 || A.Reg + A.NumRegs > 13)
+        fail("Argument outside of X0-X7");
+      break;
+    case MethodLayout::FPR:
+      if (A.Reg + A.NumRegs > 8)
+        fail("Argument outside of V0-V7");
+      break;
+    case MethodLayout::Stack:
+      break;
+    }
+  }
+  for (const MethodLayout::RegType_t &R : Decoded.getRegTypes())
+    if (R.first < 5 || R.first > 12)
+      fail("Object outside of X0-X7");
+
+  // Decoding must only depend on the encoding. MethodLayout::get() would
+  // keep every input alive in its cache, so compare with a fresh decode.
+  MethodLayout Again = MethodLayout::decode(Encoding);
+  if (Again.getEncoding() != Encoding || !sameArgs(Again, Decoded) ||
+      Again.getRegTypes() != Decoded.getRegTypes() ||
+      Again.isComplete() != Decoded.isComplete())
+    fail("Decoding the same encoding twice differs");
+  return 0;
+}
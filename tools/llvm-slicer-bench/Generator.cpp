@@ -0,0 +1,433 @@
+//===--- Generator.cpp - Synthetic lifted modules for llvm-slicer-bench ---===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Generator.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/NoFolder.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/MachO.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/raw_ostream.h"
+#include "nlohmann/json.hpp"
+#include <cstring>
+#include <random>
+
+using namespace llvm;
+using namespace llvm::slicerbench;
+
+namespace {
+const uint64_t ImageBase = 0x100000000;
+const uint64_t PageSize = 0x4000;
+
+// Segments in load command order; bind opcodes refer to them by index.
+const char *const SegText = "__TEXT";
+const char *const SegData = "__DATA";
+const unsigned DataSegmentIndex = 1;
+
+template <typename T> void put(std::string &Image, size_t &Pos, T Value) {
+  if (sys::IsBigEndianHost)
+    MachO::swapStruct(Value);
+  memcpy(&Image[Pos], &Value, sizeof(T));
+  Pos += sizeof(T);
+}
+
+void copyName(char (&Dst)[16], const char *Src) {
+  // Names of 16 characters fill the field without a terminator.
+  strncpy(Dst, Src, sizeof(Dst));
+}
+} // namespace
+
+MachOFixture::MachOFixture()
+    : Classes({"NSString", "NSData", "NSMutableData", "NSMutableDictionary",
+               "NSUserDefaults"}),
+      Selectors({"alloc", "init", "stringWithUTF8String:",
+                 "dataWithBytes:length:", "initWithData:encoding:",
+                 "setObject:forKey:", "objectForKey:", "standardUserDefaults",
+                 "length", "bytes"}),
+      NumGlobals(16) {
+  std::string Methnames;
+  for (auto &Sel : Selectors)
+    Methnames += Sel + '\0';
+  std::string Globals;
+  for (unsigned Idx = 0; Idx < NumGlobals; ++Idx) {
+    uint64_t Value = Idx + 1;
+    Globals.append((const char *)&Value, sizeof(Value));
+  }
+
+  const uint32_t Code = MachO::S_ATTR_PURE_INSTRUCTIONS |
+                        MachO::S_ATTR_SOME_INSTRUCTIONS;
+  const uint32_t CStrings = MachO::S_CSTRING_LITERALS;
+  // ret
+  const char Ret[] = {'\xc0', '\x03', '\x5f', '\xd6'};
+  Sections = {
+      {SegText, "__text", Code, std::string(Ret, sizeof(Ret)), 0, 0},
+      {SegText, "__objc_methname", CStrings, Methnames, 0, 0},
+      {SegText, "__objc_classname", CStrings, std::string("Bench\0", 6), 0, 0},
+      {SegText, "__objc_methtype", CStrings, std::string("v16@0:8\0", 8), 0,
+       0},
+      {SegText, "__cstring", CStrings, std::string("bench\0", 6), 0, 0},
+      {SegData, "__got", 0, std::string(8, '\0'), 0, 0},
+      {SegData, "__cfstring", 0, "", 0, 0},
+      {SegData, "__objc_classlist", 0, "", 0, 0},
+      {SegData, "__objc_superrefs", 0, "", 0, 0},
+      {SegData, "__objc_selrefs", MachO::S_LITERAL_POINTERS,
+       std::string(8 * Selectors.size(), '\0'), 0, 0},
+      {SegData, "__objc_classrefs", 0, std::string(8 * Classes.size(), '\0'),
+       0, 0},
+      {SegData, "__objc_const", 0, "", 0, 0},
+      {SegData, "__objc_data", 0, "", 0, 0},
+      {SegData, "__objc_ivar", 0, "", 0, 0},
+      {SegData, "__data", 0, Globals, 0, 0},
+  };
+  layout();
+}
+
+MachOFixture::Section &MachOFixture::getSection(StringRef Name) {
+  for (auto &S : Sections)
+    if (Name == S.Name)
+      return S;
+  llvm_unreachable("Unknown fixture section");
+}
+
+const MachOFixture::Section &MachOFixture::getSection(StringRef Name) const {
+  return const_cast<MachOFixture *>(this)->getSection(Name);
+}
+
+uint64_t MachOFixture::getClassRef(unsigned Idx) const {
+  return getSection("__objc_classrefs").Address + 8 * Idx;
+}
+
+uint64_t MachOFixture::getSelectorRef(unsigned Idx) const {
+  return getSection("__objc_selrefs").Address + 8 * Idx;
+}
+
+uint64_t MachOFixture::getGlobal(unsigned Idx) const {
+  return getSection("__data").Address + 8 * Idx;
+}
+
+void MachOFixture::layout() {
+  unsigned NumText = 0;
+  for (auto &S : Sections)
+    NumText += S.Segment == SegText;
+  unsigned NumData = Sections.size() - NumText;
+
+  uint32_t SizeOfCmds = 2 * sizeof(MachO::segment_command_64) +
+                        Sections.size() * sizeof(MachO::section_64) +
+                        sizeof(MachO::dyld_info_command) +
+                        sizeof(MachO::symtab_command);
+  uint64_t Offset = sizeof(MachO::mach_header_64) + SizeOfCmds;
+  // Like a linked executable, __TEXT maps the headers, and every address is
+  // the image base plus the file offset.
+  uint64_t DataStart = 0;
+  for (auto &S : Sections) {
+    if (S.Segment == SegData && !DataStart)
+      Offset = DataStart = RoundUpToAlignment(Offset, PageSize);
+    Offset = RoundUpToAlignment(Offset, 8);
+    S.Offset = Offset;
+    S.Address = ImageBase + Offset;
+    Offset += S.Contents.size();
+  }
+  uint64_t DataEnd = RoundUpToAlignment(Offset, PageSize);
+
+  // Selector references point at the selector names.
+  Section &Methnames = getSection("__objc_methname");
+  Section &SelRefs = getSection("__objc_selrefs");
+  uint64_t Name = Methnames.Address;
+  for (unsigned Idx = 0; Idx < Selectors.size(); ++Idx) {
+    memcpy(&SelRefs.Contents[8 * Idx], &Name, sizeof(Name));
+    Name += Selectors[Idx].size() + 1;
+  }
+
+  // Class references are zero and bound to the Foundation classes.
+  BindOpcodes.clear();
+  raw_string_ostream Bind(BindOpcodes);
+  for (unsigned Idx = 0; Idx < Classes.size(); ++Idx) {
+    Bind << (char)(MachO::BIND_OPCODE_SET_DYLIB_ORDINAL_IMM | 1);
+    Bind << (char)MachO::BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM
+         << "_OBJC_CLASS_$_" << Classes[Idx] << '\0';
+    Bind << (char)(MachO::BIND_OPCODE_SET_TYPE_IMM | MachO::BIND_TYPE_POINTER);
+    Bind << (char)(MachO::BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB |
+                   DataSegmentIndex);
+    encodeULEB128(getClassRef(Idx) - ImageBase - DataStart, Bind);
+    Bind << (char)MachO::BIND_OPCODE_DO_BIND;
+  }
+  Bind << (char)MachO::BIND_OPCODE_DONE;
+  Bind.flush();
+  BindOffset = DataEnd;
+
+  Image.assign(DataEnd + BindOpcodes.size(), '\0');
+  size_t Pos = 0;
+  MachO::mach_header_64 Header = {};
+  Header.magic = MachO::MH_MAGIC_64;
+  Header.cputype = MachO::CPU_TYPE_ARM64;
+  Header.cpusubtype = MachO::CPU_SUBTYPE_ARM64_ALL;
+  Header.filetype = MachO::MH_EXECUTE;
+  Header.ncmds = 4;
+  Header.sizeofcmds = SizeOfCmds;
+  put(Image, Pos, Header);
+
+  auto putSegment = [&](const char *Segment, unsigned NumSections,
+                        uint64_t FileOff, uint64_t FileSize, uint32_t Prot) {
+    MachO::segment_command_64 Seg = {};
+    Seg.cmd = MachO::LC_SEGMENT_64;
+    Seg.cmdsize = sizeof(Seg) + NumSections * sizeof(MachO::section_64);
+    copyName(Seg.segname, Segment);
+    Seg.vmaddr = ImageBase + FileOff;
+    Seg.vmsize = FileSize;
+    Seg.fileoff = FileOff;
+    Seg.filesize = FileSize;
+    Seg.maxprot = Seg.initprot = Prot;
+    Seg.nsects = NumSections;
+    put(Image, Pos, Seg);
+    for (auto &S : Sections) {
+      if (S.Segment != Segment)
+        continue;
+      MachO::section_64 Sect = {};
+      copyName(Sect.sectname, S.Name);
+      copyName(Sect.segname, S.Segment);
+      Sect.addr = S.Address;
+      Sect.size = S.Contents.size();
+      Sect.offset = S.Offset;
+      Sect.align = 3;
+      Sect.flags = S.Flags;
+      put(Image, Pos, Sect);
+    }
+  };
+  putSegment(SegText, NumText, 0, DataStart,
+             MachO::VM_PROT_READ | MachO::VM_PROT_EXECUTE);
+  putSegment(SegData, NumData, DataStart, DataEnd - DataStart,
+             MachO::VM_PROT_READ | MachO::VM_PROT_WRITE);
+
+  MachO::dyld_info_command DyldInfo = {};
+  DyldInfo.cmd = MachO::LC_DYLD_INFO_ONLY;
+  DyldInfo.cmdsize = sizeof(DyldInfo);
+  DyldInfo.bind_off = BindOffset;
+  DyldInfo.bind_size = BindOpcodes.size();
+  put(Image, Pos, DyldInfo);
+
+  MachO::symtab_command Symtab = {};
+  Symtab.cmd = MachO::LC_SYMTAB;
+  Symtab.cmdsize = sizeof(Symtab);
+  put(Image, Pos, Symtab);
+
+  for (auto &S : Sections)
+    memcpy(&Image[S.Offset], S.Contents.data(), S.Contents.size());
+  memcpy(&Image[BindOffset], BindOpcodes.data(), BindOpcodes.size());
+}
+
+void MachOFixture::write(raw_ostream &OS) const { OS << Image; }
+
+namespace {
+// Indices into the lifted register struct.
+const unsigned RegSP = 3;
+const unsigned RegX0 = 5;
+const unsigned NumArgRegs = 8;
+const unsigned NumRegisters = 40;
+// 8 byte stack slots of each frame.
+const unsigned NumSlots = 8;
+
+class ModuleGenerator {
+public:
+  ModuleGenerator(LLVMContext &C, const MachOFixture &Fixture,
+                  const GeneratorOptions &Options)
+      : C(C), Fixture(Fixture), Options(Options), Rng(Options.Seed),
+        M(new Module("bench", C)), B(C) {}
+
+  std::unique_ptr<Module> generate();
+
+private:
+  typedef IRBuilder<true, NoFolder> Builder_t;
+
+  Value *reg(unsigned Idx) { return Regs[Idx]; }
+  Value *x(unsigned Idx) { return Regs[RegX0 + Idx]; }
+  Value *slot(unsigned Idx);
+  Value *loadConstAddress(uint64_t Address);
+  Value *loadSlot() { return B.CreateLoad(slot(Rng() % NumSlots)); }
+  void storeSlot(Value *V) { B.CreateStore(V, slot(Rng() % NumSlots)); }
+
+  void emitFunction(unsigned Idx);
+  void emitCall(unsigned Idx);
+
+  LLVMContext &C;
+  const MachOFixture &Fixture;
+  const GeneratorOptions &Options;
+  std::mt19937 Rng;
+  std::unique_ptr<Module> M;
+  Builder_t B;
+  StructType *RegsTy;
+  Function *MsgSend, *CCCrypt, *CCMD5;
+  std::vector<Function *> Functions;
+  std::vector<Value *> Regs;
+};
+
+Value *ModuleGenerator::slot(unsigned Idx) {
+  Value *SP = B.CreateLoad(reg(RegSP));
+  return B.CreateIntToPtr(B.CreateAdd(SP, B.getInt64(8 * Idx)),
+                          B.getInt64Ty()->getPointerTo());
+}
+
+Value *ModuleGenerator::loadConstAddress(uint64_t Address) {
+  return B.CreateLoad(
+      B.CreateIntToPtr(B.getInt64(Address), B.getInt64Ty()->getPointerTo()));
+}
+
+void ModuleGenerator::emitCall(unsigned Idx) {
+  unsigned Kind = Rng() % 5;
+  if (Kind == 2 && !Idx)
+    Kind = 0;
+  switch (Kind) {
+  case 0:
+  case 1: {
+    // [Class selector:arg]
+    unsigned Class = Rng() % Fixture.getClasses().size();
+    unsigned Sel = Rng() % Fixture.getSelectors().size();
+    B.CreateStore(loadConstAddress(Fixture.getClassRef(Class)), x(0));
+    B.CreateStore(loadConstAddress(Fixture.getSelectorRef(Sel)), x(1));
+    B.CreateStore(loadSlot(), x(2));
+    B.CreateStore(B.getInt64(Rng() % 64), x(3));
+    B.CreateCall(MsgSend, {&*Functions[Idx]->arg_begin()});
+    storeSlot(B.CreateLoad(x(0)));
+    break;
+  }
+  case 2: {
+    // Callees precede their callers, so the call graph is acyclic.
+    Function *Callee = Functions[Rng() % Idx];
+    B.CreateStore(loadSlot(), x(0));
+    B.CreateStore(loadSlot(), x(1));
+    B.CreateCall(Callee, {&*Functions[Idx]->arg_begin()});
+    storeSlot(B.CreateLoad(x(0)));
+    break;
+  }
+  case 3: {
+    // CCCrypt(op, alg, options, key, keyLength, iv, ...)
+    B.CreateStore(B.getInt64(Rng() % 2), x(0));
+    B.CreateStore(B.getInt64(0), x(1));
+    B.CreateStore(B.getInt64(1 + Rng() % 3), x(2));
+    B.CreateStore(loadSlot(), x(3));
+    if (Rng() % 2)
+      B.CreateStore(B.getInt64(16 + 8 * (Rng() % 3)), x(4));
+    else
+      B.CreateStore(
+          loadConstAddress(Fixture.getGlobal(Rng() % Fixture.getNumGlobals())),
+          x(4));
+    B.CreateStore(loadSlot(), x(5));
+    B.CreateCall(CCCrypt, {&*Functions[Idx]->arg_begin()});
+    break;
+  }
+  case 4:
+    // CC_MD5(data, length, md)
+    B.CreateStore(loadSlot(), x(0));
+    B.CreateStore(B.getInt64(Rng() % 256), x(1));
+    B.CreateStore(loadSlot(), x(2));
+    B.CreateCall(CCMD5, {&*Functions[Idx]->arg_begin()});
+    storeSlot(B.CreateLoad(x(0)));
+    break;
+  }
+}
+
+void ModuleGenerator::emitFunction(unsigned Idx) {
+  Function *F = Functions[Idx];
+  Value *RegState = &*F->arg_begin();
+  B.SetInsertPoint(BasicBlock::Create(C, "entry", F));
+
+  // The lifter addresses each register through a GEP in the entry block.
+  Regs.assign(NumRegisters, nullptr);
+  Regs[RegSP] = B.CreateStructGEP(RegsTy, RegState, RegSP, "SP");
+  for (unsigned Reg = 0; Reg <= NumArgRegs; ++Reg)
+    Regs[RegX0 + Reg] = B.CreateStructGEP(RegsTy, RegState, RegX0 + Reg,
+                                          "X" + std::to_string(Reg));
+
+  // sub sp, sp, #frame; spill the parameters
+  Value *SP = B.CreateLoad(reg(RegSP));
+  B.CreateStore(B.CreateSub(SP, B.getInt64(8 * NumSlots)), reg(RegSP));
+  B.CreateStore(B.CreateLoad(x(0)), slot(0));
+  B.CreateStore(B.CreateLoad(x(1)), slot(1));
+
+  unsigned Blocks = std::max(1u, Options.Blocks);
+  for (unsigned Block = 0; Block < Blocks; ++Block) {
+    unsigned Calls = Options.Calls / Blocks + (Block < Options.Calls % Blocks);
+    for (unsigned Call = 0; Call < Calls; ++Call)
+      emitCall(Idx);
+
+    // A diamond that conditionally overwrites a stack slot.
+    std::string Suffix = std::to_string(Block);
+    BasicBlock *Then = BasicBlock::Create(C, "then" + Suffix, F);
+    BasicBlock *Join = BasicBlock::Create(C, "join" + Suffix, F);
+    B.CreateCondBr(B.CreateICmpEQ(B.CreateLoad(x(0)), B.getInt64(0)), Then,
+                   Join);
+    B.SetInsertPoint(Then);
+    storeSlot(B.getInt64(Rng() % 64));
+    B.CreateBr(Join);
+    B.SetInsertPoint(Join);
+  }
+
+  // The result is returned in X0.
+  B.CreateStore(loadSlot(), x(0));
+  SP = B.CreateLoad(reg(RegSP));
+  B.CreateStore(B.CreateAdd(SP, B.getInt64(8 * NumSlots)), reg(RegSP));
+  B.CreateRetVoid();
+}
+
+std::unique_ptr<Module> ModuleGenerator::generate() {
+  RegsTy = StructType::create(
+      C, std::vector<Type *>(NumRegisters, Type::getInt64Ty(C)), "regset");
+  FunctionType *FTy = FunctionType::get(
+      Type::getVoidTy(C), {RegsTy->getPointerTo()}, false);
+  MsgSend = Function::Create(FTy, GlobalValue::ExternalLinkage, "objc_msgSend",
+                             M.get());
+  CCCrypt = Function::Create(FTy, GlobalValue::ExternalLinkage, "CCCrypt",
+                             M.get());
+  CCMD5 =
+      Function::Create(FTy, GlobalValue::ExternalLinkage, "CC_MD5", M.get());
+
+  for (unsigned Idx = 0; Idx < Options.Functions; ++Idx)
+    Functions.push_back(Function::Create(
+        FTy, GlobalValue::ExternalLinkage,
+        "-[Bench" + std::to_string(Idx / 8) + " method" +
+            std::to_string(Idx % 8) + ":]",
+        M.get()));
+  for (unsigned Idx = 0; Idx < Options.Functions; ++Idx)
+    emitFunction(Idx);
+  return std::move(M);
+}
+} // namespace
+
+std::unique_ptr<Module>
+llvm::slicerbench::generateModule(LLVMContext &C, const MachOFixture &Fixture,
+                                  const GeneratorOptions &Options) {
+  return ModuleGenerator(C, Fixture, Options).generate();
+}
+
+void llvm::slicerbench::writeRules(raw_ostream &OS) {
+  typedef nlohmann::json json;
+  auto constInt = [](const char *Compare, int Value) {
+    return json{{"type", "STRICT"},
+                {"conditionType", "ConstInt"},
+                {Compare, Value}};
+  };
+  auto criterion = [](const char *Name, const char *Parameter) {
+    return json::array({{{"name", Name}, {"parameter", Parameter}}});
+  };
+  json Rules = json::array();
+  Rules.push_back({{"name", "bench: CCCrypt in ECB mode"},
+                   {"conditions", json::array({constInt("equal", 3)})},
+                   {"criterion", criterion("CCCrypt", "X2")}});
+  Rules.push_back({{"name", "bench: CCCrypt with a short key"},
+                   {"conditions", json::array({constInt("loreq", 16)})},
+                   {"criterion", criterion("CCCrypt", "X4")}});
+  Rules.push_back(
+      {{"name", "bench: CC_MD5 of a constant string"},
+       {"conditions",
+        json::array({{{"type", "STRICT"}, {"conditionType", "ConstStr"}}})},
+       {"criterion", criterion("CC_MD5", "X0")}});
+  OS << Rules.dump(2) << "\n";
+}
@@ -0,0 +1,97 @@
+//===--- Generator.h - Synthetic lifted modules for llvm-slicer-bench -----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Generates modules in the shape the ARM64 lifter produces, together with the
+// Mach-O binary their constant addresses refer to and a rules file, so the
+// whole pipeline can be benchmarked without a real application.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TOOLS_LLVM_SLICER_BENCH_GENERATOR_H
+#define LLVM_TOOLS_LLVM_SLICER_BENCH_GENERATOR_H
+
+#include "llvm/ADT/StringRef.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace llvm {
+class LLVMContext;
+class Module;
+class raw_ostream;
+
+namespace slicerbench {
+
+struct GeneratorOptions {
+  unsigned Functions;
+  // Diamonds per function.
+  unsigned Blocks;
+  // Calls per function.
+  unsigned Calls;
+  unsigned Seed;
+};
+
+/*
+ * A minimal arm64 Mach-O executable with the Objective-C sections
+ * ObjectiveCBinary reads: selector references into __objc_methname and class
+ * references bound to Foundation classes by dyld bind opcodes. Addresses are
+ * the image base plus the file offset, as ObjectiveCBinary::getRAWData
+ * expects.
+ */
+class MachOFixture {
+public:
+  MachOFixture();
+
+  const std::vector<std::string> &getClasses() const { return Classes; }
+  const std::vector<std::string> &getSelectors() const { return Selectors; }
+
+  uint64_t getClassRef(unsigned Idx) const;
+  uint64_t getSelectorRef(unsigned Idx) const;
+  // An address in __data holding a constant, like a global variable.
+  uint64_t getGlobal(unsigned Idx) const;
+  unsigned getNumGlobals() const { return NumGlobals; }
+
+  void write(raw_ostream &OS) const;
+
+private:
+  struct Section {
+    const char *Segment;
+    const char *Name;
+    uint32_t Flags;
+    std::string Contents;
+    uint64_t Address;
+    uint32_t Offset;
+  };
+
+  Section &getSection(StringRef Name);
+  const Section &getSection(StringRef Name) const;
+  void layout();
+
+  std::vector<std::string> Classes;
+  std::vector<std::string> Selectors;
+  unsigned NumGlobals;
+  std::vector<Section> Sections;
+  std::string BindOpcodes;
+  uint32_t BindOffset;
+  std::string Image;
+};
+
+// Generates the functions of a lifted module referring to Fixture.
+std::unique_ptr<Module> generateModule(LLVMContext &C,
+                                       const MachOFixture &Fixture,
+                                       const GeneratorOptions &Options);
+
+// Writes rules with criteria on the external calls of generated modules.
+void writeRules(raw_ostream &OS);
+
+} // namespace slicerbench
+} // namespace llvm
+
+#endif
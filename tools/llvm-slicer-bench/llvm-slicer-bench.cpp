@@ -0,0 +1,739 @@
+//===--- llvm-slicer-bench.cpp - Benchmarks for the slicer ----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Benchmarks for the slicer:
+//
+//  -mode=rules     the cost of checking backtracking rules against paths,
+//                  comparing the virtual Constraint tree walk with the
+//                  compiled RuleProgram.
+//  -mode=generate  writes a synthetic lifted module, the Mach-O binary its
+//                  constants refer to and a rules file (-o <prefix>).
+//  -mode=pipeline  runs the passes of llvm-slicer on the input module, or on
+//                  a generated one, and compares the time of each phase and
+//                  a digest of the results with a -reference recorded by
+//                  -write-reference.
+//  -mode=encodings decodes the Objective-C type encoding of every method in
+//                  the input Mach-O binary, or of a built-in sample, with and
+//                  without the MethodLayout cache, and can write them out as
+//                  a fuzzing corpus (-corpus <dir>).
+//  -mode=demand    runs -mode=pipeline twice in child processes, with the
+//                  points-to sets of the solved graph and with -pts-demand,
+//                  and compares the time of each phase and the results. The
+//                  generated rules name two of the external functions only,
+//                  so most of the module is never queried.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Generator.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/PostDominators.h"
+#include "llvm/Analysis/Andersen/DetectParametersPass.h"
+#include "llvm/Analysis/Andersen/ObjectiveCBinary.h"
+#include "llvm/Analysis/Andersen/StackAccessPass.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/LLVMSlicer/StaticSlicer.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+#include "../../lib/LLVMSlicer/Backtrack/Constraint.h"
+#include "../../lib/LLVMSlicer/Backtrack/RuleProgram.h"
+#include "nlohmann/json.hpp"
+#include "../../lib/LLVMSlicer/Slicing/PostDominanceFrontier.h"
+#include <chrono>
+#include <memory>
+#include <random>
+
+using namespace llvm;
+using namespace llvm::slicing;
+
+namespace {
+enum BenchMode {
+  RulesMode,
+  GenerateMode,
+  PipelineMode,
+  EncodingsMode,
+  DemandMode
+};
+}
+
+static cl::opt<BenchMode> Mode(
+    "mode", cl::desc("Benchmark to run"),
+    cl::values(clEnumValN(RulesMode, "rules", "Rule evaluation"),
+               clEnumValN(GenerateMode, "generate",
+                          "Write a synthetic lifted module"),
+               clEnumValN(PipelineMode, "pipeline", "The llvm-slicer passes"),
+               clEnumValN(EncodingsMode, "encodings",
+                          "Objective-C type encoding decoding"),
+               clEnumValN(DemandMode, "demand",
+                          "The llvm-slicer passes with demand-driven "
+                          "points-to queries"),
+               clEnumValEnd),
+    cl::init(RulesMode));
+
+static cl::opt<std::string>
+    InputFilename(cl::Positional,
+                  cl::desc("<input .ll file, generated if not given, or "
+                           "Mach-O binary for -mode=encodings>"),
+                  cl::init(""));
+
+static cl::opt<std::string>
+    OutputPrefix("o", cl::desc("Prefix of the files written by -mode=generate"),
+                 cl::value_desc("prefix"), cl::init("bench"));
+
+static cl::opt<std::string>
+    CorpusDir("corpus",
+              cl::desc("Directory to write each distinct method encoding to "
+                       "with -mode=encodings"),
+              cl::value_desc("dir"), cl::init(""));
+
+// Named so they do not collide with the slicer's own -rules.
+static cl::opt<unsigned> NumRules("num-rules",
+                                  cl::desc("Number of synthetic rules"),
+                                  cl::init(1000));
+
+static cl::opt<unsigned> NumPaths("num-paths",
+                                  cl::desc("Number of synthetic paths"),
+                                  cl::init(100000));
+
+static cl::opt<unsigned>
+    NumStores("stores", cl::desc("Number of distinct path end points"),
+              cl::init(1024));
+
+static cl::opt<unsigned>
+    NumShapes("shapes",
+              cl::desc("Number of structurally distinct rule bodies"),
+              cl::init(64));
+
+static cl::opt<unsigned> Seed("seed", cl::desc("Random seed"), cl::init(1));
+
+static cl::opt<unsigned>
+    NumFunctions("functions", cl::desc("Functions of the generated module"),
+                 cl::init(200));
+
+static cl::opt<unsigned>
+    NumBlocks("blocks", cl::desc("Branches per generated function"),
+              cl::init(4));
+
+static cl::opt<unsigned>
+    NumCalls("calls", cl::desc("Calls per generated function"), cl::init(8));
+
+static cl::opt<std::string>
+    ReferenceFile("reference",
+                  cl::desc("Timings and digest to compare the pipeline with"),
+                  cl::init(""));
+
+static cl::opt<bool>
+    WriteReference("write-reference",
+                   cl::desc("Record the pipeline run as -reference"),
+                   cl::init(false));
+
+static cl::opt<double>
+    Tolerance("tolerance",
+              cl::desc("Slowdown of a phase over the reference that fails "
+                       "the benchmark"),
+              cl::init(0.25));
+
+static cl::opt<double>
+    MinSlowdown("min-slowdown",
+                cl::desc("Seconds a phase may always exceed the reference "
+                         "by, to ignore noise in short phases"),
+                cl::init(0.05));
+
+namespace {
+typedef std::chrono::steady_clock Clock;
+
+double secondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/*
+ * Builds a random constraint tree of ConstConstraints only. CallConstraint
+ * and IN/NOTIN need a call graph and a MachO binary and are left out.
+ */
+void addConstraints(Constraint *parent, std::mt19937 &rng, unsigned depth) {
+  unsigned n = 1 + rng() % 3;
+  for (unsigned i = 0; i < n; ++i) {
+    if (depth && rng() % 3 == 0) {
+      ChainConstraint *chain = new ChainConstraint(
+          Constraint::STRICT, (ChainConstraint::ChainType)(rng() % 3));
+      addConstraints(chain, rng, depth - 1);
+      parent->addConstraint(chain);
+      continue;
+    }
+    ConstConstraint::Compare compare = (ConstConstraint::Compare)(rng() % 4);
+    parent->addConstraint(new ConstConstraint(
+        compare, Constraint::STRICT, rng() % 16, "",
+        std::vector<std::string>()));
+  }
+}
+
+std::vector<std::unique_ptr<Rule>> createRules() {
+  std::vector<std::unique_ptr<Rule>> rules;
+  std::mt19937 pick(Seed);
+  for (unsigned i = 0; i < NumRules; ++i) {
+    // Rules drawn from the same shape get identical bodies, like a
+    // precondition shared by several rules.
+    unsigned shape = pick() % std::max(1u, (unsigned)NumShapes);
+    std::mt19937 rng(Seed * 7919 + shape);
+    Rule *rule = new Rule("rule" + std::to_string(i), Constraint::STRICT,
+                          (ChainConstraint::ChainType)(rng() % 3));
+    addConstraints(rule, rng, 2);
+    rules.emplace_back(rule);
+  }
+  return rules;
+}
+
+std::vector<std::unique_ptr<Path>> createPaths(Module &M) {
+  LLVMContext &C = M.getContext();
+  Function *F = Function::Create(FunctionType::get(Type::getVoidTy(C), false),
+                                 GlobalValue::ExternalLinkage, "bench", &M);
+  IRBuilder<> B(BasicBlock::Create(C, "entry", F));
+  Value *slot = B.CreateAlloca(B.getInt64Ty());
+
+  std::mt19937 rng(Seed);
+  std::vector<StoreInst *> stores;
+  for (unsigned i = 0; i < std::max(1u, (unsigned)NumStores); ++i)
+    stores.push_back(B.CreateStore(B.getInt64(rng() % 16), slot));
+  B.CreateRetVoid();
+
+  std::vector<std::unique_ptr<Path>> paths;
+  for (unsigned i = 0; i < NumPaths; ++i) {
+    StoreInst *store = stores[rng() % stores.size()];
+    Path *path = new Path();
+    path->setEntry(new PathElement(store, store->getPointerOperand()));
+    paths.emplace_back(path);
+  }
+  return paths;
+}
+
+int runRules() {
+  LLVMContext C;
+  Module M("bench", C);
+  std::vector<std::unique_ptr<Rule>> rules = createRules();
+  std::vector<std::unique_ptr<Path>> paths = createPaths(M);
+  outs() << rules.size() << " rules x " << paths.size() << " paths\n";
+
+  std::vector<char> expected;
+  expected.reserve(rules.size() * paths.size());
+  Clock::time_point start = Clock::now();
+  for (auto &rule : rules)
+    for (auto &path : paths)
+      expected.push_back(rule->checkConstraint(path->getLast()));
+  outs() << "tree walk:          " << secondsSince(start) << "s\n";
+
+  start = Clock::now();
+  std::vector<const RuleProgram *> programs;
+  for (auto &rule : rules)
+    programs.push_back(&rule->getProgram());
+  outs() << "compile:            " << secondsSince(start) << "s\n";
+
+  size_t mismatches = 0;
+  size_t i = 0;
+  start = Clock::now();
+  for (auto &program : programs)
+    for (auto &path : paths)
+      mismatches += program->evaluate(path->getLast()) != (bool)expected[i++];
+  outs() << "program:            " << secondsSince(start) << "s\n";
+
+  i = 0;
+  start = Clock::now();
+  for (auto &rule : rules)
+    for (auto &path : paths)
+      mismatches += rule->checkRule(path.get()) != (bool)expected[i++];
+  outs() << "program and cache:  " << secondsSince(start) << "s\n";
+
+  RuleProgram::printStatistics(outs());
+  if (mismatches) {
+    errs() << mismatches << " results differ from the tree walk\n";
+    return 1;
+  }
+  return 0;
+}
+
+typedef nlohmann::json json;
+
+slicerbench::GeneratorOptions getGeneratorOptions() {
+  return {NumFunctions, NumBlocks, NumCalls, Seed};
+}
+
+bool writeFile(StringRef Path, function_ref<void(raw_ostream &)> Write) {
+  std::error_code EC;
+  raw_fd_ostream OS(Path, EC, sys::fs::F_None);
+  if (EC) {
+    errs() << Path << ": " << EC.message() << "\n";
+    return false;
+  }
+  Write(OS);
+  return true;
+}
+
+int runGenerate() {
+  LLVMContext C;
+  slicerbench::MachOFixture Fixture;
+  std::unique_ptr<Module> M =
+      slicerbench::generateModule(C, Fixture, getGeneratorOptions());
+  if (verifyModule(*M, &errs()))
+    return 1;
+  if (!writeFile(OutputPrefix + ".ll",
+                 [&](raw_ostream &OS) { OS << *M; }) ||
+      !writeFile(OutputPrefix + ".macho",
+                 [&](raw_ostream &OS) { Fixture.write(OS); }) ||
+      !writeFile(OutputPrefix + ".rules.json", slicerbench::writeRules))
+    return 1;
+  outs() << "llvm-slicer " << OutputPrefix << ".ll -binary=" << OutputPrefix
+         << ".macho -rules=" << OutputPrefix << ".rules.json\n";
+  return 0;
+}
+
+// Encodings as clang emits them for common UIKit and Foundation methods.
+const char *const SampleEncodings[] = {
+    "v16@0:8",
+    "@16@0:8",
+    "B16@0:8",
+    "v24@0:8@16",
+    "v20@0:8B16",
+    "@24@0:8q16",
+    "v32@0:8@16@24",
+    "@32@0:8@16^@24",
+    "v24@0:8@\"NSString\"16",
+    "B48@0:8@\"UITextField\"16{_NSRange=QQ}24@\"NSString\"40",
+    "v48@0:8{CGRect={CGPoint=dd}{CGSize=dd}}16",
+    "{CGRect={CGPoint=dd}{CGSize=dd}}16@0:8",
+    "v40@0:8{CGAffineTransform=dddddd}16",
+    "v32@0:8@16@?<v@?@\"NSData\"@\"NSError\">24",
+    "@40@0:8r*16Q24Q32",
+    "v28@0:8[4i]16f24",
+    "v32@0:8(?=qd)16d24",
+    "v72@0:8@16@24@32@40@48@56@64",
+};
+
+int runEncodings() {
+  std::vector<std::string> Encodings;
+  auto addMethods = [&](const std::vector<ObjectiveC::Method> &Methods) {
+    for (const ObjectiveC::Method &M : Methods)
+      Encodings.push_back(M.getType());
+  };
+  if (InputFilename.empty()) {
+    for (const char *E : SampleEncodings)
+      Encodings.push_back(E);
+  } else {
+    ObjectiveCBinary Binary(InputFilename);
+    for (auto *Classes : {&Binary.getClasses(), &Binary.getMetaClasses()})
+      for (auto &C : *Classes)
+        if (C.second->getType() == ObjectiveC::Initialized)
+          addMethods(
+              static_cast<ObjectiveC::Class &>(*C.second).getMethods());
+    for (auto &P : Binary.getProtocols()) {
+      addMethods(P.second.getInstanceMethods());
+      addMethods(P.second.getClassMethods());
+    }
+  }
+  std::vector<std::string> Unique = Encodings;
+  std::sort(Unique.begin(), Unique.end());
+  Unique.erase(std::unique(Unique.begin(), Unique.end()), Unique.end());
+  unsigned Incomplete = 0;
+  for (const std::string &E : Unique)
+    Incomplete += !ObjectiveC::MethodLayout::get(E).isComplete();
+  outs() << Encodings.size() << " methods, " << Unique.size()
+         << " distinct encodings, " << Incomplete << " not fully decoded\n";
+  if (Encodings.empty())
+    return 0;
+
+  // Repeat small inputs so the timings are not all noise.
+  unsigned Rounds = std::max<size_t>(1, 1000000 / Encodings.size());
+  size_t Mismatches = 0;
+  Clock::time_point start = Clock::now();
+  size_t Sink = 0;
+  for (unsigned R = 0; R < Rounds; ++R)
+    for (const std::string &E : Encodings)
+      Sink += ObjectiveC::MethodLayout::decode(E).getArgs().size();
+  double Decode = secondsSince(start);
+
+  start = Clock::now();
+  for (unsigned R = 0; R < Rounds; ++R)
+    for (const std::string &E : Encodings)
+      Sink -= ObjectiveC::MethodLayout::get(E).getArgs().size();
+  double Cached = secondsSince(start);
+
+  for (const std::string &E : Unique) {
+    ObjectiveC::MethodLayout Decoded = ObjectiveC::MethodLayout::decode(E);
+    const ObjectiveC::MethodLayout &Interned =
+        ObjectiveC::MethodLayout::get(E);
+    Mismatches += Decoded.getRegTypes() != Interned.getRegTypes() ||
+                  Decoded.isComplete() != Interned.isComplete();
+  }
+
+  double Lookups = (double)Rounds * Encodings.size();
+  outs() << "decode:  " << Decode * 1e9 / Lookups << " ns/method\n";
+  outs() << "cached:  " << Cached * 1e9 / Lookups << " ns/method\n";
+  ObjectiveC::MethodLayout::printStatistics(outs());
+
+  if (!CorpusDir.empty()) {
+    if (std::error_code EC = sys::fs::create_directories(CorpusDir)) {
+      errs() << CorpusDir << ": " << EC.message() << "\n";
+      return 1;
+    }
+    for (const std::string &E : Unique) {
+      MD5 Hash;
+      Hash.update(E);
+      MD5::MD5Result Result;
+      Hash.final(Result);
+      SmallString<32> Name;
+      MD5::stringifyResult(Result, Name);
+      SmallString<128> Path(CorpusDir);
+      sys::path::append(Path, Name);
+      if (!writeFile(Path, [&](raw_ostream &OS) { OS << E; }))
+        return 1;
+    }
+  }
+
+  if (Sink || Mismatches) {
+    errs() << "cached and uncached layouts differ\n";
+    return 1;
+  }
+  return 0;
+}
+
+/*
+ * Sets an option of the slicer libraries as if it was given on the command
+ * line. A value the user gave is kept unless the benchmark has to own the
+ * option, which is then an error.
+ */
+bool setOption(StringRef Name, StringRef Value, bool Owned) {
+  StringMap<cl::Option *> &Options = cl::getRegisteredOptions();
+  auto It = Options.find(Name);
+  if (It == Options.end()) {
+    errs() << "unknown option -" << Name << "\n";
+    return false;
+  }
+  if (It->second->getNumOccurrences()) {
+    if (Owned)
+      errs() << "-" << Name << " is set by -mode=pipeline\n";
+    return !Owned;
+  }
+  return !It->second->addOccurrence(0, Name, Value);
+}
+
+// Pointers printed into the report differ from run to run.
+void stripAddresses(json &J) {
+  if (J.is_object()) {
+    J.erase("address");
+    if (J.count("logicalLocations"))
+      for (json &L : J["logicalLocations"])
+        L.erase("name");
+  }
+  if (J.is_object() || J.is_array())
+    for (json &Child : J)
+      stripAddresses(Child);
+}
+
+// MD5 of the findings and of the sliced module.
+bool digestResults(StringRef ReportPath, const Module &M, std::string &Digest) {
+  MD5 Hash;
+  ErrorOr<std::unique_ptr<MemoryBuffer>> Report =
+      MemoryBuffer::getFile(ReportPath);
+  if (Report) {
+    SmallVector<StringRef, 16> Lines;
+    (*Report)->getBuffer().split(Lines, "\n", -1, false);
+    for (unsigned I = 0; I < Lines.size(); ++I) {
+      json Finding;
+      try {
+        Finding = json::parse(Lines[I].str());
+      } catch (std::exception &E) {
+        errs() << ReportPath << ":" << I + 1 << ": " << E.what() << "\n";
+        return false;
+      }
+      stripAddresses(Finding);
+      Hash.update(Finding.dump());
+      Hash.update("\n");
+    }
+  }
+  std::string Text;
+  raw_string_ostream OS(Text);
+  OS << M;
+  Hash.update(OS.str());
+
+  MD5::MD5Result Result;
+  Hash.final(Result);
+  SmallString<32> Str;
+  MD5::stringifyResult(Result, Str);
+  Digest = Str.str();
+  return true;
+}
+
+bool readJSON(StringRef Path, json &J) {
+  ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer = MemoryBuffer::getFile(Path);
+  if (!Buffer) {
+    errs() << Path << ": " << Buffer.getError().message() << "\n";
+    return false;
+  }
+  try {
+    J = json::parse((*Buffer)->getBuffer().str());
+  } catch (std::exception &E) {
+    errs() << Path << ": " << E.what() << "\n";
+    return false;
+  }
+  return true;
+}
+
+// Compares the run with the reference; false if it differs or regressed.
+bool compareWithReference(const json &Run, const json &Reference) {
+  bool OK = true;
+  if (Reference["input"] != Run["input"]) {
+    errs() << "the reference was recorded for a different input: "
+           << Reference["input"].dump() << "\n";
+    return false;
+  }
+  if (Reference["digest"] != Run["digest"]) {
+    errs() << "results differ from the reference\n";
+    OK = false;
+  }
+
+  outs() << "phase                                      wall  reference   change\n";
+  const json &Phases = Run["phases"];
+  const json &RefPhases = Reference["phases"];
+  for (auto It = Phases.begin(); It != Phases.end(); ++It) {
+    double Wall = It.value().get<double>();
+    auto Ref = RefPhases.find(It.key());
+    if (Ref == RefPhases.end()) {
+      outs() << format("%-36s %9.3fs %10c\n", It.key().c_str(), Wall, '-');
+      continue;
+    }
+    double RefWall = Ref->get<double>();
+    bool Slower =
+        Wall > RefWall * (1 + Tolerance) && Wall - RefWall > MinSlowdown;
+    outs() << format("%-36s %9.3fs %9.3fs %+7.1f%%", It.key().c_str(), Wall,
+                     RefWall,
+                     RefWall > 0 ? 100 * (Wall - RefWall) / RefWall : 0.0)
+           << (Slower ? "  slower\n" : "\n");
+    OK &= !Slower;
+  }
+  return OK;
+}
+
+/*
+ * A temporary directory for the files of a run, removed with them when the
+ * run is done. The files are all at its top level.
+ */
+class ScratchDir {
+  SmallString<128> Dir;
+
+public:
+  ~ScratchDir() {
+    if (Dir.empty())
+      return;
+    std::vector<std::string> Files;
+    std::error_code EC;
+    for (sys::fs::directory_iterator It(Dir, EC), End; It != End && !EC;
+         It.increment(EC))
+      Files.push_back(It->path());
+    for (const std::string &File : Files)
+      sys::fs::remove(File);
+    sys::fs::remove(Dir);
+  }
+
+  bool create() {
+    if (std::error_code EC =
+            sys::fs::createUniqueDirectory("slicer-bench", Dir)) {
+      errs() << EC.message() << "\n";
+      return false;
+    }
+    return true;
+  }
+
+  std::string getFile(StringRef Name) const {
+    return (Dir + "/" + Name).str();
+  }
+};
+
+int runPipeline() {
+  ScratchDir Dir;
+  if (!Dir.create())
+    return 1;
+  std::string Report = Dir.getFile("report.jsonl");
+  std::string Profile = Dir.getFile("profile.json");
+
+  LLVMContext &C = getGlobalContext();
+  std::unique_ptr<Module> M;
+  json Run;
+  if (InputFilename.empty()) {
+    slicerbench::MachOFixture Fixture;
+    M = slicerbench::generateModule(C, Fixture, getGeneratorOptions());
+    std::string Binary = Dir.getFile("fixture.macho");
+    std::string Rules = Dir.getFile("rules.json");
+    if (!writeFile(Binary, [&](raw_ostream &OS) { Fixture.write(OS); }) ||
+        !writeFile(Rules, slicerbench::writeRules) ||
+        !setOption("binary", Binary, false) ||
+        !setOption("rules", Rules, false))
+      return 1;
+    Run["input"] = {{"functions", NumFunctions.getValue()},
+                    {"blocks", NumBlocks.getValue()},
+                    {"calls", NumCalls.getValue()},
+                    {"seed", Seed.getValue()}};
+  } else {
+    SMDiagnostic Err;
+    M = parseIRFile(InputFilename, Err, C);
+    if (!M) {
+      Err.print("llvm-slicer-bench", errs());
+      return 1;
+    }
+    Run["input"] = sys::path::filename(InputFilename).str();
+  }
+  if (!setOption("r", Report, true) ||
+      !setOption("report-format", "jsonl", true) ||
+      !setOption("phase-profile", Profile, true))
+    return 1;
+
+  legacy::PassManager PM;
+  PM.add(new PostDominatorTree());
+  PM.add(new PostDominanceFrontier());
+  PM.add(new LoopInfoWrapperPass());
+  PM.add(new DetectParametersPass());
+  PM.add(new StackAccessPass());
+  PM.add(new Slicer());
+  PM.run(*M);
+
+  json Phases;
+  if (!readJSON(Profile, Phases))
+    return 1;
+  std::string Digest;
+  if (!digestResults(Report, *M, Digest))
+    return 1;
+  Run["digest"] = Digest;
+  Run["peakRss"] = Phases["peakRss"];
+  json &Totals = Phases["totals"];
+  for (auto It = Totals.begin(); It != Totals.end(); ++It)
+    Run["phases"][It.key()] = It.value()["wall"];
+  outs() << "digest " << Run["digest"].get<std::string>() << ", peak RSS "
+         << Run["peakRss"].get<uint64_t>() / (1024 * 1024) << " MB\n";
+
+  if (WriteReference) {
+    if (ReferenceFile.empty()) {
+      errs() << "-write-reference needs -reference\n";
+      return 1;
+    }
+    return writeFile(ReferenceFile,
+                     [&](raw_ostream &OS) { OS << Run.dump(2) << "\n"; })
+               ? 0
+               : 1;
+  }
+  if (ReferenceFile.empty()) {
+    for (auto It = Run["phases"].begin(); It != Run["phases"].end(); ++It)
+      outs() << format("%-36s %9.3fs\n", It.key().c_str(),
+                       It.value().get<double>());
+    return 0;
+  }
+  json Reference;
+  if (!readJSON(ReferenceFile, Reference))
+    return 1;
+  return compareWithReference(Run, Reference) ? 0 : 1;
+}
+
+// The command line the benchmark was started with.
+std::vector<const char *> ProgramArgs;
+
+// Runs -mode=pipeline with the arguments given and Extra, recording to Path.
+bool runPipelineChild(StringRef Executable, StringRef Path,
+                      ArrayRef<const char *> Extra) {
+  std::string Reference = ("-reference=" + Path).str();
+  std::vector<const char *> Args = {ProgramArgs[0], "-mode=pipeline",
+                                    "-write-reference", Reference.c_str()};
+  ArrayRef<const char *> Given = makeArrayRef(ProgramArgs).slice(1);
+  for (size_t I = 0; I < Given.size(); ++I) {
+    StringRef Arg = Given[I];
+    StringRef Name = Arg.ltrim("-").split('=').first;
+    if (!Arg.startswith("-")) {
+      Args.push_back(Given[I]);
+    } else if (Name == "mode" || Name == "reference") {
+      // Also spelled -mode demand, the value is the next argument then.
+      if (!Arg.count('='))
+        ++I;
+    } else if (Name != "write-reference") {
+      Args.push_back(Given[I]);
+    }
+  }
+  Args.insert(Args.end(), Extra.begin(), Extra.end());
+  Args.push_back(nullptr);
+
+  std::string Error;
+  int Result = sys::ExecuteAndWait(Executable, Args.data(), nullptr, nullptr,
+                                   0, 0, &Error);
+  if (Result) {
+    errs() << "-mode=pipeline failed";
+    if (!Error.empty())
+      errs() << ": " << Error;
+    errs() << "\n";
+  }
+  return !Result;
+}
+
+/*
+ * Each run gets a process of its own, the slicer keeps the analysis in
+ * globals and options can not be unset.
+ */
+int runDemand() {
+  std::string Executable =
+      sys::fs::getMainExecutable(ProgramArgs[0], (void *)(intptr_t)&runDemand);
+  ScratchDir Dir;
+  if (!Dir.create())
+    return 1;
+  std::string Exhaustive = Dir.getFile("exhaustive.json");
+  std::string Demand = Dir.getFile("demand.json");
+  outs() << "exhaustive points-to sets\n";
+  if (!runPipelineChild(Executable, Exhaustive, None))
+    return 1;
+  outs() << "demand-driven points-to queries\n";
+  if (!runPipelineChild(Executable, Demand, {"-pts-demand"}))
+    return 1;
+
+  json Reference, Run;
+  if (!readJSON(Exhaustive, Reference) || !readJSON(Demand, Run))
+    return 1;
+  compareWithReference(Run, Reference);
+  return Run["digest"] == Reference["digest"] ? 0 : 1;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  sys::PrintStackTraceOnErrorSignal();
+  PrettyStackTraceProgram X(argc, argv);
+  llvm_shutdown_obj Y;
+  cl::ParseCommandLineOptions(argc, argv, "slicer benchmarks\n");
+  ProgramArgs.assign(argv, argv + argc);
+
+  switch (Mode) {
+  case RulesMode:
+    return runRules();
+  case GenerateMode:
+    return runGenerate();
+  case PipelineMode:
+    return runPipeline();
+  case EncodingsMode:
+    return runEncodings();
+  case DemandMode:
+    return runDemand();
+  }
+  llvm_unreachable("Unknown benchmark");
+}
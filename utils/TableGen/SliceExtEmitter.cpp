@@ -2,6 +2,7 @@
 
 #include <llvm/TableGen/Record.h>
 #include <llvm/Support/raw_ostream.h>
+#include <algorithm>
 
 
 #define PRE_REGS "DetectParametersPass::getRegisterValuesBeforeCall"
@@ -22,13 +23,24 @@ namespace llvm {
     void EmitRegisterTranslation(RecordKeeper &RK, raw_ostream &OS) {
 
         OS << "namespace {\n"
-                      "int translateRegister(std::string RegName) {\n";
+              "struct RegisterName {\n"
+              "  const char *Name;\n"
+              "  int Idx;\n"
+              "};\n\n"
+              "const RegisterName RegisterNames[] = {\n";
 
         for (const auto &R : RK.getAllDerivedDefinitions("TranslateReg")) {
-            OS << "  if (RegName == \"" << R->getValueAsString("Name") << "\") \n    return " << R->getValueAsInt("idx") << ";\n";
+            OS << "    {\"" << R->getValueAsString("Name") << "\", " << R->getValueAsInt("idx") << "},\n";
         }
 
-        OS << "  llvm_unreachable(\"Unknown Register\");\n}\n}\n";
+        OS << "};\n\n"
+              "int translateRegister(StringRef RegName) {\n"
+              "  for (const RegisterName &R : RegisterNames)\n"
+              "    if (RegName == R.Name)\n"
+              "      return R.Idx;\n"
+              "  llvm_unreachable(\"Unknown Register\");\n"
+              "}\n"
+              "} // namespace\n";
 
     }
 
@@ -131,24 +143,73 @@ namespace llvm {
         }
     }
 
-    void EmitCompares(RecordKeeper &RK, raw_ostream &OS, string_map_t &Functions, std::string ParamList, std::string Parameters) {
-
-        OS << "bool handleCall(" << ParamList << ") {\n";
+    /*
+     * Emits the dispatch table: the external function names sorted by
+     * StringRef order, each with the range of its handlers in
+     * ExternalHandlers, and findExternalCall() to look a name up by binary
+     * search.
+     */
+    void EmitDispatchTable(RecordKeeper &RK, raw_ostream &OS, string_map_t &Functions, std::string HandlerParams) {
 
+        std::vector<string_map_t::iterator> Sorted;
         for (string_map_t::iterator F_it = Functions.begin(); F_it != Functions.end(); ++F_it) {
+            Sorted.push_back(F_it);
+        }
+        std::sort(Sorted.begin(), Sorted.end(), [](string_map_t::iterator A, string_map_t::iterator B) {
+            return StringRef(A->first) < StringRef(B->first);
+        });
 
-            OS << "  if (FName == \"" << F_it->first << "\") {\n";
+        OS << "namespace {\n"
+              "struct ExternalCall {\n"
+              "  const char *Name;\n"
+              "  unsigned Length;\n"
+              "  unsigned Begin;\n"
+              "  unsigned End;\n"
+              "};\n\n"
+              "const ExternalCall ExternalCalls[] = {\n";
+
+        unsigned Begin = 0;
+        for (auto &F_it : Sorted) {
+            unsigned End = Begin + F_it->second->size();
+            OS << "    {\"" << F_it->first << "\", " << F_it->first.size() << ", " << Begin << ", " << End << "},\n";
+            Begin = End;
+        }
+        OS << "};\n\n";
 
-            for (string_list_t::iterator F2_it = F_it->second->begin(); F2_it != F_it->second->end(); ++F2_it) {
-                OS << "    " << *F2_it << "("<< Parameters <<");\n";
+        OS << "void (*const ExternalHandlers[])(" << HandlerParams << ") = {\n";
+        for (auto &F_it : Sorted) {
+            for (auto &Handler : *F_it->second) {
+                OS << "    " << Handler << ",\n";
             }
-            OS << "    return true;\n";
-
-            OS << "  }\n";
         }
+        // Keeps the table non-empty.
+        OS << "    nullptr,\n"
+              "};\n\n";
+
+        OS << "const ExternalCall *findExternalCall(StringRef FName) {\n"
+              "  const ExternalCall *Begin = std::begin(ExternalCalls);\n"
+              "  const ExternalCall *End = std::end(ExternalCalls);\n"
+              "  const ExternalCall *It = std::lower_bound(\n"
+              "      Begin, End, FName, [](const ExternalCall &C, StringRef Name) {\n"
+              "        return StringRef(C.Name, C.Length) < Name;\n"
+              "      });\n"
+              "  if (It == End || StringRef(It->Name, It->Length) != FName)\n"
+              "    return nullptr;\n"
+              "  return It;\n"
+              "}\n"
+              "} // namespace\n\n";
+    }
+
+    void EmitCompares(RecordKeeper &RK, raw_ostream &OS, string_map_t &Functions, std::string ParamList, std::string Parameters) {
 
-        OS << "  return false;\n";
-        OS << "}\n\n";
+        OS << "bool handleCall(" << ParamList << ") {\n"
+              "  const ExternalCall *Call = findExternalCall(FName);\n"
+              "  if (!Call)\n"
+              "    return false;\n"
+              "  for (unsigned i = Call->Begin; i != Call->End; ++i)\n"
+              "    ExternalHandlers[i](" << Parameters << ");\n"
+              "  return true;\n"
+              "}\n\n";
     }
 
     void EmitSliceExt(RecordKeeper &RK, raw_ostream &OS) {
@@ -156,7 +217,10 @@ namespace llvm {
         OS << "#ifndef LLVM_EXTERNALHANDLER_H\n"
                       "#define LLVM_EXTERNALHANDLER_H\n"
                       "\n"
+                      "#include \"llvm/ADT/StringRef.h\"\n"
                       "#include \"llvm/Analysis/Andersen/DetectParametersPass.h\"\n"
+                      "#include <algorithm>\n"
+                      "#include <iterator>\n"
                       "\n"
                       "namespace llvm {\n\n";
 
@@ -164,6 +228,8 @@ namespace llvm {
 
         EmitExtSliceCode(RK, OS);
 
+        EmitDispatchTable(RK, OS, FunctionMap, "llvm::slicing::InsInfo *, const ptr::PointsToSets &");
+
         EmitCompares(RK, OS, FunctionMap, "llvm::slicing::InsInfo *CallInst, std::string FName, const ptr::PointsToSets &PS", "CallInst, PS");
 
         OS << "}\n"
@@ -326,19 +392,18 @@ namespace llvm {
 
     void EmitHelperPtsTo(RecordKeeper &RK, raw_ostream &OS) {
 
-        OS << "bool canHandleCall(const std::string &FName) {\n";
-        for (auto &F : PtsToFnMap) {
-            OS << "  if (FName == \"" << F.first << "\")\n"
-                  "    return true;\n";
-        }
-        OS << "  return false;\n"
-                      "}\n\n";
+        OS << "bool canHandleCall(const std::string &FName) {\n"
+              "  return findExternalCall(FName) != nullptr;\n"
+              "}\n\n";
     }
 
     void EmitPtsToExt(RecordKeeper &RK, raw_ostream &OS) {
 
         OS << "#ifndef LLVM_EXTERNALHANDLER_H\n"
-                      "#define LLVM_EXTERNALHANDLER_H\n\n";
+                      "#define LLVM_EXTERNALHANDLER_H\n\n"
+                      "#include \"llvm/ADT/StringRef.h\"\n"
+                      "#include <algorithm>\n"
+                      "#include <iterator>\n\n";
 
         OS << "namespace llvm {\n"
                       "    namespace pointsto {\n";
@@ -349,6 +414,8 @@ namespace llvm {
 
                 (RK, OS);
 
+        EmitDispatchTable(RK, OS, PtsToFnMap, "llvm::Instruction *, Andersen *");
+
         EmitHelperPtsTo(RK, OS);
 
         EmitCompares(RK, OS, PtsToFnMap, "llvm::Instruction *CallInst, Andersen *andersen, const std::string &FName", "CallInst, andersen");
@@ -425,17 +492,124 @@ namespace llvm {
         OS << "#ifndef LLVM_EXTERNALMODHANDLER_H\n"
                 "#define LLVM_EXTERNALMODHANDLER_H\n"
                 "\n"
+                "#include \"llvm/ADT/StringRef.h\"\n"
                 "#include \"llvm/Analysis/Andersen/DetectParametersPass.h\"\n"
+                "#include <algorithm>\n"
+                "#include <iterator>\n"
                 "\n"
                 "namespace llvm {\n\n";
 
 
         EmitRegisterTranslation(RK, OS);
         EmitExtModifiesCode(RK, OS);
+        EmitDispatchTable(RK, OS, FunctionMap, "llvm::Instruction *, const ptr::PointsToSets &, llvm::mods::ProgramStructure::Commands &, std::mutex &");
         EmitCompares(RK, OS, FunctionMap, "llvm::Instruction *CallInst, const ptr::PointsToSets &PS, const std::string &FName, llvm::mods::ProgramStructure::Commands &commands, std::mutex &lock", "CallInst, PS, commands, lock");
 
         OS << "}\n"
                       "#endif\n";
     }
 
+    void EmitModelString(raw_ostream &OS, StringRef S) {
+        OS << "\"";
+        OS.write_escaped(S);
+        OS << "\"";
+    }
+
+    void EmitModelRegister(raw_ostream &OS, const Record *Reg) {
+        if (Reg->isSubClassOf("Pre") || Reg->isSubClassOf("PreStore") || Reg->isSubClassOf("Post")) {
+            const char *Kind = Reg->isSubClassOf("Pre") ? "Pre" : Reg->isSubClassOf("PreStore") ? "PreStore" : "Post";
+            OS << "{\"kind\": \"" << Kind << "\", \"name\": ";
+            EmitModelString(OS, Reg->getValueAsString("Name"));
+            OS << "}";
+        } else if (Reg->isSubClassOf("DummyObject")) {
+            OS << "{\"kind\": \"DummyObject\", \"name\": ";
+            EmitModelString(OS, Reg->getValueAsString("name"));
+            OS << "}";
+        } else if (Reg->isSubClassOf("Pts")) {
+            OS << "{\"kind\": \"Pts\", \"reg\": ";
+            EmitModelRegister(OS, Reg->getValueAsDef("reg"));
+            OS << "}";
+        } else if (Reg->isSubClassOf("Call")) {
+            OS << "{\"kind\": \"Call\"}";
+        } else {
+            Reg->dump();
+            llvm_unreachable("");
+        }
+    }
+
+    /*
+     * Emits the same operations as the three handler backends as a JSON
+     * model, read at startup with -external-models and interpreted by
+     * ExternalModel instead of the compiled handlers.
+     */
+    void EmitExtModel(RecordKeeper &RK, raw_ostream &OS) {
+        OS << "{\n  \"registers\": {";
+        bool First = true;
+        for (const auto &R : RK.getAllDerivedDefinitions("TranslateReg")) {
+            OS << (First ? "\n    " : ",\n    ");
+            EmitModelString(OS, R->getValueAsString("Name"));
+            OS << ": " << R->getValueAsInt("idx");
+            First = false;
+        }
+        OS << "\n  },\n  \"functions\": [";
+
+        First = true;
+        for (const auto &F : RK.getAllDerivedDefinitions("Function")) {
+            OS << (First ? "\n    " : ",\n    ");
+            First = false;
+            OS << "{\"name\": ";
+            EmitModelString(OS, F->getValueAsString("Name"));
+
+            OS << ",\n     \"slice\": [";
+            bool FirstOp = true;
+            for (const auto &S : F->getValueAsListOfDefs("SliceOperations")) {
+                OS << (FirstOp ? "" : ", ");
+                FirstOp = false;
+                // DefMod derives from Def and Ref1 from Ref.
+                if (S->isSubClassOf("DefMod") || S->isSubClassOf("Def")) {
+                    OS << "{\"op\": \"" << (S->isSubClassOf("DefMod") ? "DefMod" : "Def") << "\", \"reg\": ";
+                    EmitModelRegister(OS, S->getValueAsDef("define"));
+                } else if (S->isSubClassOf("Ref1") || S->isSubClassOf("Ref")) {
+                    OS << "{\"op\": \"" << (S->isSubClassOf("Ref1") ? "Ref1" : "Ref") << "\", \"reg\": ";
+                    EmitModelRegister(OS, S->getValueAsDef("reference"));
+                } else {
+                    S->getSuperClasses().back()->dump();
+                    llvm_unreachable("Not handled");
+                }
+                OS << "}";
+            }
+
+            OS << "],\n     \"ptsto\": [";
+            FirstOp = true;
+            for (const auto &S : F->getValueAsListOfDefs("PtsToOperations")) {
+                OS << (FirstOp ? "" : ", ");
+                FirstOp = false;
+                if (S->isSubClassOf("Load") || S->isSubClassOf("Store")) {
+                    OS << "{\"op\": \"" << (S->isSubClassOf("Load") ? "Load" : "Store") << "\", \"val\": ";
+                    EmitModelRegister(OS, S->getValueAsDef("val"));
+                    OS << ", \"loc\": ";
+                    EmitModelRegister(OS, S->getValueAsDef("loc"));
+                } else if (S->isSubClassOf("Alloc")) {
+                    OS << "{\"op\": \"Alloc\", \"reg\": ";
+                    EmitModelRegister(OS, S->getValueAsDef("reg"));
+                    OS << ", \"type\": ";
+                    EmitModelString(OS, S->getValueAsString("type"));
+                } else if (S->isSubClassOf("Copy")) {
+                    OS << "{\"op\": \"Copy\", \"from\": ";
+                    EmitModelRegister(OS, S->getValueAsDef("from"));
+                    OS << ", \"to\": ";
+                    EmitModelRegister(OS, S->getValueAsDef("to"));
+                } else if (S->isSubClassOf("Loc")) {
+                    OS << "{\"op\": \"Loc\", \"reg\": ";
+                    EmitModelRegister(OS, S->getValueAsDef("reg"));
+                } else {
+                    llvm_unreachable("Not handled");
+                }
+                OS << "}";
+            }
+            OS << "]}";
+        }
+        OS << "\n  ]\n}\n";
+    }
+
 }
@@ -44,7 +44,8 @@ enum ActionType {
   GenCTags,
   GenSliceExt,
   GenPtsToExt,
-  GenModExt
+  GenModExt,
+  GenExtModel
 };
 
 namespace {
@@ -94,6 +95,8 @@ namespace {
                                "Generate points-to definitions for external functions"),
                     clEnumValN(GenModExt, "gen-mod-ext",
                                "Generate MOD definitions for external functions"),
+                    clEnumValN(GenExtModel, "gen-ext-model",
+                               "Generate the interpreted model of external functions"),
                     clEnumValEnd));
 
   cl::opt<std::string>
@@ -159,6 +162,9 @@ bool LLVMTableGenMain(raw_ostream &OS, RecordKeeper &Records) {
   case GenModExt:
       EmitMODExt(Records, OS);
       break;
+  case GenExtModel:
+      EmitExtModel(Records, OS);
+      break;
   case PrintEnums:
   {
     for (Record *Rec : Records.getAllDerivedDefinitions(Class))
@@ -81,6 +81,7 @@ void EmitCTags(RecordKeeper &RK, raw_ostream &OS);
 void EmitSliceExt(RecordKeeper &RK, raw_ostream &OS);
 void EmitPtsToExt(RecordKeeper &RK, raw_ostream &OS);
 void EmitMODExt(RecordKeeper &RK, raw_ostream &OS);
+void EmitExtModel(RecordKeeper &RK, raw_ostream &OS);
 
 } // End llvm namespace
 